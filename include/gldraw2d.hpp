@@ -14,8 +14,10 @@
 ////////////////*/
 #include <stddef.h>
 #include <stdint.h>
+#include "llhash.hpp"
 #include "lldatain.hpp"
 #include "llopengl.hpp"
+#include "llgui.hpp"
 
 /*////////////////////
 //   Preprocessor   //
@@ -68,33 +70,62 @@ enum packer_flags_e
     PACKER_FLAGS_USED      = (1 << 0)
 };
 
+/// @summary Identifies the placement algorithm used by a rectangle packer.
+enum packer_type_e
+{
+    PACKER_TYPE_GUILLOTINE =  0,       /// Guillotine split, best area fit from a size-bucketed free list.
+    PACKER_TYPE_MAXRECTS_BSSF,         /// MaxRects, best short side fit.
+    PACKER_TYPE_MAXRECTS_BAF,          /// MaxRects, best area fit.
+    PACKER_TYPE_SKYLINE_BL,            /// Skyline, bottom-left.
+    PACKER_TYPE_COUNT
+};
+
+/// @summary Identifies the key used to order frames before bulk packing. All
+/// orderings place larger frames first.
+enum atlas_sort_e
+{
+    ATLAS_SORT_HEIGHT      =  0,       /// Decreasing height, then decreasing width.
+    ATLAS_SORT_AREA,                   /// Decreasing area.
+    ATLAS_SORT_PERIMETER,              /// Decreasing perimeter.
+    ATLAS_SORT_MAXSIDE,                /// Decreasing length of the longest side.
+    ATLAS_SORT_COUNT
+};
+
+/// @summary Flags selecting the packer types tried by a bulk atlas pack. One
+/// trial is run for each selected packer type and each atlas_sort_e. The
+/// MaxRects packers produce the densest placements, but are several hundred
+/// times slower than the guillotine and skyline packers on large requests.
+enum atlas_pack_flags_e
+{
+    ATLAS_PACK_GUILLOTINE    = (1 << PACKER_TYPE_GUILLOTINE),
+    ATLAS_PACK_MAXRECTS_BSSF = (1 << PACKER_TYPE_MAXRECTS_BSSF),
+    ATLAS_PACK_MAXRECTS_BAF  = (1 << PACKER_TYPE_MAXRECTS_BAF),
+    ATLAS_PACK_SKYLINE_BL    = (1 << PACKER_TYPE_SKYLINE_BL),
+    ATLAS_PACK_DEFAULT       = ATLAS_PACK_GUILLOTINE | ATLAS_PACK_SKYLINE_BL,
+    ATLAS_PACK_ALL           = (1 << PACKER_TYPE_COUNT) - 1
+};
+
 /// @summary Flags used with a texture atlas entry.
 enum atlas_entry_flags_e
 {
     ATLAS_ENTRY_NORMAL     =  0,
     ATLAS_ENTRY_MULTIFRAME = (1 << 0),
-    ATLAS_ENTRY_MULTIPAGE  = (1 << 1)
-};
-
-/// @summary Defines metadata associated with a hash bucket.
-struct bucket_t
-{
-    size_t              Capacity;      /// The bucket capacity, in items.
-    size_t              Count;         /// The number of items currently in-use.
+    ATLAS_ENTRY_MULTIPAGE  = (1 << 1),
+    ATLAS_ENTRY_FREE       = (1 << 2)
 };
 
-/// @summary Represents a single node in a binary tree used for packing
-/// rectangles within a single, larger master rectangle.
-struct pknode_t
+/// @summary Identifies the state of an asynchronous DDS texture load.
+enum dds_load_state_e
 {
-    uint32_t            Flags;         /// Combination of packer_flags_e.
-    uint32_t            Index;         /// Index of the associated pkrect_t.
-    uint32_t            Child[2];      /// Index of the child nodes, 0 if no child.
-    uint32_t            Bound[4];      /// Left-Top-Right-Bottom bounding rectangle.
+    DDS_LOAD_STATE_EMPTY   =  0,       /// The load has not been created, or has been deleted.
+    DDS_LOAD_STATE_PREPARED,           /// The file has been parsed; no OpenGL objects exist yet.
+    DDS_LOAD_STATE_UPLOADING,          /// The texture exists and its levels are being uploaded.
+    DDS_LOAD_STATE_READY,              /// All levels have been uploaded.
+    DDS_LOAD_STATE_FAILED              /// The file could not be parsed or uploaded.
 };
 
 /// @summary Represents a single sub-rectangle within a larger image. This
-/// data is stored separately from nodes for more cache-friendly behavior.
+/// data is stored separately from the free space for more cache-friendly behavior.
 struct pkrect_t
 {
     size_t              X;             /// X-coordinate of upper-left corner of the content.
@@ -102,21 +133,59 @@ struct pkrect_t
     size_t              Width;         /// Width of the rectangle content.
     size_t              Height;        /// Height of the rectangle content.
     uint32_t            Content;       /// Application-defined content identifier.
-    uint32_t            Flags;         /// Flag bits, copied from the node.
+    uint32_t            Flags;         /// Combination of packer_flags_e.
+    uint32_t            PadX;          /// The horizontal padding around the content.
+    uint32_t            PadY;          /// The vertical padding around the content.
+};
+
+/// @summary Represents a free rectangle tracked by a packer. Guillotine free
+/// rectangles are disjoint. MaxRects free rectangles may overlap, but none is
+/// contained within another.
+struct pkfree_t
+{
+    uint32_t            X;             /// X-coordinate of the upper-left corner.
+    uint32_t            Y;             /// Y-coordinate of the upper-left corner.
+    uint32_t            Width;         /// Width of the free rectangle.
+    uint32_t            Height;        /// Height of the free rectangle.
+};
+
+/// @summary Represents a single horizontal segment of the skyline maintained
+/// by a skyline packer. Segments are sorted by X and cover the full width.
+struct pkskyline_t
+{
+    uint32_t            X;             /// X-coordinate of the left edge of the segment.
+    uint32_t            Y;             /// Height of the skyline along the segment.
+    uint32_t            Width;         /// Width of the segment.
+};
+
+/// @summary Stores the free rectangles of a guillotine packer whose height
+/// falls within a single power-of-two size class.
+struct pkbucket_t
+{
+    size_t              Capacity;      /// The bucket capacity, in free rectangles.
+    size_t              Count;         /// The number of free rectangles in the bucket.
+    r2d::pkfree_t      *Rects;         /// Storage for the free rectangles.
 };
 
 /// @summary Stores the data necessary for maintaining the set of sub-rectangles
-/// packed together within a single larger master rectangle.
+/// packed together within a single larger master rectangle. The Buckets array is
+/// used only by the guillotine packer, the FreeList array only by the MaxRects
+/// packers, and the Skyline array only by the skyline packer.
 struct packer_t
 {
+    uint32_t            Type;          /// One of packer_type_e.
     size_t              Width;         /// Width of primary image, in pixels.
     size_t              Height;        /// Height of primary image, in pixels.
     size_t              Free;          /// Total area currently unused.
     size_t              Used;          /// Total area currently used.
-    size_t              Capacity;      /// The capacity of the node and rectangle storage.
+    size_t              Capacity;      /// The capacity of the rectangle storage.
     size_t              Count;         /// The number of sub-rectangles currently defined.
-    r2d::pknode_t      *Nodes;         /// Storage for node instances.
+    r2d::pkbucket_t    *Buckets;       /// Guillotine free rectangles, bucketed by log2(height).
     r2d::pkrect_t      *Rects;         /// Storage for rectangle data.
+    size_t              FreeCapacity;  /// The capacity of the free rectangle or skyline storage.
+    size_t              FreeCount;     /// The number of free rectangles or skyline segments.
+    r2d::pkfree_t      *FreeList;      /// Storage for MaxRects free rectangles.
+    r2d::pkskyline_t   *Skyline;       /// Storage for skyline segments.
 };
 
 /// @summary Describes a single frame within a logical texture atlas entry. Items in
@@ -136,6 +205,7 @@ struct atlas_entry_t
 {
     uint32_t            Name;          /// The hash of the name of the entry.
     uint32_t            Flags;         /// Combination of atlas_entry_flags_e.
+    uint32_t            LastUsed;      /// The atlas frame stamp at which the entry was last used.
     size_t              FrameCount;    /// The number of frames in the entry.
     size_t              MaxWidth;      /// The maximum width of any frame, in pixels.
     size_t              MaxHeight;     /// The maximum height of any frame, in pixels.
@@ -157,11 +227,89 @@ struct atlas_config_t
     GLenum              Layout;        /// The OpenGL pixel layout of the texture page(s), ex. GL_BGRA.
     GLenum              Format;        /// The OpenGL internal format of the texture page(s), ex. GL_RGBA8.
     GLenum              DataType;      /// The OpenGL data type of the texture page(s), ex. GL_UNSIGNED_INT_8_8_8_8_REV.
+    GLenum              PageTarget;    /// GL_TEXTURE_2D_ARRAY to store all pages in one texture array, otherwise GL_TEXTURE_2D.
+    uint32_t            PackerType;    /// One of packer_type_e, used to place sub-images on each page.
+    size_t              MaxPages;      /// The page limit of a dynamic atlas, or 0 for an atlas that only grows.
+};
+
+/// @summary Stores the state of an incremental atlas page defragmentation.
+/// The live sub-images of one page are repacked by a new packer and copied,
+/// a few at a time, to scratch texture storage. Entries keep referencing the
+/// original page until every sub-image has been copied, at which point the
+/// page contents and the entry frames are replaced together.
+struct atlas_defrag_t
+{
+    bool                Active;        /// true if a page is being defragmented.
+    bool                Blocked;       /// true if the last repack failed; cleared when entries are added or removed.
+    size_t              Page;          /// The index of the page being defragmented.
+    size_t              Next;          /// The zero-based index of the next sub-image to copy.
+    size_t              Count;         /// The number of sub-images on the page.
+    uint32_t           *Order;         /// The source Rects index for each repacked sub-image.
+    uint32_t           *EntryIndex;    /// The EntryList index for each repacked sub-image.
+    uint32_t           *FrameIndex;    /// The entry frame index for each repacked sub-image.
+    r2d::packer_t       Packer;        /// The packer holding the repacked layout.
+    GLuint              Scratch;       /// The scratch texture, or the texture array for array atlases.
+    size_t              ScratchLayer;  /// The scratch layer index, for array atlases.
+};
+
+/// @summary Describes a single frame whose pixel data has been copied into the
+/// transfer buffer of an atlas and is waiting to be uploaded to its page.
+struct atlas_upload_t
+{
+    uint32_t            Entry;         /// The zero-based index of the entry, or 0xFFFFFFFFU if it was removed.
+    uint32_t            Frame;         /// The zero-based index of the frame within the entry.
+    uint32_t            Page;          /// The zero-based index of the destination page.
+    uint32_t            Sequence;      /// The order in which the frame was staged.
+    size_t              X;             /// The upper-left corner of the frame on the page.
+    size_t              Y;             /// The upper-left corner of the frame on the page.
+    size_t              Width;         /// The frame width, in pixels.
+    size_t              Height;        /// The frame height, in pixels.
+    size_t              Offset;        /// The byte offset of the pixel data in the transfer buffer.
+    size_t              Size;          /// The size of the pixel data, in bytes.
+};
+
+/// @summary Reports the work performed uploading staged atlas frames.
+struct atlas_transfer_stats_t
+{
+    size_t              FlushCount;    /// The number of times staged frames were uploaded.
+    size_t              MapCount;      /// The number of times the transfer buffer was mapped.
+    size_t              FrameCount;    /// The number of frames uploaded.
+    size_t              PageCount;     /// The number of per-page upload groups.
+    size_t              UploadCalls;   /// The number of sub-image upload calls issued.
+    size_t              Bytes;         /// The number of bytes of pixel data uploaded.
+};
+
+/// @summary Stores the frames staged for a batched upload. Frames are copied
+/// into a single mapped range of the transfer buffer as they are staged. When
+/// the staged frames are flushed, the buffer is unmapped once and the frames
+/// are uploaded grouped by page and sorted by position, so that vertically
+/// adjacent frames with contiguous data share a single sub-image upload.
+/// Uploads handed to an upload scheduler are executed before the transfer
+/// buffer is next mapped or the page textures are modified.
+struct atlas_staging_t
+{
+    size_t              Capacity;      /// The number of upload records that can be stored.
+    size_t              Count;         /// The number of frames staged.
+    r2d::atlas_upload_t *List;         /// The staged frames, in the order they were staged.
+    uint8_t            *Mapped;        /// The mapped range of the transfer buffer, or NULL.
+    size_t              Base;          /// The byte offset of the mapped range in the transfer buffer.
+    size_t              Size;          /// The size of the mapped range, in bytes.
+    size_t              Used;          /// The number of bytes of the mapped range written.
+    gl::upload_scheduler_t *Scheduler; /// The scheduler holding uploads from the transfer buffer, or NULL.
+    r2d::atlas_transfer_stats_t Stats; /// The work performed since the statistics were last reported.
 };
 
 /// @summary Dynamically builds texture atlases (without mipmaps) for 2D content
 /// such as GUIs and sprites. Each texture object is referred to as a page.
 /// Updates are streamed to the texture object using a pixel buffer object.
+/// A dynamic atlas (MaxPages > 0) never allocates more than MaxPages pages;
+/// when a frame does not fit, the least-recently-used entries are evicted.
+/// Slots of removed entries are recycled through the FreeEntry list.
+/// Frame uploads may be staged and flushed in batches; see atlas_stage_frame().
+/// When PageTarget is GL_TEXTURE_2D_ARRAY, each page is a layer of a single
+/// texture array; every TexturePages entry stores the array texture ID and
+/// the page index is the layer index, so sprites on different pages can be
+/// drawn in the same batch.
 struct atlas_t
 {
     size_t              PageWidth;     /// The width of a texture page, in pixels.
@@ -174,11 +322,17 @@ struct atlas_t
     size_t              PageCapacity;  /// The number of texture page IDs that can be stored.
     size_t              PageCount;     /// The number of texture pages used.
     r2d::packer_t      *PagePackers;   /// The list of rectangle packers used to place sub-images on the page.
+    uint32_t            PackerType;    /// One of packer_type_e, used for each page packer.
     GLuint             *TexturePages;  /// The set of OpenGL texture object IDs.
-    size_t              BucketCount;   /// The number of buckets defined in the name->index table.
-    r2d::bucket_t      *BucketList;    /// The list of bucket metadata; BucketCount items.
-    uint32_t          **EntryNames;    /// A table mapping entry name->index in EntryList.
-    uint32_t          **EntryIndices;  /// A table mapping entry name->index in EntryList.
+    GLenum              PageTarget;    /// The OpenGL texture target of the page(s), GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY.
+    GLuint              TextureArray;  /// The OpenGL texture array object ID, if PageTarget is GL_TEXTURE_2D_ARRAY.
+    size_t              ArrayLayers;   /// The number of layers allocated in TextureArray.
+    hash::table_t       EntryTable;    /// A table mapping entry name->index in EntryList.
+    uint32_t            FreeEntry;     /// The index of the first free EntryList slot, or 0xFFFFFFFFU.
+    uint32_t            FrameStamp;    /// The current frame stamp, advanced by atlas_begin_frame().
+    size_t              MaxPages;      /// The page limit of a dynamic atlas, or 0.
+    r2d::atlas_defrag_t Defrag;        /// The state of any in-progress page defragmentation.
+    r2d::atlas_staging_t Staging;      /// The frames waiting to be uploaded to the texture pages.
     GLenum              PageLayout;    /// The OpenGL pixel layout of the texture page(s), ex. GL_BGRA.
     GLenum              PageFormat;    /// The OpenGL internal format of the texture page(s),  ex. GL_RGBA8.
     GLenum              PageDataType;  /// The OpenGL data type of the texture page(s), ex. GL_UNSIGNED_INT_8_8_8_8_REV.
@@ -187,6 +341,385 @@ struct atlas_t
     size_t              BufferOffset;  /// The current byte offset into the transfer buffer.
 };
 
+/// @summary Defines the header of a baked atlas file. A baked atlas file stores
+/// the entry table, frame rectangles and name lookup table of an atlas along
+/// with the pixel data of each page, so that it can be loaded with one upload
+/// per page. All offsets are specified in bytes from the start of the file.
+/// Page data is stored contiguously, PageBytes per page, in page order.
+#pragma pack(push, 1)
+struct atlas_file_header_t
+{
+    uint32_t            Magic;         /// The four character code 'LLAT'.
+    uint32_t            Version;       /// The file format version.
+    uint32_t            PageWidth;     /// The width of a texture page, in pixels.
+    uint32_t            PageHeight;    /// The height of a texture page, in pixels.
+    uint32_t            PageCount;     /// The number of texture pages.
+    uint32_t            PageTarget;    /// GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY.
+    uint32_t            PageLayout;    /// The OpenGL pixel layout of the page data, ex. GL_BGRA.
+    uint32_t            PageFormat;    /// The OpenGL internal format of the pages, ex. GL_RGBA8.
+    uint32_t            PageDataType;  /// The OpenGL data type of the page data.
+    uint32_t            HorizontalPad; /// The horizontal padding between sub-images, in pixels.
+    uint32_t            VerticalPad;   /// The vertical padding between sub-images, in pixels.
+    uint32_t            PackerType;    /// One of packer_type_e.
+    uint32_t            EntryCount;    /// The number of atlas_file_entry_t records.
+    uint32_t            FrameCount;    /// The number of atlas_file_frame_t records.
+    uint32_t            TableCapacity; /// The number of slots in the name lookup table.
+    uint32_t            TableDeleted;  /// The number of deleted slots in the name lookup table; recomputed on load.
+    uint64_t            PageBytes;     /// The size of the pixel data for one page, in bytes.
+    uint64_t            PageOffset;    /// The offset of the pixel data for the first page.
+    uint64_t            EntryOffset;   /// The offset of the entry records.
+    uint64_t            FrameOffset;   /// The offset of the frame records.
+    uint64_t            NameOffset;    /// The offset of the name lookup table storage, as
+                                       /// laid out by hash::table_t: TableCapacity tags,
+                                       /// then TableCapacity names and entry indices.
+};
+#pragma pack(pop)
+
+/// @summary Defines a single entry record in a baked atlas file. The frames of
+/// the entry are stored consecutively in the frame records.
+#pragma pack(push, 1)
+struct atlas_file_entry_t
+{
+    uint32_t            Name;          /// The hash of the name of the entry.
+    uint32_t            Flags;         /// Combination of atlas_entry_flags_e.
+    uint32_t            FrameCount;    /// The number of frames in the entry.
+    uint32_t            FirstFrame;    /// The index of the first frame record of the entry.
+};
+#pragma pack(pop)
+
+/// @summary Defines a single frame record in a baked atlas file.
+#pragma pack(push, 1)
+struct atlas_file_frame_t
+{
+    uint32_t            PageId;        /// The zero-based index of the page containing the frame.
+    uint32_t            X;             /// The upper-left corner of the frame on the page.
+    uint32_t            Y;             /// The upper-left corner of the frame on the page.
+    uint32_t            Width;         /// The frame width, in pixels.
+    uint32_t            Height;        /// The frame height, in pixels.
+};
+#pragma pack(pop)
+
+/// @summary Describes a single frame to be placed by a bulk atlas pack.
+struct atlas_pack_item_t
+{
+    uint32_t            Entry;         /// The zero-based index of the entry in the pack request.
+    uint32_t            Frame;         /// The zero-based index of the frame within the entry.
+    uint32_t            Width;         /// The un-padded width of the frame, in pixels.
+    uint32_t            Height;        /// The un-padded height of the frame, in pixels.
+};
+
+/// @summary Stores the result of packing all items of a bulk pack request
+/// using a single combination of ordering and packer type.
+struct atlas_pack_trial_t
+{
+    uint32_t            SortKey;       /// One of atlas_sort_e.
+    uint32_t            PackerType;    /// One of packer_type_e.
+    bool                Success;       /// true if every item was placed.
+    size_t              PageCount;     /// The number of pages used by the trial.
+    size_t              PageCapacity;  /// The capacity of the Pages array.
+    r2d::packer_t      *Pages;         /// The packers for each page. Content is the item index.
+};
+
+/// @summary Describes a bulk pack request for an atlas: the set of entries and
+/// frames to place, and the trials used to find the densest placement. Trials
+/// do not touch the atlas or OpenGL, so they may run on any thread.
+struct atlas_pack_plan_t
+{
+    size_t              PageWidth;     /// The width of a texture page, in pixels.
+    size_t              PageHeight;    /// The height of a texture page, in pixels.
+    size_t              HorizontalPad; /// The horizontal padding around each frame, in pixels.
+    size_t              VerticalPad;   /// The vertical padding around each frame, in pixels.
+    size_t              EntryCount;    /// The number of entries in the request.
+    uint32_t           *EntryNames;    /// The name of each entry in the request.
+    size_t             *FrameCounts;   /// The number of frames in each entry.
+    size_t              ItemCount;     /// The total number of frames in the request.
+    r2d::atlas_pack_item_t  *Items;    /// The set of frames to place.
+    size_t              TrialCount;    /// The number of trials defined.
+    r2d::atlas_pack_trial_t *Trials;   /// The set of trials, one per ordering and packer type.
+};
+
+/// @summary Stores the state of a DDS texture loaded asynchronously. The file
+/// is mapped and parsed by create_dds_load(), which does not touch OpenGL and
+/// may run on a worker thread. The texture is created and its levels uploaded
+/// through a pixel stream, a bounded number of bytes at a time, by calls to
+/// dds_load_update() on the thread that owns the OpenGL context. Handing the
+/// load from one thread to the other is left to the application.
+struct dds_load_t
+{
+    uint32_t            State;         /// One of dds_load_state_e.
+    data::file_mapping_t File;         /// The mapping of the DDS file, if loaded from a path.
+    size_t              LevelCount;    /// The number of level descriptions, ItemCount * MipCount.
+    size_t              ItemCount;     /// The number of array items or cubemap faces, or 1.
+    size_t              MipCount;      /// The number of mipmap levels per item.
+    data::dds_level_desc_t *Levels;    /// The level descriptions, pointing into the DDS data.
+    gl::level_desc_t   *GLLevels;      /// The level descriptions returned to the application.
+    GLenum              Target;        /// The OpenGL texture target, ex. GL_TEXTURE_2D.
+    GLenum              Format;        /// The OpenGL internal format, ex. GL_RGBA8.
+    GLenum              Layout;        /// The OpenGL pixel layout, ex. GL_BGRA.
+    GLenum              DataType;      /// The OpenGL data type, ex. GL_UNSIGNED_INT_8_8_8_8_REV.
+    GLuint              Texture;       /// The OpenGL texture object, or 0 before the first update.
+    size_t              NextLevel;     /// The index of the level description being uploaded.
+    size_t              NextSlice;     /// The slice of the level being uploaded.
+    size_t              NextRow;       /// The first row (or row of blocks) not yet uploaded.
+    size_t              BytesTotal;    /// The total size of the level data, in bytes.
+    size_t              BytesUploaded; /// The number of bytes of level data uploaded or queued.
+    gl::upload_scheduler_t *Scheduler; /// The scheduler holding queued bands, or NULL.
+};
+
+/// @summary Describes the image drawn for one tile type of a tile map. The
+/// texture coordinates are stored ready for use in the vertex buffer.
+struct tilemap_source_t
+{
+    float               UV[4];         /// The texture coordinates of the upper-left and lower-right corners.
+    float               Layer;         /// The texture array layer, for texture array atlases.
+    GLuint              Texture;       /// The texture object containing the image, or 0 if undefined.
+};
+
+/// @summary Describes a range of quads within a tile map chunk that sample
+/// from the same texture object.
+struct tilemap_run_t
+{
+    GLuint              Texture;       /// The texture object sampled by the quads.
+    uint32_t            First;         /// The zero-based index of the first quad within the chunk.
+    uint32_t            Count;         /// The number of quads in the run.
+};
+
+/// @summary Stores the state of a square block of tiles whose vertex data is
+/// cached in a fixed slot of the tile map vertex buffer. The quads of a chunk
+/// are grouped by texture, so each run can be drawn with a single draw call.
+struct tilemap_chunk_t
+{
+    bool                Dirty;         /// true if the cached vertex data is out of date.
+    uint32_t            QuadCount;     /// The number of non-empty tiles in the chunk.
+    size_t              RunCount;      /// The number of texture runs in the chunk.
+    size_t              RunCapacity;   /// The number of texture runs that can be stored.
+    r2d::tilemap_run_t *Runs;          /// The texture runs, ordered by texture object.
+};
+
+/// @summary Describes a single chunk run collected while drawing a tile map.
+struct tilemap_draw_t
+{
+    GLuint              Texture;       /// The texture object sampled by the run.
+    GLsizei             Count;         /// The number of indices to draw.
+    GLint               BaseVertex;    /// The first vertex of the chunk slot in the vertex buffer.
+    size_t              Offset;        /// The byte offset of the first index in the index buffer.
+};
+
+/// @summary Reports the work performed by the most recent tile map draw.
+struct tilemap_stats_t
+{
+    size_t              ChunksVisible; /// The number of chunks intersecting the view rectangle.
+    size_t              ChunksBuilt;   /// The number of chunks whose vertex data was rebuilt.
+    size_t              QuadsDrawn;    /// The number of tile quads submitted for drawing.
+    size_t              DrawCalls;     /// The number of multi-draw calls issued.
+};
+
+/// @summary Renders a static layer of tiles from cached GPU vertex data. The
+/// map is divided into square chunks, and the vertices of each chunk are
+/// generated only when one of its tiles or the tile sources change, so a
+/// static layer costs a view rectangle test per chunk and one draw call per
+/// texture each frame. Tiles store an index into Sources; index 0 marks an
+/// empty cell. Vertices are positioned in map space, with the upper-left
+/// corner of the map at the origin, and use the standard sprite vertex layout
+/// so the built-in sprite shaders can draw them. Each chunk reserves vertex
+/// storage for a full chunk of tiles.
+struct tilemap_t
+{
+    size_t              Width;         /// The width of the map, in tiles.
+    size_t              Height;        /// The height of the map, in tiles.
+    size_t              TileWidth;     /// The width of a single tile, in pixels.
+    size_t              TileHeight;    /// The height of a single tile, in pixels.
+    size_t              ChunkSize;     /// The width and height of a chunk, in tiles.
+    size_t              ChunksX;       /// The number of chunks along the horizontal axis.
+    size_t              ChunksY;       /// The number of chunks along the vertical axis.
+    size_t              DirtyCount;    /// The number of chunks marked dirty.
+    uint32_t           *Tiles;         /// Width * Height source indices, in row-major order.
+    r2d::tilemap_chunk_t *Chunks;      /// ChunksX * ChunksY chunks, in row-major order.
+    size_t              SourceCount;   /// The number of tile sources, including the empty source 0.
+    r2d::tilemap_source_t *Sources;    /// The image drawn for each tile index.
+    uint32_t            TintColor;     /// The ABGR tint color of every tile; read-only, use tilemap_set_tint().
+    uint32_t            LayerDepth;    /// The layer depth of the map; read-only, use tilemap_set_layer_depth().
+    GLuint              VertexArray;   /// The VAO describing the vertex layout.
+    GLuint              VertexBuffer;  /// The buffer storing one vertex slot per chunk.
+    GLuint              IndexBuffer;   /// The static index buffer shared by every chunk.
+    size_t              IndexSize;     /// The size of a single index, in bytes.
+    gl::sprite_vertex_ptc_t *Vertices; /// Scratch storage for the vertices of one chunk.
+    uint64_t           *SortKeys;      /// Scratch storage used to group the tiles of one chunk by texture.
+    size_t              DrawCapacity;  /// The number of draw records that can be stored.
+    size_t              DrawCount;     /// The number of draw records collected for the current view.
+    r2d::tilemap_draw_t *Draws;        /// The draw records collected for the current view.
+    GLsizei            *DrawCounts;    /// Per-draw index counts passed to the multi-draw call.
+    GLvoid            **DrawOffsets;   /// Per-draw index offsets passed to the multi-draw call.
+    GLint              *DrawBases;     /// Per-draw base vertices passed to the multi-draw call.
+    r2d::tilemap_stats_t Stats;        /// The work performed by the most recent draw.
+};
+
+/// @summary Describes a burst of particles to spawn from a particle system.
+/// Each particle receives the base velocity and lifetime plus a uniformly
+/// distributed random offset in [-jitter, +jitter].
+struct particle_spawn_t
+{
+    float               X;             /// The spawn position, in pixels.
+    float               Y;             /// The spawn position, in pixels.
+    float               VelocityX;     /// The base velocity, in pixels per-second.
+    float               VelocityY;     /// The base velocity, in pixels per-second.
+    float               VelocityJitter;/// The maximum random offset applied to each velocity component.
+    float               Lifetime;      /// The base lifetime, in seconds.
+    float               LifeJitter;    /// The maximum random offset applied to the lifetime.
+};
+
+/// @summary Stores a pool of particles sharing one image and one set of
+/// simulation parameters. Per-particle data is stored as a structure of
+/// arrays, each aligned to 16 bytes and padded to a multiple of four items,
+/// so that four particles are integrated at a time with SSE2. Dead particles
+/// are removed by moving the last live particle into their slot. Color and
+/// size are interpolated from the start to the end value over the lifetime
+/// of each particle. A particle system does not reference any OpenGL state
+/// while it is updated, so independent systems can be updated in parallel.
+struct particle_system_t
+{
+    size_t              Capacity;      /// The maximum number of live particles.
+    size_t              Count;         /// The number of live particles.
+    void               *Block;         /// The allocation backing the per-particle arrays.
+    float              *PositionX;     /// The particle positions, in pixels.
+    float              *PositionY;     /// The particle positions, in pixels.
+    float              *VelocityX;     /// The particle velocities, in pixels per-second.
+    float              *VelocityY;     /// The particle velocities, in pixels per-second.
+    float              *Age;           /// The time since each particle was spawned, in seconds.
+    float              *InvLifetime;   /// The reciprocal of the lifetime of each particle.
+    float               Gravity[2];    /// The acceleration applied to every particle, in pixels per-second squared.
+    float               Drag;          /// The fraction of velocity lost per-second, in [0, 1].
+    float               ColorStart[4]; /// The RGBA tint color of a new particle, in [0, 1].
+    float               ColorEnd[4];   /// The RGBA tint color of a particle at the end of its life, in [0, 1].
+    float               SizeStart;     /// The width and height of a new particle, in pixels.
+    float               SizeEnd;       /// The width and height of a particle at the end of its life, in pixels.
+    float               UV[4];         /// The texture coordinates of the upper-left and lower-right corners of the image.
+    float               Layer;         /// The texture array layer of the image.
+    GLuint              Texture;       /// The texture object containing the image.
+    uint32_t            RenderState;   /// The render state passed to the effect apply callback.
+    uint32_t            LayerDepth;    /// The layer depth of the particles, increasing into the background.
+    uint32_t            Seed;          /// The state of the random number generator used when spawning.
+};
+
+/// @summary Describes a range of glyph quads within a text layout that sample
+/// from the same font page.
+struct text_run_t
+{
+    uint32_t            Page;          /// The zero-based index of the font page.
+    uint32_t            First;         /// The zero-based index of the first quad in the run.
+    uint32_t            Count;         /// The number of quads in the run.
+};
+
+/// @summary Stores the glyph quads generated for a string laid out with a
+/// bitmap font. Vertices are generated once, in layout space with the origin
+/// at the upper-left corner of the first line, and grouped by font page. A
+/// second copy holds the vertices as last placed on the screen, so a label
+/// drawn at the same position, scale and color is emitted with a single
+/// memcpy. The texture array layer of each vertex is set to the font page
+/// index. Layouts of distance field fonts may be drawn at any scale.
+struct text_layout_t
+{
+    uint32_t            Key;           /// The hash of the string, font and wrap width.
+    uint32_t            LastUsed;      /// The cache frame stamp at which the layout was last used.
+    gui::bitmap_font_t const *Font;    /// The font used to lay out the string.
+    float               WrapWidth;     /// The maximum line width, in pixels, or 0 if lines are not wrapped.
+    size_t              Length;        /// The length of the string, in bytes.
+    char               *Text;          /// A copy of the string, used to resolve hash collisions.
+    float               Width;         /// The width of the widest line, in pixels.
+    float               Height;        /// The total height of all lines, in pixels.
+    size_t              QuadCount;     /// The number of glyph quads.
+    size_t              QuadCapacity;  /// The number of glyph quads that can be stored.
+    gl::sprite_vertex_ptc_t *Vertices; /// QuadCount * 4 vertices in layout space.
+    gl::sprite_vertex_ptc_t *Placed;   /// QuadCount * 4 vertices as last placed on the screen.
+    bool                PlacedValid;   /// true if Placed holds the vertices for the placement below.
+    float               PlacedX;       /// The screen position of the last placement.
+    float               PlacedY;       /// The screen position of the last placement.
+    float               PlacedScale;   /// The scale factor of the last placement.
+    uint32_t            PlacedColor;   /// The ABGR tint color of the last placement.
+    uint32_t            PlacedDepth;   /// The layer depth of the last placement.
+    size_t              RunCount;      /// The number of font page runs.
+    size_t              RunCapacity;   /// The number of font page runs that can be stored.
+    r2d::text_run_t    *Runs;          /// The font page runs, ordered by page.
+};
+
+/// @summary Caches text layouts keyed by the hash of the string, the font
+/// and the wrap width. When the cache is full, the least-recently-used layout
+/// is replaced; layouts used during the current frame are never replaced, and
+/// the cache grows instead.
+struct text_cache_t
+{
+    size_t              Capacity;      /// The number of layouts that can be stored.
+    size_t              Count;         /// The number of layouts stored.
+    r2d::text_layout_t *Layouts;       /// The cached layouts.
+    hash::table_t       Table;         /// A table mapping layout key->index in Layouts.
+    uint32_t            FrameStamp;    /// The current frame stamp, advanced by text_cache_begin_frame().
+    size_t              Hits;          /// The number of lookups satisfied by a cached layout.
+    size_t              Misses;        /// The number of lookups that generated a layout.
+    size_t              Evictions;     /// The number of layouts replaced to make room for another.
+};
+
+/// @summary Describes the sprites stored for a single sprite grid cell. The
+/// sprites occupy slots [First, First + Count) of the grid sprite storage,
+/// and the cell can accept Capacity - Count more sprites before it overflows.
+struct sprite_cell_t
+{
+    uint32_t            First;         /// The zero-based index of the first slot.
+    uint32_t            Count;         /// The number of sprites in the cell.
+    uint32_t            Capacity;      /// The number of slots reserved for the cell.
+};
+
+/// @summary Describes a contiguous range of sprites returned by a sprite grid
+/// query, suitable for passing to gl::generate_quads().
+struct sprite_range_t
+{
+    uint32_t            First;         /// The zero-based index of the first sprite.
+    uint32_t            Count;         /// The number of sprites in the range.
+};
+
+/// @summary Statistics about the work performed by a sprite grid.
+struct sprite_grid_stats_t
+{
+    size_t              CellsVisited;  /// The number of cells visited by the last query.
+    size_t              SpritesFound;  /// The number of sprites returned by the last query.
+    size_t              CellMoves;     /// The number of updates that moved a sprite to a different cell.
+    size_t              Repacks;       /// The number of times the sprite storage was rebuilt.
+};
+
+/// @summary A uniform grid spatial index over a large set of sprites. Sprites
+/// are stored grouped by the cell containing their origin, so a visible-set
+/// query returns one contiguous range per occupied cell without touching
+/// sprites outside the view. Each cell reserves spare slots, so moving a
+/// sprite between cells is usually constant time. Sprites that do not fit
+/// are appended to an overflow region, culled individually by queries and
+/// merged into their cells once the overflow limit is exceeded. Queries are
+/// expanded by the largest sprite bounding radius, so sprites overlapping
+/// the view from a neighbouring cell are found. Sprites are identified by
+/// stable handles, since their storage slots change as they move.
+struct sprite_grid_t
+{
+    float               OriginX;       /// The world position of the upper-left corner of the grid.
+    float               OriginY;       /// The world position of the upper-left corner of the grid.
+    float               CellSize;      /// The width and height of a cell.
+    float               InvCellSize;   /// The value 1.0 / CellSize.
+    size_t              CellsX;        /// The number of cells along the horizontal axis.
+    size_t              CellsY;        /// The number of cells along the vertical axis.
+    r2d::sprite_cell_t *Cells;         /// CellsX * CellsY cell records, in row-major order.
+    float               MaxExtent;     /// The largest bounding radius of any sprite.
+    size_t              Count;         /// The number of sprites in the grid.
+    size_t              SlotCapacity;  /// The number of slots in Sprites and SlotHandle.
+    size_t              PackedCount;   /// The number of slots reserved by cells.
+    size_t              OverflowCount; /// The number of sprites in the overflow region following the cell slots.
+    size_t              OverflowLimit; /// The overflow count above which the storage is rebuilt.
+    gl::sprite_t       *Sprites;       /// The sprite storage, grouped by cell.
+    uint32_t           *SlotHandle;    /// The handle of the sprite in each slot.
+    size_t              HandleCapacity;/// The number of handles that can be allocated.
+    size_t              HandleCount;   /// The number of handles ever allocated.
+    uint32_t            FreeHandle;    /// The head of the free handle list, or 0xFFFFFFFFU.
+    uint32_t           *HandleSlot;    /// The slot of each handle, or the next free handle.
+    uint32_t           *HandleCell;    /// The cell of each handle, or 0xFFFFFFFFU if the handle is free.
+    r2d::sprite_grid_stats_t Stats;    /// Statistics about the work performed by the grid.
+};
+
 /*/////////////////
 //   Functions   //
 /////////////////*/
@@ -213,6 +746,60 @@ GLDRAW2D_PUBLIC bool dxgi_format_to_gl(uint32_t dxgi, GLenum &out_internalformat
 /// @return true if the DDS was successfully loaded into the OpenGL texture.
 GLDRAW2D_PUBLIC bool load_dds(void const *dds_data, size_t dds_size, gl::level_desc_t **out_levels, size_t *out_count, GLuint *out_texId);
 
+/// @summary Maps a DDS file and parses its level descriptions in preparation
+/// for an asynchronous upload. This function does not call OpenGL, and may be
+/// called from any thread. The pages of the file are read before returning,
+/// so that the upload does not stall on file I/O.
+/// @param load The asynchronous load to initialize.
+/// @param path The NULL-terminated path of the DDS file.
+/// @return true if the load is in the DDS_LOAD_STATE_PREPARED state.
+GLDRAW2D_PUBLIC bool create_dds_load(r2d::dds_load_t *load, char const *path);
+
+/// @summary Parses DDS data in memory in preparation for an asynchronous
+/// upload. This function does not call OpenGL, and may be called from any thread.
+/// @param load The asynchronous load to initialize.
+/// @param dds_data A blob of data representing a DDS-formatted image. This
+/// memory must remain valid until the load is ready or deleted.
+/// @param dds_size The maximum number of bytes to read from the DDS data.
+/// @return true if the load is in the DDS_LOAD_STATE_PREPARED state.
+GLDRAW2D_PUBLIC bool create_dds_load(r2d::dds_load_t *load, void const *dds_data, size_t dds_size);
+
+/// @summary Advances an asynchronous DDS load. The first call creates the
+/// texture object and allocates its storage. Level data is then copied into
+/// regions reserved from a pixel stream and uploaded, in bands of rows, until
+/// the byte budget is used. At least one band is uploaded per call. If the
+/// stream cannot supply a region, the call returns early; create the stream
+/// with PIXEL_STREAM_FLAGS_NO_WAIT so that this never blocks. If an upload
+/// scheduler is supplied, the stream is not used: all remaining bands, of at
+/// most byte_budget bytes each, are queued with the scheduler sourcing the DDS
+/// data directly, tagged with the address of the load and prioritized with
+/// upload_priority(). The load becomes ready on the first call after the
+/// scheduler has executed them all. This function must be called on the
+/// thread that owns the OpenGL context.
+/// @param load The asynchronous load to advance.
+/// @param stream The pixel stream used to source the uploads. May be NULL if @a sched is specified.
+/// @param byte_budget The maximum number of bytes to upload, or the maximum band size if @a sched is specified.
+/// @param sched An optional upload scheduler used to execute the uploads.
+/// @param visible Specify true if the texture is needed for the current frame. Used only with @a sched.
+/// @return The number of bytes uploaded or queued. Check load->State for completion.
+GLDRAW2D_PUBLIC size_t dds_load_update(r2d::dds_load_t *load, gl::pixel_stream_h2d_t *stream, size_t byte_budget, gl::upload_scheduler_t *sched = NULL, bool visible = true);
+
+/// @summary Transfers ownership of the texture and level descriptions of a
+/// completed asynchronous load to the application, matching the output of load_dds().
+/// @param load The asynchronous load, which must be in the DDS_LOAD_STATE_READY state.
+/// @param out_levels On return, points to the level descriptions. Free this
+/// array with free() when it is no longer needed.
+/// @param out_count On return, stores the number of items in the levels array.
+/// @param out_texId On return, stores the OpenGL texture object ID.
+/// @return true if the load was ready and ownership was transferred.
+GLDRAW2D_PUBLIC bool dds_load_result(r2d::dds_load_t *load, gl::level_desc_t **out_levels, size_t *out_count, GLuint *out_texId);
+
+/// @summary Frees all resources associated with an asynchronous DDS load. Any
+/// bands still queued with an upload scheduler are cancelled. If the load owns
+/// a texture object, this must be called on the thread that owns the OpenGL context.
+/// @param load The asynchronous load to delete.
+GLDRAW2D_PUBLIC void delete_dds_load(r2d::dds_load_t *load);
+
 /// @summary Initializes an packer for dynamically packing several rectangles
 /// representing images onto a single, larger rectangle.
 /// @param packer The rectangle packer to initialize.
@@ -221,6 +808,16 @@ GLDRAW2D_PUBLIC bool load_dds(void const *dds_data, size_t dds_size, gl::level_d
 /// @param capacity The expected number of sub-rectangles.
 GLDRAW2D_PUBLIC bool create_packer(r2d::packer_t *packer, size_t width, size_t height, size_t capacity);
 
+/// @summary Initializes a packer using a specific placement algorithm. The
+/// MaxRects and skyline packers fragment the master rectangle much less than
+/// the guillotine packer, at the cost of a more expensive insert.
+/// @param packer The rectangle packer to initialize.
+/// @param type One of packer_type_e specifying the placement algorithm.
+/// @param width The width of the master rectangle.
+/// @param height The height of the master rectangle.
+/// @param capacity The expected number of sub-rectangles.
+GLDRAW2D_PUBLIC bool create_packer(r2d::packer_t *packer, uint32_t type, size_t width, size_t height, size_t capacity);
+
 /// @summary Frees resources associated with a rectangle packer.
 /// @param packer The rectangle packer to delete.
 GLDRAW2D_PUBLIC void delete_packer(r2d::packer_t *packer);
@@ -243,6 +840,17 @@ GLDRAW2D_PUBLIC void reset_packer(r2d::packer_t *packer);
 /// @return true if the sub-rectangle was positioned on the master rectangle.
 GLDRAW2D_PUBLIC bool packer_insert(r2d::packer_t *packer, size_t width, size_t height, size_t hpad, size_t vpad, uint32_t id, r2d::pkrect_t *rect);
 
+/// @summary Removes a sub-rectangle from the master rectangle, returning its
+/// area (including padding) to the free space. The guillotine packer coalesces
+/// the freed area with adjacent free rectangles. The MaxRects packers return
+/// the area as a new free rectangle. The skyline packer cannot release space,
+/// and this function always fails for it. The order of the remaining items in
+/// the Rects array is not preserved.
+/// @param packer The packer that positioned the sub-rectangle.
+/// @param id The application-defined identifier supplied to packer_insert().
+/// @return true if the sub-rectangle was found and removed.
+GLDRAW2D_PUBLIC bool packer_remove(r2d::packer_t *packer, uint32_t id);
+
 /// @summary Allocates storage for and initializes an atlas entry with the specified attributes.
 /// @param ent The entry description to initialize.
 /// @param name The name of the entry, used during lookup-by-name within the atlas.
@@ -276,12 +884,49 @@ GLDRAW2D_PUBLIC void delete_atlas(r2d::atlas_t *atlas);
 /// @param atlas The image atlas to freeze.
 GLDRAW2D_PUBLIC void freeze_atlas(r2d::atlas_t *atlas);
 
-/// @summary Locates the metadata for an item within an image atlas given its name.
+/// @summary Locates the metadata for an item within an image atlas given its
+/// name, and marks the item as used during the current frame.
 /// @param atlas The image atlas to search.
 /// @param name The 32-bit unique identifier of the item specified when the item was added.
 /// @return The associated metadata, or NULL.
 GLDRAW2D_PUBLIC r2d::atlas_entry_t* find_atlas_entry(r2d::atlas_t *atlas, uint32_t name);
 
+/// @summary Advances the frame stamp of an atlas. Entries used during the
+/// current frame are never evicted, so this should be called once per frame
+/// before any entries are looked up or placed.
+/// @param atlas The image atlas to update.
+GLDRAW2D_PUBLIC void atlas_begin_frame(r2d::atlas_t *atlas);
+
+/// @summary Marks an entry as used during the current frame. Applications
+/// that cache entry indices instead of calling find_atlas_entry() each frame
+/// should call this function for each entry they draw.
+/// @param atlas The image atlas containing the entry.
+/// @param entry The entry to mark as used.
+GLDRAW2D_PUBLIC void atlas_touch_entry(r2d::atlas_t *atlas, r2d::atlas_entry_t *entry);
+
+/// @summary Removes an entry from an atlas, returning the space occupied by
+/// its frames to the page packers. The EntryList slot is recycled by a later
+/// call to atlas_create_entry(); indices of other entries are unchanged.
+/// @param atlas The image atlas to update.
+/// @param name The 32-bit unique identifier of the entry to remove.
+/// @return true if the entry was found and removed.
+GLDRAW2D_PUBLIC bool atlas_remove_entry(r2d::atlas_t *atlas, uint32_t name);
+
+/// @summary Performs a bounded amount of incremental defragmentation. When no
+/// page is being defragmented, the page with the most free space outside of
+/// its largest free rectangle is selected and its sub-images are repacked.
+/// Sub-images are then copied on the GPU with glCopyImageSubData until the
+/// byte budget is exhausted; at least one sub-image is copied per call. When
+/// every sub-image has been copied the page and its entries are updated.
+/// Defragmentation requires GL_ARB_copy_image and uncompressed pages, and is
+/// abandoned if the page is modified before it completes. This function must
+/// be called on the thread that owns the OpenGL context, typically once per
+/// frame.
+/// @param atlas The image atlas to defragment.
+/// @param byte_budget The maximum number of bytes to copy during this call.
+/// @return The number of bytes of sub-image data copied during this call.
+GLDRAW2D_PUBLIC size_t atlas_defragment(r2d::atlas_t *atlas, size_t byte_budget);
+
 /// @summary Locates the metadata for an item within an image atlas given its index.
 /// @param atlas The image atlas to search.
 /// @param index The zero-based index of the entry to retrieve.
@@ -323,7 +968,8 @@ GLDRAW2D_PUBLIC r2d::atlas_entry_t* atlas_create_entry(r2d::atlas_t *atlas, uint
 GLDRAW2D_PUBLIC r2d::atlas_entry_t* atlas_create_entry(r2d::atlas_t *atlas, uint32_t name, size_t frame_count, size_t const *frame_widths, size_t const *frame_heights, size_t hpad, size_t vpad, size_t *out_index);
 
 /// @summary Places an image within the texture atlas. This only reserves the space for the
-/// image; it does not upload any data to texture pages.
+/// image; it does not upload any data to texture pages. On a dynamic atlas that
+/// has reached its page limit, least-recently-used entries are evicted to make room.
 /// @param atlas The image atlas to update.
 /// @param entry The logical entry within the atlas to modify.
 /// @param frame The zero-based index of the frame being placed.
@@ -345,6 +991,7 @@ GLDRAW2D_PUBLIC bool atlas_place_frame(r2d::atlas_t *atlas, r2d::atlas_entry_t *
 GLDRAW2D_PUBLIC bool atlas_place_frame(r2d::atlas_t *atlas, r2d::atlas_entry_t *entry, size_t frame, size_t width, size_t height, size_t hpad, size_t vpad);
 
 /// @summary Transfers pixel data for an image or frame to the associated texture page.
+/// Any frames previously staged with atlas_stage_frame() are uploaded as well.
 /// @param atlas The atlas on which the entry has been placed.
 /// @param entry The metadata of the entry to update, retrieved with [find|get]_atlas_entry().
 /// @param frame The zero-based index of the frame whose data is being transferred.
@@ -353,6 +1000,411 @@ GLDRAW2D_PUBLIC bool atlas_place_frame(r2d::atlas_t *atlas, r2d::atlas_entry_t *
 /// @return true if the pixel data transfer was scheduled.
 GLDRAW2D_PUBLIC bool atlas_transfer_frame(r2d::atlas_t *atlas, r2d::atlas_entry_t *entry, size_t frame, void const *pixels);
 
+/// @summary Copies the pixel data for an image or frame into the transfer buffer
+/// without uploading it. The transfer buffer stays mapped until the staged frames
+/// are flushed; if it fills up, the frames staged so far are flushed automatically.
+/// Staged frames of an entry removed before the flush are discarded.
+/// @param atlas The atlas on which the entry has been placed.
+/// @param entry The metadata of the entry to update, retrieved with [find|get]_atlas_entry().
+/// @param frame The zero-based index of the frame whose data is being staged.
+/// @param pixels The pixel data to stage, tightly packed with four-byte row alignment.
+/// @return true if the pixel data was staged.
+GLDRAW2D_PUBLIC bool atlas_stage_frame(r2d::atlas_t *atlas, r2d::atlas_entry_t *entry, size_t frame, void const *pixels);
+
+/// @summary Uploads all frames staged with atlas_stage_frame() to the texture
+/// pages. This must be called before drawing with the atlas pages, since the
+/// transfer buffer cannot be used by OpenGL while it is mapped. If an upload
+/// scheduler is supplied, the uploads are instead queued with it, tagged with
+/// the address of the atlas, and run when the scheduler is drained. Any that
+/// are still queued are executed before more frames are staged or the atlas
+/// pages are modified.
+/// @param atlas The atlas whose staged frames should be uploaded.
+/// @param out_stats On return, stores the work performed by this and any
+/// automatic flushes since the statistics were last reported, which are then
+/// reset. May be NULL, in which case the statistics keep accumulating.
+/// @param sched An optional upload scheduler used to execute the uploads.
+/// @param priority The priority of the queued uploads. See gl::upload_priority().
+/// @return true if the staged data was uploaded or queued, or false if the
+/// contents of the transfer buffer were lost while it was mapped.
+GLDRAW2D_PUBLIC bool atlas_flush_transfers(r2d::atlas_t *atlas, r2d::atlas_transfer_stats_t *out_stats, gl::upload_scheduler_t *sched = NULL, uint32_t priority = 0);
+
+/// @summary Fills out the source image fields of a sprite descriptor (ImageX,
+/// ImageY, ImageWidth, ImageHeight, TextureWidth, TextureHeight and ImageLayer)
+/// from the placement of an atlas entry frame. For texture array atlases, the
+/// ImageLayer field receives the page index; otherwise it is set to zero.
+/// @param atlas The atlas on which the entry has been placed.
+/// @param entry The metadata of the entry, retrieved with [find|get]_atlas_entry().
+/// @param frame The zero-based index of the frame to reference.
+/// @param sprite The sprite descriptor to update.
+/// @return The OpenGL texture object ID the sprite should be drawn with.
+GLDRAW2D_PUBLIC GLuint atlas_sprite_source(r2d::atlas_t const *atlas, r2d::atlas_entry_t const *entry, size_t frame, gl::sprite_t *sprite);
+
+/// @summary Writes an atlas to a baked atlas file. The page pixel data is read
+/// back from the GPU in the page format, so atlases with block-compressed
+/// (BCn) pages are stored compressed. This function must be called on the
+/// thread that owns the OpenGL context, after all frames have been transferred
+/// and any staged frames have been flushed. Uploads still queued with an upload
+/// scheduler are executed first.
+/// @param atlas The atlas to save.
+/// @param path The NULL-terminated path of the file to write.
+/// @return true if the file was written.
+GLDRAW2D_PUBLIC bool atlas_save(r2d::atlas_t const *atlas, char const *path);
+
+/// @summary Initializes an atlas from baked atlas data in memory. The entry
+/// and name tables are copied directly, and each page is uploaded with a single
+/// texture transfer. The resulting atlas is frozen: no further frames can be
+/// placed on it. Data whose page size doesn't match its page format, that is
+/// truncated, or that references frames outside of its pages is rejected.
+/// This function must be called on the thread that owns the OpenGL context.
+/// @param atlas The atlas to initialize.
+/// @param data The baked atlas data.
+/// @param data_size The size of the baked atlas data, in bytes.
+/// @return true if the atlas was loaded.
+GLDRAW2D_PUBLIC bool atlas_load(r2d::atlas_t *atlas, void const *data, size_t data_size);
+
+/// @summary Initializes an atlas from a baked atlas file, which is mapped into
+/// memory and uploaded without intermediate copies.
+/// @param atlas The atlas to initialize.
+/// @param path The NULL-terminated path of the baked atlas file.
+/// @return true if the atlas was loaded.
+GLDRAW2D_PUBLIC bool atlas_load(r2d::atlas_t *atlas, char const *path);
+
+/// @summary Initializes a bulk pack request for a set of atlas entries. One
+/// trial is defined for each combination of atlas_sort_e and selected packer
+/// type. The frame sizes of all entries are supplied as flat arrays, in entry order.
+/// @param plan The pack plan to initialize.
+/// @param atlas The atlas supplying the page dimensions and padding.
+/// @param entry_count The number of entries to create.
+/// @param names An array of entry_count entry names.
+/// @param frame_counts An array of entry_count values specifying the number of frames per-entry.
+/// @param frame_widths The un-padded width of each frame, for all entries.
+/// @param frame_heights The un-padded height of each frame, for all entries.
+/// @param packers A combination of atlas_pack_flags_e selecting the packer types to try.
+/// @return true if the plan was initialized.
+GLDRAW2D_PUBLIC bool create_atlas_pack_plan(r2d::atlas_pack_plan_t *plan, r2d::atlas_t const *atlas, size_t entry_count, uint32_t const *names, size_t const *frame_counts, size_t const *frame_widths, size_t const *frame_heights, uint32_t packers = r2d::ATLAS_PACK_DEFAULT);
+
+/// @summary Frees the resources associated with a bulk pack request.
+/// @param plan The pack plan to delete.
+GLDRAW2D_PUBLIC void delete_atlas_pack_plan(r2d::atlas_pack_plan_t *plan);
+
+/// @summary Runs a single trial of a bulk pack request, sorting all items by
+/// the trial's key and placing them first-fit across as many pages as needed.
+/// Different trials of the same plan may run concurrently on separate threads.
+/// @param plan The pack plan.
+/// @param trial The zero-based index of the trial to run.
+/// @return true if every item was placed.
+GLDRAW2D_PUBLIC bool atlas_pack_trial(r2d::atlas_pack_plan_t *plan, size_t trial);
+
+/// @summary Selects the densest successful trial of a bulk pack request: the
+/// trial using the fewest pages, with ties broken by the least area used on
+/// the final page.
+/// @param plan The pack plan, after all trials have run.
+/// @return The zero-based index of the best trial, or plan->TrialCount if no trial succeeded.
+GLDRAW2D_PUBLIC size_t atlas_pack_best(r2d::atlas_pack_plan_t const *plan);
+
+/// @summary Creates the entries of a bulk pack request on an atlas using the
+/// placement from the specified trial. New texture pages are appended to the
+/// atlas for the trial's pages; existing pages are not modified. Ownership of
+/// the trial's packers is transferred to the atlas. If any entry or page cannot
+/// be created, the atlas and the trial are left unmodified. This function must
+/// be called on the thread that owns the OpenGL context.
+/// @param atlas The atlas on which the entries will be created.
+/// @param plan The pack plan.
+/// @param trial The zero-based index of a successful trial, usually from atlas_pack_best().
+/// @param out_indices An optional array of plan->EntryCount values that receive the entry indices.
+/// @return true if all entries were created.
+GLDRAW2D_PUBLIC bool atlas_apply_pack_plan(r2d::atlas_t *atlas, r2d::atlas_pack_plan_t *plan, size_t trial, size_t *out_indices);
+
+/// @summary Creates a set of atlas entries by running the selected bulk pack
+/// trials on the calling thread and applying the densest result. Applications
+/// with a job system can instead run atlas_pack_trial() for each trial in parallel.
+/// @param atlas The atlas on which the entries will be created.
+/// @param entry_count The number of entries to create.
+/// @param names An array of entry_count entry names.
+/// @param frame_counts An array of entry_count values specifying the number of frames per-entry.
+/// @param frame_widths The un-padded width of each frame, for all entries.
+/// @param frame_heights The un-padded height of each frame, for all entries.
+/// @param out_indices An optional array of entry_count values that receive the entry indices.
+/// @param packers A combination of atlas_pack_flags_e selecting the packer types to try.
+/// @return true if all entries were created and placed.
+GLDRAW2D_PUBLIC bool atlas_bulk_create_entries(r2d::atlas_t *atlas, size_t entry_count, uint32_t const *names, size_t const *frame_counts, size_t const *frame_widths, size_t const *frame_heights, size_t *out_indices, uint32_t packers = r2d::ATLAS_PACK_DEFAULT);
+
+/// @summary Initializes an empty tile map and allocates its GPU buffers.
+/// @param map The tile map to initialize.
+/// @param width The width of the map, in tiles.
+/// @param height The height of the map, in tiles.
+/// @param tile_width The width of a single tile, in pixels.
+/// @param tile_height The height of a single tile, in pixels.
+/// @param chunk_size The width and height of a chunk, in tiles, or 0 to use
+/// the default. Chunks of up to 128x128 tiles use 16-bit indices.
+/// @param source_count The number of tile sources, including the empty source 0.
+/// @return true if the tile map was initialized.
+GLDRAW2D_PUBLIC bool create_tilemap(r2d::tilemap_t *map, size_t width, size_t height, size_t tile_width, size_t tile_height, size_t chunk_size, size_t source_count);
+
+/// @summary Frees the memory and GPU resources associated with a tile map.
+/// @param map The tile map to delete.
+GLDRAW2D_PUBLIC void delete_tilemap(r2d::tilemap_t *map);
+
+/// @summary Sets the image drawn for a tile index to a frame of an atlas
+/// entry. Every chunk is marked dirty, so sources should be defined before
+/// the map is first drawn, and again only when the atlas frames move.
+/// @param map The tile map to update.
+/// @param index The tile index, in [1, map->SourceCount).
+/// @param atlas The atlas containing the image.
+/// @param entry The atlas entry containing the image.
+/// @param frame The zero-based index of the frame within the entry.
+/// @return true if the source was updated.
+GLDRAW2D_PUBLIC bool tilemap_set_source(r2d::tilemap_t *map, uint32_t index, r2d::atlas_t const *atlas, r2d::atlas_entry_t const *entry, size_t frame);
+
+/// @summary Sets the tile index stored in a map cell, marking the chunk that
+/// contains the cell dirty if the value changes.
+/// @param map The tile map to update.
+/// @param x The zero-based column of the cell.
+/// @param y The zero-based row of the cell.
+/// @param index The tile index, or 0 to clear the cell.
+GLDRAW2D_PUBLIC void tilemap_set_tile(r2d::tilemap_t *map, size_t x, size_t y, uint32_t index);
+
+/// @summary Sets the tint color applied to every tile. The color is baked
+/// into the cached vertex data, so every chunk is marked dirty if it changes.
+/// @param map The tile map to update.
+/// @param color The ABGR tint color.
+GLDRAW2D_PUBLIC void tilemap_set_tint(r2d::tilemap_t *map, uint32_t color);
+
+/// @summary Sets the layer depth of a tile map. The depth is baked into the
+/// cached vertex data, so every chunk is marked dirty if it changes.
+/// @param map The tile map to update.
+/// @param layer_depth The layer depth, increasing into the background.
+GLDRAW2D_PUBLIC void tilemap_set_layer_depth(r2d::tilemap_t *map, uint32_t layer_depth);
+
+/// @summary Retrieves the tile index stored in a map cell.
+/// @param map The tile map to query.
+/// @param x The zero-based column of the cell.
+/// @param y The zero-based row of the cell.
+/// @return The tile index, or 0 if the cell is empty or outside of the map.
+GLDRAW2D_PUBLIC uint32_t tilemap_get_tile(r2d::tilemap_t const *map, size_t x, size_t y);
+
+/// @summary Regenerates the vertex data of dirty chunks. Chunks are rebuilt
+/// automatically when they become visible; this function can be used to
+/// spread the rebuild of off-screen chunks over several frames.
+/// @param map The tile map to update.
+/// @param max_chunks The maximum number of chunks to rebuild, or 0 for no limit.
+/// @return The number of chunks rebuilt.
+GLDRAW2D_PUBLIC size_t tilemap_update(r2d::tilemap_t *map, size_t max_chunks);
+
+/// @summary Draws the chunks of a tile map that intersect a view rectangle.
+/// Dirty visible chunks are rebuilt first. The effect projection is offset
+/// by the view position while the effect setup callback runs, so the callback
+/// should call gl::sprite_effect_apply_constants() as it does for sprite
+/// batches. The offset matrix is written to a new range of the effect's
+/// constant ring, if it has one. The apply callback is invoked once per
+/// texture, with the texture object passed as the render state. The vertex
+/// array of the tile map is left bound.
+/// @param map The tile map to draw.
+/// @param effect The effect being applied.
+/// @param view_x The left edge of the view rectangle, in map pixels.
+/// @param view_y The top edge of the view rectangle, in map pixels.
+/// @param view_w The width of the view rectangle, in pixels.
+/// @param view_h The height of the view rectangle, in pixels.
+/// @param fxfuncs The effect-specific functions for applying render state.
+/// @param context Opaque data defined by the application.
+GLDRAW2D_PUBLIC void tilemap_draw(r2d::tilemap_t *map, gl::sprite_effect_t *effect, float view_x, float view_y, float view_w, float view_h, gl::sprite_effect_apply_t const *fxfuncs, void *context);
+
+/// @summary Allocates storage for a particle system and sets the simulation
+/// parameters to their defaults: no gravity or drag, an opaque white tint,
+/// and a size of 1 pixel.
+/// @param sys The particle system to initialize.
+/// @param capacity The maximum number of live particles.
+/// @return true if the particle system was initialized.
+GLDRAW2D_PUBLIC bool create_particle_system(r2d::particle_system_t *sys, size_t capacity);
+
+/// @summary Frees the storage associated with a particle system.
+/// @param sys The particle system to delete.
+GLDRAW2D_PUBLIC void delete_particle_system(r2d::particle_system_t *sys);
+
+/// @summary Sets the image drawn for every particle of a system to a frame
+/// of an atlas entry.
+/// @param sys The particle system to update.
+/// @param atlas The atlas containing the image.
+/// @param entry The atlas entry containing the image.
+/// @param frame The zero-based index of the frame within the entry.
+/// @param render_state The render state passed to the effect apply callback.
+GLDRAW2D_PUBLIC void particle_system_set_source(r2d::particle_system_t *sys, r2d::atlas_t const *atlas, r2d::atlas_entry_t const *entry, size_t frame, uint32_t render_state);
+
+/// @summary Spawns a number of particles. Particles beyond the capacity of
+/// the system are discarded.
+/// @param sys The particle system to update.
+/// @param spawn Describes the position, velocity and lifetime of the particles.
+/// @param count The number of particles to spawn.
+/// @return The number of particles spawned.
+GLDRAW2D_PUBLIC size_t particle_system_spawn(r2d::particle_system_t *sys, r2d::particle_spawn_t const &spawn, size_t count);
+
+/// @summary Integrates the velocity and position of every live particle,
+/// advances their age, and removes particles that have reached the end of
+/// their life. This function does not call OpenGL.
+/// @param sys The particle system to update.
+/// @param dt The elapsed time, in seconds.
+/// @return The number of particles removed.
+GLDRAW2D_PUBLIC size_t particle_system_update(r2d::particle_system_t *sys, float dt);
+
+/// @summary Writes four sprite vertices for each of a range of live
+/// particles. This function does not call OpenGL, so the buffer may be a
+/// mapped vertex buffer range filled from any thread.
+/// @param sys The particle system to read.
+/// @param buffer The destination buffer, with space for 4 * count vertices.
+/// @param first The zero-based index of the first particle to write.
+/// @param count The number of particles to write.
+GLDRAW2D_PUBLIC void particle_system_write_vertices(r2d::particle_system_t const *sys, gl::sprite_vertex_ptc_t *buffer, size_t first, size_t count);
+
+/// @summary Draws every live particle of a system using the dynamic buffers
+/// of a sprite effect. Vertices are written directly into the mapped vertex
+/// buffer, bypassing the sprite batch. The effect setup callback is called
+/// once, followed by the apply callback with sys->RenderState.
+/// @param sys The particle system to draw.
+/// @param effect The effect being applied. Its vertex size must be that of gl::sprite_vertex_ptc_t.
+/// @param fxfuncs The effect-specific functions for applying render state.
+/// @param context Opaque data defined by the application.
+/// @return The number of particles drawn.
+GLDRAW2D_PUBLIC size_t particle_system_draw(r2d::particle_system_t *sys, gl::sprite_effect_t *effect, gl::sprite_effect_apply_t const *fxfuncs, void *context);
+
+/// @summary Allocates storage for a text layout cache.
+/// @param cache The text layout cache to initialize.
+/// @param capacity The number of layouts expected to be in use at one time.
+/// @return true if the cache was initialized.
+GLDRAW2D_PUBLIC bool create_text_cache(r2d::text_cache_t *cache, size_t capacity);
+
+/// @summary Frees the storage associated with a text layout cache and all
+/// of its layouts.
+/// @param cache The text layout cache to delete.
+GLDRAW2D_PUBLIC void delete_text_cache(r2d::text_cache_t *cache);
+
+/// @summary Advances the frame stamp of a text layout cache. Call this once
+/// at the start of each frame.
+/// @param cache The text layout cache to update.
+GLDRAW2D_PUBLIC void text_cache_begin_frame(r2d::text_cache_t *cache);
+
+/// @summary Retrieves the layout of a string, generating and caching it if
+/// necessary. Lines are broken at newline characters and, if a wrap width is
+/// specified, at the last space before a line would exceed the wrap width.
+/// Words wider than the wrap width are broken between glyphs.
+/// @param cache The text layout cache.
+/// @param font The bitmap font used to lay out the string.
+/// @param str A NULL-terminated UTF-8 string.
+/// @param wrap_width The maximum line width, in pixels, or 0 to disable wrapping.
+/// @return The layout, or NULL if memory allocation failed. The pointer is
+/// valid until the next call to text_cache_layout().
+GLDRAW2D_PUBLIC r2d::text_layout_t* text_cache_layout(r2d::text_cache_t *cache, gui::bitmap_font_t const *font, char const *str, float wrap_width);
+
+/// @summary Writes the vertices of a text layout placed at a screen position.
+/// If the placement matches the previous placement, the cached vertices are
+/// copied directly. This function does not call OpenGL.
+/// @param layout The text layout to write.
+/// @param buffer The destination buffer, with space for 4 * layout->QuadCount vertices.
+/// @param x The screen position of the upper-left corner of the first line.
+/// @param y The screen position of the upper-left corner of the first line.
+/// @param scale The scale factor applied to the layout; 1.0 draws the font
+/// at its native size.
+/// @param color The ABGR tint color.
+/// @param layer_depth The layer depth of the text, increasing into the background.
+GLDRAW2D_PUBLIC void text_layout_write_vertices(r2d::text_layout_t *layout, gl::sprite_vertex_ptc_t *buffer, float x, float y, float scale, uint32_t color, uint32_t layer_depth);
+
+/// @summary Draws a text layout using the dynamic buffers of a sprite effect.
+/// The effect setup callback is called once, and the apply callback is called
+/// once per font page with the page texture passed as the render state.
+/// @param layout The text layout to draw.
+/// @param effect The effect being applied. Its vertex size must be that of gl::sprite_vertex_ptc_t.
+/// @param x The screen position of the upper-left corner of the first line.
+/// @param y The screen position of the upper-left corner of the first line.
+/// @param scale The scale factor applied to the layout; 1.0 draws the font
+/// at its native size.
+/// @param color The ABGR tint color.
+/// @param layer_depth The layer depth of the text, increasing into the background.
+/// @param page_textures The texture object for each font page. When the pages
+/// are stored in a texture array, every element is the array texture, and the
+/// shader must sample the array using the vertex layer, as done by the shaders
+/// created with gl::create_sprite_shader_ptc_arr() and, for distance field
+/// fonts, gl::create_sprite_shader_ptc_sdf_arr().
+/// @param fxfuncs The effect-specific functions for applying render state.
+/// @param context Opaque data defined by the application.
+/// @return The number of glyph quads drawn.
+GLDRAW2D_PUBLIC size_t text_draw(r2d::text_layout_t *layout, gl::sprite_effect_t *effect, float x, float y, float scale, uint32_t color, uint32_t layer_depth, GLuint const *page_textures, gl::sprite_effect_apply_t const *fxfuncs, void *context);
+
+/// @summary Allocates storage for a sprite grid covering a fixed region of
+/// the world. Sprites outside of the region are stored in the nearest cell.
+/// @param grid The sprite grid to initialize.
+/// @param origin_x The world position of the upper-left corner of the grid.
+/// @param origin_y The world position of the upper-left corner of the grid.
+/// @param width The width of the region covered by the grid.
+/// @param height The height of the region covered by the grid.
+/// @param cell_size The width and height of a cell, typically a fraction of
+/// the view size.
+/// @param expected_count The number of sprites expected to be stored.
+/// @return true if the grid was initialized.
+GLDRAW2D_PUBLIC bool create_sprite_grid(r2d::sprite_grid_t *grid, float origin_x, float origin_y, float width, float height, float cell_size, size_t expected_count);
+
+/// @summary Frees the storage associated with a sprite grid.
+/// @param grid The sprite grid to delete.
+GLDRAW2D_PUBLIC void delete_sprite_grid(r2d::sprite_grid_t *grid);
+
+/// @summary Adds a sprite to a sprite grid.
+/// @param grid The sprite grid to update.
+/// @param sprite The sprite definition to copy.
+/// @param out_handle On return, the handle used to update or remove the sprite.
+/// @return true if the sprite was added, or false if memory allocation failed.
+GLDRAW2D_PUBLIC bool sprite_grid_insert(r2d::sprite_grid_t *grid, gl::sprite_t const *sprite, uint32_t *out_handle);
+
+/// @summary Replaces the definition of a sprite stored in a sprite grid,
+/// moving it to a different cell if its position has changed.
+/// @param grid The sprite grid to update.
+/// @param handle The handle returned when the sprite was inserted.
+/// @param sprite The new sprite definition.
+/// @return true if the sprite was updated.
+GLDRAW2D_PUBLIC bool sprite_grid_update(r2d::sprite_grid_t *grid, uint32_t handle, gl::sprite_t const *sprite);
+
+/// @summary Removes a sprite from a sprite grid. The handle may be returned
+/// by a later call to sprite_grid_insert().
+/// @param grid The sprite grid to update.
+/// @param handle The handle returned when the sprite was inserted.
+/// @return true if the sprite was removed.
+GLDRAW2D_PUBLIC bool sprite_grid_remove(r2d::sprite_grid_t *grid, uint32_t handle);
+
+/// @summary Retrieves the sprite associated with a handle. The position of
+/// the sprite must not be modified through the returned pointer; use
+/// sprite_grid_update() instead.
+/// @param grid The sprite grid to query.
+/// @param handle The handle returned when the sprite was inserted.
+/// @return A pointer to the sprite, valid until the grid is next modified or
+/// queried, or NULL if the handle is invalid.
+GLDRAW2D_PUBLIC gl::sprite_t* sprite_grid_get(r2d::sprite_grid_t *grid, uint32_t handle);
+
+/// @summary Rebuilds the sprite storage of a grid, merging the overflow region
+/// into the cells and resizing the spare capacity of each cell. This is done
+/// automatically by sprite_grid_query() when the overflow limit is exceeded.
+/// @param grid The sprite grid to update.
+/// @return true if the storage was rebuilt, or false if memory allocation failed.
+GLDRAW2D_PUBLIC bool sprite_grid_repack(r2d::sprite_grid_t *grid);
+
+/// @summary Locates the sprites that may be visible within a rectangle. The
+/// cost of a query is proportional to the number of cells overlapping the
+/// rectangle and the number of sprites found, not the number stored.
+/// @param grid The sprite grid to query.
+/// @param x The world position of the upper-left corner of the rectangle.
+/// @param y The world position of the upper-left corner of the rectangle.
+/// @param width The width of the rectangle.
+/// @param height The height of the rectangle.
+/// @param ranges The array of ranges to write, into grid->Sprites.
+/// @param max_ranges The maximum number of ranges to write.
+/// @return The number of ranges required. If this is greater than max_ranges,
+/// only the first max_ranges ranges were written.
+GLDRAW2D_PUBLIC size_t sprite_grid_query(r2d::sprite_grid_t *grid, float x, float y, float width, float height, r2d::sprite_range_t *ranges, size_t max_ranges);
+
+/// @summary Appends the sprites in a set of query ranges to a sprite batch.
+/// @param grid The sprite grid that was queried.
+/// @param ranges The ranges returned by sprite_grid_query().
+/// @param range_count The number of ranges.
+/// @param batch The sprite batch to append to.
+/// @return The number of sprites appended.
+GLDRAW2D_PUBLIC size_t sprite_grid_batch(r2d::sprite_grid_t const *grid, r2d::sprite_range_t const *ranges, size_t range_count, gl::sprite_batch_t *batch);
+
     // we need:
     // a sprite batch for solid-colored quads
     // a sprite batch for textured quads
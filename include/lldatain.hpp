@@ -763,6 +763,16 @@ struct tga_desc_t
     void    *PixelData;       /// Pointer to the start of the image data.
 };
 
+/// @summary Describes a read-only view of an entire file mapped into the
+/// address space of the process.
+struct file_mapping_t
+{
+    void    *Data;            /// Pointer to the first byte of the file.
+    size_t   Size;            /// The size of the mapped view, in bytes.
+    void    *FileHandle;      /// The OS file handle, on platforms that require it.
+    void    *MapHandle;       /// The OS file mapping handle, on platforms that require it.
+};
+
 /*////////////////
 //   Functions  //
 ////////////////*/
@@ -858,6 +868,18 @@ LLDATAIN_PUBLIC char* load_text(char const *path, size_t *out_buffer_size, data:
 /// @return A buffer containing the loaded data, or NULL.
 LLDATAIN_PUBLIC void* load_binary(char const *path, size_t *out_buffer_size);
 
+/// @summary Maps the entire contents of a file into memory for read-only access
+/// without copying it. Pages are read from disk on first access.
+/// @param path The NULL-terminated path of the file to map.
+/// @param out_mapping On return, describes the mapped view of the file.
+/// @return true if the file was mapped. Empty files cannot be mapped.
+LLDATAIN_PUBLIC bool map_file(char const *path, data::file_mapping_t *out_mapping);
+
+/// @summary Unmaps a file mapped with map_file(). Pointers into the mapped
+/// view are invalid after this call.
+/// @param mapping The mapping to release.
+LLDATAIN_PUBLIC void unmap_file(data::file_mapping_t *mapping);
+
 /// @summary Reads the surface header present in all DDS files.
 /// @param data The buffer from which the header data should be read.
 /// @param data_size The maximum number of bytes to read from the input buffer.
@@ -13,6 +13,7 @@
 ////////////////*/
 #include <stddef.h>
 #include <stdint.h>
+#include "llhash.hpp"
 
 /*////////////////////
 //   Preprocessor   //
@@ -101,8 +102,7 @@ struct bitmap_glyph_t
 struct bitmap_font_t
 {
     size_t             GlyphCount; /// The number of glyphs defined in the font.
-    size_t             BucketCount;/// The number of buckets in the glyph table.
-    uint32_t         **GTable;     /// Table mapping Unicode codepoint -> index in Glyphs.
+    hash::table_t      GTable;     /// Table mapping Unicode codepoint -> index in Glyphs.
     bitmap_glyph_t    *Glyphs;     /// List of glyph definitions.
     size_t             KernCount;  /// The number of entries in the kerning table.
     uint32_t          *KerningA;   /// Codepoints of the first glyph in a kerning pair.
@@ -271,6 +271,16 @@ LLGUI_PUBLIC bool define_page(gui::bitmap_font_t *font, void const *src, size_t
 /// @return A pointer to the page image data, or NULL.
 LLGUI_PUBLIC void* glyph_page(gui::bitmap_font_t const *font, size_t i);
 
+/// @summary Determines the amount to advance the cursor by on the horizontal
+/// axis, taking into account the kerning table of the font.
+/// @param font The font to query.
+/// @param a The codepoint of the first glyph.
+/// @param b The codepoint of the second glyph.
+/// @param default_x The advance amount to return if there is no special kerning
+/// between codepoints a and b.
+/// @return The horizontal advance, in pixels.
+LLGUI_PUBLIC int32_t advance_x(gui::bitmap_font_t const *font, uint32_t a, uint32_t b, int32_t default_x);
+
 /// @summary Calculates the dimensions of a string when rendered with a given font.
 /// @param font The font definition to use.
 /// @param str A NULL-terminated UTF-8 string.
@@ -278,6 +288,43 @@ LLGUI_PUBLIC void* glyph_page(gui::bitmap_font_t const *font, size_t i);
 /// @param out_h On return, this location stores the height of the string, in pixels.
 LLGUI_PUBLIC void measure_string(gui::bitmap_font_t const *font, char const *str, size_t *out_w, size_t *out_h);
 
+/// @summary Computes a signed distance field from a coverage image using an
+/// exact Euclidean distance transform. Output values are 8-bit, with 128 at
+/// the glyph edge, larger values inside and smaller values outside the glyph,
+/// falling off linearly to 0 and 255 at a distance of spread pixels. This
+/// function is thread-safe; it allocates its own scratch memory.
+/// @param dst The destination image, width * height bytes.
+/// @param dst_stride The number of bytes between rows of the destination image.
+/// @param src The first coverage value of the source image.
+/// @param src_stride The number of bytes between rows of the source image.
+/// @param src_step The number of bytes between coverage values within a row;
+/// 1 for R8 images, or 4 to read the alpha channel of ABGR images.
+/// @param width The width of the source and destination images, in pixels.
+/// @param height The height of the source and destination images, in pixels.
+/// @param threshold The smallest coverage value considered inside a glyph.
+/// @param spread The distance, in pixels, mapped to the full output range.
+/// @return true if the distance field was generated.
+LLGUI_PUBLIC bool distance_field(uint8_t *dst, size_t dst_stride, void const *src, size_t src_stride, size_t src_step, size_t width, size_t height, uint8_t threshold, float spread);
+
+/// @summary Initializes a font with the glyphs, kerning and metrics of a
+/// bitmap font and storage for 8-bit distance field pages of the same size.
+/// The page data is uninitialized; see distance_field_page().
+/// @param dst The distance field font to initialize.
+/// @param src The source bitmap font.
+/// @return true if the font was initialized.
+LLGUI_PUBLIC bool create_distance_field_font(gui::bitmap_font_t *dst, gui::bitmap_font_t const *src);
+
+/// @summary Generates a single distance field page from the corresponding
+/// page of a bitmap font. The source glyphs should be rendered at a large
+/// point size with at least spread pixels of padding between them. Distinct
+/// pages may be converted concurrently from separate threads.
+/// @param dst A font initialized with create_distance_field_font().
+/// @param src The source bitmap font.
+/// @param i The zero-based index of the page to convert, in [0, src->PageCount).
+/// @param spread The distance, in pixels, mapped to the full output range.
+/// @return true if the page was converted.
+LLGUI_PUBLIC bool distance_field_page(gui::bitmap_font_t *dst, gui::bitmap_font_t const *src, size_t i, float spread);
+
 /// @summary Initializes a key buffer to empty (no keys active).
 /// @param buffer The buffer to initialize.
 LLGUI_PUBLIC void init_key_buffer(gui::key_buffer_t *buffer);
@@ -456,6 +503,41 @@ LLGUI_PUBLIC gui::button_t* button(gui::context_t *ui, uint32_t id, uint32_t x,
 /// @return Information about the current state of the button.
 LLGUI_PUBLIC gui::toggle_t* toggle(gui::context_t *ui, uint32_t id, uint32_t x, uint32_t y, uint32_t w, uint32_t h, bool default_set=false, bool click=false, bool active=true);
 
+/*////////////////////////
+//   Inline Functions   //
+////////////////////////*/
+/// @summary Retrieves the next UTF-8 codepoint from a string.
+/// @param str Pointer to the start of the codepoint.
+/// @param cp On return, this value stores the current codepoint, or
+/// 0xFFFFFFFFU if the string does not contain a valid codepoint.
+/// @return A pointer to the start of the next codepoint.
+static inline char const* next_codepoint(char const *str, uint32_t &cp)
+{
+    if ((str[0] & 0x80) == 0)
+    {   // cp in [0x00000, 0x0007F]
+        cp = str[0];
+        return str + 1;
+    }
+    if ((str[0] & 0xFF) >= 0xC2 &&   (str[0] & 0xFF) <= 0xDF && (str[1] & 0xC0) == 0x80)
+    {   // cp in [0x00080, 0x007FF]
+        cp = (str[0] & 0x1F) <<  6 | (str[1] & 0x3F);
+        return str + 2;
+    }
+    if ((str[0] & 0xF0) == 0xE0 &&   (str[1] & 0xC0) == 0x80 && (str[2] & 0xC0) == 0x80)
+    {   // cp in [0x00800, 0x0FFFF]
+        cp = (str[0] & 0x0F) << 12 | (str[1] & 0x3F) << 6  |    (str[2] & 0x3F);
+        return str + 3;
+    }
+    if ((str[0] & 0xFF) == 0xF0 &&   (str[1] & 0xC0) == 0x80 && (str[2] & 0xC0) == 0x80 && (str[3] & 0xC0) == 0x80)
+    {   // cp in [0x10000, 0x3FFFF]
+        cp = (str[1] & 0x3F) << 12 | (str[2] & 0x3F) << 6  |    (str[3] & 0x3F);
+        return str + 4;
+    }
+    // else, invalid UTF-8 codepoint.
+    cp = 0xFFFFFFFFU;
+    return str + 1;
+}
+
 /*/////////////////////
 //   Namespace End   //
 /////////////////////*/
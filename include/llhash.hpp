@@ -0,0 +1,165 @@
+/*/////////////////////////////////////////////////////////////////////////////
+/// @summary Implements a flat open-addressing hash table mapping 32-bit keys
+/// to 32-bit values. The table stores a one-byte tag per slot and probes the
+/// tags sixteen at a time, using SSE2 where it is available.
+/// @author Russell Klenk (contact@russellklenk.com)
+///////////////////////////////////////////////////////////////////////////80*/
+
+#ifndef LLHASH_HPP_INCLUDED
+#define LLHASH_HPP_INCLUDED
+
+/*////////////////
+//   Includes   //
+////////////////*/
+#include <stddef.h>
+#include <stdint.h>
+
+/*////////////////////
+//   Preprocessor   //
+////////////////////*/
+/// @summary Abstract away Windows 32-bit calling conventions and visibility.
+#if defined(_WIN32) && defined(_MSC_VER)
+    #define  LLHASH_CALL_C    __cdecl
+    #if   defined(_MSC_VER)
+    #define  LLHASH_IMPORT    __declspec(dllimport)
+    #define  LLHASH_EXPORT    __declspec(dllexport)
+    #elif defined(__GNUC__)
+    #define  LLHASH_IMPORT    __attribute__((dllimport))
+    #define  LLHASH_EXPORT    __attribute__((dllexport))
+    #else
+    #define  LLHASH_IMPORT
+    #define  LLHASH_EXPORT
+    #endif
+#else
+    #define  LLHASH_CALL_C
+    #if __GNUC__ >= 4
+    #define  LLHASH_IMPORT    __attribute__((visibility("default")))
+    #define  LLHASH_EXPORT    __attribute__((visibility("default")))
+    #endif
+#endif
+
+/// @summary Define import/export based on whether we're being used as a DLL.
+#if defined(LLHASH_SHARED)
+    #ifdef  LLHASH_EXPORTS
+    #define LLHASH_PUBLIC     LLHASH_EXPORT
+    #else
+    #define LLHASH_PUBLIC     LLHASH_IMPORT
+    #endif
+#else
+    #define LLHASH_PUBLIC
+#endif
+
+/*///////////////////////
+//   Namespace Begin   //
+///////////////////////*/
+namespace hash {
+
+/*/////////////////
+//   Constants   //
+/////////////////*/
+/// @summary The number of slots whose tags are probed together. The table
+/// capacity is always a power of two and a multiple of this value.
+#ifndef LLHASH_GROUP_SIZE
+#define LLHASH_GROUP_SIZE         16U
+#endif
+
+/// @summary The tag value stored in a slot that has never been used.
+#ifndef LLHASH_TAG_EMPTY
+#define LLHASH_TAG_EMPTY          0x80U
+#endif
+
+/// @summary The tag value stored in a slot whose key has been removed.
+#ifndef LLHASH_TAG_DELETED
+#define LLHASH_TAG_DELETED        0xFEU
+#endif
+
+/*/////////////////
+//   Data Types  //
+/////////////////*/
+/// @summary Defines a flat hash table mapping 32-bit keys to 32-bit values.
+/// The tag, key and value arrays share a single allocation, in that order,
+/// so the table can be written to and read from a file as one block. Tags
+/// with the high bit clear mark an occupied slot and hold seven bits of the
+/// key hash; other slots hold LLHASH_TAG_EMPTY or LLHASH_TAG_DELETED.
+struct table_t
+{
+    size_t             Capacity;   /// The number of slots; a power of two.
+    size_t             Count;      /// The number of occupied slots.
+    size_t             Deleted;    /// The number of slots marked deleted.
+    uint8_t           *Tags;       /// The per-slot tag bytes; Capacity items.
+    uint32_t          *Keys;       /// The per-slot keys; Capacity items.
+    uint32_t          *Values;     /// The per-slot values; Capacity items.
+};
+
+/*/////////////////
+//   Functions   //
+/////////////////*/
+/// @summary Computes the number of bytes in the single allocation backing a
+/// table with a given number of slots.
+/// @param capacity The number of slots in the table.
+/// @return The number of bytes of storage for the tag, key and value arrays.
+LLHASH_PUBLIC size_t table_storage_size(size_t capacity);
+
+/// @summary Allocates storage for a hash table sized so that a given number
+/// of items can be inserted without rehashing.
+/// @param table The hash table to initialize.
+/// @param expected_count The number of items expected to be stored.
+/// @return true if the table was initialized.
+LLHASH_PUBLIC bool create_table(hash::table_t *table, size_t expected_count);
+
+/// @summary Initializes a hash table from a copy of storage previously laid
+/// out by another table, such as a block read from a file. The storage is
+/// validated before use: every tag must be occupied, empty or deleted, each
+/// occupied tag must match its key, and the table must be within its maximum
+/// load factor so that lookups for missing keys terminate. The item and
+/// deleted slot counts are recomputed from the tags.
+/// @param table The hash table to initialize. Any existing storage is freed
+/// only if the new storage is accepted.
+/// @param storage The tag, key and value arrays; table_storage_size(capacity) bytes.
+/// @param capacity The number of slots; a power of two, at least LLHASH_GROUP_SIZE.
+/// @return true if the storage was valid and the table was initialized.
+LLHASH_PUBLIC bool load_table(hash::table_t *table, void const *storage, size_t capacity);
+
+/// @summary Frees the storage associated with a hash table.
+/// @param table The hash table to delete.
+LLHASH_PUBLIC void delete_table(hash::table_t *table);
+
+/// @summary Removes all items from a hash table without freeing its storage.
+/// @param table The hash table to clear.
+LLHASH_PUBLIC void clear_table(hash::table_t *table);
+
+/// @summary Ensures that a hash table can store a given number of items
+/// without exceeding its maximum load factor, rehashing if necessary.
+/// @param table The hash table to update.
+/// @param count The number of items the table should be able to store.
+/// @return true if the table has sufficient capacity.
+LLHASH_PUBLIC bool table_reserve(hash::table_t *table, size_t count);
+
+/// @summary Inserts an item into a hash table, or replaces the value of an
+/// existing item with the same key.
+/// @param table The hash table to update.
+/// @param key The key of the item.
+/// @param value The value to associate with the key.
+/// @return true if the item was stored, or false if memory allocation failed.
+LLHASH_PUBLIC bool table_put(hash::table_t *table, uint32_t key, uint32_t value);
+
+/// @summary Retrieves the value associated with a key.
+/// @param table The hash table to search.
+/// @param key The key to locate.
+/// @param out_value On return, stores the value associated with the key. This
+/// value is not modified if the key is not found.
+/// @return true if the key was found.
+LLHASH_PUBLIC bool table_get(hash::table_t const *table, uint32_t key, uint32_t *out_value);
+
+/// @summary Removes an item from a hash table.
+/// @param table The hash table to update.
+/// @param key The key of the item to remove.
+/// @return true if the key was found and removed.
+LLHASH_PUBLIC bool table_remove(hash::table_t *table, uint32_t key);
+
+/*/////////////////////
+//   Namespace End   //
+/////////////////////*/
+}; /* end namespace hash */
+
+#endif /* !defined(LLHASH_HPP_INCLUDED) */
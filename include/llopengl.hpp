@@ -88,6 +88,14 @@
     #define LLOPENGL_PUBLIC
 #endif
 
+/// @summary Use constexpr where the compiler supports it. Visual C++ prior to
+/// Visual Studio 2015 does not implement constexpr.
+#if defined(_MSC_VER) && (_MSC_VER < 1900)
+    #define LLOPENGL_CONSTEXPR  inline
+#else
+    #define LLOPENGL_CONSTEXPR  constexpr
+#endif
+
 /*///////////////////////
 //   Namespace Begin   //
 ///////////////////////*/
@@ -122,9 +130,103 @@ namespace gl {
 #define GL_SPRITE_PTC_LOCATION_CLR    (1)
 #endif
 
+/// @summary Defines the location of the depth attribute within the vertex.
+/// This attribute is a single float in [0, 1) derived from the layer depth.
+#ifndef GL_SPRITE_PTC_LOCATION_DEP
+#define GL_SPRITE_PTC_LOCATION_DEP    (2)
+#endif
+
+/// @summary Defines the location of the texture array layer attribute within
+/// the vertex. This attribute is used only by the texture array sprite shader.
+#ifndef GL_SPRITE_PTC_LOCATION_LAY
+#define GL_SPRITE_PTC_LOCATION_LAY    (3)
+#endif
+
+/// @summary Defines the maximum number of regions of a pixel streaming buffer
+/// that may be reserved or in-flight (committed but not yet consumed by the
+/// GPU) at any given time.
+#ifndef GL_MAX_PIXEL_STREAM_REGIONS
+#define GL_MAX_PIXEL_STREAM_REGIONS   (64U)
+#endif
+
+/// @summary Defines the maximum number of pixel pack buffers that may be
+/// used by a single asynchronous readback queue.
+#ifndef GL_MAX_PIXEL_READBACK_SLOTS
+#define GL_MAX_PIXEL_READBACK_SLOTS   (8U)
+#endif
+
+/// @summary The bucket mask value used to indicate that a shader_desc_t name
+/// list has no perfect hash index, and must be searched linearly.
+#ifndef GL_SHADER_INDEX_NONE
+#define GL_SHADER_INDEX_NONE          (0xFFFFU)
+#endif
+
+/// @summary Defines the number of texture image units tracked by the shadow
+/// state cache. Bindings on units beyond this value are always issued.
+#ifndef GL_STATE_MAX_TEXTURE_UNITS
+#define GL_STATE_MAX_TEXTURE_UNITS    (32U)
+#endif
+
+/// @summary Defines the number of indexed uniform buffer binding points
+/// tracked by the shadow state cache.
+#ifndef GL_STATE_MAX_UNIFORM_BINDINGS
+#define GL_STATE_MAX_UNIFORM_BINDINGS (16U)
+#endif
+
+/// @summary Defines the maximum number of frames a constant ring may have in
+/// flight at any one time.
+#ifndef GL_MAX_CONSTANT_RING_FRAMES
+#define GL_MAX_CONSTANT_RING_FRAMES   (4U)
+#endif
+
+/// @summary Defines the maximum number of distinct named GPU profiler scopes.
+#ifndef GL_MAX_GPU_PROFILER_SCOPES
+#define GL_MAX_GPU_PROFILER_SCOPES    (32U)
+#endif
+
+/// @summary Defines the maximum number of scope instances recorded per frame.
+/// Each instance consumes two timestamp query objects.
+#ifndef GL_MAX_GPU_PROFILER_SAMPLES
+#define GL_MAX_GPU_PROFILER_SAMPLES   (256U)
+#endif
+
+/// @summary Defines the maximum number of frames of GPU profiler latency.
+/// Query results are read back this many frames after they were issued.
+#ifndef GL_MAX_GPU_PROFILER_FRAMES
+#define GL_MAX_GPU_PROFILER_FRAMES    (4U)
+#endif
+
+/// @summary Defines the maximum nesting depth of GPU profiler scopes.
+#ifndef GL_MAX_GPU_PROFILER_DEPTH
+#define GL_MAX_GPU_PROFILER_DEPTH     (16U)
+#endif
+
+/// @summary The value stored in the shadow state cache for a piece of state
+/// whose value is unknown. Setting the state will always issue the GL call.
+#ifndef GL_STATE_UNKNOWN
+#define GL_STATE_UNKNOWN              (0xFFFFFFFFU)
+#endif
+
 /*//////////////////
 //   Data Types   //
 //////////////////*/
+/// @summary Flags used to configure a host-to-device pixel streaming buffer.
+enum pixel_stream_flags_e
+{
+    PIXEL_STREAM_FLAGS_NONE       =  0,
+    PIXEL_STREAM_FLAGS_PERSISTENT = (1 << 0), /// Map once using glBufferStorage (GL 4.4).
+    PIXEL_STREAM_FLAGS_NO_WAIT    = (1 << 1)  /// Fail a reservation instead of stalling.
+};
+
+/// @summary Identifies the state of a single region within a pixel stream.
+enum pixel_stream_region_e
+{
+    PIXEL_STREAM_REGION_RESERVED  =  0,       /// Reserved and being written by the CPU.
+    PIXEL_STREAM_REGION_COMMITTED =  1,       /// Written, but no fence has been placed.
+    PIXEL_STREAM_REGION_FENCED    =  2,       /// Waiting for the GPU to signal the fence.
+    PIXEL_STREAM_REGION_CANCELLED =  3        /// Rolled back; released when it reaches the tail.
+};
+
 /// @summary Describes an active GLSL attribute.
 struct attribute_desc_t
 {
@@ -144,7 +246,9 @@ struct sampler_desc_t
     GLint    ImageUnit;    /// The assigned texture image unit, ex. GL_TEXTURE0
 };
 
-/// @summary Describes an active GLSL uniform.
+/// @summary Describes an active GLSL uniform. Uniforms declared within a
+/// uniform block have a Location of -1, and their DataOffset is the byte
+/// offset of the uniform within the block.
 struct uniform_desc_t
 {
     GLenum   DataType;     /// The data type, ex. GL_FLOAT
@@ -152,20 +256,38 @@ struct uniform_desc_t
     size_t   DataSize;     /// The size of the uniform data, in bytes
     size_t   DataOffset;   /// The offset of the uniform data, in bytes
     GLsizei  Dimension;    /// The data dimension, for array types
+    GLint    BlockIndex;   /// The index of the containing uniform block, or -1
+};
+
+/// @summary Describes an active GLSL uniform block.
+struct uniform_block_desc_t
+{
+    GLuint   Index;        /// The uniform block index within the program
+    GLuint   Binding;      /// The assigned uniform buffer binding point
+    size_t   DataSize;     /// The minimum size of the buffer range, in bytes
 };
 
 /// @summary Describes a successfully compiled and linked GLSL shader program.
+/// The Index tables store a minimal perfect hash of the corresponding names;
+/// element zero is the bucket mask, followed by one displacement per bucket.
+/// A mask of GL_SHADER_INDEX_NONE indicates the names have not been indexed.
 struct shader_desc_t
 {
     size_t            UniformCount;   /// Number of active uniforms
     uint32_t         *UniformNames;   /// Hashed names of active uniforms
     uniform_desc_t   *Uniforms;       /// Information about active uniforms
+    uint16_t         *UniformIndex;   /// Perfect hash table for UniformNames
     size_t            AttributeCount; /// Number of active inputs
     uint32_t         *AttributeNames; /// Hashed names of active inputs
     attribute_desc_t *Attributes;     /// Information about active inputs
+    uint16_t         *AttributeIndex; /// Perfect hash table for AttributeNames
     size_t            SamplerCount;   /// Number of active samplers
     uint32_t         *SamplerNames;   /// Hashed names of samplers
     sampler_desc_t   *Samplers;       /// Information about active samplers
+    uint16_t         *SamplerIndex;   /// Perfect hash table for SamplerNames
+    size_t            UniformBlockCount; /// Number of active uniform blocks
+    uint32_t         *UniformBlockNames; /// Hashed names of uniform blocks
+    uniform_block_desc_t *UniformBlocks; /// Information about active uniform blocks
     void             *Metadata;       /// Pointer to the raw memory
 };
 
@@ -179,6 +301,56 @@ struct shader_source_t
     char  **SourceCode [GL_MAX_SHADER_STAGES]; /// NULL-terminated ASCII strings
 };
 
+/// @summary Describes an on-disk cache of linked shader program binaries. Each
+/// entry is keyed by a hash of the shader source code, and is only valid for
+/// the driver (vendor, renderer and version) that produced it. An entry stores
+/// the program binary along with the reflected shader_desc_t metadata, so that
+/// neither compilation nor reflection is required on a cache hit.
+struct shader_cache_t
+{
+    char    *Directory;     /// The directory containing cached program binaries.
+    uint32_t DriverHash;    /// Hash of the GL vendor, renderer and version strings.
+    bool     Enabled;       /// false if the driver supports no program binary formats.
+    size_t   Hits;          /// The number of programs restored from the cache.
+    size_t   Misses;        /// The number of programs not found in the cache.
+    size_t   Rejects;       /// The number of cached binaries rejected by the driver.
+    size_t   Writes;        /// The number of programs written to the cache.
+};
+
+/// @summary Identifies the state of a shader program within a build batch.
+enum shader_build_state_e
+{
+    SHADER_BUILD_STATE_COMPILING  =  0,       /// Shader stages are being compiled.
+    SHADER_BUILD_STATE_LINKING    =  1,       /// The program is being linked.
+    SHADER_BUILD_STATE_COMPLETE   =  2,       /// The program is linked and reflected.
+    SHADER_BUILD_STATE_FAILED     =  3        /// Compilation or linking failed.
+};
+
+/// @summary Describes a single shader program submitted to a build batch.
+struct shader_build_t
+{
+    gl::shader_source_t *Source;  /// The shader source code; must remain valid until complete.
+    gl::shader_desc_t   *Shader;  /// The shader program object to initialize.
+    GLuint   Program;             /// The OpenGL program object, or 0 on failure.
+    GLuint   Stages[GL_MAX_SHADER_STAGES]; /// The OpenGL shader objects for each stage.
+    uint32_t State;               /// One of shader_build_state_e.
+};
+
+/// @summary Describes a batch of shader programs built asynchronously. All
+/// programs are submitted to the driver up front, and are then polled until
+/// each has finished compiling and linking. With KHR_parallel_shader_compile
+/// the driver compiles programs on background threads and polling never blocks;
+/// without it, the batch falls back to building each program on first poll.
+struct shader_batch_t
+{
+    size_t   Count;         /// The number of programs submitted to the batch.
+    size_t   Capacity;      /// The maximum number of programs in the batch.
+    size_t   Pending;       /// The number of programs not yet complete or failed.
+    size_t   Failed;        /// The number of programs that failed to build.
+    bool     Parallel;      /// true if KHR_parallel_shader_compile is in use.
+    gl::shader_build_t *Items; /// The set of programs submitted to the batch.
+};
+
 /// @summary Describes a single level of an image in a mipmap chain.
 struct level_desc_t
 {
@@ -224,6 +396,65 @@ struct pixel_transfer_d2h_t
     void  *TransferBuffer;  /// Pointer to target image data, or PBO byte offset
 };
 
+/// @summary Identifies the state of a single slot within a readback queue.
+enum pixel_readback_state_e
+{
+    PIXEL_READBACK_STATE_IDLE     =  0,       /// The slot is available for a new request.
+    PIXEL_READBACK_STATE_PENDING  =  1,       /// The GPU is copying into the slot.
+    PIXEL_READBACK_STATE_MAPPED   =  2        /// The application is reading the slot.
+};
+
+/// @summary Describes a completed readback. The Memory field points into a
+/// mapped pack buffer, and remains valid until pixel_stream_d2h_release() is
+/// called. The memory may be read from any thread, but the slot must be
+/// released from the thread that owns the OpenGL context.
+struct pixel_readback_t
+{
+    void    *Memory;        /// Pointer to the mapped pixel data.
+    size_t   Size;          /// The size of the pixel data, in bytes.
+    size_t   Width;         /// The width of the image, in pixels.
+    size_t   Height;        /// The height of the image, in pixels.
+    size_t   RowPitch;      /// The number of bytes between rows of the image.
+    GLenum   Layout;        /// The pixel data layout, ex. GL_BGRA.
+    GLenum   DataType;      /// The pixel data type, ex. GL_UNSIGNED_INT_8_8_8_8_REV.
+    uint64_t Sequence;      /// The zero-based request number, in submission order.
+    uintptr_t Tag;          /// Application-defined data supplied with the request.
+};
+
+/// @summary Describes a single pack buffer within a readback queue.
+struct pixel_readback_slot_t
+{
+    GLuint   Pbo;           /// The pixel buffer object used as the pack target.
+    GLsync   Fence;         /// The fence signaled when the copy has completed.
+    size_t   Capacity;      /// The size of the buffer storage, in bytes.
+    uint32_t State;         /// One of pixel_readback_state_e.
+    gl::pixel_readback_t Info; /// Description of the requested image.
+};
+
+/// @summary Counters maintained by an asynchronous readback queue.
+struct pixel_readback_stats_t
+{
+    size_t   Requests;      /// The number of requests submitted to the GPU.
+    size_t   Dropped;       /// The number of requests dropped because all slots were busy.
+    size_t   Completed;     /// The number of readbacks returned to the application.
+};
+
+/// @summary Describes a queue used to download pixel data from the device
+/// (GPU) to the host (CPU) without stalling the pipeline. A fixed number of
+/// pack buffers are used in rotation; each request copies into the next free
+/// buffer and places a fence behind the copy. The application polls the
+/// queue, typically once per-frame, and maps results in submission order
+/// once their fences have signaled - usually two or three frames later.
+struct pixel_stream_d2h_t
+{
+    size_t   SlotCount;     /// The number of pack buffers in the rotation.
+    size_t   SlotHead;      /// The index of the oldest outstanding slot.
+    size_t   ActiveCount;   /// The number of slots pending or mapped.
+    uint64_t Sequence;      /// The sequence number assigned to the next request.
+    gl::pixel_readback_slot_t  Slots[GL_MAX_PIXEL_READBACK_SLOTS];
+    gl::pixel_readback_stats_t Stats; /// Counters for submitted and dropped requests.
+};
+
 /// @summary Describes a transfer of pixel data from the host (CPU) to the
 /// device (GPU), using glTexSubImage or glCompressedTexSubImage. The fields
 /// Target[X/Y/Z] indicate where to place the data on the target texture. The
@@ -261,32 +492,139 @@ struct pixel_transfer_h2d_t
     void  *TransferBuffer;  /// Pointer to source image data, or PBO byte offset
 };
 
+/// @summary Describes a single reserved or in-flight region of a host-to-device
+/// pixel streaming buffer.
+struct pixel_stream_region_t
+{
+    GLsync   Fence;         /// The fence signaled when the GPU has consumed the region.
+    uint8_t *Address;       /// The host address returned for the reservation.
+    size_t   Offset;        /// The byte offset of the region within the buffer.
+    size_t   Size;          /// The size of the region, in bytes.
+    uint32_t State;         /// One of pixel_stream_region_e.
+};
+
+/// @summary Counters maintained by a pixel streaming buffer. Applications may
+/// reset the counters at any time, typically once per-frame.
+struct pixel_stream_stats_t
+{
+    size_t   Reservations;  /// The number of successful reservations.
+    size_t   Stalls;        /// The number of times the CPU waited on a fence.
+    size_t   Skips;         /// The number of reservations failed due to lack of space.
+    size_t   BytesReserved; /// The total number of bytes reserved.
+    size_t   BytesInFlight; /// The number of bytes reserved, but not yet released.
+    size_t   MaxInFlight;   /// The high-water mark of BytesInFlight.
+};
+
 /// @summary Describes a buffer used to stream data from the host (CPU) to the
-/// device (GPU) using a GPU-asynchronous buffer transfer. The buffer usage is
-/// always GL_STREAM_DRAW, and the target is always GL_PIXEL_UNPACK_BUFFER.
-/// The buffer is allocated in memory accessible to both the CPU and the driver.
-/// Buffer regions are reserved, data copied into the buffer by the CPU, and
-/// then the reservation is committed. The transfer is then performed using
-/// the pixel_transfer_h2d function. A single pixel streaming buffer can be
-/// used to target multiple texture objects.
+/// device (GPU) using a GPU-asynchronous buffer transfer. The target is always
+/// GL_PIXEL_UNPACK_BUFFER. The buffer is managed as a ring of regions. Each
+/// region is reserved, written by the CPU and then committed. After issuing
+/// the transfers that read from committed regions, the application may call
+/// pixel_stream_h2d_fence() to place a fence behind them; the region is then
+/// recycled only after the GPU has signaled the fence. Calling the fence
+/// function is optional; when the ring is full, pixel_stream_h2d_reserve()
+/// fences any committed regions itself before waiting. When the stream is
+/// persistently mapped, several reservations may be outstanding at once.
+/// A single pixel streaming buffer can be used to target multiple textures.
 struct pixel_stream_h2d_t
 {
-    GLuint Pbo;             /// The pixel buffer object used for streaming.
-    size_t Alignment;       /// The alignment for any buffer reservations.
-    size_t BufferSize;      /// The size of the transfer buffer, in bytes.
-    size_t ReserveOffset;   /// The byte offset of the active reservation.
-    size_t ReserveSize;     /// The size of the active reservation, in bytes.
+    GLuint   Pbo;           /// The pixel buffer object used for streaming.
+    uint32_t Flags;         /// A combination of pixel_stream_flags_e.
+    size_t   Alignment;     /// The alignment for any buffer reservations.
+    size_t   BufferSize;    /// The size of the transfer buffer, in bytes.
+    size_t   HeadOffset;    /// The byte offset at which the next reservation begins.
+    uint8_t *MappedBase;    /// The base address of a persistently-mapped buffer, or NULL.
+    size_t   RegionHead;    /// The index of the oldest region in Regions.
+    size_t   RegionCount;   /// The number of regions reserved or in-flight.
+    gl::pixel_stream_region_t Regions[GL_MAX_PIXEL_STREAM_REGIONS];
+    gl::pixel_stream_stats_t  Stats; /// Counters for stalls and bytes in flight.
+};
+
+/// @summary Describes a single host-to-device pixel transfer queued with an
+/// upload scheduler. The source data (client memory or PBO range) referenced
+/// by the transfer must remain valid until the job completes.
+struct upload_job_t
+{
+    gl::pixel_transfer_h2d_t Transfer; /// The transfer to execute.
+    GLuint    Texture;      /// The texture object the transfer writes to.
+    GLint     Alignment;    /// The GL_UNPACK_ALIGNMENT value current when the job was submitted.
+    uint32_t  Priority;     /// The job priority; lower values are executed first.
+    uint64_t  Sequence;     /// The submission order, used to break priority ties.
+    uint64_t  SubmitTime;   /// The time at which the job was submitted, in microseconds.
+    size_t    SubmitFrame;  /// The scheduler FrameIndex when the job was submitted.
+    uintptr_t Tag;          /// An application-defined value identifying the job.
+};
+
+/// @summary Signature for an application-defined function called when a
+/// queued upload job has been executed and its source data may be released.
+typedef void (*upload_complete_fn)(uintptr_t tag, void *context);
+
+/// @summary Counters maintained by an upload scheduler. Applications may
+/// reset the counters at any time, typically once per-frame.
+struct upload_stats_t
+{
+    size_t    QueueDepth;   /// The number of jobs waiting to execute.
+    size_t    QueueBytes;   /// The number of bytes waiting to be uploaded.
+    size_t    MaxQueueDepth;/// The high-water mark of QueueDepth.
+    size_t    Drains;       /// The number of calls to upload_scheduler_drain().
+    size_t    JobsSubmitted;/// The number of jobs submitted.
+    size_t    JobsExecuted; /// The number of jobs executed.
+    size_t    BytesExecuted;/// The number of bytes uploaded.
+    uint64_t  DrainMicros;  /// The CPU time spent executing jobs, in microseconds.
+    uint64_t  MaxDrainMicros;   /// The longest single drain, in microseconds.
+    uint64_t  TotalLatencyMicros;/// The sum of submit-to-execute times, in microseconds.
+    uint64_t  MaxLatencyMicros; /// The longest submit-to-execute time, in microseconds.
+    size_t    MaxLatencyFrames; /// The largest number of drains a job waited through.
+};
+
+/// @summary Queues host-to-device pixel transfers and executes them in
+/// priority order against a per-drain byte and CPU time budget, so that
+/// streaming content is spread over several frames rather than causing a
+/// spike in the frame time. The queue is a binary heap ordered by priority
+/// and then by submission order. At least one job is executed per drain.
+struct upload_scheduler_t
+{
+    size_t    ByteBudget;   /// The maximum number of bytes uploaded per drain, or 0 for no limit.
+    uint64_t  TimeBudget;   /// The maximum CPU time spent per drain, in microseconds, or 0 for no limit.
+    size_t    Capacity;     /// The number of jobs that can be queued without reallocating.
+    size_t    Count;        /// The number of jobs queued.
+    gl::upload_job_t *Jobs; /// The queued jobs, stored as a binary heap.
+    uint64_t  NextSequence; /// The sequence number assigned to the next job.
+    size_t    FrameIndex;   /// The number of drains performed.
+    gl::upload_complete_fn Complete; /// The function called when a job completes, or NULL.
+    void     *Context;      /// Opaque data passed through to the Complete function.
+    gl::upload_stats_t Stats; /// Counters for queue depth, throughput and latency.
+};
+
+/// @summary Flags that can be set on a sprite to control how it is drawn.
+enum sprite_flags_e
+{
+    SPRITE_FLAGS_NONE         = (0 << 0), /// The sprite may be translucent.
+    SPRITE_FLAG_OPAQUE        = (1 << 0)  /// The sprite is opaque or alpha-tested.
+};
+
+/// @summary Identifies the pass being drawn by a sprite effect. The effect
+/// setup callback can inspect sprite_effect_t::Pass to configure the shader,
+/// for example to enable alpha testing during the opaque pass.
+enum sprite_pass_e
+{
+    SPRITE_PASS_ALL           = 0,        /// All sprites, blended in painter's order.
+    SPRITE_PASS_OPAQUE        = 1,        /// Opaque sprites, depth-tested front-to-back.
+    SPRITE_PASS_TRANSLUCENT   = 2         /// Translucent sprites, blended back-to-front.
 };
 
 /// @summary A structure representing a single interleaved sprite vertex in
 /// the vertex buffer. The vertex encodes 2D screen space position, texture
-/// coordinate, and packed ABGR color values into 20 bytes per-vertex. The
-/// GPU expands the vertex into 32 bytes. Tint color is constant per-sprite.
+/// coordinate, packed ABGR color, depth and texture array layer values into
+/// 28 bytes per-vertex. The GPU expands the vertex into 40 bytes. Tint color,
+/// depth and texture layer are constant per-sprite.
 #pragma pack(push, 1)
 struct sprite_vertex_ptc_t
 {
     float     XYUV[4];          /// Position.x, Position.y (screen space), 2d texcoord.
     uint32_t  TintColor;        /// The ABGR tint color.
+    float     Depth;            /// The normalized layer depth, in [0, 1).
+    float     Layer;            /// The texture array layer, for array textures.
 };
 #pragma pack(pop)
 
@@ -312,6 +650,8 @@ struct sprite_t
     uint32_t  TextureHeight;    /// The height of the texture defining the source image.
     uint32_t  LayerDepth;       /// The layer depth of the sprite, increasing into the background.
     uint32_t  RenderState;      /// An application-defined render state identifier.
+    uint32_t  Flags;            /// A combination of sprite_flags_e.
+    uint32_t  ImageLayer;       /// The texture array layer (atlas page) of the source image.
 };
 
 /// @summary A structure storing the data required to represent a sprite within
@@ -325,6 +665,8 @@ struct sprite_quad_t
     float     Scale[2];         /// Texture coordinate scale factors.
     float     Orientation;      /// The angle of orientation, in radians.
     uint32_t  TintColor;        /// The ABGR tint color.
+    float     Depth;            /// The normalized layer depth, in [0, 1).
+    float     Layer;            /// The texture array layer of the source image.
 };
 
 /// @summary Data used for sorting buffered quads. Grouped together to improve
@@ -333,6 +675,26 @@ struct sprite_sort_data_t
 {
     uint32_t  LayerDepth;       /// The layer depth of the sprite, increasing into the background.
     uint32_t  RenderState;      /// The render state associated with the sprite.
+    uint32_t  Flags;            /// The sprite_flags_e associated with the sprite.
+};
+
+/// @summary Describes a persistently-mapped uniform buffer used to supply
+/// per-draw shader constants. The buffer is divided into one segment per
+/// frame in flight. Each frame suballocates aligned ranges from its segment,
+/// writes constants directly into mapped memory and binds the ranges with
+/// glBindBufferRange. A fence placed at the end of each frame prevents the
+/// segment from being overwritten while the GPU is still reading from it.
+struct constant_ring_t
+{
+    GLuint   Buffer;        /// The uniform buffer object.
+    uint8_t *MappedBase;    /// The base address of the persistently-mapped buffer.
+    size_t   Alignment;     /// The value of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+    size_t   FrameSize;     /// The size of a single frame segment, in bytes.
+    size_t   FrameCount;    /// The number of frame segments.
+    size_t   FrameIndex;    /// The index of the segment for the current frame.
+    size_t   FrameUsed;     /// The number of bytes allocated in the current frame.
+    size_t   Stalls;        /// The number of times begin_frame waited on a fence.
+    GLsync   Fences[GL_MAX_CONSTANT_RING_FRAMES]; /// The fence for each segment.
 };
 
 /// @summary A structure storing all of the data required to render sprites
@@ -346,6 +708,7 @@ struct sprite_effect_t
     size_t    IndexOffset;      /// Current offset (in indices) in buffer.
     size_t    IndexSize;        /// Size of one index, in bytes.
     uint32_t  CurrentState;     /// The active render state identifier.
+    uint32_t  Pass;             /// The pass being drawn, one of sprite_pass_e.
     GLuint    VertexArray;      /// The VAO describing the vertex layout.
     GLuint    VertexBuffer;     /// Buffer object for dynamic vertex data.
     GLuint    IndexBuffer;      /// Buffer object for dynamic index data.
@@ -358,6 +721,8 @@ struct sprite_effect_t
     GLenum    BlendFuncAlpha;   /// The alpha channel blend function.
     GLfloat   BlendColor[4];    /// RGBA constant blend color.
     float     Projection[16];   /// Projection matrix for current viewport
+    gl::constant_ring_t *ConstantRing; /// The ring supplying shader constants, or NULL.
+    size_t    ConstantOffset;   /// Offset of the current constants within ConstantRing.
 };
 
 /// @summary Signature for a function used to apply render state for an effect
@@ -387,6 +752,7 @@ struct sprite_batch_t
 {
     size_t                     Count;       /// The number of buffered sprites.
     size_t                     Capacity;    /// The capacity of the various buffers.
+    size_t                     OpaqueCount; /// The number of opaque quads at the start of Order.
     gl::sprite_quad_t         *Quads;       /// Buffer for transformed quad data.
     gl::sprite_sort_data_t    *State;       /// Render state identifiers for each quad.
     uint32_t                  *Order;       /// Insertion order values for each quad.
@@ -401,6 +767,7 @@ struct sprite_shader_ptc_clr_t
     gl::attribute_desc_t      *AttribPTX;   /// Information about the Position-Texture attribute.
     gl::attribute_desc_t      *AttribCLR;   /// Information about the ARGB color attribute.
     gl::uniform_desc_t        *UniformMSS;  /// Information about the screenspace -> clipspace matrix.
+    gl::uniform_block_desc_t  *BlockSPC;    /// Information about the SpriteConstants block, or NULL.
 };
 
 /// @summary Maintains the state associated with a default sprite shader
@@ -413,8 +780,221 @@ struct sprite_shader_ptc_tex_t
     gl::attribute_desc_t      *AttribCLR;   /// Information about the ARGB color attribute.
     gl::sampler_desc_t        *SamplerTEX;  /// Information about the texture sampler.
     gl::uniform_desc_t        *UniformMSS;  /// Information about the screenspace -> clipspace matrix.
+    gl::uniform_block_desc_t  *BlockSPC;    /// Information about the SpriteConstants block, or NULL.
+    gl::uniform_desc_t        *UniformATH;  /// Information about the alpha test threshold.
+};
+
+/// @summary Maintains the state associated with a sprite shader that samples
+/// image data from a 2D texture array, such as a texture array atlas. The
+/// array layer is supplied per-vertex, so sprites from any atlas page can be
+/// drawn without a state change.
+struct sprite_shader_ptc_arr_t
+{
+    GLuint                     Program;     /// The OpenGL program object ID.
+    gl::shader_desc_t          ShaderDesc;  /// Metadata about the shader program.
+    gl::attribute_desc_t      *AttribPTX;   /// Information about the Position-Texture attribute.
+    gl::attribute_desc_t      *AttribCLR;   /// Information about the ARGB color attribute.
+    gl::attribute_desc_t      *AttribLAY;   /// Information about the texture array layer attribute.
+    gl::sampler_desc_t        *SamplerTEX;  /// Information about the texture array sampler.
+    gl::uniform_desc_t        *UniformMSS;  /// Information about the screenspace -> clipspace matrix.
+    gl::uniform_block_desc_t  *BlockSPC;    /// Information about the SpriteConstants block, or NULL.
+    gl::uniform_desc_t        *UniformATH;  /// Information about the alpha test threshold.
+};
+
+/// @summary Maintains the state associated with a sprite shader that renders
+/// text from signed distance field font pages. The distance is read from the
+/// red channel and converted to coverage using the screen-space derivative of
+/// the distance, so a single set of pages renders sharply at any scale.
+struct sprite_shader_ptc_sdf_t
+{
+    GLuint                     Program;     /// The OpenGL program object ID.
+    gl::shader_desc_t          ShaderDesc;  /// Metadata about the shader program.
+    gl::attribute_desc_t      *AttribPTX;   /// Information about the Position-Texture attribute.
+    gl::attribute_desc_t      *AttribCLR;   /// Information about the ARGB color attribute.
+    gl::sampler_desc_t        *SamplerTEX;  /// Information about the distance field sampler.
+    gl::uniform_desc_t        *UniformMSS;  /// Information about the screenspace -> clipspace matrix.
+    gl::uniform_block_desc_t  *BlockSPC;    /// Information about the SpriteConstants block, or NULL.
+    gl::uniform_desc_t        *UniformEDG;  /// Information about the edge offset; negative values embolden.
+};
+
+/// @summary Maintains the state associated with a sprite shader that renders
+/// text from signed distance field font pages stored in a 2D texture array.
+/// The array layer is supplied per-vertex, as written by r2d::text_draw().
+struct sprite_shader_ptc_sdf_arr_t
+{
+    GLuint                     Program;     /// The OpenGL program object ID.
+    gl::shader_desc_t          ShaderDesc;  /// Metadata about the shader program.
+    gl::attribute_desc_t      *AttribPTX;   /// Information about the Position-Texture attribute.
+    gl::attribute_desc_t      *AttribCLR;   /// Information about the ARGB color attribute.
+    gl::attribute_desc_t      *AttribLAY;   /// Information about the texture array layer attribute.
+    gl::sampler_desc_t        *SamplerTEX;  /// Information about the distance field array sampler.
+    gl::uniform_desc_t        *UniformMSS;  /// Information about the screenspace -> clipspace matrix.
+    gl::uniform_block_desc_t  *BlockSPC;    /// Information about the SpriteConstants block, or NULL.
+    gl::uniform_desc_t        *UniformEDG;  /// Information about the edge offset; negative values embolden.
+};
+
+/// @summary Identifies the buffer binding targets tracked by the shadow state cache.
+enum state_buffer_target_e
+{
+    STATE_BUFFER_ARRAY            =  0,       /// GL_ARRAY_BUFFER
+    STATE_BUFFER_ELEMENT_ARRAY    =  1,       /// GL_ELEMENT_ARRAY_BUFFER (per-VAO state)
+    STATE_BUFFER_PIXEL_PACK       =  2,       /// GL_PIXEL_PACK_BUFFER
+    STATE_BUFFER_PIXEL_UNPACK     =  3,       /// GL_PIXEL_UNPACK_BUFFER
+    STATE_BUFFER_UNIFORM          =  4,       /// GL_UNIFORM_BUFFER
+    STATE_BUFFER_COPY_READ        =  5,       /// GL_COPY_READ_BUFFER
+    STATE_BUFFER_COPY_WRITE       =  6,       /// GL_COPY_WRITE_BUFFER
+    STATE_BUFFER_TEXTURE          =  7,       /// GL_TEXTURE_BUFFER
+    STATE_BUFFER_TARGET_COUNT     =  8
 };
 
+/// @summary Identifies the texture binding targets tracked by the shadow state cache.
+enum state_texture_target_e
+{
+    STATE_TEXTURE_1D              =  0,       /// GL_TEXTURE_1D
+    STATE_TEXTURE_2D              =  1,       /// GL_TEXTURE_2D
+    STATE_TEXTURE_3D              =  2,       /// GL_TEXTURE_3D
+    STATE_TEXTURE_1D_ARRAY        =  3,       /// GL_TEXTURE_1D_ARRAY
+    STATE_TEXTURE_2D_ARRAY        =  4,       /// GL_TEXTURE_2D_ARRAY
+    STATE_TEXTURE_RECTANGLE       =  5,       /// GL_TEXTURE_RECTANGLE
+    STATE_TEXTURE_CUBE_MAP        =  6,       /// GL_TEXTURE_CUBE_MAP
+    STATE_TEXTURE_CUBE_MAP_ARRAY  =  7,       /// GL_TEXTURE_CUBE_MAP_ARRAY
+    STATE_TEXTURE_BUFFER          =  8,       /// GL_TEXTURE_BUFFER
+    STATE_TEXTURE_TARGET_COUNT    =  9
+};
+
+/// @summary Describes a buffer range bound to an indexed binding point.
+struct state_buffer_range_t
+{
+    GLuint     Buffer;      /// The bound buffer object, or GL_STATE_UNKNOWN.
+    GLintptr   Offset;      /// The byte offset of the bound range.
+    GLsizeiptr Size;        /// The size of the bound range, in bytes.
+};
+
+/// @summary Counts the state-setting calls made through the shadow state cache.
+struct state_counters_t
+{
+    size_t   Issued;        /// The number of calls passed through to OpenGL.
+    size_t   Elided;        /// The number of redundant calls that were skipped.
+};
+
+/// @summary Shadows a subset of the OpenGL context state so that redundant
+/// state changes can be skipped. All llopengl and gldraw2d functions set
+/// state through the current cache, if any. If the application modifies the
+/// same state directly, it must call state_cache_invalidate() afterwards.
+struct state_cache_t
+{
+    GLuint   Program;       /// The program object set with glUseProgram.
+    GLuint   VertexArray;   /// The bound vertex array object.
+    GLuint   Buffers[gl::STATE_BUFFER_TARGET_COUNT]; /// Buffer bindings, by state_buffer_target_e.
+    gl::state_buffer_range_t UniformRanges[GL_STATE_MAX_UNIFORM_BINDINGS]; /// Indexed uniform buffer bindings.
+    GLuint   ActiveTexture; /// The zero-based active texture unit.
+    GLuint   Textures[GL_STATE_MAX_TEXTURE_UNITS][gl::STATE_TEXTURE_TARGET_COUNT];
+    GLuint   Blend;         /// GL_TRUE, GL_FALSE or GL_STATE_UNKNOWN for GL_BLEND.
+    GLuint   DepthTest;     /// GL_TRUE, GL_FALSE or GL_STATE_UNKNOWN for GL_DEPTH_TEST.
+    GLuint   DepthMask;     /// GL_TRUE, GL_FALSE or GL_STATE_UNKNOWN.
+    GLenum   DepthFunc;     /// The depth comparison function.
+    GLenum   BlendFunc[4];  /// Source RGB, target RGB, source alpha, target alpha factors.
+    GLenum   BlendEquation[2]; /// RGB and alpha blend equations.
+    float    BlendColor[4]; /// The constant blend color.
+    bool     BlendColorValid; /// true if BlendColor reflects the GL state.
+    gl::state_counters_t Counters; /// Counts of issued and elided calls.
+};
+
+/// @summary Stores the GPU timing statistics for a single named scope. Times
+/// are the total GPU time spent in all instances of the scope within a frame.
+struct gpu_scope_stats_t
+{
+    char const *Name;       /// The scope name, as passed to gpu_scope_begin().
+    uint32_t    NameHash;   /// The hashed scope name, from shader_name().
+    size_t      Calls;      /// The number of instances in the most recent frame.
+    uint64_t    LastNs;     /// The GPU time for the most recent frame, in nanoseconds.
+    uint64_t    MinNs;      /// The minimum per-frame GPU time, in nanoseconds.
+    uint64_t    MaxNs;      /// The maximum per-frame GPU time, in nanoseconds.
+    uint64_t    TotalNs;    /// The sum of per-frame GPU times, in nanoseconds.
+    uint64_t    Frames;     /// The number of frames contributing to TotalNs.
+    double      AvgNs;      /// The average per-frame GPU time, in nanoseconds.
+};
+
+/// @summary Records the GPU timestamp queries issued during a single frame.
+struct gpu_profiler_frame_t
+{
+    GLuint      Queries[GL_MAX_GPU_PROFILER_SAMPLES * 2]; /// Begin and end timestamp queries.
+    uint8_t     Scopes [GL_MAX_GPU_PROFILER_SAMPLES];     /// The scope index of each sample.
+    size_t      SampleCount;/// The number of samples recorded in the frame.
+    size_t      LastQuery;  /// The index of the most recently issued query.
+    bool        Pending;    /// true if the frame has unresolved queries.
+};
+
+/// @summary Measures GPU time spent within named scopes using GL_TIMESTAMP
+/// queries. Timestamps are used rather than GL_TIME_ELAPSED so that scopes
+/// may nest. Queries are recorded into a ring of frames and read back without
+/// stalling FrameCount frames later; frames whose results are still not
+/// available at that point are dropped.
+struct gpu_profiler_t
+{
+    bool        Enabled;    /// false if the driver does not support timestamp queries.
+    size_t      FrameCount; /// The number of frames in the query ring.
+    size_t      FrameIndex; /// The index of the frame being recorded.
+    size_t      ScopeCount; /// The number of named scopes.
+    size_t      Depth;      /// The current scope nesting depth.
+    size_t      Dropped;    /// The number of frames whose results were not available.
+    size_t      Overflows;  /// The number of scope instances not recorded.
+    size_t      Stack [GL_MAX_GPU_PROFILER_DEPTH];  /// Sample indices of the open scopes.
+    gl::gpu_scope_stats_t   Scopes[GL_MAX_GPU_PROFILER_SCOPES]; /// Per-scope statistics.
+    gl::gpu_profiler_frame_t Frames[GL_MAX_GPU_PROFILER_FRAMES]; /// The query ring.
+};
+
+/// @summary Identifies the commands that can be recorded into a command buffer.
+enum command_type_e
+{
+    COMMAND_TYPE_USE_PROGRAM         = 0,  /// state_use_program.
+    COMMAND_TYPE_BIND_VERTEX_ARRAY   = 1,  /// state_bind_vertex_array.
+    COMMAND_TYPE_BIND_BUFFER         = 2,  /// state_bind_buffer.
+    COMMAND_TYPE_BIND_BUFFER_RANGE   = 3,  /// state_bind_buffer_range.
+    COMMAND_TYPE_BIND_TEXTURE        = 4,  /// state_bind_texture.
+    COMMAND_TYPE_SET_SAMPLER         = 5,  /// set_sampler.
+    COMMAND_TYPE_SET_UNIFORM         = 6,  /// set_uniform, with the value stored inline.
+    COMMAND_TYPE_ENABLE              = 7,  /// state_enable.
+    COMMAND_TYPE_BLEND_FUNC          = 8,  /// state_blend_func.
+    COMMAND_TYPE_BLEND_EQUATION      = 9,  /// state_blend_equation.
+    COMMAND_TYPE_BLEND_COLOR         = 10, /// state_blend_color.
+    COMMAND_TYPE_DEPTH_FUNC          = 11, /// state_depth_func.
+    COMMAND_TYPE_DEPTH_MASK          = 12, /// state_depth_mask.
+    COMMAND_TYPE_TRANSFER_PIXELS_H2D = 13, /// transfer_pixels_h2d.
+    COMMAND_TYPE_TRANSFER_PIXELS_D2H = 14, /// transfer_pixels_d2h.
+    COMMAND_TYPE_DRAW_SPRITE_BATCH   = 15, /// sprite_effect_draw_batch_ptc.
+    COMMAND_TYPE_CALLBACK            = 16, /// An application-defined function.
+    COMMAND_TYPE_COUNT               = 17
+};
+
+/// @summary Describes a run of commands recorded under a single sort key.
+struct command_group_t
+{
+    uint64_t  SortKey;      /// The application-defined sort key.
+    size_t    Begin;        /// The byte offset of the first command.
+    size_t    End;          /// The byte offset one past the last command.
+};
+
+/// @summary A linear buffer of rendering commands recorded without a GL
+/// context. Each recording thread owns its own command buffer, so recording
+/// requires no locks; the buffers are handed to the GL thread, which replays
+/// them in sort key order with execute_command_buffers(). Commands are grouped
+/// by sort key. Groups with equal keys replay in buffer order, and commands
+/// within a group always replay in the order they were recorded.
+struct command_buffer_t
+{
+    uint8_t  *Commands;     /// Storage for the encoded commands.
+    size_t    Capacity;     /// The capacity of the Commands array, in bytes.
+    size_t    Used;         /// The number of bytes of command data recorded.
+    size_t    CommandCount; /// The number of commands recorded.
+    gl::command_group_t *Groups; /// The list of command groups.
+    size_t    GroupCount;   /// The number of command groups recorded.
+    size_t    GroupCapacity;/// The capacity of the Groups array.
+};
+
+/// @summary Signature for an application-defined command executed during replay.
+typedef void (*command_callback_fn)(void *context);
+
 /*//////////////
 //  Functors  //
 //////////////*/
@@ -586,11 +1166,31 @@ LLOPENGL_PUBLIC void copy_linker_log(GLuint program, char *buffer, size_t buffer
 /// @return true if memory was allocated successfully.
 LLOPENGL_PUBLIC bool shader_desc_alloc(gl::shader_desc_t *desc, size_t num_attribs, size_t num_samplers, size_t num_uniforms);
 
+/// @summary Allocates memory for a shader_desc_t structure, including storage
+/// for uniform block descriptions, using the standard C library malloc().
+/// @param desc The shader description to initialize.
+/// @param num_attribs The number of active attributes for the program.
+/// @param num_samplers The number of active texture samplers for the program.
+/// @param num_uniforms The number of active uniforms for the program.
+/// @param num_blocks The number of active uniform blocks for the program.
+/// @return true if memory was allocated successfully.
+LLOPENGL_PUBLIC bool shader_desc_alloc(gl::shader_desc_t *desc, size_t num_attribs, size_t num_samplers, size_t num_uniforms, size_t num_blocks);
+
 /// @summary Releases memory for a shader_desc_t structure using the standard
 /// C library free() function.
 /// @param desc The shader description to release.
 LLOPENGL_PUBLIC void shader_desc_free(gl::shader_desc_t *desc);
 
+/// @summary Builds the minimal perfect hash tables for the attribute, sampler
+/// and uniform names of a shader program. The name and value arrays are
+/// reordered so that each name is stored at the slot its hash maps to. This is
+/// called automatically by build_shader() after reflection.
+/// @param desc The shader description to index.
+/// @return true if all three name lists were indexed. If a list cannot be
+/// indexed (for example, two names have the same hash), lookups into that list
+/// fall back to a linear search.
+LLOPENGL_PUBLIC bool shader_desc_index(gl::shader_desc_t *desc);
+
 /// @summary Counts the number of active vertex attribues, texture samplers
 /// and uniform values defined in a shader program.
 /// @param program The OpenGL program object to query.
@@ -652,12 +1252,118 @@ LLOPENGL_PUBLIC void reflect_program_details(
 LLOPENGL_PUBLIC void set_sampler(gl::sampler_desc_t *sampler, GLuint texture);
 
 /// @summary Sets a uniform value for the currently bound shader program.
+/// Uniforms declared within a uniform block cannot be set this way; write
+/// them into the block buffer with std140_store() instead.
 /// @param uniform The description of the uniform to set.
 /// @param value The data to copy to the uniform.
 /// @param transpose For matrix values, specify true to transpose the matrix
 /// elements before passing them to the shader program.
 LLOPENGL_PUBLIC void set_uniform(gl::uniform_desc_t *uniform, void const *value, bool transpose);
 
+/// @summary Retrieves the number of active uniform blocks in a program.
+/// @param program The OpenGL program object to query.
+/// @return The number of active uniform blocks.
+LLOPENGL_PUBLIC size_t reflect_uniform_block_count(GLuint program);
+
+/// @summary Retrieves descriptions of the active uniform blocks in a program,
+/// and assigns each block a uniform buffer binding point equal to its index.
+/// @param program The OpenGL program object to query.
+/// @param buffer A temporary buffer used to hold uniform block names.
+/// @param buffer_size The maximum number of bytes that can be written to the
+/// temporary name buffer.
+/// @param block_names Pointer to an array to be filled with the 32-bit hash
+/// values of the active uniform block names.
+/// @param block_info Pointer to an array to be filled with uniform block descriptions.
+LLOPENGL_PUBLIC void reflect_uniform_blocks(GLuint program, char *buffer, size_t buffer_size, uint32_t *block_names, gl::uniform_block_desc_t *block_info);
+
+/// @summary Re-applies the uniform buffer binding points recorded in a shader
+/// description to a program object, for example after glProgramBinary.
+/// @param program The OpenGL program object.
+/// @param shader The shader program description.
+LLOPENGL_PUBLIC void apply_uniform_block_bindings(GLuint program, gl::shader_desc_t const *shader);
+
+/// @summary Binds a range of a uniform buffer to the binding point of a uniform block.
+/// @param block The description of the uniform block.
+/// @param buffer The OpenGL buffer object containing the block data.
+/// @param offset The byte offset of the block data within the buffer.
+/// @param size The size of the block data, in bytes.
+LLOPENGL_PUBLIC void set_uniform_block(gl::uniform_block_desc_t const *block, GLuint buffer, size_t offset, size_t size);
+
+/// @summary Calculates the base alignment of a uniform value under the std140
+/// layout rules. Arrays and matrices are aligned to 16 bytes.
+/// @param data_type The uniform data type, ex. GL_FLOAT_VEC3.
+/// @param dimension The array dimension, or 1 for non-array values.
+/// @return The base alignment of the value, in bytes.
+LLOPENGL_PUBLIC size_t std140_alignment(GLenum data_type, size_t dimension);
+
+/// @summary Calculates the number of bytes occupied by a uniform value under
+/// the std140 layout rules, including any padding between array elements
+/// and matrix columns.
+/// @param data_type The uniform data type, ex. GL_FLOAT_MAT3.
+/// @param dimension The array dimension, or 1 for non-array values.
+/// @return The size of the value, in bytes.
+LLOPENGL_PUBLIC size_t std140_size(GLenum data_type, size_t dimension);
+
+/// @summary Computes std140 offsets for a list of uniform values declared in order.
+/// @param data_types The data type of each value.
+/// @param dimensions The array dimension of each value.
+/// @param count The number of values.
+/// @param out_offsets An array of @a count elements to receive the byte offset of each value.
+/// @return The total size of the block, rounded up to 16 bytes.
+LLOPENGL_PUBLIC size_t std140_layout(GLenum const *data_types, size_t const *dimensions, size_t count, size_t *out_offsets);
+
+/// @summary Writes a tightly-packed uniform value into a std140 block, inserting
+/// the padding required between array elements and matrix columns.
+/// @param block The base address of the uniform block data.
+/// @param offset The byte offset of the value within the block.
+/// @param data_type The uniform data type, ex. GL_FLOAT_MAT3.
+/// @param dimension The array dimension, or 1 for non-array values.
+/// @param value The tightly-packed source value.
+LLOPENGL_PUBLIC void std140_store(void *block, size_t offset, GLenum data_type, size_t dimension, void const *value);
+
+/// @summary Writes a uniform value into a mapped uniform block, using the
+/// offset reported by reflection.
+/// @param block The base address of the uniform block data.
+/// @param uniform The description of a uniform declared within the block.
+/// @param value The tightly-packed source value.
+LLOPENGL_PUBLIC void std140_store(void *block, gl::uniform_desc_t const *uniform, void const *value);
+
+/// @summary Creates a persistently-mapped constant ring. This requires OpenGL
+/// 4.4 or ARB_buffer_storage.
+/// @param ring The constant ring to initialize.
+/// @param frame_size The number of bytes available for constants each frame.
+/// @param frame_count The number of frames that may be in flight, at most
+/// GL_MAX_CONSTANT_RING_FRAMES. Three is typical.
+/// @return true if the ring was created successfully.
+LLOPENGL_PUBLIC bool create_constant_ring(gl::constant_ring_t *ring, size_t frame_size, size_t frame_count);
+
+/// @summary Deletes the buffer and fences owned by a constant ring.
+/// @param ring The constant ring to delete.
+LLOPENGL_PUBLIC void delete_constant_ring(gl::constant_ring_t *ring);
+
+/// @summary Advances the constant ring to the next frame segment, waiting for
+/// the GPU to finish reading from it if necessary.
+/// @param ring The constant ring.
+LLOPENGL_PUBLIC void constant_ring_begin_frame(gl::constant_ring_t *ring);
+
+/// @summary Places a fence behind all draws that read from the current frame segment.
+/// @param ring The constant ring.
+LLOPENGL_PUBLIC void constant_ring_end_frame(gl::constant_ring_t *ring);
+
+/// @summary Suballocates an aligned range from the current frame segment.
+/// @param ring The constant ring.
+/// @param size The number of bytes to allocate.
+/// @param out_offset On return, the byte offset of the range within the ring buffer.
+/// @return A pointer to the mapped memory, or NULL if the frame segment is full.
+LLOPENGL_PUBLIC void* constant_ring_alloc(gl::constant_ring_t *ring, size_t size, size_t *out_offset);
+
+/// @summary Binds a range previously allocated from a constant ring to a uniform block.
+/// @param ring The constant ring.
+/// @param block The description of the uniform block.
+/// @param offset The offset returned by constant_ring_alloc().
+/// @param size The size of the allocated range, in bytes.
+LLOPENGL_PUBLIC void constant_ring_bind(gl::constant_ring_t *ring, gl::uniform_block_desc_t const *block, size_t offset, size_t size);
+
 /// @summary Initializes a shader source code buffer to empty.
 /// @param source The source code buffer to clear.
 LLOPENGL_PUBLIC void shader_source_init(gl::shader_source_t *source);
@@ -678,6 +1384,194 @@ LLOPENGL_PUBLIC void shader_source_add(gl::shader_source_t *source, GLenum shade
 /// @return true if the build process was successful.
 LLOPENGL_PUBLIC bool build_shader(gl::shader_source_t *source, gl::shader_desc_t *shader, GLuint *out_program);
 
+/// @summary Determines whether the current OpenGL context supports a given
+/// extension. This function must be called with an active OpenGL context.
+/// @param name The NULL-terminated extension name, ex. "GL_KHR_parallel_shader_compile".
+/// @return true if the extension is supported.
+LLOPENGL_PUBLIC bool extension_supported(char const *name);
+
+/// @summary Initializes a shadow state cache. All state is marked unknown,
+/// so the first call to set each piece of state is always issued.
+/// @param cache The shadow state cache to initialize.
+LLOPENGL_PUBLIC void state_cache_init(gl::state_cache_t *cache);
+
+/// @summary Marks all state in a shadow state cache as unknown. Call this
+/// after modifying GL state without going through the state_* functions.
+/// The call counters are preserved.
+/// @param cache The shadow state cache to invalidate.
+LLOPENGL_PUBLIC void state_cache_invalidate(gl::state_cache_t *cache);
+
+/// @summary Resets the issued and elided call counters, typically once per-frame.
+/// @param cache The shadow state cache to update.
+LLOPENGL_PUBLIC void state_cache_reset_counters(gl::state_cache_t *cache);
+
+/// @summary Sets the shadow state cache used by the state_* functions. The
+/// cache shadows a single OpenGL context; when no cache is current, every
+/// call is passed directly through to OpenGL.
+/// @param cache The shadow state cache to make current, or NULL.
+LLOPENGL_PUBLIC void make_state_cache_current(gl::state_cache_t *cache);
+
+/// @summary Retrieves the current shadow state cache.
+/// @return The current shadow state cache, or NULL.
+LLOPENGL_PUBLIC gl::state_cache_t* current_state_cache(void);
+
+/// @summary Sets the current program object, if it differs from the current value.
+/// @param program The OpenGL program object, or 0.
+LLOPENGL_PUBLIC void state_use_program(GLuint program);
+
+/// @summary Binds a vertex array object, if it differs from the current value.
+/// Binding a different vertex array changes the GL_ELEMENT_ARRAY_BUFFER binding.
+/// @param vao The OpenGL vertex array object, or 0.
+LLOPENGL_PUBLIC void state_bind_vertex_array(GLuint vao);
+
+/// @summary Binds a buffer object to a target, if it differs from the current value.
+/// @param target The buffer target, ex. GL_PIXEL_UNPACK_BUFFER.
+/// @param buffer The OpenGL buffer object, or 0.
+LLOPENGL_PUBLIC void state_bind_buffer(GLenum target, GLuint buffer);
+
+/// @summary Binds a range of a buffer object to an indexed binding point, if it
+/// differs from the current value. This also changes the generic binding.
+/// @param target The indexed buffer target, ex. GL_UNIFORM_BUFFER.
+/// @param index The binding point index.
+/// @param buffer The OpenGL buffer object.
+/// @param offset The byte offset of the range.
+/// @param size The size of the range, in bytes.
+LLOPENGL_PUBLIC void state_bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+/// @summary Selects the active texture unit, if it differs from the current value.
+/// @param unit The zero-based texture image unit index.
+LLOPENGL_PUBLIC void state_active_texture(GLuint unit);
+
+/// @summary Binds a texture object to a target on a given texture image unit,
+/// if it differs from the current value. The active texture unit is changed
+/// only if the texture binding must be issued.
+/// @param unit The zero-based texture image unit index.
+/// @param target The texture target, ex. GL_TEXTURE_2D.
+/// @param texture The OpenGL texture object, or 0.
+LLOPENGL_PUBLIC void state_bind_texture(GLuint unit, GLenum target, GLuint texture);
+
+/// @summary Enables or disables a capability. Only GL_BLEND and GL_DEPTH_TEST
+/// are tracked; other capabilities are always passed through.
+/// @param cap The capability, ex. GL_BLEND.
+/// @param enable true to call glEnable, or false to call glDisable.
+LLOPENGL_PUBLIC void state_enable(GLenum cap, bool enable);
+
+/// @summary Sets the blend factors, if they differ from the current values.
+/// @param src_rgb The source color blend factor.
+/// @param dst_rgb The target color blend factor.
+/// @param src_alpha The source alpha blend factor.
+/// @param dst_alpha The target alpha blend factor.
+LLOPENGL_PUBLIC void state_blend_func(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha);
+
+/// @summary Sets the blend equations, if they differ from the current values.
+/// @param mode_rgb The color blend equation, ex. GL_FUNC_ADD.
+/// @param mode_alpha The alpha blend equation, ex. GL_FUNC_ADD.
+LLOPENGL_PUBLIC void state_blend_equation(GLenum mode_rgb, GLenum mode_alpha);
+
+/// @summary Sets the constant blend color, if it differs from the current value.
+/// @param r The red component of the blend color.
+/// @param g The green component of the blend color.
+/// @param b The blue component of the blend color.
+/// @param a The alpha component of the blend color.
+LLOPENGL_PUBLIC void state_blend_color(float r, float g, float b, float a);
+
+/// @summary Sets the depth comparison function, if it differs from the current value.
+/// @param func The depth function, ex. GL_LEQUAL.
+LLOPENGL_PUBLIC void state_depth_func(GLenum func);
+
+/// @summary Enables or disables depth buffer writes, if it differs from the current value.
+/// @param write true to enable depth writes.
+LLOPENGL_PUBLIC void state_depth_mask(bool write);
+
+/// @summary Deletes buffer objects, clearing any cached bindings that refer to them.
+/// @param n The number of buffer objects.
+/// @param buffers The OpenGL buffer objects to delete.
+LLOPENGL_PUBLIC void state_delete_buffers(GLsizei n, GLuint const *buffers);
+
+/// @summary Deletes texture objects, clearing any cached bindings that refer to them.
+/// @param n The number of texture objects.
+/// @param textures The OpenGL texture objects to delete.
+LLOPENGL_PUBLIC void state_delete_textures(GLsizei n, GLuint const *textures);
+
+/// @summary Deletes vertex array objects, clearing the cached binding if necessary.
+/// @param n The number of vertex array objects.
+/// @param arrays The OpenGL vertex array objects to delete.
+LLOPENGL_PUBLIC void state_delete_vertex_arrays(GLsizei n, GLuint const *arrays);
+
+/// @summary Deletes a program object. The cached program is not changed, since
+/// a program in use is not deleted until it is no longer current.
+/// @param program The OpenGL program object to delete.
+LLOPENGL_PUBLIC void state_delete_program(GLuint program);
+
+/// @summary Initializes a batch used to build multiple shader programs
+/// concurrently. If KHR_parallel_shader_compile is supported, the driver is
+/// told how many compiler threads to use.
+/// @param batch The shader batch to initialize.
+/// @param capacity The maximum number of programs that will be submitted.
+/// @param thread_count The number of driver compiler threads to request.
+/// Specify 0xFFFFFFFF to let the driver choose.
+/// @return true if the batch is initialized successfully.
+LLOPENGL_PUBLIC bool create_shader_batch(gl::shader_batch_t *batch, size_t capacity, GLuint thread_count);
+
+/// @summary Frees resources associated with a shader batch. Any programs that
+/// have not finished building are deleted; completed programs are retained.
+/// @param batch The shader batch to delete.
+LLOPENGL_PUBLIC void delete_shader_batch(gl::shader_batch_t *batch);
+
+/// @summary Submits a shader program to the driver for compilation without
+/// waiting on the result. The source and shader objects must remain valid
+/// until the program has completed or failed.
+/// @param batch The shader batch.
+/// @param source The shader source code buffer.
+/// @param shader The shader program object to initialize when the build completes.
+/// @return The zero-based index of the program within the batch, or the batch
+/// capacity if the batch is full or the program could not be submitted.
+LLOPENGL_PUBLIC size_t shader_batch_add(gl::shader_batch_t *batch, gl::shader_source_t *source, gl::shader_desc_t *shader);
+
+/// @summary Advances all programs in the batch as far as possible. Programs
+/// whose stages have compiled are linked; programs that have linked are
+/// reflected. When parallel compilation is available this never blocks.
+/// @param batch The shader batch.
+/// @return The number of programs still pending.
+LLOPENGL_PUBLIC size_t shader_batch_poll(gl::shader_batch_t *batch);
+
+/// @summary Blocks until every program in the batch has completed or failed.
+/// @param batch The shader batch.
+/// @return true if every program was built successfully.
+LLOPENGL_PUBLIC bool shader_batch_finish(gl::shader_batch_t *batch);
+
+/// @summary Initializes an on-disk shader program binary cache. The directory
+/// must already exist. If the driver does not support program binaries, the
+/// cache is initialized but disabled, and all builds are performed from source.
+/// This function must be called with an active OpenGL context.
+/// @param cache The shader cache to initialize.
+/// @param directory The NULL-terminated path of the cache directory.
+/// @return true if the cache is initialized successfully.
+LLOPENGL_PUBLIC bool create_shader_cache(gl::shader_cache_t *cache, char const *directory);
+
+/// @summary Frees resources associated with a shader program binary cache.
+/// Files in the cache directory are not modified.
+/// @param cache The shader cache to delete.
+LLOPENGL_PUBLIC void delete_shader_cache(gl::shader_cache_t *cache);
+
+/// @summary Computes a 64-bit hash of the stages and source code strings of a
+/// shader program, used to key entries in the shader program binary cache.
+/// @param source The shader source code buffer.
+/// @return A 64-bit hash value identifying the source code.
+LLOPENGL_PUBLIC uint64_t shader_source_hash(gl::shader_source_t const *source);
+
+/// @summary Builds a shader program, restoring it from the program binary cache
+/// if possible. On a cache miss, or if the driver rejects the cached binary,
+/// the program is compiled, linked and reflected from source and the result is
+/// written back to the cache.
+/// @param cache The shader cache, or NULL to always build from source.
+/// @param source The shader source code buffer.
+/// @param shader The shader program object to initialize.
+/// @param out_program On return, this address is set to the identifier of the
+/// OpenGL shader program object. If an error occurs, this value will be 0.
+/// @return true if the build process was successful.
+LLOPENGL_PUBLIC bool build_shader(gl::shader_cache_t *cache, gl::shader_source_t *source, gl::shader_desc_t *shader, GLuint *out_program);
+
 /// @summary Given an OpenGL block-compressed internal format identifier,
 /// determine the size of each compressed block, in pixels. For non block-
 /// compressed formats, the block size is defined to be 1.
@@ -836,6 +1730,52 @@ LLOPENGL_PUBLIC void texture_storage(
 /// @param transfer An object describing the transfer operation to execute.
 LLOPENGL_PUBLIC void transfer_pixels_d2h(gl::pixel_transfer_d2h_t *transfer);
 
+/// @summary Initializes an asynchronous readback queue. Pack buffers are
+/// allocated on demand, and grow to fit the largest request they receive.
+/// @param stream The readback queue to initialize.
+/// @param slot_count The number of pack buffers to rotate between, at most
+/// GL_MAX_PIXEL_READBACK_SLOTS. Three is sufficient for most applications.
+/// @return true if the queue is initialized successfully.
+LLOPENGL_PUBLIC bool create_pixel_stream_d2h(gl::pixel_stream_d2h_t *stream, size_t slot_count);
+
+/// @summary Deletes the pack buffers and fences owned by a readback queue.
+/// @param stream The readback queue to delete.
+LLOPENGL_PUBLIC void delete_pixel_stream_d2h(gl::pixel_stream_d2h_t *stream);
+
+/// @summary Submits an asynchronous readback. The PackBuffer, Target[X/Y/Z],
+/// Target[Width/Height] and TransferBuffer fields of the transfer description
+/// are ignored; the data is always packed tightly into the next free slot.
+/// If all slots are busy, the request is dropped rather than stalling. A
+/// texture source is read with glGetTexImage, which returns the entire level,
+/// so the transfer region must cover the whole level; for array and 3D
+/// textures every slice of the level is returned. The texture must be bound
+/// to the target.
+/// @param stream The readback queue.
+/// @param transfer Describes the source image and region to download.
+/// @param tag Application-defined data returned with the completed readback.
+/// @return true if the request was submitted, or false if it was dropped or
+/// requested a sub-rectangle of a texture level.
+LLOPENGL_PUBLIC bool pixel_stream_d2h_request(gl::pixel_stream_d2h_t *stream, gl::pixel_transfer_d2h_t const *transfer, uintptr_t tag);
+
+/// @summary Polls the fences of outstanding requests without blocking.
+/// @param stream The readback queue.
+/// @return The number of completed requests that can be mapped immediately.
+LLOPENGL_PUBLIC size_t pixel_stream_d2h_poll(gl::pixel_stream_d2h_t *stream);
+
+/// @summary Maps the oldest outstanding request, if the GPU has completed it.
+/// Requests are always returned in submission order. Only one request may be
+/// mapped at a time; release it with pixel_stream_d2h_release().
+/// @param stream The readback queue.
+/// @param out_readback On return, describes the mapped pixel data.
+/// @return true if a completed request was mapped, or false if none are ready.
+LLOPENGL_PUBLIC bool pixel_stream_d2h_try_map(gl::pixel_stream_d2h_t *stream, gl::pixel_readback_t *out_readback);
+
+/// @summary Unmaps the request returned by pixel_stream_d2h_try_map(), making
+/// its slot available for a new request. Any pointers into the mapped data
+/// are invalidated, so worker threads must be finished with it.
+/// @param stream The readback queue.
+LLOPENGL_PUBLIC void pixel_stream_d2h_release(gl::pixel_stream_d2h_t *stream);
+
 /// @summary Allocates a buffer for streaming pixel data from the host (CPU)
 /// to the device (GPU). The buffer exists in driver-accessable memory.
 /// @param stream The stream to initialize.
@@ -844,36 +1784,142 @@ LLOPENGL_PUBLIC void transfer_pixels_d2h(gl::pixel_transfer_d2h_t *transfer);
 /// @return true if the stream is initialized successfully.
 LLOPENGL_PUBLIC bool create_pixel_stream_h2d(gl::pixel_stream_h2d_t *stream, size_t alignment, size_t size);
 
+/// @summary Allocates a buffer for streaming pixel data from the host (CPU)
+/// to the device (GPU). The buffer exists in driver-accessable memory.
+/// @param stream The stream to initialize.
+/// @param alignment The alignment required for mapped buffers. Specify zero to use the default alignment.
+/// @param size The desired size of the buffer, in bytes.
+/// @param flags A combination of pixel_stream_flags_e. PIXEL_STREAM_FLAGS_PERSISTENT
+/// requires OpenGL 4.4 or ARB_buffer_storage.
+/// @return true if the stream is initialized successfully.
+LLOPENGL_PUBLIC bool create_pixel_stream_h2d(gl::pixel_stream_h2d_t *stream, size_t alignment, size_t size, uint32_t flags);
+
 /// @summary Deletes a host-to-device pixel stream.
 /// @param stream The pixel stream to delete.
 LLOPENGL_PUBLIC void delete_pixel_stream_h2d(gl::pixel_stream_h2d_t *stream);
 
 /// @summary Reserves a portion of the pixel streaming buffer for use by the
-/// application. Note that only one buffer reservation may be active at any given time.
+/// application. If the ring has wrapped onto a region the GPU may still be
+/// reading, the call fences any committed regions that have no fence yet,
+/// then waits on the oldest region's fence, or fails immediately if the
+/// stream was created with PIXEL_STREAM_FLAGS_NO_WAIT. Unless the stream is
+/// persistently mapped, only one reservation may be active at any given time.
 /// @param stream The pixel stream to allocate from.
 /// @param size The number of bytes to allocate.
 /// @return A pointer to the start of the reserved region, or NULL.
 LLOPENGL_PUBLIC void* pixel_stream_h2d_reserve(gl::pixel_stream_h2d_t *stream, size_t size);
 
-/// @summary Commits the reserved region of the buffer, indicating that the
-/// application has finished accessing the buffer directly. The reserved portion
-/// of the buffer may now be used as a transfer source.
+/// @summary Commits the most recently reserved region of the buffer, indicating
+/// that the application has finished accessing the buffer directly. The reserved
+/// portion of the buffer may now be used as a transfer source.
 /// @param stream The stream to commit.
 /// @param transfer The transfer object to populate. The UnpackBuffer, TransferSize and TransferBuffer fields will be modified.
 /// @return true if the transfer was successfully committed.
 LLOPENGL_PUBLIC bool pixel_stream_h2d_commit(gl::pixel_stream_h2d_t *stream, gl::pixel_transfer_h2d_t *transfer);
 
-/// @summary Cancels the reserved region of the buffer, indicating that the
-/// application has finished accessing the buffer directly. The reserved
-/// portion of the buffer will be rolled back, anc cannot be used as a transfer source.
+/// @summary Commits a specific reserved region of the buffer, indicating that
+/// the application has finished accessing that region directly.
+/// @param stream The stream to commit.
+/// @param reservation The address returned by pixel_stream_h2d_reserve().
+/// @param transfer The transfer object to populate. The UnpackBuffer, TransferSize and TransferBuffer fields will be modified.
+/// @return true if the transfer was successfully committed.
+LLOPENGL_PUBLIC bool pixel_stream_h2d_commit(gl::pixel_stream_h2d_t *stream, void const *reservation, gl::pixel_transfer_h2d_t *transfer);
+
+/// @summary Cancels the most recently reserved region of the buffer, indicating
+/// that the application has finished accessing the buffer directly. The reserved
+/// portion of the buffer will be rolled back, and cannot be used as a transfer source.
 /// @param stream The stream to roll back.
 LLOPENGL_PUBLIC void pixel_stream_h2d_cancel(gl::pixel_stream_h2d_t *stream);
 
+/// @summary Cancels a specific reserved region of the buffer.
+/// @param stream The stream to roll back.
+/// @param reservation The address returned by pixel_stream_h2d_reserve().
+LLOPENGL_PUBLIC void pixel_stream_h2d_cancel(gl::pixel_stream_h2d_t *stream, void const *reservation);
+
+/// @summary Places a fence behind all committed regions of the buffer. This
+/// is optional, but calling it after issuing the transfer_pixels_h2d() calls
+/// that source data from the committed regions lets the regions be recycled
+/// as soon as the fence signals, rather than when the ring next fills up.
+/// @param stream The stream to fence.
+/// @return The number of regions that were fenced.
+LLOPENGL_PUBLIC size_t pixel_stream_h2d_fence(gl::pixel_stream_h2d_t *stream);
+
+/// @summary Polls the fences of in-flight regions without blocking, and
+/// releases any regions the GPU has finished reading from.
+/// @param stream The stream to update.
+/// @return The number of bytes released.
+LLOPENGL_PUBLIC size_t pixel_stream_h2d_retire(gl::pixel_stream_h2d_t *stream);
+
+/// @summary Resets the counters associated with a pixel stream. The value of
+/// BytesInFlight is preserved, and becomes the new MaxInFlight value.
+/// @param stream The stream whose counters will be reset.
+LLOPENGL_PUBLIC void pixel_stream_h2d_reset_stats(gl::pixel_stream_h2d_t *stream);
+
 /// @summary Copies pixel data from the host (CPU) to the device (GPU). The
 /// pixel data is copied to a single mip-level of a texture image.
 /// @param transfer An object describing the transfer operation to execute.
 LLOPENGL_PUBLIC void transfer_pixels_h2d(gl::pixel_transfer_h2d_t *transfer);
 
+/// @summary Initializes an upload scheduler with the specified budgets.
+/// @param sched The upload scheduler to initialize.
+/// @param capacity The expected number of queued jobs.
+/// @param byte_budget The maximum number of bytes uploaded per drain, or 0 for no limit.
+/// @param time_budget The maximum CPU time spent per drain, in microseconds, or 0 for no limit.
+/// @return true if the scheduler was initialized.
+LLOPENGL_PUBLIC bool create_upload_scheduler(gl::upload_scheduler_t *sched, size_t capacity, size_t byte_budget, uint64_t time_budget);
+
+/// @summary Frees the storage associated with an upload scheduler. Jobs still
+/// queued are discarded without calling the completion function.
+/// @param sched The upload scheduler to delete.
+LLOPENGL_PUBLIC void delete_upload_scheduler(gl::upload_scheduler_t *sched);
+
+/// @summary Queues a pixel transfer for execution by upload_scheduler_drain().
+/// The current GL_UNPACK_ALIGNMENT is recorded and applied when the job
+/// executes. This function must be called on the thread that owns the OpenGL context.
+/// @param sched The upload scheduler.
+/// @param texture The texture object written by the transfer; it is bound to
+/// the transfer target (or GL_TEXTURE_CUBE_MAP, for cube map faces) when the job executes.
+/// @param transfer The transfer to execute. The structure is copied.
+/// @param priority The job priority; lower values are executed first. See upload_priority().
+/// @param tag An application-defined value passed to the completion function.
+/// @return true if the job was queued.
+LLOPENGL_PUBLIC bool upload_scheduler_submit(gl::upload_scheduler_t *sched, GLuint texture, gl::pixel_transfer_h2d_t const *transfer, uint32_t priority, uintptr_t tag);
+
+/// @summary Removes all queued jobs with a given tag, for example because the
+/// target texture is being deleted. The completion function is not called.
+/// @param sched The upload scheduler.
+/// @param tag The tag of the jobs to remove.
+/// @return The number of jobs removed.
+LLOPENGL_PUBLIC size_t upload_scheduler_cancel(gl::upload_scheduler_t *sched, uintptr_t tag);
+
+/// @summary Immediately executes all queued jobs with a given tag, in priority
+/// order and without regard to the budgets, for example because their source
+/// data or target texture is about to be modified. The completion function is
+/// called for each job. This function must be called on the thread that owns
+/// the OpenGL context.
+/// @param sched The upload scheduler.
+/// @param tag The tag of the jobs to execute.
+/// @return The number of bytes uploaded.
+LLOPENGL_PUBLIC size_t upload_scheduler_flush(gl::upload_scheduler_t *sched, uintptr_t tag);
+
+/// @summary Counts the queued jobs with a given tag.
+/// @param sched The upload scheduler.
+/// @param tag The tag of the jobs to count.
+/// @return The number of jobs with the tag waiting to execute.
+LLOPENGL_PUBLIC size_t upload_scheduler_pending(gl::upload_scheduler_t const *sched, uintptr_t tag);
+
+/// @summary Executes queued jobs in priority order until the byte or time
+/// budget is exhausted. Call this once per-frame on the thread that owns the
+/// OpenGL context.
+/// @param sched The upload scheduler.
+/// @return The number of bytes uploaded.
+LLOPENGL_PUBLIC size_t upload_scheduler_drain(gl::upload_scheduler_t *sched);
+
+/// @summary Resets the counters associated with an upload scheduler. The
+/// queue depth and size are preserved.
+/// @param sched The upload scheduler whose counters will be reset.
+LLOPENGL_PUBLIC void upload_scheduler_reset_stats(gl::upload_scheduler_t *sched);
+
 /// @summary Initializes a sprite batch with the specified capacity.
 /// @param batch The sprite batch.
 /// @param capacity The initial capacity of the batch, in quads.
@@ -972,11 +2018,36 @@ LLOPENGL_PUBLIC void sprite_effect_blend_additive(gl::sprite_effect_t *effect);
 /// @param effect The effect to update.
 LLOPENGL_PUBLIC void sprite_effect_blend_premultiplied(gl::sprite_effect_t *effect);
 
-/// @summary Sets up the effect projection matrix for the given viewport.
+/// @summary Sets up the effect projection matrix for the given viewport. When
+/// a constant ring is supplied, the matrix is written once into the current
+/// frame segment of the ring as a SpriteConstants block, and shaders pick it
+/// up through gl::sprite_effect_apply_constants() without any glUniform call.
+/// Since the ring segment is recycled, call this once per frame after
+/// gl::constant_ring_begin_frame().
 /// @param effect The effect to update.
 /// @param width The viewport width.
 /// @param height The viewport height.
-LLOPENGL_PUBLIC void sprite_effect_set_viewport(gl::sprite_effect_t *effect, int width, int height);
+/// @param ring The constant ring used to supply the matrix, or NULL to upload
+/// effect->Projection with glUniformMatrix4fv instead.
+/// @return false if the ring segment for the current frame is exhausted.
+LLOPENGL_PUBLIC bool sprite_effect_set_viewport(gl::sprite_effect_t *effect, int width, int height, gl::constant_ring_t *ring = NULL);
+
+/// @summary Writes effect->Projection into a new range of the effect's
+/// constant ring. Call this after modifying the projection matrix directly.
+/// Nothing is written if the effect has no constant ring.
+/// @param effect The effect to update.
+/// @return false if the ring segment for the current frame is exhausted.
+LLOPENGL_PUBLIC bool sprite_effect_update_constants(gl::sprite_effect_t *effect);
+
+/// @summary Supplies the effect projection matrix to the currently bound
+/// sprite shader. If the effect has a constant ring and the shader declares
+/// the SpriteConstants block, the range written by the last viewport update
+/// is bound to the block; otherwise the matrix is uploaded to the uMSS
+/// uniform. Call this from the effect setup callback.
+/// @param effect The effect being applied.
+/// @param block The SpriteConstants block of the shader, or NULL.
+/// @param uniform The uMSS uniform of the shader.
+LLOPENGL_PUBLIC void sprite_effect_apply_constants(gl::sprite_effect_t *effect, gl::uniform_block_desc_t const *block, gl::uniform_desc_t *uniform);
 
 /// @summary Binds the vertex and index buffers of an effect for use in
 /// subsequent rendering commands.
@@ -1022,6 +2093,34 @@ LLOPENGL_PUBLIC void sprite_effect_draw_batch_ptc(
     gl::sprite_effect_apply_t const *fxfuncs,
     void                            *context);
 
+/// @summary Sorts a sprite batch for layered rendering. Sprites flagged with
+/// SPRITE_FLAG_OPAQUE are moved to the start of the order array and sorted
+/// front-to-back; the remaining sprites follow, sorted back-to-front. The
+/// number of opaque sprites is stored in batch->OpaqueCount.
+/// @param batch The sprite batch to sort.
+LLOPENGL_PUBLIC void sort_sprite_batch_layered(gl::sprite_batch_t *batch);
+
+/// @summary Renders a sprite batch sorted with sort_sprite_batch_layered() in
+/// two passes. Opaque sprites are drawn front-to-back with blending disabled
+/// and depth writes enabled, so hidden pixels in deep layer stacks are
+/// rejected by the depth test. Translucent sprites are then drawn
+/// back-to-front with the effect's blend state, depth-tested against the
+/// opaque sprites but without depth writes. The application must provide a
+/// depth buffer and clear it each frame. The effect setup callback is invoked
+/// once per pass with effect->Pass set; when using the built-in textured
+/// sprite shader it should set uATH to a threshold such as 0.5 for the opaque
+/// pass, and to zero otherwise. The effect functions must not change the
+/// blend state while the opaque pass is drawn.
+/// @param effect The effect being applied.
+/// @param batch The sprite batch being rendered.
+/// @param fxfuncs The effect-specific functions for applying render state.
+/// @param context Opaque data defined by the application.
+LLOPENGL_PUBLIC void sprite_effect_draw_batch_layered_ptc(
+    gl::sprite_effect_t             *effect,
+    gl::sprite_batch_t              *batch,
+    gl::sprite_effect_apply_t const *fxfuncs,
+    void                            *context);
+
 /// @summary Renders a portion of a sprite batch for which the vertex and index
 /// data has already been buffered. This function is generally not called by
 /// the user directly; it is called internally from sprite_effect_draw_batch_ptc().
@@ -1042,8 +2141,11 @@ LLOPENGL_PUBLIC void sprite_effect_draw_batch_region_ptc(
 /// @summary Creates a shader program consisting of a vertex and fragment shader
 /// used for rendering solid-colored 2D sprites in screen space.
 /// @param shader The shader state to initialize.
+/// @param constant_block Specify true to declare the projection matrix in a
+/// std140 SpriteConstants block supplied from a constant ring, or false to
+/// declare it as a plain uMSS uniform for use without a constant ring.
 /// @return true if the shader program was created successfully.
-LLOPENGL_PUBLIC bool create_sprite_shader_ptc_clr(gl::sprite_shader_ptc_clr_t *shader);
+LLOPENGL_PUBLIC bool create_sprite_shader_ptc_clr(gl::sprite_shader_ptc_clr_t *shader, bool constant_block = true);
 
 /// @summary Frees the resources associated with a solid-color sprite shader.
 /// @param shader The shader program object to free.
@@ -1054,16 +2156,296 @@ LLOPENGL_PUBLIC void delete_sprite_shader_ptc_clr(gl::sprite_shader_ptc_clr_t *s
 /// image data from a single 2D texture object, and modulate the sample value
 /// with the per-sprite tint color.
 /// @param shader The shader state to initialize.
+/// @param constant_block Specify true to declare the projection matrix in a
+/// std140 SpriteConstants block supplied from a constant ring, or false to
+/// declare it as a plain uMSS uniform for use without a constant ring.
 /// @return true if the shader program was created successfully.
-LLOPENGL_PUBLIC bool create_sprite_shader_ptc_tex(gl::sprite_shader_ptc_tex_t *shader);
+LLOPENGL_PUBLIC bool create_sprite_shader_ptc_tex(gl::sprite_shader_ptc_tex_t *shader, bool constant_block = true);
 
 /// @summary Frees the resources associated with a textured sprite shader.
 /// @param shader The shader program object to free.
 LLOPENGL_PUBLIC void delete_sprite_shader_ptc_tex(gl::sprite_shader_ptc_tex_t *shader);
 
+/// @summary Creates a shader program consisting of a vertex and fragment shader
+/// used for rendering standard 2D sprites in screen space. The shaders sample
+/// image data from a 2D texture array using the per-sprite layer, and modulate
+/// the sample value with the per-sprite tint color.
+/// @param shader The shader state to initialize.
+/// @param constant_block Specify true to declare the projection matrix in a
+/// std140 SpriteConstants block supplied from a constant ring, or false to
+/// declare it as a plain uMSS uniform for use without a constant ring.
+/// @return true if the shader program was created successfully.
+LLOPENGL_PUBLIC bool create_sprite_shader_ptc_arr(gl::sprite_shader_ptc_arr_t *shader, bool constant_block = true);
+
+/// @summary Frees the resources associated with a texture array sprite shader.
+/// @param shader The shader program object to free.
+LLOPENGL_PUBLIC void delete_sprite_shader_ptc_arr(gl::sprite_shader_ptc_arr_t *shader);
+
+/// @summary Creates a shader program consisting of a vertex and fragment shader
+/// used for rendering text in screen space from signed distance field pages,
+/// such as those generated by gui::distance_field_page(). The pages must be
+/// uploaded as separate GL_R8 2D textures with linear filtering; the vertex
+/// layer is ignored. Use create_sprite_shader_ptc_sdf_arr() for pages stored
+/// in a texture array. The edge offset uniform
+/// defaults to zero, placing the glyph edge at a distance value of 0.5.
+/// @param shader The shader state to initialize.
+/// @param constant_block Specify true to declare the projection matrix in a
+/// std140 SpriteConstants block supplied from a constant ring, or false to
+/// declare it as a plain uMSS uniform for use without a constant ring.
+/// @return true if the shader program was created successfully.
+LLOPENGL_PUBLIC bool create_sprite_shader_ptc_sdf(gl::sprite_shader_ptc_sdf_t *shader, bool constant_block = true);
+
+/// @summary Frees the resources associated with a distance field sprite shader.
+/// @param shader The shader program object to free.
+LLOPENGL_PUBLIC void delete_sprite_shader_ptc_sdf(gl::sprite_shader_ptc_sdf_t *shader);
+
+/// @summary Creates a shader program consisting of a vertex and fragment shader
+/// used for rendering text in screen space from signed distance field pages
+/// stored in the layers of a GL_R8 2D texture array with linear filtering.
+/// The page is selected by the per-vertex layer.
+/// @param shader The shader state to initialize.
+/// @param constant_block Specify true to declare the projection matrix in a
+/// std140 SpriteConstants block supplied from a constant ring, or false to
+/// declare it as a plain uMSS uniform for use without a constant ring.
+/// @return true if the shader program was created successfully.
+LLOPENGL_PUBLIC bool create_sprite_shader_ptc_sdf_arr(gl::sprite_shader_ptc_sdf_arr_t *shader, bool constant_block = true);
+
+/// @summary Frees the resources associated with a texture array distance field sprite shader.
+/// @param shader The shader program object to free.
+LLOPENGL_PUBLIC void delete_sprite_shader_ptc_sdf_arr(gl::sprite_shader_ptc_sdf_arr_t *shader);
+
+/// @summary Creates the timestamp query objects for a GPU profiler. If the
+/// driver reports no timestamp counter bits, the profiler is created in the
+/// disabled state and all scopes are ignored.
+/// @param profiler The GPU profiler to initialize.
+/// @param frame_count The number of frames of latency before query results
+/// are read back, at most GL_MAX_GPU_PROFILER_FRAMES. Three is typical.
+/// @return true if the profiler was initialized.
+LLOPENGL_PUBLIC bool create_gpu_profiler(gl::gpu_profiler_t *profiler, size_t frame_count);
+
+/// @summary Deletes the query objects owned by a GPU profiler.
+/// @param profiler The GPU profiler to delete.
+LLOPENGL_PUBLIC void delete_gpu_profiler(gl::gpu_profiler_t *profiler);
+
+/// @summary Sets the GPU profiler used by gpu_scope_begin() and gpu_scope_end().
+/// The llopengl and gldraw2d draw and transfer functions record scopes into
+/// the current profiler.
+/// @param profiler The GPU profiler to make current, or NULL to disable profiling.
+LLOPENGL_PUBLIC void make_gpu_profiler_current(gl::gpu_profiler_t *profiler);
+
+/// @summary Retrieves the GPU profiler used by gpu_scope_begin() and gpu_scope_end().
+/// @return The current GPU profiler, or NULL.
+LLOPENGL_PUBLIC gl::gpu_profiler_t* current_gpu_profiler(void);
+
+/// @summary Advances the GPU profiler to the next frame, resolving the queries
+/// recorded FrameCount frames ago and updating the per-scope statistics.
+/// @param profiler The GPU profiler.
+LLOPENGL_PUBLIC void gpu_profiler_begin_frame(gl::gpu_profiler_t *profiler);
+
+/// @summary Marks the end of the frame being recorded. Any scopes still open
+/// are closed.
+/// @param profiler The GPU profiler.
+LLOPENGL_PUBLIC void gpu_profiler_end_frame(gl::gpu_profiler_t *profiler);
+
+/// @summary Resets the accumulated min, max and average statistics of all scopes.
+/// @param profiler The GPU profiler.
+LLOPENGL_PUBLIC void gpu_profiler_reset_stats(gl::gpu_profiler_t *profiler);
+
+/// @summary Retrieves the statistics for a named scope.
+/// @param profiler The GPU profiler to query.
+/// @param name A NULL-terminated ASCII string scope name.
+/// @return The scope statistics, or NULL if no scope has the given name.
+LLOPENGL_PUBLIC gl::gpu_scope_stats_t const* gpu_profiler_find(gl::gpu_profiler_t const *profiler, char const *name);
+
+/// @summary Copies the statistics of all named scopes to an array.
+/// @param profiler The GPU profiler to query.
+/// @param stats The array to receive the scope statistics.
+/// @param max_stats The maximum number of items to write to @a stats.
+/// @return The number of items written to @a stats.
+LLOPENGL_PUBLIC size_t gpu_profiler_export(gl::gpu_profiler_t const *profiler, gl::gpu_scope_stats_t *stats, size_t max_stats);
+
+/// @summary Opens a named scope in the current GPU profiler, if any.
+/// @param name A NULL-terminated ASCII string scope name. The string must
+/// remain valid for the lifetime of the profiler; string literals are typical.
+LLOPENGL_PUBLIC void gpu_scope_begin(char const *name);
+
+/// @summary Closes the most recently opened scope in the current GPU profiler, if any.
+LLOPENGL_PUBLIC void gpu_scope_end(void);
+
+/// @summary Allocates storage for a command buffer. The buffer grows as needed.
+/// @param cmdbuf The command buffer to initialize.
+/// @param capacity The initial capacity, in bytes.
+/// @return true if the command buffer was initialized.
+LLOPENGL_PUBLIC bool create_command_buffer(gl::command_buffer_t *cmdbuf, size_t capacity);
+
+/// @summary Frees the storage owned by a command buffer.
+/// @param cmdbuf The command buffer to delete.
+LLOPENGL_PUBLIC void delete_command_buffer(gl::command_buffer_t *cmdbuf);
+
+/// @summary Discards all commands recorded into a command buffer.
+/// @param cmdbuf The command buffer to reset.
+LLOPENGL_PUBLIC void command_buffer_reset(gl::command_buffer_t *cmdbuf);
+
+/// @summary Starts a new command group. Subsequent commands are replayed at
+/// the position determined by the sort key. Commands recorded before the
+/// first call use a sort key of zero.
+/// @param cmdbuf The command buffer.
+/// @param sort_key The application-defined sort key.
+/// @return true if the group was started.
+LLOPENGL_PUBLIC bool command_buffer_sort_key(gl::command_buffer_t *cmdbuf, uint64_t sort_key);
+
+/// @summary Records a command to select a program object.
+/// @param cmdbuf The command buffer.
+/// @param program The OpenGL program object.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_use_program(gl::command_buffer_t *cmdbuf, GLuint program);
+
+/// @summary Records a command to bind a vertex array object.
+/// @param cmdbuf The command buffer.
+/// @param vao The OpenGL vertex array object.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_bind_vertex_array(gl::command_buffer_t *cmdbuf, GLuint vao);
+
+/// @summary Records a command to bind a buffer object.
+/// @param cmdbuf The command buffer.
+/// @param target The buffer target, ex. GL_ARRAY_BUFFER.
+/// @param buffer The OpenGL buffer object.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_bind_buffer(gl::command_buffer_t *cmdbuf, GLenum target, GLuint buffer);
+
+/// @summary Records a command to bind a range of a buffer object to an indexed binding point.
+/// @param cmdbuf The command buffer.
+/// @param target The indexed buffer target, ex. GL_UNIFORM_BUFFER.
+/// @param index The binding point index.
+/// @param buffer The OpenGL buffer object.
+/// @param offset The byte offset of the range.
+/// @param size The size of the range, in bytes.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_bind_buffer_range(gl::command_buffer_t *cmdbuf, GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+/// @summary Records a command to bind a texture object to a texture unit.
+/// @param cmdbuf The command buffer.
+/// @param unit The zero-based texture unit.
+/// @param target The texture target, ex. GL_TEXTURE_2D.
+/// @param texture The OpenGL texture object.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_bind_texture(gl::command_buffer_t *cmdbuf, GLuint unit, GLenum target, GLuint texture);
+
+/// @summary Records a command to bind a texture to a sampler of the current program.
+/// @param cmdbuf The command buffer.
+/// @param sampler The sampler description, which must remain valid until replay.
+/// @param texture The OpenGL texture object.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_set_sampler(gl::command_buffer_t *cmdbuf, gl::sampler_desc_t *sampler, GLuint texture);
+
+/// @summary Records a command to set a uniform of the current program. The
+/// uniform value is copied into the command buffer.
+/// @param cmdbuf The command buffer.
+/// @param uniform The uniform description, which must remain valid until replay.
+/// @param value The uniform value; uniform->DataSize bytes are copied.
+/// @param transpose For matrix values, specify true to transpose the matrix.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_set_uniform(gl::command_buffer_t *cmdbuf, gl::uniform_desc_t *uniform, void const *value, bool transpose);
+
+/// @summary Records a command to enable or disable a capability.
+/// @param cmdbuf The command buffer.
+/// @param cap The capability, ex. GL_BLEND.
+/// @param enable Specify true to enable the capability.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_enable(gl::command_buffer_t *cmdbuf, GLenum cap, bool enable);
+
+/// @summary Records a command to set the blend factors.
+/// @param cmdbuf The command buffer.
+/// @param src_rgb The source RGB blend factor.
+/// @param dst_rgb The destination RGB blend factor.
+/// @param src_alpha The source alpha blend factor.
+/// @param dst_alpha The destination alpha blend factor.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_blend_func(gl::command_buffer_t *cmdbuf, GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha);
+
+/// @summary Records a command to set the blend equations.
+/// @param cmdbuf The command buffer.
+/// @param mode_rgb The RGB blend equation.
+/// @param mode_alpha The alpha blend equation.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_blend_equation(gl::command_buffer_t *cmdbuf, GLenum mode_rgb, GLenum mode_alpha);
+
+/// @summary Records a command to set the constant blend color.
+/// @param cmdbuf The command buffer.
+/// @param r The red component.
+/// @param g The green component.
+/// @param b The blue component.
+/// @param a The alpha component.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_blend_color(gl::command_buffer_t *cmdbuf, float r, float g, float b, float a);
+
+/// @summary Records a command to set the depth comparison function.
+/// @param cmdbuf The command buffer.
+/// @param func The depth comparison function, ex. GL_LEQUAL.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_depth_func(gl::command_buffer_t *cmdbuf, GLenum func);
+
+/// @summary Records a command to enable or disable depth buffer writes.
+/// @param cmdbuf The command buffer.
+/// @param write Specify true to enable depth writes.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_depth_mask(gl::command_buffer_t *cmdbuf, bool write);
+
+/// @summary Records a host-to-device pixel transfer. The transfer description
+/// is copied; any client memory it references must remain valid until replay.
+/// @param cmdbuf The command buffer.
+/// @param transfer The pixel transfer description.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_transfer_pixels_h2d(gl::command_buffer_t *cmdbuf, gl::pixel_transfer_h2d_t const *transfer);
+
+/// @summary Records a device-to-host pixel transfer. The transfer description
+/// is copied; any client memory it references must remain valid until replay.
+/// @param cmdbuf The command buffer.
+/// @param transfer The pixel transfer description.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_transfer_pixels_d2h(gl::command_buffer_t *cmdbuf, gl::pixel_transfer_d2h_t const *transfer);
+
+/// @summary Records a command to draw a sprite batch. The effect, batch and
+/// effect functions must remain valid and unmodified until replay.
+/// @param cmdbuf The command buffer.
+/// @param effect The sprite effect used to draw the batch.
+/// @param batch The sprite batch to draw.
+/// @param fxfuncs The effect setup and state application functions.
+/// @param context Opaque data passed to the effect functions.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_draw_sprite_batch(gl::command_buffer_t *cmdbuf, gl::sprite_effect_t *effect, gl::sprite_batch_t *batch, gl::sprite_effect_apply_t const *fxfuncs, void *context);
+
+/// @summary Records a command that invokes an application-defined function on the GL thread.
+/// @param cmdbuf The command buffer.
+/// @param func The function to invoke.
+/// @param context Opaque data passed to the function.
+/// @return true if the command was recorded.
+LLOPENGL_PUBLIC bool command_buffer_callback(gl::command_buffer_t *cmdbuf, gl::command_callback_fn func, void *context);
+
+/// @summary Replays a set of command buffers on the GL thread. The command
+/// groups of all buffers are merged and executed in ascending sort key order.
+/// The buffers are not modified; call command_buffer_reset() to re-use them.
+/// @param buffers The list of command buffers to replay.
+/// @param buffer_count The number of command buffers.
+/// @return The number of commands executed.
+LLOPENGL_PUBLIC size_t execute_command_buffers(gl::command_buffer_t * const *buffers, size_t buffer_count);
+
 /*////////////////////////
 //   Inline Functions   //
 ////////////////////////*/
+/// @summary Computes an upload job priority. Jobs for visible content are
+/// executed before all other jobs, and within each group, smaller mip levels
+/// (the mip tail) are executed first, so that a texture becomes usable at
+/// low resolution as early as possible.
+/// @param visible Specify true if the texture is currently visible.
+/// @param level The zero-based mip level written by the job.
+/// @return A priority value for use with upload_scheduler_submit().
+static inline uint32_t upload_priority(bool visible, size_t level)
+{
+    uint32_t const lod = level < 0xFFFFU ? uint32_t(level) : 0xFFFFU;
+    return (visible ? 0U : 0x80000000U) | (0xFFFFU - lod);
+}
+
 /// @summary Searches a list of name-value pairs for a named item.
 /// @param name_u32 The 32-bit unsigned integer hash of the search query.
 /// @param name_list A list of 32-bit unsigned integer name hashes.
@@ -1094,13 +2476,76 @@ static inline T* kv_find(char const *name_str, uint32_t const *name_list, T *val
     return gl::kv_find(name_u32, name_list, value_list, count);
 }
 
+/// @summary Calculates the same 32-bit hash value as shader_name(), but can be
+/// evaluated at compile time. To guarantee compile-time evaluation, use the
+/// result to initialize a constant, ex. static uint32_t const U = shader_name_literal("uMSS");
+/// @param name A NULL-terminated ASCII string identifier.
+/// @param hash The hash of the preceeding characters. Always specify 0.
+/// @return A 32-bit unsigned integer hash of the name.
+LLOPENGL_CONSTEXPR uint32_t shader_name_literal(char const *name, uint32_t hash = 0)
+{
+    return (*name != '\0') ? gl::shader_name_literal(name + 1, ((hash << 7) | (hash >> 25)) + uint32_t(*name)) : hash;
+}
+
+/// @summary Maps a name hash to a bucket of a perfect hash table.
+/// @param name The 32-bit name hash.
+/// @param mask The bucket mask, stored as the first element of the table.
+/// @return The zero-based bucket index.
+static inline uint32_t phf_bucket(uint32_t name, uint32_t mask)
+{
+    name ^= name >> 16;
+    name *= 0x85EBCA6BU;
+    name ^= name >> 13;
+    return name & mask;
+}
+
+/// @summary Maps a name hash and bucket displacement to a slot of a perfect
+/// hash table.
+/// @param name The 32-bit name hash.
+/// @param disp The displacement value for the bucket containing the name.
+/// @param count The number of items in the table.
+/// @return The zero-based slot index, in [0, count).
+static inline size_t phf_slot(uint32_t name, uint32_t disp, size_t count)
+{
+    uint32_t x = (name ^ (disp * 0x9E3779B1U)) * 0xC2B2AE35U;
+    x ^= x >> 15;
+    return size_t((uint64_t(x) * uint64_t(count)) >> 32);
+}
+
+/// @summary Searches a perfect hash indexed list of name-value pairs for a
+/// named item. This requires a single probe into the name list.
+/// @param name_u32 The 32-bit unsigned integer hash of the search query.
+/// @param name_list A list of 32-bit unsigned integer name hashes.
+/// @param value_list A list of values, ordered such that name_list[i]
+/// corresponds to value_list[i].
+/// @param index The perfect hash table built by shader_desc_index().
+/// @param count The number of items in the name and value lists.
+template <typename T>
+static inline T* phf_find(uint32_t name_u32, uint32_t const *name_list, T *value_list, uint16_t const *index, size_t count)
+{
+    if (count == 0) return NULL;
+    if (index == NULL || index[0] == GL_SHADER_INDEX_NONE)
+        return gl::kv_find(name_u32, name_list, value_list, count);
+    size_t i = gl::phf_slot(name_u32, index[1 + gl::phf_bucket(name_u32, index[0])], count);
+    return (name_list[i] == name_u32) ? &value_list[i] : NULL;
+}
+
 /// @summary Searches for a vertex attribute definition by name.
 /// @param shader The shader program object to query.
 /// @param name A NULL-terminated ASCII string vertex attribute identifier.
 /// @return The corresponding vertex attribute definition, or NULL.
 static inline gl::attribute_desc_t *find_attribute(gl::shader_desc_t *shader, char const *name)
 {
-    return gl::kv_find(name, shader->AttributeNames, shader->Attributes, shader->AttributeCount);
+    return gl::phf_find(gl::shader_name(name), shader->AttributeNames, shader->Attributes, shader->AttributeIndex, shader->AttributeCount);
+}
+
+/// @summary Searches for a vertex attribute definition by name.
+/// @param shader The shader program object to query.
+/// @param name The hashed name, from shader_name() or shader_name_literal().
+/// @return The corresponding vertex attribute definition, or NULL.
+static inline gl::attribute_desc_t *find_attribute(gl::shader_desc_t *shader, uint32_t name)
+{
+    return gl::phf_find(name, shader->AttributeNames, shader->Attributes, shader->AttributeIndex, shader->AttributeCount);
 }
 
 /// @summary Searches for a texture sampler definition by name.
@@ -1109,7 +2554,16 @@ static inline gl::attribute_desc_t *find_attribute(gl::shader_desc_t *shader, ch
 /// @return The corresponding texture sampler definition, or NULL.
 static inline gl::sampler_desc_t* find_sampler(gl::shader_desc_t *shader, char const *name)
 {
-    return gl::kv_find(name, shader->SamplerNames, shader->Samplers, shader->SamplerCount);
+    return gl::phf_find(gl::shader_name(name), shader->SamplerNames, shader->Samplers, shader->SamplerIndex, shader->SamplerCount);
+}
+
+/// @summary Searches for a texture sampler definition by name.
+/// @param shader The shader program object to query.
+/// @param name The hashed name, from shader_name() or shader_name_literal().
+/// @return The corresponding texture sampler definition, or NULL.
+static inline gl::sampler_desc_t* find_sampler(gl::shader_desc_t *shader, uint32_t name)
+{
+    return gl::phf_find(name, shader->SamplerNames, shader->Samplers, shader->SamplerIndex, shader->SamplerCount);
 }
 
 /// @summary Searches for a uniform variable definition by name.
@@ -1118,7 +2572,25 @@ static inline gl::sampler_desc_t* find_sampler(gl::shader_desc_t *shader, char c
 /// @return The corresponding uniform variable definition, or NULL.
 static inline gl::uniform_desc_t* find_uniform(gl::shader_desc_t *shader, char const *name)
 {
-    return gl::kv_find(name, shader->UniformNames, shader->Uniforms, shader->UniformCount);
+    return gl::phf_find(gl::shader_name(name), shader->UniformNames, shader->Uniforms, shader->UniformIndex, shader->UniformCount);
+}
+
+/// @summary Searches for a uniform variable definition by name.
+/// @param shader The shader program object to query.
+/// @param name The hashed name, from shader_name() or shader_name_literal().
+/// @return The corresponding uniform variable definition, or NULL.
+static inline gl::uniform_desc_t* find_uniform(gl::shader_desc_t *shader, uint32_t name)
+{
+    return gl::phf_find(name, shader->UniformNames, shader->Uniforms, shader->UniformIndex, shader->UniformCount);
+}
+
+/// @summary Searches for a uniform block definition by name.
+/// @param shader The shader program object to query.
+/// @param name A NULL-terminated ASCII string uniform block identifier.
+/// @return The corresponding uniform block definition, or NULL.
+static inline gl::uniform_block_desc_t* find_uniform_block(gl::shader_desc_t *shader, char const *name)
+{
+    return gl::kv_find(name, shader->UniformBlockNames, shader->UniformBlocks, shader->UniformBlockCount);
 }
 
 /// @summary Sorts a sprite batch using std::sort(). The sort is indirect; the
@@ -6,29 +6,87 @@
 /*////////////////
 //   Includes   //
 ////////////////*/
+#include <math.h>
+#include <stdio.h>
 #include <assert.h>
 #include <string.h>
 #include "gldraw2d.hpp"
 #include "llgui.hpp"
 
+/*////////////////////
+//   Preprocessor   //
+////////////////////*/
+/// @summary Use SSE2 to update particles when the target supports it.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define GLDRAW2D_USE_SSE2   1
+    #include <emmintrin.h>
+#else
+    #define GLDRAW2D_USE_SSE2   0
+#endif
+
 /*/////////////////
 //   Constants   //
 /////////////////*/
-/// @summary The desired number of uint32_t names per-bucket.
-static size_t const ATLAS_NAMES_PER_BUCKET = 16;
-
 /// @summary The default capacity of an image cache, in images.
 static size_t const ATLAS_DEFAULT_CAPACITY = 1024;
 
-/// @summary The zero-based index of the first name within a bucket.
-static size_t const ATLAS_FIRST_NAME       = 2;
-
-/// @summary Define the minimum number of name buckets allocated per-image cache.
-static size_t const ATLAS_MIN_BUCKET_COUNT = ATLAS_DEFAULT_CAPACITY / ATLAS_NAMES_PER_BUCKET;
-
 /// @summary Define the default capacity of the TexturePages texture ID storage.
 static size_t const ATLAS_PAGE_CAPACITY    = 4;
 
+/// @summary Marks the end of the free entry list of an atlas.
+static uint32_t const ATLAS_NO_ENTRY       = 0xFFFFFFFFU;
+
+/// @summary A page is defragmented only if the free space outside of its
+/// largest free rectangle is at least 1/ATLAS_DEFRAG_MIN_WASTE of the page.
+static size_t const ATLAS_DEFRAG_MIN_WASTE = 8;
+
+/// @summary The default capacity of the staged upload list of an atlas.
+static size_t const ATLAS_STAGE_CAPACITY   = 64;
+
+/// @summary The row alignment of frame pixel data in the transfer buffer, in bytes.
+static size_t const ATLAS_ROW_ALIGNMENT    = 4;
+
+/// @summary The stride used when touching the pages of a mapped DDS file, in bytes.
+static size_t const DDS_PREFAULT_STRIDE    = 4096;
+
+/// @summary The default width and height of a tile map chunk, in tiles.
+static size_t const TILEMAP_DEFAULT_CHUNK  = 32;
+
+/// @summary The default capacity of the draw record list of a tile map.
+static size_t const TILEMAP_DRAW_CAPACITY  = 64;
+
+/// @summary The number of per-particle arrays stored by a particle system.
+static size_t const PARTICLE_STREAM_COUNT  = 6;
+
+/// @summary The alignment of the per-particle arrays, in bytes.
+static size_t const PARTICLE_ALIGNMENT     = 16;
+
+/// @summary The default capacity of a text layout cache, in layouts.
+static size_t const TEXT_CACHE_CAPACITY    = 64;
+
+/// @summary The maximum number of font pages; bitmap_glyph_t::PageIndex is 8 bits.
+static size_t const TEXT_MAX_PAGES         = 256;
+
+/// @summary Identifies a free sprite grid handle, or the end of the free list.
+static uint32_t const SPRITE_GRID_NONE     = 0xFFFFFFFFU;
+
+/// @summary The default overflow count above which a sprite grid is repacked.
+static size_t const SPRITE_GRID_OVERFLOW   = 1024;
+
+/// @summary The four character code 'LLAT' identifying a baked atlas file.
+static uint32_t const ATLAS_FILE_MAGIC     = 0x54414C4CU;
+
+/// @summary The baked atlas file format version written by atlas_save().
+/// Version 2 stores the name lookup table as verbatim hash::table_t storage.
+static uint32_t const ATLAS_FILE_VERSION   = 0x00020000U;
+
+/// @summary The alignment of the page data within a baked atlas file, in bytes.
+static size_t   const ATLAS_FILE_ALIGNMENT = 16;
+
+/// @summary Define the number of free rectangle size classes used by the
+/// guillotine packer. Free rectangles are bucketed by log2(height).
+static size_t const PACKER_BUCKET_COUNT    = 32;
+
 /*///////////////
 //   Globals   //
 ///////////////*/
@@ -231,22 +289,97 @@ struct rectq_maxa_t
     }
 };
 
+/// @summary Orders the items of a bulk atlas pack request, largest first, by
+/// one of the keys in atlas_sort_e. Ties are broken by item index so that
+/// every trial is deterministic.
+struct pack_item_order
+{
+    r2d::atlas_pack_item_t const *Items;
+    uint32_t                      Key;
+
+    inline pack_item_order(r2d::atlas_pack_item_t const *items, uint32_t key)
+        :
+        Items(items),
+        Key(key)
+    { /* empty */ }
+
+    inline uint64_t primary(r2d::atlas_pack_item_t const &i) const
+    {
+        switch (Key)
+        {
+            case r2d::ATLAS_SORT_AREA:      return uint64_t(i.Width) * i.Height;
+            case r2d::ATLAS_SORT_PERIMETER: return uint64_t(i.Width) + i.Height;
+            case r2d::ATLAS_SORT_MAXSIDE:   return i.Width > i.Height ? i.Width : i.Height;
+            default:                        return i.Height;
+        }
+    }
+
+    inline bool operator()(uint32_t a, uint32_t b) const
+    {
+        r2d::atlas_pack_item_t const &ia = Items[a];
+        r2d::atlas_pack_item_t const &ib = Items[b];
+        uint64_t const pa = primary(ia);
+        uint64_t const pb = primary(ib);
+        if (pa != pb) return (pa > pb);
+        if (ia.Width  != ib.Width)  return (ia.Width  > ib.Width);
+        if (ia.Height != ib.Height) return (ia.Height > ib.Height);
+        return (a < b);
+    }
+};
+
+/// @summary Orders the sub-images of a page being defragmented, tallest first,
+/// by their padded extents. Ties are broken by index for a deterministic layout.
+struct defrag_order
+{
+    r2d::pkrect_t const *Rects;
+
+    inline defrag_order(r2d::pkrect_t const *rects)
+        :
+        Rects(rects)
+    { /* empty */ }
+
+    inline bool operator()(uint32_t a, uint32_t b) const
+    {
+        r2d::pkrect_t const &ra = Rects[a];
+        r2d::pkrect_t const &rb = Rects[b];
+        size_t const ha = ra.Height + ra.PadY * 2;
+        size_t const hb = rb.Height + rb.PadY * 2;
+        size_t const wa = ra.Width  + ra.PadX * 2;
+        size_t const wb = rb.Width  + rb.PadX * 2;
+        if (ha != hb) return (ha > hb);
+        if (wa != wb) return (wa > wb);
+        return (a < b);
+    }
+};
+
+/// @summary Orders staged atlas uploads by page, then column, then row, so
+/// that vertically adjacent frames are consecutive. Frames staged to the same
+/// position keep the order in which they were staged.
+struct upload_order
+{
+    inline bool operator()(r2d::atlas_upload_t const &a, r2d::atlas_upload_t const &b) const
+    {
+        if (a.Page != b.Page) return (a.Page < b.Page);
+        if (a.X    != b.X   ) return (a.X    < b.X   );
+        if (a.Y    != b.Y   ) return (a.Y    < b.Y   );
+        return (a.Sequence < b.Sequence);
+    }
+};
+
+/// @summary Orders the chunk runs collected while drawing a tile map by
+/// texture, so that each texture is drawn with a single multi-draw call.
+struct tilemap_draw_order
+{
+    inline bool operator()(r2d::tilemap_draw_t const &a, r2d::tilemap_draw_t const &b) const
+    {
+        if (a.Texture != b.Texture) return (a.Texture < b.Texture);
+        return (a.BaseVertex < b.BaseVertex);
+    }
+};
+
 /*///////////////////////
 //   Local Functions   //
 ///////////////////////*/
-/// @summary Mixes the bits of a 32-bit unsigned integer.
-/// @param value The input value.
-/// @return The output value.
-static inline uint32_t hash_u32(uint32_t value)
-{
-    value ^= value >> 16;
-    value *= 0x85EBCA6B;
-    value ^= value >> 13;
-    value *= 0xC2B2AE35;
-    value ^= value >> 16;
-    return value;
-}
-
 /// @summary Resets a rectangle priority queue to empty without allocating or freeing storage.
 /// @param pq The rectangle priority queue to clear.
 static inline void rectq_clear(rectq_t *pq)
@@ -415,427 +548,2258 @@ static size_t max_value(size_t n, size_t const *v)
     return x;
 }
 
-/// @summary Attempt to find a node that can contain the given area within the
-/// rectangle packer binary tree, performing any necessary spatial subdivision.
+/// @summary Ensures that the free rectangle or skyline storage of a packer can
+/// hold at least the specified number of items.
 /// @param p The rectangle packer being updated.
-/// @param n The zero-based index of the node at which the insertion is being attempted.
-/// @param w The width of the rectangle being inserted.
-/// @param h The height of the rectangle being inserted.
-/// @return The node at which the rectangle should be inserted, or NULL if the
-/// rectangle cannot fit within the remaining area of the master rectangle.
-static r2d::pknode_t* node_insert(r2d::packer_t *p, uint32_t n, size_t w, size_t h)
+/// @param count The required number of free rectangles or skyline segments.
+/// @return true if the storage has sufficient capacity.
+static bool packer_reserve_free(r2d::packer_t *p, size_t count)
 {
-    r2d::pknode_t *node  = &p->Nodes[n];
-    if (node->Child[0]  != 0 && node->Child[1] != 0)
+    if (count <= p->FreeCapacity)
+        return true;
+
+    size_t nc = p->FreeCapacity > 0 ? p->FreeCapacity * 2 : 64;
+    while (nc < count) nc *= 2;
+    if (p->Type == r2d::PACKER_TYPE_SKYLINE_BL)
     {
-        // this node is not a leaf node, so attempt the insert in the subtree.
-        r2d::pknode_t *t = node_insert(p, node->Child[0], w, h);
-        if (t != NULL)   return t;
-        else return node_insert(p, node->Child[1], w, h);
+        r2d::pkskyline_t *S = (r2d::pkskyline_t*) realloc(p->Skyline, nc * sizeof(r2d::pkskyline_t));
+        if (S == NULL)   return false;
+        p->Skyline = S;
     }
     else
     {
-        if (node->Flags & r2d::PACKER_FLAGS_USED)
-            return NULL;
+        r2d::pkfree_t *F = (r2d::pkfree_t*) realloc(p->FreeList, nc * sizeof(r2d::pkfree_t));
+        if (F == NULL)   return false;
+        p->FreeList = F;
+    }
+    p->FreeCapacity = nc;
+    return true;
+}
 
-        // if the sub-rect won't fit, don't continue down this path.
-        uint32_t rect_width  = node->Bound[2] - node->Bound[0];
-        uint32_t rect_height = node->Bound[3] - node->Bound[1];
-        if (w  > rect_width || h  > rect_height)
-            return NULL;
+/// @summary Ensures that the rectangle storage of a packer can hold one more
+/// sub-rectangle.
+/// @param p The rectangle packer being updated.
+/// @return true if the storage has room for another sub-rectangle.
+static bool packer_reserve_rect(r2d::packer_t *p)
+{
+    if (p->Count < p->Capacity)
+        return true;
+
+    size_t        nc =  p->Capacity  >  2048 ? (p->Capacity + 2048) : p->Capacity * 2;
+    r2d::pkrect_t *R = (r2d::pkrect_t*) realloc(p->Rects, nc * sizeof(r2d::pkrect_t));
+    if (R == NULL)   return false;
+    p->Rects    = R;
+    p->Capacity = nc;
+    return true;
+}
+
+/// @summary Computes the size class of a guillotine free rectangle, which is
+/// the base-2 logarithm of its height, clamped to the number of buckets.
+/// @param h The height of the free rectangle, in pixels.
+/// @return The zero-based index of the bucket for the free rectangle.
+static inline size_t guillotine_bucket(uint32_t h)
+{
+    size_t b = 0;
+    while (h > 1 && b < PACKER_BUCKET_COUNT - 1)
+    {
+        h >>= 1;
+        b++;
+    }
+    return b;
+}
+
+/// @summary Adds a free rectangle to the bucketed index of a guillotine packer.
+/// Empty rectangles are discarded.
+/// @param p The rectangle packer being updated.
+/// @param f The free rectangle to add.
+/// @return true if the free rectangle was added, or false if memory allocation failed.
+static bool guillotine_add(r2d::packer_t *p, r2d::pkfree_t const &f)
+{
+    if (f.Width == 0 || f.Height == 0)
+        return true;
+
+    r2d::pkbucket_t *b = &p->Buckets[guillotine_bucket(f.Height)];
+    if (b->Count == b->Capacity)
+    {
+        size_t        nc = b->Capacity > 0 ? b->Capacity * 2 : 16;
+        r2d::pkfree_t *R = (r2d::pkfree_t*) realloc(b->Rects, nc * sizeof(r2d::pkfree_t));
+        if (R == NULL)   return false;
+        b->Rects    = R;
+        b->Capacity = nc;
+    }
+    b->Rects[b->Count++] = f;
+    p->FreeCount++;
+    return true;
+}
 
-        // if the sub-rect fits exactly, we'll store it at 'node'.
-        if (w == rect_width && h == rect_height)
-            return node;
-
-        // otherwise, we'll split the space at this node into a used
-        // portion, stored in node->Child[0], and an unsed portion in
-        // stored in node->Child[1].
-        r2d::pknode_t  a;
-        a.Flags      = r2d::PACKER_FLAGS_NONE;
-        a.Index      = 0xFFFFFFFFU;
-        a.Child[0]   = 0;
-        a.Child[1]   = 0;
-
-        r2d::pknode_t  b;
-        b.Flags      = r2d::PACKER_FLAGS_NONE;
-        b.Index      = 0xFFFFFFFFU;
-        b.Child[0]   = 0;
-        b.Child[1]   = 0;
-
-        uint32_t dw  = rect_width  - w;
-        uint32_t dh  = rect_height - h;
-        if (dw > dh)
-        {
-            a.Bound[0] = node->Bound[0];
-            a.Bound[1] = node->Bound[1];
-            a.Bound[2] = node->Bound[0] + uint32_t(w);
-            a.Bound[3] = node->Bound[3];
-
-            b.Bound[0] = node->Bound[0] + uint32_t(w);
-            b.Bound[1] = node->Bound[1];
-            b.Bound[2] = node->Bound[2];
-            b.Bound[3] = node->Bound[3];
+/// @summary Removes a free rectangle from the bucketed index of a guillotine
+/// packer. The last item in the bucket is moved into the vacated slot.
+/// @param p The rectangle packer being updated.
+/// @param bucket The zero-based index of the bucket containing the rectangle.
+/// @param index The zero-based index of the rectangle within the bucket.
+/// @return The removed free rectangle.
+static inline r2d::pkfree_t guillotine_take(r2d::packer_t *p, size_t bucket, size_t index)
+{
+    r2d::pkbucket_t *b = &p->Buckets[bucket];
+    r2d::pkfree_t    f =  b->Rects[index];
+    b->Rects[index]    =  b->Rects[--b->Count];
+    p->FreeCount--;
+    return f;
+}
+
+/// @summary Selects the free rectangle of a guillotine packer in which to
+/// place a sub-rectangle. Only the buckets whose size class can hold the
+/// sub-rectangle are searched. Within the first bucket containing a fit, the
+/// rectangle leaving the least unused area is selected.
+/// @param p The rectangle packer being searched.
+/// @param w The padded width of the sub-rectangle.
+/// @param h The padded height of the sub-rectangle.
+/// @param out_bucket On return, stores the bucket index of the selected free rectangle.
+/// @param out_index On return, stores the index of the selected free rectangle within the bucket.
+/// @return true if a free rectangle was found for the sub-rectangle.
+static bool guillotine_find(r2d::packer_t const *p, uint32_t w, uint32_t h, size_t &out_bucket, size_t &out_index)
+{
+    for (size_t b = guillotine_bucket(h); b < PACKER_BUCKET_COUNT; ++b)
+    {
+        r2d::pkbucket_t const &bucket = p->Buckets[b];
+        uint64_t               best   = 0xFFFFFFFFFFFFFFFFULL;
+        bool                   found  = false;
+        for (size_t i = 0, n = bucket.Count; i < n; ++i)
+        {
+            r2d::pkfree_t const &f = bucket.Rects[i];
+            if (w > f.Width || h > f.Height)
+                continue;
+
+            uint64_t const area = uint64_t(f.Width) * f.Height - uint64_t(w) * h;
+            if (area < best)
+            {
+                best       = area;
+                out_bucket = b;
+                out_index  = i;
+                found      = true;
+                if (area == 0) break;
+            }
         }
-        else
+        if (found) return true;
+    }
+    return false;
+}
+
+/// @summary Places a sub-rectangle in the upper-left corner of a free rectangle
+/// of a guillotine packer, splitting the remainder along the shorter leftover
+/// axis into a right and a bottom free rectangle.
+/// @param p The rectangle packer being updated.
+/// @param bucket The bucket index of the free rectangle, from guillotine_find().
+/// @param index The index of the free rectangle within the bucket.
+/// @param w The padded width of the sub-rectangle.
+/// @param h The padded height of the sub-rectangle.
+/// @param out_x On return, stores the x-coordinate of the placed sub-rectangle.
+/// @param out_y On return, stores the y-coordinate of the placed sub-rectangle.
+/// @return true if the free rectangle index was updated, or false if memory allocation failed.
+static bool guillotine_place(r2d::packer_t *p, size_t bucket, size_t index, uint32_t w, uint32_t h, uint32_t &out_x, uint32_t &out_y)
+{
+    r2d::pkfree_t const f  = guillotine_take(p, bucket, index);
+    uint32_t      const lw = f.Width  - w;
+    uint32_t      const lh = f.Height - h;
+    if (lw < lh)
+    {   // split horizontally; the bottom rectangle spans the full width.
+        r2d::pkfree_t  r = { f.X + w, f.Y, lw, h };
+        r2d::pkfree_t  b = { f.X, f.Y + h, f.Width, lh };
+        if (!guillotine_add(p, r)) return false;
+        if (!guillotine_add(p, b)) return false;
+    }
+    else
+    {   // split vertically; the right rectangle spans the full height.
+        r2d::pkfree_t  r = { f.X + w, f.Y, lw, f.Height };
+        r2d::pkfree_t  b = { f.X, f.Y + h, w, lh };
+        if (!guillotine_add(p, r)) return false;
+        if (!guillotine_add(p, b)) return false;
+    }
+    out_x = f.X;
+    out_y = f.Y;
+    return true;
+}
+
+/// @summary Returns an area to the free rectangle index of a guillotine
+/// packer, first merging it with any free rectangle that shares a full edge.
+/// Merging repeats until no neighbor shares a full edge with the result.
+/// @param p The rectangle packer being updated.
+/// @param f The area being released.
+/// @return true if the area was added, or false if memory allocation failed.
+static bool guillotine_release(r2d::packer_t *p, r2d::pkfree_t f)
+{
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (size_t b = 0; b < PACKER_BUCKET_COUNT && !merged; ++b)
+        {
+            r2d::pkbucket_t const &bucket = p->Buckets[b];
+            for (size_t i = 0; i < bucket.Count; ++i)
+            {
+                r2d::pkfree_t const &g = bucket.Rects[i];
+                if (g.Y == f.Y && g.Height == f.Height && (g.X + g.Width == f.X || f.X + f.Width == g.X))
+                {   // g is immediately to the left or right of f.
+                    f.X      = g.X < f.X ? g.X : f.X;
+                    f.Width += g.Width;
+                    guillotine_take(p, b, i);
+                    merged   = true;
+                    break;
+                }
+                if (g.X == f.X && g.Width == f.Width && (g.Y + g.Height == f.Y || f.Y + f.Height == g.Y))
+                {   // g is immediately above or below f.
+                    f.Y       = g.Y < f.Y ? g.Y : f.Y;
+                    f.Height += g.Height;
+                    guillotine_take(p, b, i);
+                    merged    = true;
+                    break;
+                }
+            }
+        }
+    }
+    return guillotine_add(p, f);
+}
+
+/// @summary Resets the free rectangle index, list or skyline of a packer so
+/// that it describes an empty master rectangle.
+/// @param p The rectangle packer being reset.
+static void packer_reset_free(r2d::packer_t *p)
+{
+    p->FreeCount = 0;
+    if (p->Type == r2d::PACKER_TYPE_GUILLOTINE && p->Buckets != NULL)
+    {
+        r2d::pkfree_t     f = { 0, 0, uint32_t(p->Width), uint32_t(p->Height) };
+        for (size_t i = 0; i < PACKER_BUCKET_COUNT; ++i)
         {
-            a.Bound[0] = node->Bound[0];
-            a.Bound[1] = node->Bound[1];
-            a.Bound[2] = node->Bound[2];
-            a.Bound[3] = node->Bound[1] + uint32_t(h);
+            p->Buckets[i].Count = 0;
+        }
+        guillotine_add(p, f);
+    }
+    if (p->Type == r2d::PACKER_TYPE_SKYLINE_BL && p->FreeCapacity > 0)
+    {
+        r2d::pkskyline_t  s = { 0, 0, uint32_t(p->Width) };
+        p->Skyline[0]  = s;
+        p->FreeCount   = 1;
+    }
+    if ((p->Type == r2d::PACKER_TYPE_MAXRECTS_BSSF || p->Type == r2d::PACKER_TYPE_MAXRECTS_BAF) && p->FreeCapacity > 0)
+    {
+        r2d::pkfree_t     f = { 0, 0, uint32_t(p->Width), uint32_t(p->Height) };
+        p->FreeList[0] = f;
+        p->FreeCount   = 1;
+    }
+}
 
-            b.Bound[0] = node->Bound[0];
-            b.Bound[1] = node->Bound[1] + uint32_t(h);
-            b.Bound[2] = node->Bound[2];
-            b.Bound[3] = node->Bound[3];
+/// @summary Selects the free rectangle of a MaxRects packer in which to place
+/// a sub-rectangle, using either the best short side fit or best area fit rule.
+/// @param p The rectangle packer being searched.
+/// @param w The padded width of the sub-rectangle.
+/// @param h The padded height of the sub-rectangle.
+/// @param out_x On return, stores the x-coordinate of the selected position.
+/// @param out_y On return, stores the y-coordinate of the selected position.
+/// @return true if a position was found for the sub-rectangle.
+static bool maxrects_find(r2d::packer_t const *p, uint32_t w, uint32_t h, uint32_t &out_x, uint32_t &out_y)
+{
+    bool     const baf   = p->Type == r2d::PACKER_TYPE_MAXRECTS_BAF;
+    uint64_t       best1 = 0xFFFFFFFFFFFFFFFFULL;
+    uint64_t       best2 = 0xFFFFFFFFFFFFFFFFULL;
+    bool           found = false;
+    for (size_t i = 0, n = p->FreeCount; i < n; ++i)
+    {
+        r2d::pkfree_t const &f = p->FreeList[i];
+        if (w > f.Width || h > f.Height)
+            continue;
+
+        uint64_t const dw      = f.Width  - w;
+        uint64_t const dh      = f.Height - h;
+        uint64_t const short_s = dw < dh ? dw : dh;
+        uint64_t const long_s  = dw < dh ? dh : dw;
+        uint64_t const area    = uint64_t(f.Width) * f.Height - uint64_t(w) * h;
+        uint64_t const score1  = baf ? area    : short_s;
+        uint64_t const score2  = baf ? short_s : long_s;
+        if (score1 < best1 || (score1 == best1 && score2 < best2))
+        {
+            best1 = score1;
+            best2 = score2;
+            out_x = f.X;
+            out_y = f.Y;
+            found = true;
         }
+    }
+    return found;
+}
+
+/// @summary Determines whether free rectangle a is entirely contained within
+/// free rectangle b.
+static inline bool maxrects_contained(r2d::pkfree_t const &a, r2d::pkfree_t const &b)
+{
+    return a.X >= b.X && a.Y >= b.Y &&
+           a.X + a.Width  <= b.X + b.Width &&
+           a.Y + a.Height <= b.Y + b.Height;
+}
 
-        if (p->Count == p->Capacity)
+/// @summary Removes free rectangles of a MaxRects packer that are contained
+/// within another free rectangle.
+/// @param p The rectangle packer being updated.
+static void maxrects_prune(r2d::packer_t *p)
+{
+    r2d::pkfree_t *F = p->FreeList;
+    size_t         c = p->FreeCount;
+    for (size_t i = 0; i < c; ++i)
+    {
+        for (size_t j = i + 1; j < c; ++j)
         {
-            size_t        nc =  p->Capacity  >  2048 ? (p->Capacity + 2048) : p->Capacity    * 2;
-            r2d::pknode_t *N = (r2d::pknode_t*) realloc(p->Nodes, nc * sizeof(r2d::pknode_t) * 3);
-            r2d::pkrect_t *R = (r2d::pkrect_t*) realloc(p->Rects, nc * sizeof(r2d::pkrect_t));
-            if (N != NULL)   p->Nodes = N;
-            if (R != NULL)   p->Rects = R;
-            if (N != NULL && R != NULL) p->Capacity = nc;
-            else return NULL;
+            if (maxrects_contained(F[i], F[j]))
+            {   // F[i] is redundant; replace it with the last item and re-test.
+                F[i--] = F[--c];
+                break;
+            }
+            if (maxrects_contained(F[j], F[i]))
+            {   // F[j] is redundant; replace it with the last item and re-test.
+                F[j--] = F[--c];
+            }
         }
+    }
+    p->FreeCount = c;
+}
 
-        size_t index_a =(p->Count * 3) + 1;
-        size_t index_b =(p->Count * 3) + 2;
-        node->Child[0] = index_a;
-        node->Child[1] = index_b;
-        p->Nodes[index_a] = a;
-        p->Nodes[index_b] = b;
-        return node_insert(p, node->Child[0], w, h);
+/// @summary Updates the free rectangle list of a MaxRects packer after a
+/// sub-rectangle has been placed. Every free rectangle overlapping the placed
+/// rectangle is split into up to four maximal free rectangles, and any free
+/// rectangle contained within another is then discarded.
+/// @param p The rectangle packer being updated.
+/// @param u The rectangle that was placed.
+/// @return true if the free list was updated, or false if memory allocation failed.
+static bool maxrects_place(r2d::packer_t *p, r2d::pkfree_t const &u)
+{
+    size_t const n   = p->FreeCount;
+    size_t       out = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        r2d::pkfree_t f = p->FreeList[i];
+        if (u.X >= f.X + f.Width  || u.X + u.Width  <= f.X ||
+            u.Y >= f.Y + f.Height || u.Y + u.Height <= f.Y)
+        {   // no overlap; keep the free rectangle as-is. out <= i, so
+            // this never overwrites an item that has not been visited.
+            p->FreeList[out++] = f;
+            continue;
+        }
+        // new rectangles are appended past the end of the visited range.
+        if (!packer_reserve_free(p, p->FreeCount + 4))
+            return false;
+        if (u.X > f.X)
+        {   // the portion to the left of the placed rectangle.
+            r2d::pkfree_t  r = { f.X, f.Y, u.X - f.X, f.Height };
+            p->FreeList[p->FreeCount++] = r;
+        }
+        if (u.X + u.Width < f.X + f.Width)
+        {   // the portion to the right of the placed rectangle.
+            r2d::pkfree_t  r = { u.X + u.Width, f.Y, (f.X + f.Width) - (u.X + u.Width), f.Height };
+            p->FreeList[p->FreeCount++] = r;
+        }
+        if (u.Y > f.Y)
+        {   // the portion above the placed rectangle.
+            r2d::pkfree_t  r = { f.X, f.Y, f.Width, u.Y - f.Y };
+            p->FreeList[p->FreeCount++] = r;
+        }
+        if (u.Y + u.Height < f.Y + f.Height)
+        {   // the portion below the placed rectangle.
+            r2d::pkfree_t  r = { f.X, u.Y + u.Height, f.Width, (f.Y + f.Height) - (u.Y + u.Height) };
+            p->FreeList[p->FreeCount++] = r;
+        }
     }
+    // move the newly split rectangles down to follow the retained rectangles.
+    size_t const nsplit = p->FreeCount - n;
+    memmove(&p->FreeList[out], &p->FreeList[n], nsplit * sizeof(r2d::pkfree_t));
+    p->FreeCount = out + nsplit;
+    maxrects_prune(p);
+    return true;
 }
 
-/*///////////////////////
-//  Public Functions   //
-///////////////////////*/
-bool r2d::dxgi_format_to_gl(uint32_t dxgi, GLenum &out_internalformat, GLenum &out_format, GLenum &out_datatype)
+/// @summary Determines whether a sub-rectangle can be placed with its left
+/// edge at the start of the specified skyline segment.
+/// @param p The skyline packer being searched.
+/// @param index The zero-based index of the skyline segment.
+/// @param w The padded width of the sub-rectangle.
+/// @param h The padded height of the sub-rectangle.
+/// @param out_y On return, stores the y-coordinate at which the sub-rectangle rests.
+/// @return true if the sub-rectangle fits at the specified segment.
+static bool skyline_fit(r2d::packer_t const *p, size_t index, uint32_t w, uint32_t h, uint32_t &out_y)
 {
-    switch (dxgi)
+    r2d::pkskyline_t const *S = p->Skyline;
+    uint32_t          const x = S[index].X;
+    if (x + w > p->Width)
+        return false;
+
+    uint32_t  y    = S[index].Y;
+    uint32_t  left = w;
+    size_t    i    = index;
+    while (left > 0)
+    {   // the sub-rectangle rests on the highest segment it spans.
+        if (S[i].Y > y) y = S[i].Y;
+        if (y + h > p->Height)
+            return false;
+        left = S[i].Width < left ? left - S[i].Width : 0;
+        i++;
+    }
+    out_y = y;
+    return true;
+}
+
+/// @summary Selects the skyline segment at which to place a sub-rectangle
+/// using the bottom-left rule: minimize the resulting top edge, then the width
+/// of the segment the sub-rectangle starts on.
+/// @param p The skyline packer being searched.
+/// @param w The padded width of the sub-rectangle.
+/// @param h The padded height of the sub-rectangle.
+/// @param out_index On return, stores the index of the selected segment.
+/// @param out_y On return, stores the y-coordinate of the selected position.
+/// @return true if a position was found for the sub-rectangle.
+static bool skyline_find(r2d::packer_t const *p, uint32_t w, uint32_t h, size_t &out_index, uint32_t &out_y)
+{
+    uint32_t  best_top   = 0xFFFFFFFFU;
+    uint32_t  best_width = 0xFFFFFFFFU;
+    bool      found      = false;
+    for (size_t i = 0, n = p->FreeCount; i < n; ++i)
     {
-        case data::DXGI_FORMAT_UNKNOWN:
-        case data::DXGI_FORMAT_R32G32B32A32_TYPELESS:
-        case data::DXGI_FORMAT_R32G32B32_TYPELESS:
-        case data::DXGI_FORMAT_R16G16B16A16_TYPELESS:
-        case data::DXGI_FORMAT_R32G32_TYPELESS:
-        case data::DXGI_FORMAT_R32G8X24_TYPELESS:
-        case data::DXGI_FORMAT_R10G10B10A2_TYPELESS:
-        case data::DXGI_FORMAT_R8G8B8A8_TYPELESS:
-        case data::DXGI_FORMAT_R16G16_TYPELESS:
-        case data::DXGI_FORMAT_R32_TYPELESS:
-        case data::DXGI_FORMAT_R24G8_TYPELESS:
-        case data::DXGI_FORMAT_R8G8_TYPELESS:
-        case data::DXGI_FORMAT_R16_TYPELESS:
-        case data::DXGI_FORMAT_R8_TYPELESS:
-        case data::DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
-        case data::DXGI_FORMAT_X24_TYPELESS_G8_UINT:
-        case data::DXGI_FORMAT_R1_UNORM:
-        case data::DXGI_FORMAT_R8G8_B8G8_UNORM:
-        case data::DXGI_FORMAT_G8R8_G8B8_UNORM:
-        case data::DXGI_FORMAT_BC1_TYPELESS:
-        case data::DXGI_FORMAT_BC2_TYPELESS:
-        case data::DXGI_FORMAT_BC2_UNORM:
-        case data::DXGI_FORMAT_BC2_UNORM_SRGB:
-        case data::DXGI_FORMAT_BC3_TYPELESS:
-        case data::DXGI_FORMAT_BC4_TYPELESS:
-        case data::DXGI_FORMAT_BC4_UNORM:
-        case data::DXGI_FORMAT_BC4_SNORM:
-        case data::DXGI_FORMAT_BC5_TYPELESS:
-        case data::DXGI_FORMAT_BC5_SNORM:
-        case data::DXGI_FORMAT_B8G8R8A8_TYPELESS:
-        case data::DXGI_FORMAT_B8G8R8X8_TYPELESS:
-        case data::DXGI_FORMAT_BC6H_TYPELESS:
-        case data::DXGI_FORMAT_BC7_TYPELESS:
-        case data::DXGI_FORMAT_AYUV:
-        case data::DXGI_FORMAT_Y410:
-        case data::DXGI_FORMAT_Y416:
-        case data::DXGI_FORMAT_NV12:
-        case data::DXGI_FORMAT_P010:
-        case data::DXGI_FORMAT_P016:
-        case data::DXGI_FORMAT_420_OPAQUE:
-        case data::DXGI_FORMAT_YUY2:
-        case data::DXGI_FORMAT_Y210:
-        case data::DXGI_FORMAT_Y216:
-        case data::DXGI_FORMAT_NV11:
-        case data::DXGI_FORMAT_AI44:
-        case data::DXGI_FORMAT_IA44:
+        uint32_t y = 0;
+        if (skyline_fit(p, i, w, h, y))
+        {
+            uint32_t const top = y + h;
+            if (top < best_top || (top == best_top && p->Skyline[i].Width < best_width))
+            {
+                best_top   = top;
+                best_width = p->Skyline[i].Width;
+                out_index  = i;
+                out_y      = y;
+                found      = true;
+            }
+        }
+    }
+    return found;
+}
+
+/// @summary Updates the skyline after a sub-rectangle has been placed at the
+/// start of a skyline segment. Segments covered by the sub-rectangle are
+/// trimmed or removed, and adjacent segments at equal height are merged.
+/// @param p The skyline packer being updated.
+/// @param index The zero-based index of the segment the sub-rectangle starts on.
+/// @param u The rectangle that was placed.
+/// @return true if the skyline was updated, or false if memory allocation failed.
+static bool skyline_place(r2d::packer_t *p, size_t index, r2d::pkfree_t const &u)
+{
+    if (!packer_reserve_free(p, p->FreeCount + 1))
+        return false;
+
+    r2d::pkskyline_t *S = p->Skyline;
+    r2d::pkskyline_t  s = { u.X, u.Y + u.Height, u.Width };
+    memmove(&S[index + 1], &S[index], (p->FreeCount - index) * sizeof(r2d::pkskyline_t));
+    S[index] = s;
+    p->FreeCount++;
+
+    // trim or remove the segments now covered by the new segment.
+    for (size_t i = index + 1; i < p->FreeCount; )
+    {
+        uint32_t const prev_end = S[i-1].X + S[i-1].Width;
+        if (S[i].X >= prev_end)
             break;
-        case data::DXGI_FORMAT_R32G32B32A32_FLOAT:
-            out_internalformat = GL_RGBA32F;
-            out_format         = GL_BGRA;
-            out_datatype       = GL_FLOAT;
-            return true;
-        case data::DXGI_FORMAT_R32G32B32A32_UINT:
-            out_internalformat = GL_RGBA32UI;
-            out_format         = GL_BGRA_INTEGER;
-            out_datatype       = GL_UNSIGNED_INT;
-            return true;
-        case data::DXGI_FORMAT_R32G32B32A32_SINT:
-            out_internalformat = GL_RGBA32I;
-            out_format         = GL_BGRA_INTEGER;
-            out_datatype       = GL_INT;
-            return true;
-        case data::DXGI_FORMAT_R32G32B32_FLOAT:
-            out_internalformat = GL_RGB32F;
-            out_format         = GL_BGR;
-            out_datatype       = GL_FLOAT;
-            return true;
-        case data::DXGI_FORMAT_R32G32B32_UINT:
-            out_internalformat = GL_RGB32UI;
-            out_format         = GL_BGR_INTEGER;
-            out_datatype       = GL_UNSIGNED_INT;
-            return true;
-        case data::DXGI_FORMAT_R32G32B32_SINT:
-            out_internalformat = GL_RGB32I;
-            out_format         = GL_BGR_INTEGER;
-            out_datatype       = GL_INT;
-            return true;
-        case data::DXGI_FORMAT_R16G16B16A16_FLOAT:
-            out_internalformat = GL_RGBA16F;
-            out_format         = GL_BGRA;
-            out_datatype       = GL_HALF_FLOAT;
-            return true;
-        case data::DXGI_FORMAT_R16G16B16A16_UNORM:
-            out_internalformat = GL_RGBA16;
-            out_format         = GL_BGRA_INTEGER;
-            out_datatype       = GL_UNSIGNED_SHORT;
-            return true;
-        case data::DXGI_FORMAT_R16G16B16A16_UINT:
-            out_internalformat = GL_RGBA16UI;
-            out_format         = GL_BGRA_INTEGER;
-            out_datatype       = GL_UNSIGNED_SHORT;
-            return true;
-        case data::DXGI_FORMAT_R16G16B16A16_SNORM:
-            out_internalformat = GL_RGBA16_SNORM;
-            out_format         = GL_BGRA_INTEGER;
-            out_datatype       = GL_SHORT;
-            return true;
-        case data::DXGI_FORMAT_R16G16B16A16_SINT:
-            out_internalformat = GL_RGBA16I;
-            out_format         = GL_BGRA_INTEGER;
-            out_datatype       = GL_SHORT;
-            return true;
-        case data::DXGI_FORMAT_R32G32_FLOAT:
-            out_internalformat = GL_RG32F;
-            out_format         = GL_RG;
-            out_datatype       = GL_FLOAT;
-            return true;
-        case data::DXGI_FORMAT_R32G32_UINT:
-            out_internalformat = GL_RG32UI;
-            out_format         = GL_RG;
-            out_datatype       = GL_UNSIGNED_INT;
-            return true;
-        case data::DXGI_FORMAT_R32G32_SINT:
-            out_internalformat = GL_RG32I;
-            out_format         = GL_RG;
-            out_datatype       = GL_INT;
-            return true;
-        case data::DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
-            out_internalformat = GL_DEPTH_STENCIL;
-            out_format         = GL_DEPTH_STENCIL;
-            out_datatype       = GL_FLOAT; // ???
-            return true;
-        case data::DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
-            out_internalformat = GL_RG32F;
-            out_format         = GL_RG;
-            out_datatype       = GL_FLOAT;
-            return true;
-        case data::DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
-            return true;
-        case data::DXGI_FORMAT_R10G10B10A2_UNORM:
-            out_internalformat = GL_RGB10_A2;
-            out_format         = GL_BGRA;
-            out_datatype       = GL_UNSIGNED_INT_2_10_10_10_REV;
-            return true;
-        case data::DXGI_FORMAT_R10G10B10A2_UINT:
-            out_internalformat = GL_RGB10_A2UI;
-            out_format         = GL_BGRA;
-            out_datatype       = GL_UNSIGNED_INT_2_10_10_10_REV;
-            return true;
-        case data::DXGI_FORMAT_R11G11B10_FLOAT:
-            out_internalformat = GL_R11F_G11F_B10F;
-            out_format         = GL_BGR;
-            out_datatype       = GL_FLOAT; // ???
-            return true;
-        case data::DXGI_FORMAT_R8G8B8A8_UNORM:
-            out_internalformat = GL_RGBA8;
-            out_format         = GL_BGRA;
-            out_datatype       = GL_UNSIGNED_INT_8_8_8_8_REV;
-            return true;
-        case data::DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
-            out_internalformat = GL_SRGB8_ALPHA8;
-            out_format         = GL_BGRA;
-            out_datatype       = GL_UNSIGNED_INT_8_8_8_8_REV;
-            return true;
-        case data::DXGI_FORMAT_R8G8B8A8_UINT:
-            out_internalformat = GL_RGBA8UI;
-            out_format         = GL_BGRA;
-            out_datatype       = GL_UNSIGNED_INT_8_8_8_8_REV;
-            return true;
-        case data::DXGI_FORMAT_R8G8B8A8_SNORM:
-            out_internalformat = GL_RGBA8_SNORM;
-            out_format         = GL_BGRA;
-            out_datatype       = GL_UNSIGNED_INT_8_8_8_8_REV;
-            return true;
-        case data::DXGI_FORMAT_R8G8B8A8_SINT:
-            out_internalformat = GL_RGBA8I;
-            out_format         = GL_BGRA;
-            out_datatype       = GL_BYTE;
-            return true;
-        case data::DXGI_FORMAT_R16G16_FLOAT:
-            out_internalformat = GL_RG16F;
-            out_format         = GL_RG;
-            out_datatype       = GL_HALF_FLOAT;
-            return true;
-        case data::DXGI_FORMAT_R16G16_UNORM:
-            out_internalformat = GL_RG16;
-            out_format         = GL_RG;
-            out_datatype       = GL_UNSIGNED_SHORT;
-            return true;
-        case data::DXGI_FORMAT_R16G16_UINT:
-            out_internalformat = GL_RG16UI;
-            out_format         = GL_RG;
-            out_datatype       = GL_UNSIGNED_SHORT;
-            return true;
-        case data::DXGI_FORMAT_R16G16_SNORM:
-            out_internalformat = GL_RG16_SNORM;
-            out_format         = GL_RG;
-            out_datatype       = GL_SHORT;
-            return true;
-        case data::DXGI_FORMAT_R16G16_SINT:
-            out_internalformat = GL_RG16I;
-            out_format         = GL_RG;
-            out_datatype       = GL_SHORT;
-            return true;
-        case data::DXGI_FORMAT_D32_FLOAT:
-            out_internalformat = GL_DEPTH_COMPONENT;
-            out_format         = GL_DEPTH_COMPONENT;
-            out_datatype       = GL_FLOAT;
-            return true;
-        case data::DXGI_FORMAT_R32_FLOAT:
-            out_internalformat = GL_R32F;
-            out_format         = GL_RED;
-            out_datatype       = GL_FLOAT;
-            return true;
-        case data::DXGI_FORMAT_R32_UINT:
-            out_internalformat = GL_R32UI;
-            out_format         = GL_RED;
-            out_datatype       = GL_UNSIGNED_INT;
-            return true;
-        case data::DXGI_FORMAT_R32_SINT:
-            out_internalformat = GL_R32I;
-            out_format         = GL_RED;
-            out_datatype       = GL_INT;
+        uint32_t const shrink = prev_end - S[i].X;
+        if (S[i].Width > shrink)
+        {
+            S[i].X     += shrink;
+            S[i].Width -= shrink;
+            break;
+        }
+        memmove(&S[i], &S[i + 1], (p->FreeCount - i - 1) * sizeof(r2d::pkskyline_t));
+        p->FreeCount--;
+    }
+
+    // merge adjacent segments at the same height.
+    for (size_t i = 0; i + 1 < p->FreeCount; )
+    {
+        if (S[i].Y == S[i + 1].Y)
+        {
+            S[i].Width += S[i + 1].Width;
+            memmove(&S[i + 1], &S[i + 2], (p->FreeCount - i - 2) * sizeof(r2d::pkskyline_t));
+            p->FreeCount--;
+        }
+        else ++i;
+    }
+    return true;
+}
+
+/// @summary Abandons any in-progress page defragmentation, freeing the
+/// repacked layout and the scratch texture. The page is left unmodified.
+/// @param atlas The atlas being updated.
+static void atlas_defrag_abort(r2d::atlas_t *atlas)
+{
+    r2d::atlas_defrag_t *d = &atlas->Defrag;
+    if (d->Active)
+    {
+        if (d->Scratch != 0 && atlas->PageTarget != GL_TEXTURE_2D_ARRAY)
+        {   // the scratch texture is owned by the defragmentation.
+            gl::state_delete_textures(1, &d->Scratch);
+        }
+        r2d::delete_packer(&d->Packer);
+        free(d->Order);
+    }
+    d->Active       = false;
+    d->Page         = 0;
+    d->Next         = 0;
+    d->Count        = 0;
+    d->Order        = NULL;
+    d->EntryIndex   = NULL;
+    d->FrameIndex   = NULL;
+    d->Scratch      = 0;
+    d->ScratchLayer = 0;
+    memset(&d->Packer, 0, sizeof(r2d::packer_t));
+}
+
+/// @summary Resets the staged upload state of an atlas to empty, optionally
+/// freeing the upload list. The transfer buffer must not be mapped.
+/// @param atlas The atlas being updated.
+/// @param free_list Specify true to free the upload list storage.
+static void atlas_staging_reset(r2d::atlas_t *atlas, bool free_list)
+{
+    r2d::atlas_staging_t *s = &atlas->Staging;
+    if (free_list)
+    {
+        if (s->List != NULL) free(s->List);
+        s->Capacity = 0;
+        s->List     = NULL;
+        memset(&s->Stats, 0, sizeof(r2d::atlas_transfer_stats_t));
+    }
+    s->Count  = 0;
+    s->Mapped = NULL;
+    s->Base   = 0;
+    s->Size   = 0;
+    s->Used   = 0;
+}
+
+/// @summary Executes any uploads from the transfer buffer that are still
+/// queued with an upload scheduler. This must be done before the transfer
+/// buffer is mapped again, or before the page textures are modified.
+/// @param atlas The atlas being updated.
+static void atlas_staging_sync(r2d::atlas_t *atlas)
+{
+    if (atlas->Staging.Scheduler != NULL)
+    {
+        gl::upload_scheduler_flush(atlas->Staging.Scheduler, uintptr_t(atlas));
+        atlas->Staging.Scheduler = NULL;
+    }
+}
+
+/// @summary Maps the unused remainder of the transfer buffer for staging. If
+/// fewer than @a min_size bytes remain, the buffer is orphaned and mapped in full.
+/// @param atlas The atlas being updated. The transfer buffer must not be mapped.
+/// @param min_size The number of bytes that must be available in the mapping.
+/// @return true if the transfer buffer was mapped.
+static bool atlas_staging_map(r2d::atlas_t *atlas, size_t min_size)
+{
+    r2d::atlas_staging_t *s      = &atlas->Staging;
+    size_t                offset =  atlas->BufferOffset;
+    GLbitfield            flags  =  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+
+    // queued uploads can't source the buffer while it is mapped.
+    atlas_staging_sync(atlas);
+    if (offset + min_size > atlas->TransferBytes)
+    {   // additionally discard (orphan) the buffer.
+        flags |= GL_MAP_INVALIDATE_BUFFER_BIT;
+        offset = 0;
+    }
+    gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, atlas->TransferBuffer);
+    GLvoid *buffer_ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, GLintptr(offset), GLsizeiptr(atlas->TransferBytes - offset), flags);
+    gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (buffer_ptr == NULL)
+        return false;
+
+    s->Mapped = (uint8_t*) buffer_ptr;
+    s->Base   = offset;
+    s->Size   = atlas->TransferBytes - offset;
+    s->Used   = 0;
+    s->Stats.MapCount++;
+    return true;
+}
+
+/// @summary Unmaps the transfer buffer and uploads all staged frames. Frames
+/// are uploaded grouped by page, and vertically adjacent frames of the same
+/// width whose data is contiguous in the transfer buffer are uploaded together.
+/// @param atlas The atlas being updated.
+/// @param sched The upload scheduler used to execute the uploads, or NULL to upload immediately.
+/// @param priority The priority of uploads queued with @a sched.
+/// @return true if the staged data was uploaded or queued.
+static bool atlas_staging_flush(r2d::atlas_t *atlas, gl::upload_scheduler_t *sched, uint32_t priority)
+{
+    r2d::atlas_staging_t *s          = &atlas->Staging;
+    GLenum         const  target     =  atlas->PageTarget;
+    bool           const  compressed =  gl::bytes_per_block(atlas->PageFormat) > 0;
+    size_t         const  block      =  gl::block_dimension(atlas->PageFormat);
+    bool                  result     =  true;
+
+    if (s->Mapped == NULL)
+        return true;
+
+    gl::gpu_scope_begin("atlas_flush_transfers");
+    gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, atlas->TransferBuffer);
+    if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE)
+    {   // the buffer contents were lost (ex. display mode change).
+        result = false;
+    }
+    if (result && s->Count > 0)
+    {
+        GLuint   bound = 0;
+        uint32_t page  = ATLAS_NO_ENTRY;
+        size_t   i     = 0;
+        std::sort(s->List, s->List + s->Count, upload_order());
+        while (i < s->Count)
+        {
+            r2d::atlas_upload_t const &u = s->List[i++];
+            if (u.Entry == ATLAS_NO_ENTRY)
+                continue;
+
+            // extend the upload with the frames directly below this one.
+            size_t height = u.Height;
+            size_t bytes  = u.Size;
+            size_t frames = 1;
+            while (i < s->Count)
+            {
+                r2d::atlas_upload_t const &v = s->List[i];
+                if (v.Entry  == ATLAS_NO_ENTRY   || v.Page   != u.Page  ||
+                    v.X      != u.X              || v.Width  != u.Width ||
+                    v.Y      != u.Y + height     || v.Offset != u.Offset + bytes ||
+                    (height  %  block) != 0)
+                    break;
+                height += v.Height;
+                bytes  += v.Size;
+                frames++;
+                i++;
+            }
+
+            GLuint const tex = atlas->TexturePages[u.Page];
+            if (u.Page != page)
+            {
+                s->Stats.PageCount++;
+                page = u.Page;
+            }
+
+            gl::pixel_transfer_h2d_t x;
+            x.Target          = target;
+            x.UnpackBuffer    = atlas->TransferBuffer;
+            x.Format          = compressed ? atlas->PageFormat : atlas->PageLayout;
+            x.DataType        = atlas->PageDataType;
+            x.TargetIndex     = 0;
+            x.TargetX         = u.X;
+            x.TargetY         = u.Y;
+            x.TargetZ         = target == GL_TEXTURE_2D_ARRAY ? u.Page : 0;
+            x.SourceX         = 0;
+            x.SourceY         = 0;
+            x.SourceZ         = 0;
+            x.SourceWidth     = u.Width;
+            x.SourceHeight    = height;
+            x.TransferWidth   = u.Width;
+            x.TransferHeight  = height;
+            x.TransferSlices  = 1;
+            x.TransferSize    = bytes;
+            x.TransferBuffer  = (void*) u.Offset;
+            if (sched != NULL && gl::upload_scheduler_submit(sched, tex, &x, priority, uintptr_t(atlas)))
+            {   // the scheduler binds the page when the upload executes.
+                s->Scheduler = sched;
+            }
+            else
+            {
+                if (tex != bound)
+                {
+                    gl::state_bind_texture(0, target, tex);
+                    bound = tex;
+                }
+                gl::transfer_pixels_h2d(&x);
+            }
+            s->Stats.FrameCount  += frames;
+            s->Stats.UploadCalls += 1;
+            s->Stats.Bytes       += bytes;
+        }
+        gl::state_bind_texture(0, target, 0);
+    }
+    gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    gl::gpu_scope_end();
+
+    // the next mapping starts after the data used by this flush.
+    atlas->BufferOffset = s->Base + s->Used;
+    s->Stats.FlushCount++;
+    atlas_staging_reset(atlas, false);
+    return result;
+}
+
+/// @summary Grows the texture array backing a texture array atlas so that it
+/// has at least the specified number of layers. A new texture array is allocated
+/// and the contents of the existing layers are copied to it on the GPU, using
+/// glCopyImageSubData where available, or a read framebuffer otherwise.
+/// @param atlas The texture array atlas to grow.
+/// @param min_layers The minimum number of layers required.
+/// @return true if the texture array has at least @a min_layers layers.
+static bool atlas_grow_array(r2d::atlas_t *atlas, size_t min_layers)
+{
+    if (atlas->ArrayLayers >= min_layers)
+        return true;
+
+    // queued uploads reference the old texture array.
+    atlas_staging_sync(atlas);
+    size_t const old_layers = atlas->ArrayLayers;
+    size_t       new_layers = old_layers * 2;
+    GLuint const old_tex    = atlas->TextureArray;
+    GLuint       new_tex    = 0;
+    if (new_layers < ATLAS_PAGE_CAPACITY) new_layers = ATLAS_PAGE_CAPACITY;
+    if (new_layers < min_layers)          new_layers = min_layers;
+
+    glGenTextures(1, &new_tex);
+    if (new_tex == 0) return false;
+    gl::state_bind_texture(0, GL_TEXTURE_2D_ARRAY, new_tex);
+    gl::texture_storage(GL_TEXTURE_2D_ARRAY, atlas->PageFormat, atlas->PageDataType, GL_LINEAR, GL_LINEAR, atlas->PageWidth, atlas->PageHeight, new_layers, 1);
+
+    if (old_tex != 0 && atlas->PageCount > 0)
+    {   // copy the used layers from the old array into the new array.
+        GLsizei const w  = GLsizei(atlas->PageWidth);
+        GLsizei const h  = GLsizei(atlas->PageHeight);
+        GLsizei const nl = GLsizei(atlas->PageCount);
+        if (gl::extension_supported("GL_ARB_copy_image"))
+        {
+            glCopyImageSubData(old_tex, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, new_tex, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, w, h, nl);
+        }
+        else
+        {   // attach each source layer to a read framebuffer and copy to the new layer.
+            // the state cache doesn't track framebuffers; restore the caller's binding.
+            GLint  prev = 0;
+            GLuint fbo  = 0;
+            glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prev);
+            glGenFramebuffers(1, &fbo);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+            for (GLsizei i = 0; i < nl; ++i)
+            {
+                glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, old_tex, 0, i);
+                glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, 0, 0, w, h);
+            }
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, GLuint(prev));
+            glDeleteFramebuffers(1, &fbo);
+        }
+    }
+    gl::state_bind_texture(0, GL_TEXTURE_2D_ARRAY, 0);
+    if (old_tex != 0)
+    {   // the old array will be deleted when the GPU is done with it.
+        gl::state_delete_textures(1, &old_tex);
+    }
+    for (size_t i = 0; i < atlas->PageCount; ++i)
+    {
+        atlas->TexturePages[i] = new_tex;
+    }
+    atlas->TextureArray = new_tex;
+    atlas->ArrayLayers  = new_layers;
+    return true;
+}
+
+/// @summary Allocates texture storage for a new page of an atlas, which will
+/// become page PageCount. Any in-progress defragmentation is abandoned. The caller is responsible for initializing the page
+/// packer, storing the texture ID in TexturePages and incrementing PageCount.
+/// @param atlas The atlas being updated.
+/// @return The OpenGL texture object ID for the new page, or 0.
+static GLuint atlas_page_storage(r2d::atlas_t *atlas)
+{
+    // a new page may take the scratch layer of an in-progress defragmentation.
+    atlas_defrag_abort(atlas);
+    atlas->Defrag.Blocked = false;
+    if (atlas->PageCount == atlas->PageCapacity)
+    {   // allocate additional storage. we'll initialize as-needed.
+        size_t newc = atlas->PageCapacity + ATLAS_PAGE_CAPACITY;
+        void  *newp = realloc(atlas->PagePackers , newc * sizeof(r2d::packer_t));
+        void  *newt = realloc(atlas->TexturePages, newc * sizeof(GLuint));
+        if (newp != NULL) atlas->PagePackers  = (r2d::packer_t*) newp;
+        if (newt != NULL) atlas->TexturePages = (GLuint*) newt;
+        if (newp != NULL && newt != NULL) atlas->PageCapacity = newc;
+    }
+    if (atlas->PageCount >= atlas->PageCapacity)
+    {   // unable to allocate storage for the new page.
+        return 0;
+    }
+
+    // create texture storage for the new texture page.
+    GLuint tex  = 0;
+    if (atlas->PageTarget == GL_TEXTURE_2D_ARRAY)
+    {   // the new page is the next layer of the texture array.
+        if (!atlas_grow_array(atlas, atlas->PageCount + 1))
+            return 0;
+        tex = atlas->TextureArray;
+    }
+    else
+    {
+        glGenTextures(1, &tex);
+        if (tex == 0) return 0;
+        gl::state_bind_texture(0, GL_TEXTURE_2D, tex);
+        gl::texture_storage(GL_TEXTURE_2D, atlas->PageFormat, atlas->PageDataType, GL_LINEAR, GL_LINEAR, atlas->PageWidth, atlas->PageHeight, 1, 1);
+    }
+    return tex;
+}
+
+/// @summary Releases texture storage returned by atlas_page_storage() when the
+/// page could not be initialized. An array layer is left allocated and will be
+/// reused by the next page.
+/// @param atlas The atlas being updated.
+/// @param tex The OpenGL texture object ID returned by atlas_page_storage().
+static void atlas_free_page_storage(r2d::atlas_t *atlas, GLuint tex)
+{
+    if (atlas->PageTarget != GL_TEXTURE_2D_ARRAY)
+    {
+        gl::state_bind_texture(0, GL_TEXTURE_2D, 0);
+        gl::state_delete_textures(1, &tex);
+    }
+}
+
+/// @summary Attempts to place a frame on one of the existing pages of an atlas,
+/// trying the most recently created page first. A page that is being
+/// defragmented is skipped, since its layout is about to be replaced.
+/// @param atlas The atlas being updated.
+/// @param entry The logical entry within the atlas to modify.
+/// @param frame The zero-based index of the frame being placed.
+/// @param w The width of the frame, in pixels.
+/// @param h The height of the frame, in pixels.
+/// @param hpad The amount of horizontal padding, in pixels.
+/// @param vpad The amount of vertical padding, in pixels.
+/// @return true if the frame was placed on an existing page.
+static bool atlas_place_existing(r2d::atlas_t *atlas, r2d::atlas_entry_t *entry, size_t frame, size_t w, size_t h, size_t hpad, size_t vpad)
+{
+    size_t const nump = atlas->PageCount;
+    size_t page_index = nump - 1;
+    while (page_index < nump)
+    {
+        r2d::pkrect_t   rect;
+        r2d::packer_t  *pack = &atlas->PagePackers[page_index];
+        bool const      skip = atlas->Defrag.Active && atlas->Defrag.Page == page_index;
+        if (!skip && r2d::packer_insert(pack, w, h, hpad, vpad, entry->Name, &rect))
+        {   // the frame was successfully placed on this page.
+            // note that rect is the unpadded content rectangle.
+            r2d::atlas_frame_t  eframe = {
+                rect.X,
+                rect.Y,
+                rect.Width,
+                rect.Height
+            };
+            r2d::set_atlas_entry_frame(entry, frame, page_index, eframe);
+            atlas->Defrag.Blocked = false;
             return true;
-        case data::DXGI_FORMAT_D24_UNORM_S8_UINT:
-            out_internalformat = GL_DEPTH_STENCIL;
-            out_format         = GL_DEPTH_STENCIL;
-            out_datatype       = GL_UNSIGNED_INT;
-            return true;
-        case data::DXGI_FORMAT_R8G8_UNORM:
-            out_internalformat = GL_RG8;
-            out_format         = GL_RG;
-            out_datatype       = GL_UNSIGNED_BYTE;
-            return true;
-        case data::DXGI_FORMAT_R8G8_UINT:
-            out_internalformat = GL_RG8UI;
-            out_format         = GL_RG;
-            out_datatype       = GL_UNSIGNED_BYTE;
-            return true;
-        case data::DXGI_FORMAT_R8G8_SNORM:
-            out_internalformat = GL_RG8_SNORM;
-            out_format         = GL_RG;
-            out_datatype       = GL_BYTE;
+        }
+        // decrement at page_index = 0 will cause wrap-around.
+        // page_index in this case will then be > npages.
+        page_index--;
+    }
+    return false;
+}
+
+/// @summary Computes the area of the largest free rectangle tracked by a packer.
+/// @param p The rectangle packer to query. Must be a guillotine or MaxRects packer.
+/// @return The area of the largest free rectangle, in pixels.
+static size_t packer_largest_free(r2d::packer_t const *p)
+{
+    size_t largest = 0;
+    if (p->Type == r2d::PACKER_TYPE_GUILLOTINE)
+    {
+        for (size_t b = 0; b < PACKER_BUCKET_COUNT; ++b)
+        {
+            r2d::pkbucket_t const &bucket = p->Buckets[b];
+            for (size_t i = 0; i < bucket.Count; ++i)
+            {
+                size_t const a = size_t(bucket.Rects[i].Width) * bucket.Rects[i].Height;
+                if (a > largest) largest = a;
+            }
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < p->FreeCount; ++i)
+        {
+            size_t const a = size_t(p->FreeList[i].Width) * p->FreeList[i].Height;
+            if (a > largest) largest = a;
+        }
+    }
+    return largest;
+}
+
+/// @summary Removes an entry from an atlas: its frames are released from the
+/// page packers, its name is removed from the lookup table, any staged uploads
+/// are discarded, and its slot is pushed onto the free list. Frames on a page being defragmented are left in
+/// the page packer, which is about to be replaced, and are instead marked so
+/// that they are neither copied nor kept in the repacked layout.
+/// @param atlas The atlas being updated.
+/// @param index The zero-based index of the entry in EntryList.
+static void atlas_release_entry(r2d::atlas_t *atlas, size_t index)
+{
+    r2d::atlas_entry_t  *e = &atlas->EntryList[index];
+    r2d::atlas_defrag_t *d = &atlas->Defrag;
+    d->Blocked = false; // the freed space may let a failed repack succeed.
+    for (size_t i = 0; i < e->FrameCount; ++i)
+    {
+        size_t const page = e->PageIds[i];
+        if (d->Active && d->Page == page)
+        {
+            for (size_t k = 0; k < d->Count; ++k)
+            {
+                if (d->EntryIndex[k] == index)
+                    d->EntryIndex[k] = ATLAS_NO_ENTRY;
+            }
+            continue;
+        }
+        if (atlas->PagePackers != NULL && page < atlas->PageCount && e->Frames[i].Width > 0)
+            r2d::packer_remove(&atlas->PagePackers[page], e->Name);
+    }
+    for (size_t k = 0; k < atlas->Staging.Count; ++k)
+    {   // the space may be reused before the staged data is uploaded.
+        if (atlas->Staging.List[k].Entry == index)
+            atlas->Staging.List[k].Entry  = ATLAS_NO_ENTRY;
+    }
+    hash::table_remove(&atlas->EntryTable, e->Name);
+    r2d::delete_atlas_entry(e);
+    e->Name     = 0;
+    e->Flags    = r2d::ATLAS_ENTRY_FREE;
+    e->LastUsed = 0;
+    e->Page0    = atlas->FreeEntry;
+    atlas->FreeEntry = uint32_t(index);
+}
+
+/// @summary Evicts the least-recently-used entry of a dynamic atlas. Entries
+/// used during the current frame are never evicted.
+/// @param atlas The atlas being updated.
+/// @param keep The entry being placed, which must not be evicted.
+/// @return true if an entry was evicted.
+static bool atlas_evict_lru(r2d::atlas_t *atlas, r2d::atlas_entry_t const *keep)
+{
+    size_t   victim = atlas->EntryCount;
+    uint32_t oldest = atlas->FrameStamp;
+    for (size_t i = 0; i < atlas->EntryCount; ++i)
+    {
+        r2d::atlas_entry_t const &e = atlas->EntryList[i];
+        if ((e.Flags & r2d::ATLAS_ENTRY_FREE) || &e == keep)
+            continue;
+        // the subtraction handles wrap-around of the frame stamp.
+        if (atlas->FrameStamp - e.LastUsed > atlas->FrameStamp - oldest)
+        {
+            oldest = e.LastUsed;
+            victim = i;
+        }
+    }
+    if (victim == atlas->EntryCount)
+        return false;
+
+    atlas_release_entry(atlas, victim);
+    return true;
+}
+
+/// @summary Selects a page to defragment and computes its repacked layout.
+/// The page wasting the most free space outside of its largest free rectangle
+/// is chosen, provided the waste is at least 1/ATLAS_DEFRAG_MIN_WASTE of the page.
+/// If the repack fails, no further attempt is made until an entry is added or
+/// removed, since the same page and layout would be selected again.
+/// @param atlas The atlas being updated.
+/// @return true if a defragmentation was started.
+static bool atlas_defrag_begin(r2d::atlas_t *atlas)
+{
+    r2d::atlas_defrag_t *d     = &atlas->Defrag;
+    size_t               page  =  atlas->PageCount;
+    size_t               waste = (atlas->PageWidth * atlas->PageHeight) / ATLAS_DEFRAG_MIN_WASTE;
+    if (d->Blocked)
+        return false;
+    for (size_t i = 0; i < atlas->PageCount; ++i)
+    {
+        r2d::packer_t const *p = &atlas->PagePackers[i];
+        if (p->Type == r2d::PACKER_TYPE_SKYLINE_BL || p->Count == 0)
+            continue;
+        size_t const w = p->Free - packer_largest_free(p);
+        if (w > waste)
+        {
+            waste = w;
+            page  = i;
+        }
+    }
+    if (page == atlas->PageCount)
+        return false;
+
+    r2d::packer_t const *src = &atlas->PagePackers[page];
+    size_t        const  n   =  src->Count;
+    uint32_t            *mem = (uint32_t*) malloc(n * 3 * sizeof(uint32_t));
+    if (mem == NULL)
+    {
+        d->Blocked = true;
+        return false;
+    }
+
+    d->Active     = true;
+    d->Page       = page;
+    d->Next       = 0;
+    d->Count      = n;
+    d->Order      = mem;
+    d->EntryIndex = mem + n;
+    d->FrameIndex = mem + n * 2;
+    for (size_t i = 0; i < n; ++i)
+    {
+        d->Order[i] = uint32_t(i);
+    }
+    std::sort(d->Order, d->Order + n, defrag_order(src->Rects));
+
+    // repack the sub-images, tallest first, and locate the entry frame for each.
+    if (!r2d::create_packer(&d->Packer, src->Type, src->Width, src->Height, n))
+        goto error_cleanup;
+    for (size_t k = 0; k < n; ++k)
+    {
+        r2d::pkrect_t const &r = src->Rects[d->Order[k]];
+        uint32_t      index    = 0;
+        size_t        frame    = 0;
+        if (!hash::table_get(&atlas->EntryTable, r.Content, &index))
+            goto error_cleanup;
+        r2d::atlas_entry_t const &e = atlas->EntryList[index];
+        for (frame = 0; frame < e.FrameCount; ++frame)
+        {
+            if (e.PageIds[frame] == page && e.Frames[frame].X == r.X && e.Frames[frame].Y == r.Y)
+                break;
+        }
+        if (frame == e.FrameCount)
+            goto error_cleanup;
+        if (!r2d::packer_insert(&d->Packer, r.Width, r.Height, r.PadX, r.PadY, r.Content, NULL))
+            goto error_cleanup;
+        d->EntryIndex[k] = index;
+        d->FrameIndex[k] = uint32_t(frame);
+    }
+
+    // allocate the scratch storage the sub-images are copied into.
+    if (atlas->PageTarget == GL_TEXTURE_2D_ARRAY)
+    {   // the scratch layer is the first unused layer of the array.
+        if (!atlas_grow_array(atlas, atlas->PageCount + 1))
+            goto error_cleanup;
+        d->Scratch      = atlas->TextureArray;
+        d->ScratchLayer = atlas->PageCount;
+    }
+    else
+    {
+        glGenTextures(1, &d->Scratch);
+        if (d->Scratch == 0)
+            goto error_cleanup;
+        gl::state_bind_texture(0, GL_TEXTURE_2D, d->Scratch);
+        gl::texture_storage(GL_TEXTURE_2D, atlas->PageFormat, atlas->PageDataType, GL_LINEAR, GL_LINEAR, atlas->PageWidth, atlas->PageHeight, 1, 1);
+        gl::state_bind_texture(0, GL_TEXTURE_2D, 0);
+    }
+    return true;
+
+error_cleanup:
+    atlas_defrag_abort(atlas);
+    d->Blocked = true;
+    return false;
+}
+
+/// @summary Completes a page defragmentation once every sub-image has been
+/// copied: the scratch contents replace the page, the repacked layout replaces
+/// the page packer, and the frames of the affected entries are updated.
+/// @param atlas The atlas being updated.
+static void atlas_defrag_finish(r2d::atlas_t *atlas)
+{
+    r2d::atlas_defrag_t *d    = &atlas->Defrag;
+    size_t        const  page =  d->Page;
+    if (atlas->PageTarget == GL_TEXTURE_2D_ARRAY)
+    {   // copy the scratch layer over the page layer; layers never overlap.
+        glCopyImageSubData(
+            d->Scratch, GL_TEXTURE_2D_ARRAY, 0, 0, 0, GLint(d->ScratchLayer),
+            d->Scratch, GL_TEXTURE_2D_ARRAY, 0, 0, 0, GLint(page),
+            GLsizei(atlas->PageWidth), GLsizei(atlas->PageHeight), 1);
+    }
+    else
+    {   // the old page will be deleted when the GPU is done with it.
+        gl::state_delete_textures(1, &atlas->TexturePages[page]);
+        atlas->TexturePages[page] = d->Scratch;
+    }
+    for (size_t k = 0; k < d->Count; ++k)
+    {
+        if (d->EntryIndex[k] == ATLAS_NO_ENTRY)
+            continue;
+        r2d::pkrect_t const &r = d->Packer.Rects[k];
+        r2d::atlas_frame_t  &f = atlas->EntryList[d->EntryIndex[k]].Frames[d->FrameIndex[k]];
+        f.X = r.X;
+        f.Y = r.Y;
+    }
+    for (size_t k = 0; k < d->Count; ++k)
+    {   // release the space of entries removed during the defragmentation.
+        // Order still holds the source rectangle index, which has the name.
+        if (d->EntryIndex[k] == ATLAS_NO_ENTRY)
+            r2d::packer_remove(&d->Packer, atlas->PagePackers[page].Rects[d->Order[k]].Content);
+    }
+    r2d::delete_packer(&atlas->PagePackers[page]);
+    atlas->PagePackers[page] = d->Packer;
+
+    // ownership of the packer and scratch texture has been transferred.
+    free(d->Order);
+    memset(&d->Packer, 0, sizeof(r2d::packer_t));
+    d->Active  = false;
+    d->Order   = NULL;
+    d->Scratch = 0;
+    atlas_defrag_abort(atlas);
+}
+
+/// @summary Rounds a baked atlas file offset up to the page data alignment.
+/// @param offset The byte offset to align.
+/// @return The aligned byte offset.
+static inline uint64_t atlas_file_align(uint64_t offset)
+{
+    return (offset + (ATLAS_FILE_ALIGNMENT - 1)) & ~uint64_t(ATLAS_FILE_ALIGNMENT - 1);
+}
+
+/// @summary Frees the page packers owned by a bulk pack trial and marks the
+/// trial as not having succeeded.
+/// @param t The trial to clear.
+static void pack_trial_clear(r2d::atlas_pack_trial_t *t)
+{
+    if (t->Pages != NULL)
+    {
+        for (size_t i = 0; i < t->PageCount; ++i)
+        {
+            r2d::delete_packer(&t->Pages[i]);
+        }
+        free(t->Pages);
+    }
+    t->Success      = false;
+    t->PageCount    = 0;
+    t->PageCapacity = 0;
+    t->Pages        = NULL;
+}
+
+/// @summary Selects the default OpenGL texture target for the surfaces in a
+/// DDS file. The target used by the application might be different, but one
+/// is required to allocate storage and upload the data.
+/// @param header The base DDS header.
+/// @param header_ex The DX10 extended header, or NULL.
+/// @param width The width of the base surface, in pixels.
+/// @param height The height of the base surface, in pixels.
+/// @return The OpenGL texture target.
+static GLenum dds_default_target(data::dds_header_t const *header, data::dds_header_dxt10_t const *header_ex, size_t width, size_t height)
+{
+    bool isArray   = data::dds_array  (header, header_ex);
+    bool isVolume  = data::dds_volume (header, header_ex);
+    bool isCubemap = data::dds_cubemap(header, header_ex);
+    if (isArray)
+    {   // note that volume arrays are not supported.
+        if (isCubemap) return GL_TEXTURE_CUBE_MAP_ARRAY;
+        else if (width == 1 || height == 1) return GL_TEXTURE_1D_ARRAY;
+        else return GL_TEXTURE_2D_ARRAY;
+    }
+    else if (isVolume) return GL_TEXTURE_3D;
+    else if (isCubemap) return GL_TEXTURE_CUBE_MAP;
+    else if (width == 1 || height == 1) return GL_TEXTURE_1D;
+    else return GL_TEXTURE_2D;
+}
+
+/// @summary Reads one byte from every page of a block of memory, so that the
+/// pages of a memory-mapped file are resident before they are copied.
+/// @param data The start of the block of memory.
+/// @param size The size of the block, in bytes.
+static void prefault_pages(void const *data, size_t size)
+{
+    uint8_t const volatile *p = (uint8_t const volatile*) data;
+    for (size_t i = 0; i < size; i += DDS_PREFAULT_STRIDE)
+    {
+        (void) p[i];
+    }
+}
+
+/// @summary Resets an asynchronous DDS load to the empty state, freeing any
+/// level descriptions and file mapping. The texture object is not deleted.
+/// @param load The asynchronous load to reset.
+static void dds_load_reset(r2d::dds_load_t *load)
+{
+    if (load->Scheduler != NULL)
+    {   // queued bands reference the level data being freed.
+        gl::upload_scheduler_cancel(load->Scheduler, uintptr_t(load));
+        load->Scheduler = NULL;
+    }
+    if (load->Levels   != NULL) free(load->Levels);
+    if (load->GLLevels != NULL) free(load->GLLevels);
+    data::unmap_file(&load->File);
+    load->State         = r2d::DDS_LOAD_STATE_EMPTY;
+    load->LevelCount    = 0;
+    load->ItemCount     = 0;
+    load->MipCount      = 0;
+    load->Levels        = NULL;
+    load->GLLevels      = NULL;
+    load->Target        = GL_NONE;
+    load->Format        = GL_NONE;
+    load->Layout        = GL_NONE;
+    load->DataType      = GL_NONE;
+    load->Texture       = 0;
+    load->NextLevel     = 0;
+    load->NextSlice     = 0;
+    load->NextRow       = 0;
+    load->BytesTotal    = 0;
+    load->BytesUploaded = 0;
+}
+
+/// @summary Parses the headers and level descriptions of a DDS file for an
+/// asynchronous load, and selects the OpenGL format and texture target.
+/// @param load The asynchronous load to update. On failure, the load is reset
+/// and left in the DDS_LOAD_STATE_FAILED state.
+/// @param dds_data A blob of data representing a DDS-formatted image.
+/// @param dds_size The maximum number of bytes to read from the DDS data.
+/// @return true if the load is in the DDS_LOAD_STATE_PREPARED state.
+static bool dds_load_parse(r2d::dds_load_t *load, void const *dds_data, size_t dds_size)
+{
+    data::dds_header_dxt10_t *h_ex      = NULL;
+    data::dds_header_t        header    = {0};
+    data::dds_header_dxt10_t  header_ex = {0};
+    uint8_t const            *data_end  = (uint8_t const*) dds_data + dds_size;
+
+    if (!data::dds_header(dds_data, dds_size, &header))
+        goto error_cleanup;
+    if (data::dds_header_dxt10(dds_data, dds_size, &header_ex))
+        h_ex = &header_ex;
+
+    load->ItemCount  = data::dds_array_count(&header, h_ex);
+    load->MipCount   = data::dds_level_count(&header, h_ex);
+    load->LevelCount = load->ItemCount * load->MipCount;
+    if (load->LevelCount == 0)
+        goto error_cleanup;
+
+    load->Levels   = (data::dds_level_desc_t*) malloc(load->LevelCount * sizeof(data::dds_level_desc_t));
+    load->GLLevels = (gl::level_desc_t*) malloc(load->LevelCount * sizeof(gl::level_desc_t));
+    if (load->Levels == NULL || load->GLLevels == NULL)
+        goto error_cleanup;
+    if (data::dds_describe(dds_data, dds_size, &header, h_ex, load->Levels, load->LevelCount) != load->LevelCount)
+        goto error_cleanup;
+    if (!r2d::dxgi_format_to_gl(load->Levels[0].Format, load->Format, load->Layout, load->DataType))
+        goto error_cleanup;
+
+    load->Target = dds_default_target(&header, h_ex, load->Levels[0].Width, load->Levels[0].Height);
+    for (size_t i = 0; i < load->LevelCount; ++i)
+    {
+        data::dds_level_desc_t const &ddsd = load->Levels[i];
+        gl::level_desc_t             &glsd = load->GLLevels[i];
+        if (ddsd.BytesPerRow == 0 || (uint8_t const*) ddsd.LevelData + ddsd.DataSize > data_end)
+        {   // the level data is truncated.
+            goto error_cleanup;
+        }
+        glsd.Index           = ddsd.Index;
+        glsd.Width           = ddsd.Width;
+        glsd.Height          = ddsd.Height;
+        glsd.Slices          = ddsd.Slices;
+        glsd.BytesPerElement = ddsd.BytesPerElement;
+        glsd.BytesPerRow     = ddsd.BytesPerRow;
+        glsd.BytesPerSlice   = ddsd.BytesPerSlice;
+        glsd.Layout          = load->Layout;
+        glsd.Format          = load->Format;
+        glsd.DataType        = load->DataType;
+        load->BytesTotal    += ddsd.DataSize;
+    }
+    load->State = r2d::DDS_LOAD_STATE_PREPARED;
+    return true;
+
+error_cleanup:
+    dds_load_reset(load);
+    load->State = r2d::DDS_LOAD_STATE_FAILED;
+    return false;
+}
+
+/// @summary Marks every chunk of a tile map dirty.
+/// @param map The tile map to update.
+static void tilemap_mark_all_dirty(r2d::tilemap_t *map)
+{
+    size_t const count = map->ChunksX * map->ChunksY;
+    for (size_t i = 0; i < count; ++i)
+    {
+        map->Chunks[i].Dirty = true;
+    }
+    map->DirtyCount = count;
+}
+
+/// @summary Regenerates the vertex data and texture runs of a tile map chunk
+/// and uploads the vertices to the chunk slot of the vertex buffer.
+/// @param map The tile map containing the chunk.
+/// @param index The zero-based index of the chunk.
+/// @return true if the chunk was rebuilt.
+static bool tilemap_build_chunk(r2d::tilemap_t *map, size_t index)
+{
+    r2d::tilemap_chunk_t &chunk = map->Chunks[index];
+    size_t   const size  = map->ChunkSize;
+    size_t   const x0    = (index % map->ChunksX) * size;
+    size_t   const y0    = (index / map->ChunksX) * size;
+    size_t   const x1    = (x0 + size) < map->Width  ? (x0 + size) : map->Width;
+    size_t   const y1    = (y0 + size) < map->Height ? (y0 + size) : map->Height;
+    float    const tw    = float(map->TileWidth);
+    float    const th    = float(map->TileHeight);
+    float    const depth = float(map->LayerDepth < 0xFFFFFFU ? map->LayerDepth : 0xFFFFFFU) * (1.0f / 16777216.0f);
+    uint32_t const color = map->TintColor;
+    size_t         count = 0;
+    size_t         runs  = 0;
+
+    // collect the non-empty tiles, keyed by texture and then by cell.
+    for (size_t y = y0; y < y1; ++y)
+    {
+        uint32_t const *row = &map->Tiles[y * map->Width];
+        for (size_t x = x0; x < x1; ++x)
+        {
+            uint32_t const t = row[x];
+            if (t == 0 || t >= map->SourceCount || map->Sources[t].Texture == 0)
+                continue;
+            uint64_t const cell = uint64_t((y - y0) * size + (x - x0));
+            map->SortKeys[count++] = (uint64_t(map->Sources[t].Texture) << 32) | cell;
+        }
+    }
+    std::sort(map->SortKeys, map->SortKeys + count);
+
+    // split the sorted tiles into per-texture runs.
+    for (size_t i = 0; i < count; ++i)
+    {
+        GLuint const tex = GLuint(map->SortKeys[i] >> 32);
+        if (runs > 0 && chunk.Runs[runs - 1].Texture == tex)
+        {
+            chunk.Runs[runs - 1].Count++;
+            continue;
+        }
+        if (runs == chunk.RunCapacity)
+        {
+            size_t              newc = chunk.RunCapacity > 0 ? chunk.RunCapacity * 2 : 1;
+            r2d::tilemap_run_t *newr = (r2d::tilemap_run_t*) realloc(chunk.Runs, newc * sizeof(r2d::tilemap_run_t));
+            if (newr == NULL) return false;
+            chunk.RunCapacity = newc;
+            chunk.Runs        = newr;
+        }
+        chunk.Runs[runs].Texture = tex;
+        chunk.Runs[runs].First   = uint32_t(i);
+        chunk.Runs[runs].Count   = 1;
+        runs++;
+    }
+
+    // generate four vertices per tile, in the winding used for sprites.
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t   const cell = size_t(map->SortKeys[i] & 0xFFFFFFFFU);
+        size_t   const tx   = x0 + (cell % size);
+        size_t   const ty   = y0 + (cell / size);
+        r2d::tilemap_source_t const &src = map->Sources[map->Tiles[ty * map->Width + tx]];
+        gl::sprite_vertex_ptc_t     *v   = &map->Vertices[i * 4];
+        float    const l    = float(tx) * tw;
+        float    const t    = float(ty) * th;
+        float    const r    = l + tw;
+        float    const b    = t + th;
+        v[0].XYUV[0] = l; v[0].XYUV[1] = t; v[0].XYUV[2] = src.UV[0]; v[0].XYUV[3] = src.UV[1];
+        v[1].XYUV[0] = r; v[1].XYUV[1] = t; v[1].XYUV[2] = src.UV[2]; v[1].XYUV[3] = src.UV[1];
+        v[2].XYUV[0] = r; v[2].XYUV[1] = b; v[2].XYUV[2] = src.UV[2]; v[2].XYUV[3] = src.UV[3];
+        v[3].XYUV[0] = l; v[3].XYUV[1] = b; v[3].XYUV[2] = src.UV[0]; v[3].XYUV[3] = src.UV[3];
+        for (size_t j = 0; j < 4; ++j)
+        {
+            v[j].TintColor = color;
+            v[j].Depth     = depth;
+            v[j].Layer     = src.Layer;
+        }
+    }
+    if (count > 0)
+    {
+        size_t const vsize = sizeof(gl::sprite_vertex_ptc_t);
+        size_t const slot  = index * size * size * 4 * vsize;
+        gl::state_bind_buffer(GL_ARRAY_BUFFER, map->VertexBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, GLintptr(slot), GLsizeiptr(count * 4 * vsize), map->Vertices);
+    }
+
+    chunk.QuadCount = uint32_t(count);
+    chunk.RunCount  = runs;
+    chunk.Dirty     = false;
+    map->DirtyCount--;
+    return true;
+}
+
+/// @summary Appends a draw record to the list collected for the current view.
+/// @param map The tile map being drawn.
+/// @param draw The draw record to append.
+/// @return true if the record was appended.
+static bool tilemap_push_draw(r2d::tilemap_t *map, r2d::tilemap_draw_t const &draw)
+{
+    if (map->DrawCount == map->DrawCapacity)
+    {
+        size_t               newc = map->DrawCapacity * 2;
+        r2d::tilemap_draw_t *newd = (r2d::tilemap_draw_t*) realloc(map->Draws, newc * sizeof(r2d::tilemap_draw_t));
+        if (newd == NULL) return false;
+        map->Draws = newd;
+        GLsizei *newn = (GLsizei*) realloc(map->DrawCounts, newc * sizeof(GLsizei));
+        if (newn == NULL) return false;
+        map->DrawCounts = newn;
+        GLvoid **newo = (GLvoid**) realloc(map->DrawOffsets, newc * sizeof(GLvoid*));
+        if (newo == NULL) return false;
+        map->DrawOffsets = newo;
+        GLint   *newb = (GLint*) realloc(map->DrawBases, newc * sizeof(GLint));
+        if (newb == NULL) return false;
+        map->DrawBases    = newb;
+        map->DrawCapacity = newc;
+    }
+    map->Draws[map->DrawCount++] = draw;
+    return true;
+}
+
+/// @summary Generates a uniformly distributed random value for particle spawning.
+/// @param seed The xorshift generator state, updated on return.
+/// @return A value in [-1, +1].
+static inline float particle_random(uint32_t &seed)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return float(seed >> 8) * (2.0f / 16777215.0f) - 1.0f;
+}
+
+/// @summary Computes the screen rectangle and packed tint color of a single
+/// particle from its position and normalized age.
+/// @param sys The particle system containing the particle.
+/// @param i The zero-based index of the particle.
+/// @param rect On return, the left, top, right and bottom edges of the quad.
+/// @param color On return, the ABGR tint color.
+static inline void particle_quad(r2d::particle_system_t const *sys, size_t i, float *rect, uint32_t &color)
+{
+    float t = sys->Age[i] * sys->InvLifetime[i];
+    if   (t > 1.0f) t = 1.0f;
+    float const half = (sys->SizeStart + (sys->SizeEnd - sys->SizeStart) * t) * 0.5f;
+    rect[0] = sys->PositionX[i] - half;
+    rect[1] = sys->PositionY[i] - half;
+    rect[2] = sys->PositionX[i] + half;
+    rect[3] = sys->PositionY[i] + half;
+    color   = 0;
+    for (size_t c = 0; c < 4; ++c)
+    {
+        float const v = sys->ColorStart[c] + (sys->ColorEnd[c] - sys->ColorStart[c]) * t;
+        color |= uint32_t(v * 255.0f + 0.5f) << (c * 8);
+    }
+}
+
+/// @summary Writes the four sprite vertices of a particle quad.
+/// @param sys The particle system containing the particle.
+/// @param v The first of four vertices to write.
+/// @param rect The left, top, right and bottom edges of the quad.
+/// @param color The ABGR tint color.
+/// @param depth The normalized layer depth.
+static inline void particle_vertices(r2d::particle_system_t const *sys, gl::sprite_vertex_ptc_t *v, float const *rect, uint32_t color, float depth)
+{
+    v[0].XYUV[0] = rect[0]; v[0].XYUV[1] = rect[1]; v[0].XYUV[2] = sys->UV[0]; v[0].XYUV[3] = sys->UV[1];
+    v[1].XYUV[0] = rect[2]; v[1].XYUV[1] = rect[1]; v[1].XYUV[2] = sys->UV[2]; v[1].XYUV[3] = sys->UV[1];
+    v[2].XYUV[0] = rect[2]; v[2].XYUV[1] = rect[3]; v[2].XYUV[2] = sys->UV[2]; v[2].XYUV[3] = sys->UV[3];
+    v[3].XYUV[0] = rect[0]; v[3].XYUV[1] = rect[3]; v[3].XYUV[2] = sys->UV[0]; v[3].XYUV[3] = sys->UV[3];
+    for (size_t j = 0; j < 4; ++j)
+    {
+        v[j].TintColor = color;
+        v[j].Depth     = depth;
+        v[j].Layer     = sys->Layer;
+    }
+}
+
+/// @summary Computes the cache key of a text layout using 32-bit FNV-1a over
+/// the string bytes, the font address and the wrap width.
+/// @param font The bitmap font.
+/// @param str The string, which need not be NULL-terminated.
+/// @param length The length of the string, in bytes.
+/// @param wrap_width The wrap width, in pixels.
+/// @return The 32-bit layout key.
+static uint32_t text_layout_key(gui::bitmap_font_t const *font, char const *str, size_t length, float wrap_width)
+{
+    uint8_t const *f = (uint8_t const*) &font;
+    uint8_t const *w = (uint8_t const*) &wrap_width;
+    uint32_t       h =  0x811C9DC5U;
+    for (size_t i = 0; i < length; ++i)
+    {
+        h ^= uint8_t(str[i]);
+        h *= 0x01000193U;
+    }
+    for (size_t i = 0; i < sizeof(font); ++i)
+    {
+        h ^= f[i];
+        h *= 0x01000193U;
+    }
+    for (size_t i = 0; i < sizeof(wrap_width); ++i)
+    {
+        h ^= w[i];
+        h *= 0x01000193U;
+    }
+    return h;
+}
+
+/// @summary Offsets a range of glyph quads within a text layout.
+/// @param v The first vertex of the first quad.
+/// @param count The number of quads to offset.
+/// @param dx The horizontal offset, in pixels.
+/// @param dy The vertical offset, in pixels.
+static inline void text_offset_quads(gl::sprite_vertex_ptc_t *v, size_t count, float dx, float dy)
+{
+    for (size_t i = 0, n = count * 4; i < n; ++i)
+    {
+        v[i].XYUV[0] += dx;
+        v[i].XYUV[1] += dy;
+    }
+}
+
+/// @summary Generates the glyph quads for a string. Quads are generated into
+/// the Placed array in string order, then grouped by font page into the
+/// Vertices array; the Placed array must be regenerated before it is used.
+/// @param layout The text layout to update. The Font, WrapWidth, Length and
+/// Text fields must be set.
+/// @return true if the layout was generated, or false if memory allocation failed.
+static bool text_layout_build(r2d::text_layout_t *layout)
+{
+    gui::bitmap_font_t const *font = layout->Font;
+    size_t const length = layout->Length;
+
+    if (layout->QuadCapacity < length)
+    {   // every glyph quad consumes at least one byte of the string.
+        size_t newc = layout->QuadCapacity ? layout->QuadCapacity : 16;
+        while (newc < length) newc *= 2;
+        gl::sprite_vertex_ptc_t *v = (gl::sprite_vertex_ptc_t*) realloc(layout->Vertices, newc * 4 * sizeof(gl::sprite_vertex_ptc_t));
+        if (v == NULL) return false;
+        layout->Vertices = v;
+        gl::sprite_vertex_ptc_t *p = (gl::sprite_vertex_ptc_t*) realloc(layout->Placed, newc * 4 * sizeof(gl::sprite_vertex_ptc_t));
+        if (p == NULL) return false;
+        layout->Placed   = p;
+        layout->QuadCapacity = newc;
+    }
+
+    gl::sprite_vertex_ptc_t *quads = layout->Placed;
+    float const line_height = float(font->LineHeight);
+    float const wrap        = layout->WrapWidth;
+    float const su          = font->PageWidth  ? 1.0f / float(font->PageWidth)  : 0.0f;
+    float const sv          = font->PageHeight ? 1.0f / float(font->PageHeight) : 0.0f;
+    char  const *str        = layout->Text;
+    char  const *end        = layout->Text + length;
+    size_t       count      = 0;     // the number of quads generated
+    size_t       line_start = 0;     // the first quad on the current line
+    size_t       break_quad = 0;     // the first quad following the last space
+    bool         has_break  = false; // true if the current line contains a space
+    float        break_x    = 0.0f;  // the pen position following the last space
+    float        pen_x      = 0.0f;
+    float        pen_y      = 0.0f;
+    float        width      = 0.0f;
+    uint32_t     prev       = 0xFFFFFFFFU;
+    uint32_t     cp         = 0;
+
+    while (str < end)
+    {
+        str = gui::next_codepoint(str, cp);
+        if (cp == '\n')
+        {   // explicit line break.
+            if (width < pen_x) width = pen_x;
+            pen_x      = 0.0f;
+            pen_y     += line_height;
+            line_start = count;
+            has_break  = false;
+            prev       = cp;
+            continue;
+        }
+
+        uint32_t glyph_index = 0;
+        if (cp == 0xFFFFFFFFU || !hash::table_get(&font->GTable, cp, &glyph_index))
+        {   // invalid codepoint, or no glyph in the font; skip it.
+            prev = cp;
+            continue;
+        }
+
+        gui::bitmap_glyph_t const &g = font->Glyphs[glyph_index];
+        float const advance = float(gui::advance_x(font, prev, cp, g.AdvanceX));
+        prev = cp;
+
+        if (wrap > 0.0f && cp != ' ' && pen_x + float(g.OffsetX + g.Width) > wrap)
+        {
+            if (has_break)
+            {   // move the current word to the start of the next line.
+                text_offset_quads(&quads[break_quad * 4], count - break_quad, -break_x, line_height);
+                if (width < break_x) width = break_x;
+                pen_x     -= break_x;
+                pen_y     += line_height;
+                line_start = break_quad;
+                has_break  = false;
+            }
+            else if (count > line_start)
+            {   // the word is wider than the line; break between glyphs.
+                if (width < pen_x) width = pen_x;
+                pen_x      = 0.0f;
+                pen_y     += line_height;
+                line_start = count;
+            }
+        }
+
+        if (g.Width > 0 && g.Height > 0)
+        {
+            gl::sprite_vertex_ptc_t *v = &quads[count++ * 4];
+            float const l  = pen_x + float(g.OffsetX);
+            float const t  = pen_y + float(g.OffsetY);
+            float const r  = l + float(g.Width);
+            float const b  = t + float(g.Height);
+            float const u0 = float(g.TextureX) * su;
+            float const u1 = float(g.TextureX  + g.Width) * su;
+            float const v0 = 1.0f - float(g.TextureY) * sv;
+            float const v1 = 1.0f - float(g.TextureY + g.Height) * sv;
+            v[0].XYUV[0] = l; v[0].XYUV[1] = t; v[0].XYUV[2] = u0; v[0].XYUV[3] = v0;
+            v[1].XYUV[0] = r; v[1].XYUV[1] = t; v[1].XYUV[2] = u1; v[1].XYUV[3] = v0;
+            v[2].XYUV[0] = r; v[2].XYUV[1] = b; v[2].XYUV[2] = u1; v[2].XYUV[3] = v1;
+            v[3].XYUV[0] = l; v[3].XYUV[1] = b; v[3].XYUV[2] = u0; v[3].XYUV[3] = v1;
+            for (size_t j = 0; j < 4; ++j)
+            {
+                v[j].TintColor = 0xFFFFFFFFU;
+                v[j].Depth     = 0.0f;
+                v[j].Layer     = g.PageIndex;
+            }
+        }
+        pen_x += advance;
+
+        if (cp == ' ')
+        {   // the next word may be moved to a new line.
+            has_break  = true;
+            break_quad = count;
+            break_x    = pen_x;
+        }
+    }
+    if (width < pen_x) width = pen_x;
+
+    // group the quads by font page using a counting sort, preserving the
+    // string order of the quads within each page.
+    uint32_t page_first[TEXT_MAX_PAGES];
+    uint32_t page_count[TEXT_MAX_PAGES];
+    size_t   run_count = 0;
+    memset(page_count, 0, sizeof(page_count));
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (page_count[size_t(quads[i * 4].Layer)]++ == 0)
+            run_count++;
+    }
+    if (layout->RunCapacity < run_count)
+    {
+        r2d::text_run_t *runs = (r2d::text_run_t*) realloc(layout->Runs, run_count * sizeof(r2d::text_run_t));
+        if (runs == NULL) return false;
+        layout->Runs        = runs;
+        layout->RunCapacity = run_count;
+    }
+    for (size_t i = 0, n = 0, first = 0; i < TEXT_MAX_PAGES; ++i)
+    {
+        page_first[i] = uint32_t(first);
+        if (page_count[i] > 0)
+        {
+            layout->Runs[n].Page  = uint32_t(i);
+            layout->Runs[n].First = uint32_t(first);
+            layout->Runs[n].Count = page_count[i];
+            first += page_count[i];
+            n++;
+        }
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t dst = page_first[size_t(quads[i * 4].Layer)]++;
+        memcpy(&layout->Vertices[dst * 4], &quads[i * 4], 4 * sizeof(gl::sprite_vertex_ptc_t));
+    }
+
+    layout->Width       = width;
+    layout->Height      = length > 0 ? pen_y + line_height : 0.0f;
+    layout->QuadCount   = count;
+    layout->RunCount    = run_count;
+    layout->PlacedValid = false;
+    return true;
+}
+
+/// @summary Updates the placed vertices of a text layout for a screen
+/// position, scale, color and layer depth. Nothing is done if the placement
+/// matches the previous placement.
+/// @param layout The text layout to update.
+/// @param x The screen position of the upper-left corner of the first line.
+/// @param y The screen position of the upper-left corner of the first line.
+/// @param scale The scale factor applied to the layout.
+/// @param color The ABGR tint color.
+/// @param layer_depth The layer depth of the text.
+static void text_layout_place(r2d::text_layout_t *layout, float x, float y, float scale, uint32_t color, uint32_t layer_depth)
+{
+    if (layout->PlacedValid     &&
+        layout->PlacedX     == x && layout->PlacedY     == y && layout->PlacedScale == scale &&
+        layout->PlacedColor == color && layout->PlacedDepth == layer_depth)
+        return;
+
+    gl::sprite_vertex_ptc_t const *src = layout->Vertices;
+    gl::sprite_vertex_ptc_t       *dst = layout->Placed;
+    float const depth = float(layer_depth < 0xFFFFFFU ? layer_depth : 0xFFFFFFU) * (1.0f / 16777216.0f);
+    for (size_t i = 0, n = layout->QuadCount * 4; i < n; ++i)
+    {
+        dst[i].XYUV[0]   = src[i].XYUV[0] * scale + x;
+        dst[i].XYUV[1]   = src[i].XYUV[1] * scale + y;
+        dst[i].XYUV[2]   = src[i].XYUV[2];
+        dst[i].XYUV[3]   = src[i].XYUV[3];
+        dst[i].TintColor = color;
+        dst[i].Depth     = depth;
+        dst[i].Layer     = src[i].Layer;
+    }
+    layout->PlacedValid  = true;
+    layout->PlacedX      = x;
+    layout->PlacedY      = y;
+    layout->PlacedScale  = scale;
+    layout->PlacedColor  = color;
+    layout->PlacedDepth  = layer_depth;
+}
+
+/// @summary Selects the slot used to store a new layout in a text cache,
+/// evicting the least-recently-used layout not used during the current frame
+/// if the cache is full, or growing the cache if every layout is in use.
+/// @param cache The text layout cache.
+/// @param out_index On return, the zero-based index of the slot in cache->Layouts.
+/// @return true if a slot is available, or false if memory allocation failed.
+static bool text_cache_slot(r2d::text_cache_t *cache, uint32_t &out_index)
+{
+    if (cache->Count == cache->Capacity)
+    {
+        size_t   best  = cache->Count;
+        uint32_t stamp = cache->FrameStamp;
+        for (size_t i  = 0; i < cache->Count; ++i)
+        {
+            r2d::text_layout_t const &L = cache->Layouts[i];
+            if (L.LastUsed != stamp && (best == cache->Count || L.LastUsed < cache->Layouts[best].LastUsed))
+                best = i;
+        }
+        if (best < cache->Count)
+        {   // evict the layout; its buffers are reused by the new layout.
+            uint32_t current = 0;
+            r2d::text_layout_t &L = cache->Layouts[best];
+            if (L.Font != NULL && hash::table_get(&cache->Table, L.Key, &current) && current == uint32_t(best))
+                hash::table_remove(&cache->Table, L.Key);
+            cache->Evictions++;
+            out_index = uint32_t(best);
             return true;
-        case data::DXGI_FORMAT_R8G8_SINT:
-            out_internalformat = GL_RG8I;
-            out_format         = GL_RG;
-            out_datatype       = GL_BYTE;
+        }
+
+        // every layout was used during this frame; grow the cache.
+        size_t newc = cache->Capacity * 2;
+        r2d::text_layout_t *layouts = (r2d::text_layout_t*) realloc(cache->Layouts, newc * sizeof(r2d::text_layout_t));
+        if (layouts == NULL) return false;
+        cache->Layouts  = layouts;
+        cache->Capacity = newc;
+    }
+    memset(&cache->Layouts[cache->Count], 0, sizeof(r2d::text_layout_t));
+    out_index = uint32_t(cache->Count++);
+    return true;
+}
+
+/// @summary Reserves space in the dynamic buffers of a sprite effect for a
+/// number of quads, orphaning the buffers if they are full, and maps the
+/// vertex range for writing. The buffers must be bound.
+/// @param effect The sprite effect whose buffers are being written.
+/// @param max_quads The number of quads remaining to be drawn.
+/// @param out_count On return, the number of quads that can be written.
+/// @return A pointer to the mapped vertex range, or NULL.
+static gl::sprite_vertex_ptc_t* sprite_effect_map_quads(gl::sprite_effect_t *effect, size_t max_quads, size_t &out_count)
+{
+    if (effect->VertexOffset + 4 > effect->VertexCapacity)
+    {   // the buffer is full; orphan it to avoid waiting on the GPU.
+        effect->VertexOffset = 0;
+        effect->IndexOffset  = 0;
+        glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(effect->VertexCapacity * effect->VertexSize), NULL, GL_DYNAMIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(effect->IndexCapacity * effect->IndexSize), NULL, GL_DYNAMIC_DRAW);
+    }
+
+    size_t count = (effect->VertexCapacity - effect->VertexOffset) / 4;
+    if (count > max_quads) count = max_quads;
+
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    GLvoid    *v_data = glMapBufferRange(GL_ARRAY_BUFFER, GLintptr(effect->VertexOffset * effect->VertexSize), GLsizeiptr(count * 4 * effect->VertexSize), access);
+    out_count = count;
+    return (gl::sprite_vertex_ptc_t*) v_data;
+}
+
+/// @summary Unmaps the vertex range mapped by sprite_effect_map_quads(),
+/// generates the indices for the quads written to it and draws them.
+/// @param effect The sprite effect whose buffers are being written.
+/// @param count The number of quads written to the mapped vertex range.
+/// @return true if the quads were drawn.
+static bool sprite_effect_draw_quads(gl::sprite_effect_t *effect, size_t count)
+{
+    GLsizei    isize  = GLsizei(effect->IndexSize);
+    GLenum     type   = isize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    size_t     base_v = effect->VertexOffset;
+    size_t     base_i = effect->IndexOffset;
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    GLvoid *i_data = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, GLintptr(base_i * effect->IndexSize), GLsizeiptr(count * 6 * effect->IndexSize), access);
+    if (i_data == NULL)
+        return false;
+    if (isize == 2) gl::generate_quad_indices_u16(i_data, 0, base_v, count);
+    else gl::generate_quad_indices_u32(i_data, 0, base_v, count);
+    glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+
+    glDrawElements(GL_TRIANGLES, GLsizei(count * 6), type, GL_BUFFER_OFFSET(base_i * isize));
+    effect->VertexOffset += count * 4;
+    effect->IndexOffset  += count * 6;
+    return true;
+}
+
+/// @summary Computes the radius of the circle centered on the origin of a
+/// sprite that contains the sprite at any orientation.
+/// @param s The sprite definition.
+/// @return The bounding radius.
+static inline float sprite_extent(gl::sprite_t const &s)
+{
+    float const w  = float(s.ImageWidth);
+    float const h  = float(s.ImageHeight);
+    float const cx = w > 0.0f ? s.OriginX / w : 0.0f;
+    float const cy = h > 0.0f ? s.OriginY / h : 0.0f;
+    float const dw = fabsf(w * s.ScaleX);
+    float const dh = fabsf(h * s.ScaleY);
+    float const ax = dw * (fabsf(cx) > fabsf(1.0f - cx) ? fabsf(cx) : fabsf(1.0f - cx));
+    float const ay = dh * (fabsf(cy) > fabsf(1.0f - cy) ? fabsf(cy) : fabsf(1.0f - cy));
+    return sqrtf(ax * ax + ay * ay);
+}
+
+/// @summary Computes the cell column or row containing a world coordinate,
+/// clamped to the grid.
+/// @param v The world coordinate, relative to the grid origin.
+/// @param inv The value 1.0 / CellSize.
+/// @param n The number of cells along the axis.
+/// @return The zero-based cell column or row.
+static inline size_t sprite_grid_axis(float v, float inv, size_t n)
+{
+    float c = floorf(v * inv);
+    if (c < 0.0f)      return 0;
+    if (c >= float(n)) return n - 1;
+    return size_t(c);
+}
+
+/// @summary Computes the cell containing the origin of a sprite.
+/// @param grid The sprite grid.
+/// @param s The sprite definition.
+/// @return The zero-based index of the cell.
+static inline uint32_t sprite_grid_cell(r2d::sprite_grid_t const *grid, gl::sprite_t const &s)
+{
+    size_t cx = sprite_grid_axis(s.ScreenX - grid->OriginX, grid->InvCellSize, grid->CellsX);
+    size_t cy = sprite_grid_axis(s.ScreenY - grid->OriginY, grid->InvCellSize, grid->CellsY);
+    return uint32_t(cy * grid->CellsX + cx);
+}
+
+/// @summary Moves the sprite in one slot of a sprite grid to another slot.
+/// @param grid The sprite grid.
+/// @param dst The destination slot.
+/// @param src The source slot.
+static inline void sprite_grid_move_slot(r2d::sprite_grid_t *grid, size_t dst, size_t src)
+{
+    uint32_t const handle = grid->SlotHandle[src];
+    grid->Sprites[dst]    = grid->Sprites[src];
+    grid->SlotHandle[dst] = handle;
+    grid->HandleSlot[handle] = uint32_t(dst);
+}
+
+/// @summary Ensures that the slot storage of a sprite grid has space for one
+/// more sprite in the overflow region.
+/// @param grid The sprite grid.
+/// @return true if the overflow region has space for another sprite.
+static bool sprite_grid_reserve_overflow(r2d::sprite_grid_t *grid)
+{
+    size_t need = grid->PackedCount + grid->OverflowCount + 1;
+    if (need <= grid->SlotCapacity)
+        return true;
+
+    size_t newc = grid->SlotCapacity ? grid->SlotCapacity : 64;
+    while (newc < need) newc *= 2;
+    gl::sprite_t *sprites = (gl::sprite_t*) realloc(grid->Sprites, newc * sizeof(gl::sprite_t));
+    if (sprites == NULL) return false;
+    grid->Sprites = sprites;
+    uint32_t *owners = (uint32_t*) realloc(grid->SlotHandle, newc * sizeof(uint32_t));
+    if (owners == NULL) return false;
+    grid->SlotHandle   = owners;
+    grid->SlotCapacity = newc;
+    return true;
+}
+
+/// @summary Removes the sprite associated with a handle from its slot,
+/// filling the slot with the last sprite of the same cell or of the overflow
+/// region. The handle itself is not modified.
+/// @param grid The sprite grid.
+/// @param handle The handle of the sprite to remove.
+static void sprite_grid_unlink(r2d::sprite_grid_t *grid, uint32_t handle)
+{
+    size_t const slot = grid->HandleSlot[handle];
+    if (slot >= grid->PackedCount)
+    {   // the sprite is in the overflow region.
+        size_t last = grid->PackedCount + grid->OverflowCount - 1;
+        if (slot != last) sprite_grid_move_slot(grid, slot, last);
+        grid->OverflowCount--;
+    }
+    else
+    {
+        r2d::sprite_cell_t &cell = grid->Cells[grid->HandleCell[handle]];
+        size_t last = cell.First + cell.Count - 1;
+        if (slot != last) sprite_grid_move_slot(grid, slot, last);
+        cell.Count--;
+    }
+}
+
+/// @summary Stores a sprite in a cell of a sprite grid, or in the overflow
+/// region if the cell has no spare capacity.
+/// @param grid The sprite grid.
+/// @param handle The handle of the sprite.
+/// @param cell The zero-based index of the cell containing the sprite origin.
+/// @param sprite The sprite definition.
+/// @return true if the sprite was stored.
+static bool sprite_grid_link(r2d::sprite_grid_t *grid, uint32_t handle, uint32_t cell, gl::sprite_t const *sprite)
+{
+    r2d::sprite_cell_t &c = grid->Cells[cell];
+    size_t slot;
+    if (c.Count < c.Capacity)
+    {
+        slot = c.First + c.Count++;
+    }
+    else
+    {
+        if (!sprite_grid_reserve_overflow(grid))
+            return false;
+        slot = grid->PackedCount + grid->OverflowCount++;
+    }
+    grid->Sprites[slot]      = *sprite;
+    grid->SlotHandle[slot]   = handle;
+    grid->HandleSlot[handle] = uint32_t(slot);
+    grid->HandleCell[handle] = cell;
+    float const extent = sprite_extent(*sprite);
+    if (grid->MaxExtent < extent) grid->MaxExtent = extent;
+    return true;
+}
+
+/// @summary Appends a range of sprites to a query result, merging it with the
+/// previous range if the two are adjacent.
+/// @param ranges The array of ranges being written.
+/// @param max_ranges The maximum number of ranges to write.
+/// @param count The number of ranges in the result; updated on return.
+/// @param first The zero-based index of the first sprite in the range.
+/// @param n The number of sprites in the range.
+static inline void sprite_grid_emit(r2d::sprite_range_t *ranges, size_t max_ranges, size_t &count, uint32_t first, uint32_t n)
+{
+    if (count > 0 && count <= max_ranges && ranges[count-1].First + ranges[count-1].Count == first)
+    {
+        ranges[count-1].Count += n;
+        return;
+    }
+    if (count < max_ranges)
+    {
+        ranges[count].First = first;
+        ranges[count].Count = n;
+    }
+    count++;
+}
+
+/*///////////////////////
+//  Public Functions   //
+///////////////////////*/
+bool r2d::dxgi_format_to_gl(uint32_t dxgi, GLenum &out_internalformat, GLenum &out_format, GLenum &out_datatype)
+{
+    switch (dxgi)
+    {
+        case data::DXGI_FORMAT_UNKNOWN:
+        case data::DXGI_FORMAT_R32G32B32A32_TYPELESS:
+        case data::DXGI_FORMAT_R32G32B32_TYPELESS:
+        case data::DXGI_FORMAT_R16G16B16A16_TYPELESS:
+        case data::DXGI_FORMAT_R32G32_TYPELESS:
+        case data::DXGI_FORMAT_R32G8X24_TYPELESS:
+        case data::DXGI_FORMAT_R10G10B10A2_TYPELESS:
+        case data::DXGI_FORMAT_R8G8B8A8_TYPELESS:
+        case data::DXGI_FORMAT_R16G16_TYPELESS:
+        case data::DXGI_FORMAT_R32_TYPELESS:
+        case data::DXGI_FORMAT_R24G8_TYPELESS:
+        case data::DXGI_FORMAT_R8G8_TYPELESS:
+        case data::DXGI_FORMAT_R16_TYPELESS:
+        case data::DXGI_FORMAT_R8_TYPELESS:
+        case data::DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+        case data::DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+        case data::DXGI_FORMAT_R1_UNORM:
+        case data::DXGI_FORMAT_R8G8_B8G8_UNORM:
+        case data::DXGI_FORMAT_G8R8_G8B8_UNORM:
+        case data::DXGI_FORMAT_BC1_TYPELESS:
+        case data::DXGI_FORMAT_BC2_TYPELESS:
+        case data::DXGI_FORMAT_BC2_UNORM:
+        case data::DXGI_FORMAT_BC2_UNORM_SRGB:
+        case data::DXGI_FORMAT_BC3_TYPELESS:
+        case data::DXGI_FORMAT_BC4_TYPELESS:
+        case data::DXGI_FORMAT_BC4_UNORM:
+        case data::DXGI_FORMAT_BC4_SNORM:
+        case data::DXGI_FORMAT_BC5_TYPELESS:
+        case data::DXGI_FORMAT_BC5_SNORM:
+        case data::DXGI_FORMAT_B8G8R8A8_TYPELESS:
+        case data::DXGI_FORMAT_B8G8R8X8_TYPELESS:
+        case data::DXGI_FORMAT_BC6H_TYPELESS:
+        case data::DXGI_FORMAT_BC7_TYPELESS:
+        case data::DXGI_FORMAT_AYUV:
+        case data::DXGI_FORMAT_Y410:
+        case data::DXGI_FORMAT_Y416:
+        case data::DXGI_FORMAT_NV12:
+        case data::DXGI_FORMAT_P010:
+        case data::DXGI_FORMAT_P016:
+        case data::DXGI_FORMAT_420_OPAQUE:
+        case data::DXGI_FORMAT_YUY2:
+        case data::DXGI_FORMAT_Y210:
+        case data::DXGI_FORMAT_Y216:
+        case data::DXGI_FORMAT_NV11:
+        case data::DXGI_FORMAT_AI44:
+        case data::DXGI_FORMAT_IA44:
+            break;
+        case data::DXGI_FORMAT_R32G32B32A32_FLOAT:
+            out_internalformat = GL_RGBA32F;
+            out_format         = GL_BGRA;
+            out_datatype       = GL_FLOAT;
             return true;
-        case data::DXGI_FORMAT_R16_FLOAT:
-            out_internalformat = GL_R16F;
-            out_format         = GL_RED;
-            out_datatype       = GL_HALF_FLOAT;
+        case data::DXGI_FORMAT_R32G32B32A32_UINT:
+            out_internalformat = GL_RGBA32UI;
+            out_format         = GL_BGRA_INTEGER;
+            out_datatype       = GL_UNSIGNED_INT;
             return true;
-        case data::DXGI_FORMAT_D16_UNORM:
-            out_internalformat = GL_DEPTH_COMPONENT;
-            out_format         = GL_DEPTH_COMPONENT;
-            out_datatype       = GL_UNSIGNED_SHORT;
+        case data::DXGI_FORMAT_R32G32B32A32_SINT:
+            out_internalformat = GL_RGBA32I;
+            out_format         = GL_BGRA_INTEGER;
+            out_datatype       = GL_INT;
             return true;
-        case data::DXGI_FORMAT_R16_UNORM:
-            out_internalformat = GL_R16;
-            out_format         = GL_RED;
+        case data::DXGI_FORMAT_R32G32B32_FLOAT:
+            out_internalformat = GL_RGB32F;
+            out_format         = GL_BGR;
+            out_datatype       = GL_FLOAT;
+            return true;
+        case data::DXGI_FORMAT_R32G32B32_UINT:
+            out_internalformat = GL_RGB32UI;
+            out_format         = GL_BGR_INTEGER;
+            out_datatype       = GL_UNSIGNED_INT;
+            return true;
+        case data::DXGI_FORMAT_R32G32B32_SINT:
+            out_internalformat = GL_RGB32I;
+            out_format         = GL_BGR_INTEGER;
+            out_datatype       = GL_INT;
+            return true;
+        case data::DXGI_FORMAT_R16G16B16A16_FLOAT:
+            out_internalformat = GL_RGBA16F;
+            out_format         = GL_BGRA;
+            out_datatype       = GL_HALF_FLOAT;
+            return true;
+        case data::DXGI_FORMAT_R16G16B16A16_UNORM:
+            out_internalformat = GL_RGBA16;
+            out_format         = GL_BGRA_INTEGER;
             out_datatype       = GL_UNSIGNED_SHORT;
             return true;
-        case data::DXGI_FORMAT_R16_UINT:
-            out_internalformat = GL_R16UI;
-            out_format         = GL_RED;
+        case data::DXGI_FORMAT_R16G16B16A16_UINT:
+            out_internalformat = GL_RGBA16UI;
+            out_format         = GL_BGRA_INTEGER;
             out_datatype       = GL_UNSIGNED_SHORT;
             return true;
-        case data::DXGI_FORMAT_R16_SNORM:
-            out_internalformat = GL_R16_SNORM;
-            out_format         = GL_RED;
+        case data::DXGI_FORMAT_R16G16B16A16_SNORM:
+            out_internalformat = GL_RGBA16_SNORM;
+            out_format         = GL_BGRA_INTEGER;
             out_datatype       = GL_SHORT;
             return true;
-        case data::DXGI_FORMAT_R16_SINT:
-            out_internalformat = GL_R16I;
-            out_format         = GL_RED;
+        case data::DXGI_FORMAT_R16G16B16A16_SINT:
+            out_internalformat = GL_RGBA16I;
+            out_format         = GL_BGRA_INTEGER;
             out_datatype       = GL_SHORT;
             return true;
-        case data::DXGI_FORMAT_R8_UNORM:
-            out_internalformat = GL_R8;
-            out_format         = GL_RED;
-            out_datatype       = GL_UNSIGNED_BYTE;
+        case data::DXGI_FORMAT_R32G32_FLOAT:
+            out_internalformat = GL_RG32F;
+            out_format         = GL_RG;
+            out_datatype       = GL_FLOAT;
             return true;
-        case data::DXGI_FORMAT_R8_UINT:
-            out_internalformat = GL_R8UI;
-            out_format         = GL_RED;
-            out_datatype       = GL_UNSIGNED_BYTE;
+        case data::DXGI_FORMAT_R32G32_UINT:
+            out_internalformat = GL_RG32UI;
+            out_format         = GL_RG;
+            out_datatype       = GL_UNSIGNED_INT;
             return true;
-        case data::DXGI_FORMAT_R8_SNORM:
-            out_internalformat = GL_R8_SNORM;
-            out_format         = GL_RED;
-            out_datatype       = GL_BYTE;
+        case data::DXGI_FORMAT_R32G32_SINT:
+            out_internalformat = GL_RG32I;
+            out_format         = GL_RG;
+            out_datatype       = GL_INT;
             return true;
-        case data::DXGI_FORMAT_R8_SINT:
-            out_internalformat = GL_R8I;
-            out_format         = GL_RED;
-            out_datatype       = GL_BYTE;
+        case data::DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+            out_internalformat = GL_DEPTH_STENCIL;
+            out_format         = GL_DEPTH_STENCIL;
+            out_datatype       = GL_FLOAT; // ???
             return true;
-        case data::DXGI_FORMAT_A8_UNORM:
-            out_internalformat = GL_R8;
-            out_format         = GL_RED;
-            out_datatype       = GL_UNSIGNED_BYTE;
+        case data::DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+            out_internalformat = GL_RG32F;
+            out_format         = GL_RG;
+            out_datatype       = GL_FLOAT;
             return true;
-        case data::DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
-            out_internalformat = GL_RGB9_E5;
-            out_format         = GL_RGB;
-            out_datatype       = GL_UNSIGNED_INT;
+        case data::DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
             return true;
-        case data::DXGI_FORMAT_BC1_UNORM:
-            out_internalformat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
-            out_format         = GL_RGBA;
-            out_datatype       = GL_UNSIGNED_BYTE;
+        case data::DXGI_FORMAT_R10G10B10A2_UNORM:
+            out_internalformat = GL_RGB10_A2;
+            out_format         = GL_BGRA;
+            out_datatype       = GL_UNSIGNED_INT_2_10_10_10_REV;
             return true;
-        case data::DXGI_FORMAT_BC1_UNORM_SRGB:
-            out_internalformat = 0x8C4D;
-            out_format         = GL_RGBA;
-            out_datatype       = GL_UNSIGNED_BYTE;
+        case data::DXGI_FORMAT_R10G10B10A2_UINT:
+            out_internalformat = GL_RGB10_A2UI;
+            out_format         = GL_BGRA;
+            out_datatype       = GL_UNSIGNED_INT_2_10_10_10_REV;
             return true;
-        case data::DXGI_FORMAT_BC3_UNORM:
-            out_internalformat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
-            out_format         = GL_RGBA;
-            out_datatype       = GL_UNSIGNED_BYTE;
+        case data::DXGI_FORMAT_R11G11B10_FLOAT:
+            out_internalformat = GL_R11F_G11F_B10F;
+            out_format         = GL_BGR;
+            out_datatype       = GL_FLOAT; // ???
             return true;
-        case data::DXGI_FORMAT_BC3_UNORM_SRGB:
-            out_internalformat = 0x8C4E;
-            out_format         = GL_RGBA;
-            out_datatype       = GL_UNSIGNED_BYTE;
+        case data::DXGI_FORMAT_R8G8B8A8_UNORM:
+            out_internalformat = GL_RGBA8;
+            out_format         = GL_BGRA;
+            out_datatype       = GL_UNSIGNED_INT_8_8_8_8_REV;
+            return true;
+        case data::DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+            out_internalformat = GL_SRGB8_ALPHA8;
+            out_format         = GL_BGRA;
+            out_datatype       = GL_UNSIGNED_INT_8_8_8_8_REV;
+            return true;
+        case data::DXGI_FORMAT_R8G8B8A8_UINT:
+            out_internalformat = GL_RGBA8UI;
+            out_format         = GL_BGRA;
+            out_datatype       = GL_UNSIGNED_INT_8_8_8_8_REV;
+            return true;
+        case data::DXGI_FORMAT_R8G8B8A8_SNORM:
+            out_internalformat = GL_RGBA8_SNORM;
+            out_format         = GL_BGRA;
+            out_datatype       = GL_UNSIGNED_INT_8_8_8_8_REV;
+            return true;
+        case data::DXGI_FORMAT_R8G8B8A8_SINT:
+            out_internalformat = GL_RGBA8I;
+            out_format         = GL_BGRA;
+            out_datatype       = GL_BYTE;
+            return true;
+        case data::DXGI_FORMAT_R16G16_FLOAT:
+            out_internalformat = GL_RG16F;
+            out_format         = GL_RG;
+            out_datatype       = GL_HALF_FLOAT;
+            return true;
+        case data::DXGI_FORMAT_R16G16_UNORM:
+            out_internalformat = GL_RG16;
+            out_format         = GL_RG;
+            out_datatype       = GL_UNSIGNED_SHORT;
+            return true;
+        case data::DXGI_FORMAT_R16G16_UINT:
+            out_internalformat = GL_RG16UI;
+            out_format         = GL_RG;
+            out_datatype       = GL_UNSIGNED_SHORT;
+            return true;
+        case data::DXGI_FORMAT_R16G16_SNORM:
+            out_internalformat = GL_RG16_SNORM;
+            out_format         = GL_RG;
+            out_datatype       = GL_SHORT;
+            return true;
+        case data::DXGI_FORMAT_R16G16_SINT:
+            out_internalformat = GL_RG16I;
+            out_format         = GL_RG;
+            out_datatype       = GL_SHORT;
+            return true;
+        case data::DXGI_FORMAT_D32_FLOAT:
+            out_internalformat = GL_DEPTH_COMPONENT;
+            out_format         = GL_DEPTH_COMPONENT;
+            out_datatype       = GL_FLOAT;
+            return true;
+        case data::DXGI_FORMAT_R32_FLOAT:
+            out_internalformat = GL_R32F;
+            out_format         = GL_RED;
+            out_datatype       = GL_FLOAT;
+            return true;
+        case data::DXGI_FORMAT_R32_UINT:
+            out_internalformat = GL_R32UI;
+            out_format         = GL_RED;
+            out_datatype       = GL_UNSIGNED_INT;
+            return true;
+        case data::DXGI_FORMAT_R32_SINT:
+            out_internalformat = GL_R32I;
+            out_format         = GL_RED;
+            out_datatype       = GL_INT;
+            return true;
+        case data::DXGI_FORMAT_D24_UNORM_S8_UINT:
+            out_internalformat = GL_DEPTH_STENCIL;
+            out_format         = GL_DEPTH_STENCIL;
+            out_datatype       = GL_UNSIGNED_INT;
+            return true;
+        case data::DXGI_FORMAT_R8G8_UNORM:
+            out_internalformat = GL_RG8;
+            out_format         = GL_RG;
+            out_datatype       = GL_UNSIGNED_BYTE;
+            return true;
+        case data::DXGI_FORMAT_R8G8_UINT:
+            out_internalformat = GL_RG8UI;
+            out_format         = GL_RG;
+            out_datatype       = GL_UNSIGNED_BYTE;
+            return true;
+        case data::DXGI_FORMAT_R8G8_SNORM:
+            out_internalformat = GL_RG8_SNORM;
+            out_format         = GL_RG;
+            out_datatype       = GL_BYTE;
+            return true;
+        case data::DXGI_FORMAT_R8G8_SINT:
+            out_internalformat = GL_RG8I;
+            out_format         = GL_RG;
+            out_datatype       = GL_BYTE;
+            return true;
+        case data::DXGI_FORMAT_R16_FLOAT:
+            out_internalformat = GL_R16F;
+            out_format         = GL_RED;
+            out_datatype       = GL_HALF_FLOAT;
+            return true;
+        case data::DXGI_FORMAT_D16_UNORM:
+            out_internalformat = GL_DEPTH_COMPONENT;
+            out_format         = GL_DEPTH_COMPONENT;
+            out_datatype       = GL_UNSIGNED_SHORT;
+            return true;
+        case data::DXGI_FORMAT_R16_UNORM:
+            out_internalformat = GL_R16;
+            out_format         = GL_RED;
+            out_datatype       = GL_UNSIGNED_SHORT;
+            return true;
+        case data::DXGI_FORMAT_R16_UINT:
+            out_internalformat = GL_R16UI;
+            out_format         = GL_RED;
+            out_datatype       = GL_UNSIGNED_SHORT;
+            return true;
+        case data::DXGI_FORMAT_R16_SNORM:
+            out_internalformat = GL_R16_SNORM;
+            out_format         = GL_RED;
+            out_datatype       = GL_SHORT;
+            return true;
+        case data::DXGI_FORMAT_R16_SINT:
+            out_internalformat = GL_R16I;
+            out_format         = GL_RED;
+            out_datatype       = GL_SHORT;
+            return true;
+        case data::DXGI_FORMAT_R8_UNORM:
+            out_internalformat = GL_R8;
+            out_format         = GL_RED;
+            out_datatype       = GL_UNSIGNED_BYTE;
+            return true;
+        case data::DXGI_FORMAT_R8_UINT:
+            out_internalformat = GL_R8UI;
+            out_format         = GL_RED;
+            out_datatype       = GL_UNSIGNED_BYTE;
+            return true;
+        case data::DXGI_FORMAT_R8_SNORM:
+            out_internalformat = GL_R8_SNORM;
+            out_format         = GL_RED;
+            out_datatype       = GL_BYTE;
+            return true;
+        case data::DXGI_FORMAT_R8_SINT:
+            out_internalformat = GL_R8I;
+            out_format         = GL_RED;
+            out_datatype       = GL_BYTE;
+            return true;
+        case data::DXGI_FORMAT_A8_UNORM:
+            out_internalformat = GL_R8;
+            out_format         = GL_RED;
+            out_datatype       = GL_UNSIGNED_BYTE;
+            return true;
+        case data::DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+            out_internalformat = GL_RGB9_E5;
+            out_format         = GL_RGB;
+            out_datatype       = GL_UNSIGNED_INT;
+            return true;
+        case data::DXGI_FORMAT_BC1_UNORM:
+            out_internalformat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+            out_format         = GL_RGBA;
+            out_datatype       = GL_UNSIGNED_BYTE;
+            return true;
+        case data::DXGI_FORMAT_BC1_UNORM_SRGB:
+            out_internalformat = 0x8C4D;
+            out_format         = GL_RGBA;
+            out_datatype       = GL_UNSIGNED_BYTE;
+            return true;
+        case data::DXGI_FORMAT_BC3_UNORM:
+            out_internalformat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+            out_format         = GL_RGBA;
+            out_datatype       = GL_UNSIGNED_BYTE;
+            return true;
+        case data::DXGI_FORMAT_BC3_UNORM_SRGB:
+            out_internalformat = 0x8C4E;
+            out_format         = GL_RGBA;
+            out_datatype       = GL_UNSIGNED_BYTE;
             return true;
         case data::DXGI_FORMAT_BC5_UNORM:
             out_internalformat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
@@ -912,796 +2876,2632 @@ bool r2d::dxgi_format_to_gl(uint32_t dxgi, GLenum &out_internalformat, GLenum &o
             out_format         = GL_BGRA;
             out_datatype       = GL_UNSIGNED_SHORT_4_4_4_4_REV;
             return true;
-        default:
-            break;
+        default:
+            break;
+    }
+    return false;
+}
+
+bool r2d::load_dds(void const *dds_data, size_t dds_size, gl::level_desc_t **out_levels, size_t *out_count, GLuint *out_texId)
+{
+    size_t                    count     =  0;
+    size_t                   nexpect    =  0;
+    size_t                   nitems     =  0;
+    size_t                   nlevels    =  0;
+    data::dds_level_desc_t   *levels    = NULL;
+    data::dds_header_dxt10_t *h_ex      = NULL;
+    data::dds_header_t        header    = {0};
+    data::dds_header_dxt10_t  header_ex = {0};
+    gl::level_desc_t         *gldesc    = NULL;
+
+    if (!data::dds_header(dds_data, dds_size, &header))
+    {   // the DDS file doesn't contain the necessary header.
+        if (out_levels) *out_levels = NULL;
+        if (out_count ) *out_count  = 0;
+        if (out_texId ) *out_texId  = 0;
+        return false;
+    }
+    if (data::dds_header_dxt10(dds_data, dds_size, &header_ex))
+    {   // the DDS DX10 header is optional.
+        h_ex = &header_ex;
+    }
+    nitems   = data::dds_array_count(&header, h_ex);
+    nlevels  = data::dds_level_count(&header, h_ex);
+    nexpect  = nitems * nlevels;
+    if (nitems == 0  && nlevels == 0)
+    {   // the DDS file must contain at least one surface.
+        if (out_levels) *out_levels = NULL;
+        if (out_count ) *out_count  = 0;
+        if (out_texId ) *out_texId  = 0;
+        return false;
+    }
+
+    // allocate memory for the level descriptions returned to the user.
+    gldesc = (gl::level_desc_t*) malloc(nexpect * sizeof(gl::level_desc_t));
+    if (gldesc == NULL)
+    {   // unable to allocate the required memory.
+        if (out_levels) *out_levels = NULL;
+        if (out_count ) *out_count  = 0;
+        if (out_texId ) *out_texId  = 0;
+        return false;
+    }
+
+    // parse the remainder of the DDS file and describe the surfaces it contains.
+    levels = (data::dds_level_desc_t*) malloc(nexpect * sizeof(data::dds_level_desc_t));
+    count  =  data::dds_describe(dds_data, dds_size, &header, h_ex, levels, nexpect);
+    if (count != nexpect)
+    {   // unable to parse all of the level descriptions.
+        if (levels != NULL) free(levels);
+        if (gldesc != NULL) free(gldesc);
+        if (out_levels) *out_levels = NULL;
+        if (out_count ) *out_count  = 0;
+        if (out_texId ) *out_texId  = 0;
+        return false;
+    }
+
+    // figure out the GL format from the DXGI format.
+    size_t width    = levels[0].Width;
+    size_t height   = levels[0].Height;
+    GLenum target   = GL_NONE;
+    GLenum format   = GL_NONE;
+    GLenum layout   = GL_NONE;
+    GLenum dataType = GL_NONE;
+    GLenum magFilter= GL_LINEAR;
+    GLenum minFilter= nlevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+    if (!r2d::dxgi_format_to_gl(levels[0].Format, format, layout, dataType))
+    {   // the DDS data is stored in an unsupported format.
+        if (levels != NULL) free(levels);
+        if (gldesc != NULL) free(gldesc);
+        if (out_levels) *out_levels = NULL;
+        if (out_count ) *out_count  = 0;
+        if (out_texId ) *out_texId  = 0;
+        return false;
+    }
+
+    // create the target texture object name and allocate GPU storage.
+    GLuint texId = 0;
+    glGenTextures (1, &texId);
+    if (texId  ==  0)
+    {   // unable to create the OpenGL texture object.
+        if (levels != NULL) free(levels);
+        if (gldesc != NULL) free(gldesc);
+        if (out_levels) *out_levels = NULL;
+        if (out_count ) *out_count  = 0;
+        if (out_texId ) *out_texId  = 0;
+        return false;
+    }
+
+    // figure out the 'default' texture target type. the target used by
+    // the application might be different, but we need something to upload.
+    target = dds_default_target(&header, h_ex, width, height);
+
+    // allocate GPU storage for all elements/slices and levels of the texture.
+    GLenum error = glGetError(); // clear the current error value, if any.
+    gl::state_bind_texture(0, target, texId);
+    gl::texture_storage(target, format, dataType, minFilter, magFilter, width , height, nitems, nlevels);
+    error = glGetError();
+    if (error != GL_NO_ERROR)
+    {   // unable to allocate the necessary GPU resources.
+        gl::state_delete_textures(1, &texId);
+        if (levels != NULL) free(levels);
+        if (gldesc != NULL) free(gldesc);
+        if (out_levels) *out_levels = NULL;
+        if (out_count ) *out_count  = 0;
+        if (out_texId ) *out_texId  = 0;
+        return false;
+    }
+
+    for (size_t dds_level  = 0;  dds_level < count; ++dds_level)
+    {
+        data::dds_level_desc_t  &ddsd = levels[dds_level];
+        gl::level_desc_t        &glsd = gldesc[dds_level];
+        gl::pixel_transfer_h2d_t xfer;
+
+        // upload data to the GPU. since PBO's are not being used, this is
+        // synchronous on the CPU; the data is memcpy'd to driver memory and
+        // then transferred to the GPU.
+        xfer.Target            = target;
+        xfer.Format            = gl::bytes_per_block(format) > 0 ? format : layout;
+        xfer.DataType          = dataType;
+        xfer.UnpackBuffer      = 0;
+        xfer.TargetIndex       = ddsd.Index;          // target mipmap level.
+        xfer.TargetX           = 0;
+        xfer.TargetY           = 0;
+        xfer.TargetZ           = dds_level / nlevels; // target array slice.
+        xfer.SourceX           = 0;
+        xfer.SourceY           = 0;
+        xfer.SourceZ           = 0;
+        xfer.SourceWidth       = ddsd.Width;
+        xfer.SourceHeight      = ddsd.Height;
+        xfer.TransferWidth     = ddsd.Width;
+        xfer.TransferHeight    = ddsd.Height;
+        xfer.TransferSlices    = ddsd.Slices;
+        xfer.TransferSize      = ddsd.DataSize;
+        xfer.TransferBuffer    = ddsd.LevelData;
+        gl::transfer_pixels_h2d(&xfer);
+
+        // convert the level description to the GL format.
+        glsd.Index             = ddsd.Index;
+        glsd.Width             = ddsd.Width;
+        glsd.Height            = ddsd.Height;
+        glsd.Slices            = ddsd.Slices;
+        glsd.BytesPerElement   = ddsd.BytesPerElement;
+        glsd.BytesPerRow       = ddsd.BytesPerRow;
+        glsd.BytesPerSlice     = ddsd.BytesPerSlice;
+        glsd.Layout            = layout;
+        glsd.Format            = format;
+        glsd.DataType          = dataType;
+    }
+
+    // cleanup and set output parameters; we're done.
+    if (out_levels) *out_levels = gldesc;
+    if (out_count ) *out_count  = count;
+    if (out_texId ) *out_texId  = texId;
+    free(levels);
+    return true;
+}
+
+bool r2d::create_dds_load(r2d::dds_load_t *load, char const *path)
+{
+    memset(load, 0, sizeof(r2d::dds_load_t));
+    if (!data::map_file(path, &load->File))
+    {
+        load->State = r2d::DDS_LOAD_STATE_FAILED;
+        return false;
+    }
+    if (!dds_load_parse(load, load->File.Data, load->File.Size))
+        return false;
+
+    // bring the file into memory here, rather than on the GL thread.
+    prefault_pages(load->File.Data, load->File.Size);
+    return true;
+}
+
+bool r2d::create_dds_load(r2d::dds_load_t *load, void const *dds_data, size_t dds_size)
+{
+    memset(load, 0, sizeof(r2d::dds_load_t));
+    return dds_load_parse(load, dds_data, dds_size);
+}
+
+size_t r2d::dds_load_update(r2d::dds_load_t *load, gl::pixel_stream_h2d_t *stream, size_t byte_budget, gl::upload_scheduler_t *sched, bool visible)
+{
+    if (load->State == r2d::DDS_LOAD_STATE_PREPARED)
+    {   // create the texture object and allocate storage for all levels.
+        data::dds_level_desc_t const &base = load->Levels[0];
+        GLenum minf  = load->MipCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+        GLenum error = glGetError(); // clear the current error value, if any.
+        glGenTextures(1, &load->Texture);
+        if (load->Texture == 0)
+        {
+            dds_load_reset(load);
+            load->State = r2d::DDS_LOAD_STATE_FAILED;
+            return 0;
+        }
+        gl::state_bind_texture(0, load->Target, load->Texture);
+        gl::texture_storage(load->Target, load->Format, load->DataType, minf, GL_LINEAR, base.Width, base.Height, load->Target == GL_TEXTURE_3D ? base.Slices : load->ItemCount, load->MipCount);
+        gl::state_bind_texture(0, load->Target, 0);
+        if ((error = glGetError()) != GL_NO_ERROR)
+        {   // unable to allocate the necessary GPU resources.
+            gl::state_delete_textures(1, &load->Texture);
+            dds_load_reset(load);
+            load->State = r2d::DDS_LOAD_STATE_FAILED;
+            return 0;
+        }
+        load->State = r2d::DDS_LOAD_STATE_UPLOADING;
+    }
+    if (load->State != r2d::DDS_LOAD_STATE_UPLOADING)
+        return 0;
+
+    bool const compressed = gl::bytes_per_block(load->Format) > 0;
+    size_t     uploaded   = 0;
+    GLint      align      = 4;
+
+    gl::gpu_scope_begin("dds_load_update");
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &align);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    gl::state_bind_texture(0, load->Target, load->Texture);
+    while (load->NextLevel < load->LevelCount && (sched != NULL || uploaded == 0 || uploaded < byte_budget))
+    {
+        data::dds_level_desc_t const &ddsd = load->Levels[load->NextLevel];
+        size_t const item  = load->NextLevel / load->MipCount;
+        size_t const rows  = ddsd.BytesPerSlice / ddsd.BytesPerRow;   // rows of pixels or blocks.
+        size_t const rowh  = compressed ? 4 : 1;                      // pixels per row.
+        size_t const avail = sched != NULL ? byte_budget : (byte_budget > uploaded ? byte_budget - uploaded : 0);
+        size_t       band  = avail / ddsd.BytesPerRow;
+        void        *dst   = NULL;
+
+        // upload as many rows as fit in the budget and the stream, but
+        // always upload at least one row per call. with a scheduler, the
+        // budget limits the size of each queued band instead.
+        if (band == 0 && uploaded > 0 && sched == NULL) break;
+        if (band == 0) band = 1;
+        if (band > rows - load->NextRow) band = rows - load->NextRow;
+        if (sched == NULL && band * ddsd.BytesPerRow > stream->BufferSize) band = stream->BufferSize / ddsd.BytesPerRow;
+        if (band == 0)
+        {   // a single row does not fit in the stream buffer.
+            load->State = r2d::DDS_LOAD_STATE_FAILED;
+            break;
+        }
+
+        size_t   const bytes = band * ddsd.BytesPerRow;
+        uint8_t const *src   = (uint8_t const*) ddsd.LevelData + load->NextSlice * ddsd.BytesPerSlice + load->NextRow * ddsd.BytesPerRow;
+        if (sched == NULL)
+        {
+            if ((dst = gl::pixel_stream_h2d_reserve(stream, bytes)) == NULL)
+            {   // the stream is full; try again on the next update.
+                break;
+            }
+            memcpy(dst, src, bytes);
+        }
+
+        size_t const y = load->NextRow * rowh;
+        size_t const h = (y + band * rowh) < ddsd.Height ? band * rowh : ddsd.Height - y;
+        gl::pixel_transfer_h2d_t x;
+        x.Target          = load->Target == GL_TEXTURE_CUBE_MAP ? GLenum(GL_TEXTURE_CUBE_MAP_POSITIVE_X + item) : load->Target;
+        x.Format          = compressed ? load->Format : load->Layout;
+        x.DataType        = load->DataType;
+        x.TargetIndex     = ddsd.Index;
+        x.TargetX         = 0;
+        x.TargetY         = load->Target == GL_TEXTURE_1D_ARRAY ? item : y;
+        x.TargetZ         = load->Target == GL_TEXTURE_3D ? load->NextSlice : item;
+        x.SourceX         = 0;
+        x.SourceY         = 0;
+        x.SourceZ         = 0;
+        x.SourceWidth     = ddsd.Width;
+        x.SourceHeight    = h;
+        x.TransferWidth   = ddsd.Width;
+        x.TransferHeight  = load->Target == GL_TEXTURE_1D_ARRAY ? 1 : h;
+        x.TransferSlices  = 1;
+        if (sched != NULL)
+        {   // source the DDS data directly; it stays valid until the load is ready.
+            x.UnpackBuffer    = 0;
+            x.TransferSize    = bytes;
+            x.TransferBuffer  = (void*) src;
+            if (!gl::upload_scheduler_submit(sched, load->Texture, &x, gl::upload_priority(visible, ddsd.Index), uintptr_t(load)))
+            {
+                load->State = r2d::DDS_LOAD_STATE_FAILED;
+                break;
+            }
+            load->Scheduler = sched;
+        }
+        else
+        {
+            if (!gl::pixel_stream_h2d_commit(stream, dst, &x))
+            {
+                load->State = r2d::DDS_LOAD_STATE_FAILED;
+                break;
+            }
+            x.TransferSize    = bytes; // the region size may include alignment padding.
+            gl::transfer_pixels_h2d(&x);
+        }
+        uploaded            += bytes;
+        load->BytesUploaded += bytes;
+
+        // advance to the next band, slice or level.
+        if ((load->NextRow += band) == rows)
+        {
+            load->NextRow = 0;
+            if (++load->NextSlice == ddsd.Slices)
+            {
+                load->NextSlice = 0;
+                load->NextLevel++;
+            }
+        }
+    }
+    if (uploaded > 0 && sched == NULL)
+    {   // the regions are recycled once the GPU has consumed them.
+        gl::pixel_stream_h2d_fence(stream);
+    }
+    gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    gl::state_bind_texture(0, load->Target, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, align);
+    gl::gpu_scope_end();
+
+    if (load->State == r2d::DDS_LOAD_STATE_UPLOADING && load->NextLevel == load->LevelCount &&
+       (load->Scheduler == NULL || gl::upload_scheduler_pending(load->Scheduler, uintptr_t(load)) == 0))
+    {   // all data has been uploaded; the source data is no longer needed.
+        free(load->Levels);
+        load->Levels    = NULL;
+        load->Scheduler = NULL;
+        data::unmap_file(&load->File);
+        load->State     = r2d::DDS_LOAD_STATE_READY;
+    }
+    return uploaded;
+}
+
+bool r2d::dds_load_result(r2d::dds_load_t *load, gl::level_desc_t **out_levels, size_t *out_count, GLuint *out_texId)
+{
+    if (load->State != r2d::DDS_LOAD_STATE_READY)
+    {
+        if (out_levels) *out_levels = NULL;
+        if (out_count ) *out_count  = 0;
+        if (out_texId ) *out_texId  = 0;
+        return false;
+    }
+    if (out_levels) *out_levels = load->GLLevels;
+    else free(load->GLLevels);
+    if (out_count ) *out_count  = load->LevelCount;
+    if (out_texId ) *out_texId  = load->Texture;
+    else gl::state_delete_textures(1, &load->Texture);
+    load->GLLevels = NULL;
+    load->Texture  = 0;
+    dds_load_reset(load);
+    return true;
+}
+
+void r2d::delete_dds_load(r2d::dds_load_t *load)
+{
+    if (load->Texture != 0)
+    {   // the texture was never handed to the application.
+        gl::state_delete_textures(1, &load->Texture);
+    }
+    dds_load_reset(load);
+}
+
+
+bool r2d::create_packer(r2d::packer_t *packer, size_t width, size_t height, size_t capacity)
+{
+    return r2d::create_packer(packer, r2d::PACKER_TYPE_GUILLOTINE, width, height, capacity);
+}
+
+bool r2d::create_packer(r2d::packer_t *packer, uint32_t type, size_t width, size_t height, size_t capacity)
+{
+    if (packer != NULL && type < r2d::PACKER_TYPE_COUNT)
+    {
+        if (capacity == 0) capacity = 1;
+        packer->Type         = type;
+        packer->Width        = width;
+        packer->Height       = height;
+        packer->Free         = width * height;
+        packer->Used         = 0;
+        packer->Capacity     = capacity;
+        packer->Count        = 0;
+        packer->Buckets      = NULL;
+        packer->Rects        = NULL;
+        packer->FreeCapacity = 0;
+        packer->FreeCount    = 0;
+        packer->FreeList     = NULL;
+        packer->Skyline      = NULL;
+
+        packer->Rects = (r2d::pkrect_t*) malloc(capacity * sizeof(r2d::pkrect_t));
+        if (packer->Rects == NULL) goto error_cleanup;
+        if (type == r2d::PACKER_TYPE_GUILLOTINE)
+        {   // the guillotine packer indexes free rectangles by size class.
+            packer->Buckets = (r2d::pkbucket_t*) malloc(PACKER_BUCKET_COUNT * sizeof(r2d::pkbucket_t));
+            if (packer->Buckets == NULL) goto error_cleanup;
+            for (size_t i = 0; i < PACKER_BUCKET_COUNT; ++i)
+            {
+                packer->Buckets[i].Capacity = 0;
+                packer->Buckets[i].Count    = 0;
+                packer->Buckets[i].Rects    = NULL;
+            }
+        }
+        else if (!packer_reserve_free(packer, 64))
+        {   // MaxRects and skyline packers use a flat list.
+            goto error_cleanup;
+        }
+        packer_reset_free(packer);
+        if (packer->FreeCount == 0) goto error_cleanup;
+        return true;
+
+error_cleanup:
+        r2d::delete_packer(packer);
+        return false;
+    }
+    else return false;
+}
+
+void r2d::delete_packer(r2d::packer_t *packer)
+{
+    if (packer != NULL)
+    {
+        if (packer->Buckets != NULL)
+        {
+            for (size_t i = 0; i < PACKER_BUCKET_COUNT; ++i)
+            {
+                if (packer->Buckets[i].Rects != NULL)
+                    free(packer->Buckets[i].Rects);
+            }
+            free(packer->Buckets);
+        }
+        if (packer->Skyline  != NULL) free(packer->Skyline);
+        if (packer->FreeList != NULL) free(packer->FreeList);
+        if (packer->Rects    != NULL) free(packer->Rects);
+        packer->Width        = 0;
+        packer->Height       = 0;
+        packer->Free         = 0;
+        packer->Used         = 0;
+        packer->Capacity     = 0;
+        packer->Count        = 0;
+        packer->Buckets      = NULL;
+        packer->Rects        = NULL;
+        packer->FreeCapacity = 0;
+        packer->FreeCount    = 0;
+        packer->FreeList     = NULL;
+        packer->Skyline      = NULL;
+    }
+}
+
+void r2d::reset_packer(r2d::packer_t *packer)
+{
+    packer->Count = 0;
+    packer->Free  = packer->Width * packer->Height;
+    packer->Used  = 0;
+    packer_reset_free(packer);
+}
+
+bool r2d::packer_insert(r2d::packer_t *packer, size_t width, size_t height, size_t hpad, size_t vpad, uint32_t id, r2d::pkrect_t *rect)
+{
+    size_t w = width  + (hpad * 2);
+    size_t h = height + (vpad * 2);
+    size_t a = w * h;
+
+    // if there isn't enough space available, don't
+    // bother searching for a place to put this rectangle.
+    if (a > packer->Free)
+        return false;
+    if (w > packer->Width || h > packer->Height)
+        return false;
+    if (!packer_reserve_rect(packer))
+        return false;
+
+    uint32_t const uw = uint32_t(w);
+    uint32_t const uh = uint32_t(h);
+    uint32_t       x  = 0;
+    uint32_t       y  = 0;
+    size_t         i  = 0;
+    size_t         b  = 0;
+    switch (packer->Type)
+    {
+        case r2d::PACKER_TYPE_GUILLOTINE:
+            {
+                if (!guillotine_find (packer, uw, uh, b, i))       return false;
+                if (!guillotine_place(packer, b, i, uw, uh, x, y)) return false;
+            }
+            break;
+        case r2d::PACKER_TYPE_SKYLINE_BL:
+            {
+                if (!skyline_find(packer, uw, uh, i, y)) return false;
+                x = packer->Skyline[i].X;
+                r2d::pkfree_t u = { x, y, uw, uh };
+                if (!skyline_place(packer, i, u)) return false;
+            }
+            break;
+        default:
+            {
+                if (!maxrects_find(packer, uw, uh, x, y)) return false;
+                r2d::pkfree_t u = { x, y, uw, uh };
+                if (!maxrects_place(packer, u)) return false;
+            }
+            break;
+    }
+
+    r2d::pkrect_t r;
+    r.X        = x + hpad;
+    r.Y        = y + vpad;
+    r.Width    = width;
+    r.Height   = height;
+    r.Content  = id;
+    r.Flags    = r2d::PACKER_FLAGS_USED;
+    r.PadX     = uint32_t(hpad);
+    r.PadY     = uint32_t(vpad);
+    if (rect) *rect = r;
+
+    packer->Rects[packer->Count++] = r;
+    packer->Free -= a;
+    packer->Used += a;
+    return true;
+}
+
+bool r2d::packer_remove(r2d::packer_t *packer, uint32_t id)
+{
+    if (packer->Type == r2d::PACKER_TYPE_SKYLINE_BL)
+        return false;
+
+    for (size_t i = 0, n = packer->Count; i < n; ++i)
+    {
+        r2d::pkrect_t const &r = packer->Rects[i];
+        if (r.Content != id)
+            continue;
+
+        r2d::pkfree_t f = {
+            uint32_t(r.X - r.PadX),
+            uint32_t(r.Y - r.PadY),
+            uint32_t(r.Width  + r.PadX * 2),
+            uint32_t(r.Height + r.PadY * 2)
+        };
+        if (packer->Type == r2d::PACKER_TYPE_GUILLOTINE)
+        {
+            if (!guillotine_release(packer, f))
+                return false;
+        }
+        else
+        {
+            if (!packer_reserve_free(packer, packer->FreeCount + 1))
+                return false;
+            packer->FreeList[packer->FreeCount++] = f;
+            maxrects_prune(packer);
+        }
+        size_t const a = size_t(f.Width) * size_t(f.Height);
+        packer->Free  += a;
+        packer->Used  -= a;
+        packer->Rects[i] = packer->Rects[--packer->Count];
+        return true;
+    }
+    return false;
+}
+
+bool r2d::create_atlas_entry(r2d::atlas_entry_t *ent, uint32_t name, size_t frame_count)
+{
+    if (ent != NULL)
+    {
+        if (frame_count == 0) frame_count = 1;
+        ent->Name        = name;
+        ent->Flags       = r2d::ATLAS_ENTRY_NORMAL;
+        ent->LastUsed    = 0;
+        ent->FrameCount  = frame_count;
+        ent->MaxWidth    = 0;
+        ent->MaxHeight   = 0;
+        ent->Page0       = 0;
+        ent->Frame0      = {
+            0, 0, 0, 0
+        };
+        if (frame_count == 1)
+        {   // this is the typical case - only one frame.
+            // don't allocate additional storage, use the pre-allocated stuff.
+            ent->PageIds = &ent->Page0;
+            ent->Frames  = &ent->Frame0;
+        }
+        else
+        {   // multi-frame entries allocate separate array storage.
+            ent->Flags  |= r2d::ATLAS_ENTRY_MULTIFRAME;
+            ent->PageIds = (size_t*)            malloc(frame_count * sizeof(size_t));
+            ent->Frames  = (r2d::atlas_frame_t*)malloc(frame_count * sizeof(r2d::atlas_frame_t));
+            if (ent->PageIds != NULL) memset(ent->PageIds, 0, frame_count * sizeof(size_t));
+            if (ent->Frames  != NULL) memset(ent->Frames , 0, frame_count * sizeof(r2d::atlas_frame_t));
+        }
+        return true;
+    }
+    else return false;
+}
+
+void r2d::delete_atlas_entry(r2d::atlas_entry_t *ent)
+{
+    if (ent != NULL)
+    {
+        if (ent->Flags & r2d::ATLAS_ENTRY_MULTIFRAME)
+        {
+            if (ent->Frames  != NULL) free(ent->Frames);
+            if (ent->PageIds != NULL) free(ent->PageIds);
+        }
+        ent->FrameCount = 0;
+        ent->PageIds    = NULL;
+        ent->Frames     = NULL;
+    }
+}
+
+void r2d::set_atlas_entry_frame(r2d::atlas_entry_t *ent, size_t frame_index, size_t page_id, r2d::atlas_frame_t const &frame)
+{
+    assert(frame_index < ent->FrameCount);
+
+    if (frame.Width  > ent->MaxWidth)
+        ent->MaxWidth  = frame.Width;
+
+    if (frame.Height > ent->MaxHeight)
+        ent->MaxHeight = frame.Height;
+
+    if (frame_index > 0 && ent->PageIds[frame_index] != page_id)
+        ent->Flags    |= r2d::ATLAS_ENTRY_MULTIPAGE;
+
+    ent->PageIds[frame_index] = page_id;
+    ent->Frames [frame_index] = frame;
+}
+
+bool r2d::create_atlas(r2d::atlas_t *atlas, r2d::atlas_config_t const &config)
+{
+    if (atlas != NULL)
+    {
+        GLint   nalign         = 4;
+        GLsizei nbytes         = 0;
+        atlas->PageWidth       = config.PageWidth;
+        atlas->PageHeight      = config.PageHeight;
+        atlas->HorizontalPad   = config.HorizontalPad;
+        atlas->VerticalPad     = config.VerticalPad;
+        atlas->EntryCapacity   = 0;
+        atlas->EntryCount      = 0;
+        atlas->EntryList       = NULL;
+        atlas->PageCapacity    = 0;
+        atlas->PageCount       = 0;
+        atlas->PagePackers     = NULL;
+        atlas->TexturePages    = NULL;
+        atlas->PageTarget      = config.PageTarget == GL_TEXTURE_2D_ARRAY ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+        atlas->PackerType      = config.PackerType < r2d::PACKER_TYPE_COUNT ? config.PackerType : uint32_t(r2d::PACKER_TYPE_GUILLOTINE);
+        atlas->TextureArray    = 0;
+        atlas->ArrayLayers     = 0;
+        atlas->FreeEntry       = ATLAS_NO_ENTRY;
+        atlas->FrameStamp      = 0;
+        atlas->MaxPages        = config.MaxPages;
+        atlas->PageLayout      = config.Layout;
+        atlas->PageFormat      = config.Format;
+        atlas->PageDataType    = config.DataType;
+        atlas->TransferBuffer  = 0;
+        atlas->TransferBytes   = 0;
+        atlas->BufferOffset    = 0;
+        atlas->Defrag.Active   = false;
+        atlas->Defrag.Blocked  = false;
+        atlas->Staging.List    = NULL;
+        atlas->Staging.Scheduler = NULL;
+        atlas_defrag_abort(atlas);
+        atlas_staging_reset(atlas, true);
+        if (atlas->MaxPages > 0 && atlas->PackerType == r2d::PACKER_TYPE_SKYLINE_BL)
+        {   // dynamic atlases must be able to release space.
+            atlas->PackerType  = r2d::PACKER_TYPE_GUILLOTINE;
+        }
+
+        // pre-allocate storage for the entry lookup-by-name table.
+        if (!hash::create_table(&atlas->EntryTable, config.ExpectedCount))
+            goto error_cleanup;
+
+        // pre-allocate storage for the entry list.
+        if (config.ExpectedCount > 0)
+        {
+            atlas->EntryCapacity = config.ExpectedCount;
+            atlas->EntryCount    = 0;
+            atlas->EntryList     = (r2d::atlas_entry_t*) malloc(config.ExpectedCount * sizeof(r2d::atlas_entry_t));
+            if (atlas->EntryList == NULL) goto error_cleanup;
+        }
+
+        // pre-allocate storage for texture page packers and page texture IDs.
+        atlas->PagePackers  = (r2d::packer_t*) malloc(ATLAS_PAGE_CAPACITY * sizeof(r2d::packer_t));
+        if (atlas->PagePackers == NULL)  goto error_cleanup;
+        atlas->TexturePages = (GLuint*)  malloc(ATLAS_PAGE_CAPACITY * sizeof(GLuint));
+        if (atlas->TexturePages == NULL) goto error_cleanup;
+        atlas->PageCapacity = ATLAS_PAGE_CAPACITY;
+        atlas->PageCount    = 0;
+
+        // generate the PBO used to stream data to the GPU.
+        glGenBuffers(1, &atlas->TransferBuffer);
+        if (atlas->TransferBuffer == 0) goto error_cleanup;
+        gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, atlas->TransferBuffer);
+        glGetIntegerv(GL_UNPACK_ALIGNMENT , &nalign);
+        nbytes = gl::bytes_per_slice(config.Format, config.DataType, config.PageWidth, config.PageHeight, size_t(nalign));
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, nbytes, NULL, GL_STREAM_DRAW);
+        gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        atlas->TransferBytes = size_t(nbytes);
+        atlas->BufferOffset  = 0;
+        return true;
+
+error_cleanup:
+        if (atlas->TransferBuffer != 0)
+        {
+            gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            gl::state_delete_buffers(1, &atlas->TransferBuffer);
+        }
+        if (atlas->TexturePages != NULL)  free(atlas->TexturePages);
+        if (atlas->PagePackers != NULL)   free(atlas->PagePackers);
+        if (atlas->EntryList != NULL)     free(atlas->EntryList);
+        hash::delete_table(&atlas->EntryTable);
+        atlas->EntryCapacity  = 0;
+        atlas->EntryCount     = 0;
+        atlas->EntryList      = NULL;
+        atlas->PageCapacity   = 0;
+        atlas->PageCount      = 0;
+        atlas->PagePackers    = NULL;
+        atlas->TexturePages   = NULL;
+        atlas->TextureArray   = 0;
+        atlas->ArrayLayers    = 0;
+        atlas->TransferBuffer = 0;
+        atlas->TransferBytes  = 0;
+        atlas->BufferOffset   = 0;
+        return false;
+    }
+    else return false;
+}
+
+void r2d::delete_atlas(r2d::atlas_t *atlas)
+{
+    if (atlas != NULL)
+    {
+        atlas_defrag_abort(atlas);
+        if (atlas->Staging.Scheduler != NULL)
+        {   // discard any queued uploads; the pages are about to be deleted.
+            gl::upload_scheduler_cancel(atlas->Staging.Scheduler, uintptr_t(atlas));
+            atlas->Staging.Scheduler = NULL;
+        }
+        if (atlas->Staging.Mapped != NULL)
+        {   // discard any staged frames.
+            gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, atlas->TransferBuffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        atlas_staging_reset(atlas, true);
+        if (atlas->TransferBuffer != 0)
+        {   // if the buffer is in use, it will be
+            // deleted when the GPU is finished with it.
+            gl::state_delete_buffers(1, &atlas->TransferBuffer);
+        }
+        if (atlas->TextureArray != 0)
+        {   // all pages share the one texture array; delete it once.
+            gl::state_delete_textures(1, &atlas->TextureArray);
+        }
+        if (atlas->TexturePages != NULL)
+        {
+            if (atlas->PageCount > 0 && atlas->PageTarget != GL_TEXTURE_2D_ARRAY)
+            {   // any textures in use will be deleted when the GPU is done with them.
+                gl::state_delete_textures(GLsizei(atlas->PageCount), atlas->TexturePages);
+            }
+            free(atlas->TexturePages);
+        }
+        if (atlas->PagePackers != NULL)
+        {
+            for (size_t i = 0; i < atlas->PageCount; ++i)
+            {
+                r2d::delete_packer(&atlas->PagePackers[i]);
+            }
+            free(atlas->PagePackers);
+        }
+        if (atlas->EntryList != NULL)
+        {
+            free(atlas->EntryList);
+        }
+        hash::delete_table(&atlas->EntryTable);
+        atlas->EntryCapacity     = 0;
+        atlas->EntryCount        = 0;
+        atlas->EntryList         = NULL;
+        atlas->PageCapacity      = 0;
+        atlas->PageCount         = 0;
+        atlas->PagePackers       = NULL;
+        atlas->TexturePages      = NULL;
+        atlas->TextureArray      = 0;
+        atlas->ArrayLayers       = 0;
+        atlas->TransferBuffer    = 0;
+        atlas->TransferBytes     = 0;
+        atlas->BufferOffset      = 0;
+    }
+}
+
+void r2d::freeze_atlas(r2d::atlas_t *atlas)
+{
+    atlas_defrag_abort(atlas);
+    atlas_staging_flush(atlas, NULL, 0);
+    atlas_staging_sync(atlas);
+    atlas_staging_reset(atlas, true);
+    if (atlas->TransferBuffer != 0)
+    {
+        gl::state_delete_buffers(1, &atlas->TransferBuffer);
+        atlas->TransferBuffer  = 0;
+        atlas->TransferBytes   = 0;
+        atlas->BufferOffset    = 0;
+    }
+    if (atlas->PagePackers != NULL)
+    {
+        for (size_t i = 0; i < atlas->PageCount; ++i)
+        {
+            r2d::delete_packer(&atlas->PagePackers[i]);
+        }
+        free(atlas->PagePackers);
+        atlas->PagePackers = NULL;
+    }
+}
+
+r2d::atlas_entry_t* r2d::find_atlas_entry(r2d::atlas_t *atlas, uint32_t name)
+{
+    uint32_t index = 0;
+    if (hash::table_get(&atlas->EntryTable, name, &index))
+    {
+        atlas->EntryList[index].LastUsed = atlas->FrameStamp;
+        return &atlas->EntryList[index];
+    }
+    else return NULL;
+}
+
+void r2d::atlas_begin_frame(r2d::atlas_t *atlas)
+{
+    atlas->FrameStamp++;
+}
+
+void r2d::atlas_touch_entry(r2d::atlas_t *atlas, r2d::atlas_entry_t *entry)
+{
+    entry->LastUsed = atlas->FrameStamp;
+}
+
+bool r2d::atlas_remove_entry(r2d::atlas_t *atlas, uint32_t name)
+{
+    uint32_t index = 0;
+    if (hash::table_get(&atlas->EntryTable, name, &index))
+    {
+        atlas_release_entry(atlas, index);
+        return true;
+    }
+    return false;
+}
+
+size_t r2d::atlas_defragment(r2d::atlas_t *atlas, size_t byte_budget)
+{
+    if (atlas->PagePackers == NULL || gl::bytes_per_block(atlas->PageFormat) > 0)
+    {   // frozen atlases and block-compressed pages are not defragmented.
+        return 0;
+    }
+    if (!gl::extension_supported("GL_ARB_copy_image"))
+    {   // sub-images can only be moved with glCopyImageSubData.
+        return 0;
+    }
+    if (atlas->Staging.Mapped != NULL)
+    {   // staged frames must land before sub-images are moved.
+        atlas_staging_flush(atlas, NULL, 0);
+    }
+    atlas_staging_sync(atlas);
+    if (!atlas->Defrag.Active && !atlas_defrag_begin(atlas))
+    {   // no page is fragmented enough to be worth repacking.
+        return 0;
+    }
+
+    r2d::atlas_defrag_t *d      = &atlas->Defrag;
+    r2d::packer_t const *src    = &atlas->PagePackers[d->Page];
+    GLenum        const  target =  atlas->PageTarget;
+    GLuint        const  stex   =  atlas->TexturePages[d->Page];
+    GLint         const  sz     =  target == GL_TEXTURE_2D_ARRAY ? GLint(d->Page)         : 0;
+    GLint         const  dz     =  target == GL_TEXTURE_2D_ARRAY ? GLint(d->ScratchLayer) : 0;
+    size_t               copied =  0;
+
+    gl::gpu_scope_begin("atlas_defragment");
+    while (d->Next < d->Count && (copied == 0 || copied < byte_budget))
+    {
+        r2d::pkrect_t const &s = src->Rects[d->Order[d->Next]];
+        r2d::pkrect_t const &r = d->Packer.Rects[d->Next];
+        if (d->EntryIndex[d->Next] == ATLAS_NO_ENTRY)
+        {   // the entry was removed; its sub-image is not copied.
+            d->Next++;
+            continue;
+        }
+        glCopyImageSubData(
+            stex      , target, 0, GLint(s.X), GLint(s.Y), sz,
+            d->Scratch, target, 0, GLint(r.X), GLint(r.Y), dz,
+            GLsizei(s.Width), GLsizei(s.Height), 1);
+        copied += size_t(gl::bytes_per_slice(atlas->PageFormat, atlas->PageDataType, s.Width, s.Height, 1));
+        d->Next++;
+    }
+    if (d->Next == d->Count)
+    {   // all sub-images have been copied; swap in the repacked page.
+        atlas_defrag_finish(atlas);
+    }
+    gl::gpu_scope_end();
+    return copied;
+}
+
+r2d::atlas_entry_t* r2d::get_atlas_entry(r2d::atlas_t *atlas, size_t index)
+{
+    return &atlas->EntryList[index];
+}
+
+r2d::atlas_entry_t* r2d::atlas_create_entry(r2d::atlas_t *atlas, uint32_t name, size_t frame_count, size_t *out_index)
+{
+    if (atlas->EntryCount == atlas->EntryCapacity && atlas->FreeEntry == ATLAS_NO_ENTRY)
+    {   // grow storage for the entry definitions.
+        size_t newc = atlas->EntryCapacity > 4096 ? atlas->EntryCapacity + 512 : atlas->EntryCapacity * 2;
+        if (newc == 0) newc = ATLAS_DEFAULT_CAPACITY;
+        void  *newl = realloc(atlas->EntryList, newc * sizeof(r2d::atlas_entry_t));
+        if (newl != NULL)
+        {
+            atlas->EntryCapacity = newc;
+            atlas->EntryList     = (r2d::atlas_entry_t*) newl;
+        }
+        else return NULL;
+        for (size_t i = 0; i < atlas->EntryCount; ++i)
+        {   // single-frame entries point at their own storage, which just moved.
+            r2d::atlas_entry_t *e = &atlas->EntryList[i];
+            if ((e->Flags & r2d::ATLAS_ENTRY_MULTIFRAME) == 0)
+            {
+                e->PageIds = &e->Page0;
+                e->Frames  = &e->Frame0;
+            }
+        }
+    }
+
+    // reuse the slot of a removed entry, if one is available.
+    size_t const entry_id  = atlas->FreeEntry != ATLAS_NO_ENTRY ? atlas->FreeEntry : atlas->EntryCount;
+    if (!hash::table_reserve(&atlas->EntryTable, atlas->EntryTable.Count + 1))
+    {   // failed to grow storage for the entry name lookup table.
+        return NULL;
+    }
+
+    r2d::atlas_entry_t *e = &atlas->EntryList[entry_id];
+    uint32_t const next   = entry_id < atlas->EntryCount ? uint32_t(e->Page0) : ATLAS_NO_ENTRY;
+    if (!r2d::create_atlas_entry(e, name , frame_count))
+    {   // failed to allocate storage for frame data for the entry.
+        return NULL;
+    }
+    if (out_index) *out_index = entry_id;
+
+    hash::table_put(&atlas->EntryTable, name, uint32_t(entry_id));
+    e->LastUsed = atlas->FrameStamp;
+    if (entry_id == atlas->EntryCount)
+        atlas->EntryCount++;
+    else
+        atlas->FreeEntry = next;
+    return e;
+}
+
+r2d::atlas_entry_t* r2d::atlas_create_entry(r2d::atlas_t *atlas, uint32_t name, size_t frame_count, size_t const *frame_widths, size_t const *frame_heights, size_t *out_index)
+{
+    return r2d::atlas_create_entry(atlas, name, frame_count, frame_widths, frame_heights, atlas->HorizontalPad, atlas->VerticalPad, out_index);
+}
+
+r2d::atlas_entry_t* r2d::atlas_create_entry(r2d::atlas_t *atlas, uint32_t name, size_t frame_count, size_t const *frame_widths, size_t const *frame_heights, size_t hpad, size_t vpad, size_t *out_index)
+{
+    // TODO: maybe want to use this opportunity to be smarter and reduce chances
+    // for failure by pre-allocating the necessary storage instead of possibly
+    // performing multiple allocations and ending up with partially-valid state.
+    r2d::atlas_entry_t *ae = r2d::atlas_create_entry(atlas, name, frame_count, out_index);
+    if (ae != NULL)
+    {
+        for (size_t i = 0; i < frame_count; ++i)
+        {
+            r2d::atlas_place_frame(atlas, ae, i, frame_widths[i], frame_heights[i], hpad, vpad);
+        }
+    }
+    return ae;
+}
+
+bool r2d::atlas_place_frame(r2d::atlas_t *atlas, r2d::atlas_entry_t *entry, size_t frame, size_t w, size_t h)
+{
+    return r2d::atlas_place_frame(atlas, entry, frame, w, h, atlas->HorizontalPad, atlas->VerticalPad);
+}
+
+bool r2d::atlas_place_frame(r2d::atlas_t *atlas, r2d::atlas_entry_t *entry, size_t frame, size_t w, size_t h, size_t hpad, size_t vpad)
+{
+    size_t frame_width  = w + (hpad * 2);
+    size_t frame_height = h + (vpad * 2);
+
+    if (frame_width > atlas->PageWidth || frame_height > atlas->PageHeight)
+    {   // no texture page can be large enough to hold this frame.
+        return false;
+    }
+    if (atlas->PagePackers == NULL)
+    {   // the atlas has been frozen, no data can be added.
+        return false;
+    }
+
+    for ( ; ; )
+    {
+        if (atlas_place_existing(atlas, entry, frame, w, h, hpad, vpad))
+            return true;
+        if (atlas->MaxPages == 0 || atlas->PageCount < atlas->MaxPages)
+            break; // allocate a new page.
+        if (!atlas_evict_lru(atlas, entry))
+            return false;
+    }
+
+    // we were unable to find a page on which to place the frame, so allocate a new page.
+    size_t const page_width  = atlas->PageWidth;
+    size_t const page_height = atlas->PageHeight;
+    size_t const page_id     = atlas->PageCount;
+    GLuint const tex         = atlas_page_storage(atlas);
+    if (tex == 0) return false;
+
+    // initialize a new rectangle packer for placing sub-images.
+    if (!r2d::create_packer(&atlas->PagePackers[page_id], atlas->PackerType, page_width, page_height, ATLAS_DEFAULT_CAPACITY))
+    {   // unable to initialize the packer, so delete the texture page.
+        atlas_free_page_storage(atlas, tex);
+        return false;
     }
-    return false;
+
+    r2d::pkrect_t  rect;
+    r2d::packer_t *pack = &atlas->PagePackers[page_id];
+    r2d::packer_insert(pack, w, h, hpad, vpad, entry->Name, &rect);
+    r2d::atlas_frame_t eframe = { rect.X, rect.Y, rect.Width, rect.Height };
+    r2d::set_atlas_entry_frame(entry, frame, page_id, eframe);
+    atlas->TexturePages[page_id] = tex;
+    atlas->PageCount++;
+    return true;
 }
 
-bool r2d::load_dds(void const *dds_data, size_t dds_size, gl::level_desc_t **out_levels, size_t *out_count, GLuint *out_texId)
+bool r2d::atlas_transfer_frame(r2d::atlas_t *atlas, r2d::atlas_entry_t *entry, size_t frame, void const *pixels)
 {
-    size_t                    count     =  0;
-    size_t                   nexpect    =  0;
-    size_t                   nitems     =  0;
-    size_t                   nlevels    =  0;
-    data::dds_level_desc_t   *levels    = NULL;
-    data::dds_header_dxt10_t *h_ex      = NULL;
-    data::dds_header_t        header    = {0};
-    data::dds_header_dxt10_t  header_ex = {0};
-    gl::level_desc_t         *gldesc    = NULL;
+    if (!r2d::atlas_stage_frame(atlas, entry, frame, pixels))
+        return false;
+    return atlas_staging_flush(atlas, NULL, 0);
+}
 
-    if (!data::dds_header(dds_data, dds_size, &header))
-    {   // the DDS file doesn't contain the necessary header.
-        if (out_levels) *out_levels = NULL;
-        if (out_count ) *out_count  = 0;
-        if (out_texId ) *out_texId  = 0;
+bool r2d::atlas_stage_frame(r2d::atlas_t *atlas, r2d::atlas_entry_t *entry, size_t frame, void const *pixels)
+{
+    r2d::atlas_staging_t     *s      = &atlas->Staging;
+    r2d::atlas_frame_t const &bounds =  entry->Frames [frame];
+    size_t             const  pageid =  entry->PageIds[frame];
+    size_t             const  size   =  gl::bytes_per_slice(atlas->PageFormat, atlas->PageDataType, bounds.Width, bounds.Height, ATLAS_ROW_ALIGNMENT);
+
+    if (atlas->TransferBuffer == 0 || size > atlas->TransferBytes)
         return false;
+    if (bounds.Width == 0 || bounds.Height == 0)
+        return true;
+
+    if (atlas->Defrag.Active && atlas->Defrag.Page == pageid)
+    {   // the scratch copy of this frame would be stale.
+        atlas_defrag_abort(atlas);
     }
-    if (data::dds_header_dxt10(dds_data, dds_size, &header_ex))
-    {   // the DDS DX10 header is optional.
-        h_ex = &header_ex;
+    if (s->Count == s->Capacity)
+    {   // grow the upload list before touching the transfer buffer.
+        size_t               newc = s->Capacity > 0 ? s->Capacity * 2 : ATLAS_STAGE_CAPACITY;
+        r2d::atlas_upload_t *newl = (r2d::atlas_upload_t*) realloc(s->List, newc * sizeof(r2d::atlas_upload_t));
+        if (newl == NULL) return false;
+        s->Capacity = newc;
+        s->List     = newl;
     }
-    nitems   = data::dds_array_count(&header, h_ex);
-    nlevels  = data::dds_level_count(&header, h_ex);
-    nexpect  = nitems * nlevels;
-    if (nitems == 0  && nlevels == 0)
-    {   // the DDS file must contain at least one surface.
-        if (out_levels) *out_levels = NULL;
-        if (out_count ) *out_count  = 0;
-        if (out_texId ) *out_texId  = 0;
+    if (s->Mapped != NULL && s->Used + size > s->Size)
+    {   // the mapped range is full; upload the frames staged so far.
+        if (!atlas_staging_flush(atlas, NULL, 0))
+            return false;
+    }
+    if (s->Mapped == NULL && !atlas_staging_map(atlas, size))
         return false;
+
+    memcpy(s->Mapped + s->Used, pixels, size);
+    r2d::atlas_upload_t &u = s->List[s->Count];
+    u.Entry    = uint32_t(entry - atlas->EntryList);
+    u.Frame    = uint32_t(frame);
+    u.Page     = uint32_t(pageid);
+    u.Sequence = uint32_t(s->Count);
+    u.X        = bounds.X;
+    u.Y        = bounds.Y;
+    u.Width    = bounds.Width;
+    u.Height   = bounds.Height;
+    u.Offset   = s->Base + s->Used;
+    u.Size     = size;
+    s->Used   += size;
+    s->Count++;
+    return true;
+}
+
+bool r2d::atlas_flush_transfers(r2d::atlas_t *atlas, r2d::atlas_transfer_stats_t *out_stats, gl::upload_scheduler_t *sched, uint32_t priority)
+{
+    bool result = atlas_staging_flush(atlas, sched, priority);
+    if (out_stats != NULL)
+    {
+        *out_stats = atlas->Staging.Stats;
+        memset(&atlas->Staging.Stats, 0, sizeof(r2d::atlas_transfer_stats_t));
     }
+    return result;
+}
 
-    // allocate memory for the level descriptions returned to the user.
-    gldesc = (gl::level_desc_t*) malloc(nexpect * sizeof(gl::level_desc_t));
-    if (gldesc == NULL)
-    {   // unable to allocate the required memory.
-        if (out_levels) *out_levels = NULL;
-        if (out_count ) *out_count  = 0;
-        if (out_texId ) *out_texId  = 0;
+GLuint r2d::atlas_sprite_source(r2d::atlas_t const *atlas, r2d::atlas_entry_t const *entry, size_t frame, gl::sprite_t *sprite)
+{
+    r2d::atlas_frame_t const &bounds = entry->Frames [frame];
+    size_t             const  pageid = entry->PageIds[frame];
+    sprite->ImageX        = uint32_t(bounds.X);
+    sprite->ImageY        = uint32_t(bounds.Y);
+    sprite->ImageWidth    = uint32_t(bounds.Width);
+    sprite->ImageHeight   = uint32_t(bounds.Height);
+    sprite->TextureWidth  = uint32_t(atlas->PageWidth);
+    sprite->TextureHeight = uint32_t(atlas->PageHeight);
+    sprite->ImageLayer    = atlas->PageTarget == GL_TEXTURE_2D_ARRAY ? uint32_t(pageid) : 0;
+    return atlas->TexturePages[pageid];
+}
+
+bool r2d::atlas_save(r2d::atlas_t const *atlas, char const *path)
+{
+    r2d::atlas_file_header_t header;
+    FILE     *fp          = NULL;
+    uint8_t  *pixels      = NULL;
+    size_t    frame_count = 0;
+    size_t    page_bytes  = 0;
+    size_t    read_pages  = 0;
+    size_t    table_bytes = hash::table_storage_size(atlas->EntryTable.Capacity);
+    GLint     pack_align  = 4;
+    bool      compressed  = gl::bytes_per_block(atlas->PageFormat) > 0;
+    uint8_t   zero[ATLAS_FILE_ALIGNMENT];
+
+    for (size_t i = 0; i < atlas->EntryCount; ++i)
+    {
+        frame_count += atlas->EntryList[i].FrameCount;
+    }
+    memset(zero, 0, sizeof(zero));
+    page_bytes = size_t(gl::bytes_per_slice(atlas->PageFormat, atlas->PageDataType, atlas->PageWidth, atlas->PageHeight, 1));
+
+    header.Magic         = ATLAS_FILE_MAGIC;
+    header.Version       = ATLAS_FILE_VERSION;
+    header.PageWidth     = uint32_t(atlas->PageWidth);
+    header.PageHeight    = uint32_t(atlas->PageHeight);
+    header.PageCount     = uint32_t(atlas->PageCount);
+    header.PageTarget    = uint32_t(atlas->PageTarget);
+    header.PageLayout    = uint32_t(atlas->PageLayout);
+    header.PageFormat    = uint32_t(atlas->PageFormat);
+    header.PageDataType  = uint32_t(atlas->PageDataType);
+    header.HorizontalPad = uint32_t(atlas->HorizontalPad);
+    header.VerticalPad   = uint32_t(atlas->VerticalPad);
+    header.PackerType    = uint32_t(atlas->PackerType);
+    header.EntryCount    = uint32_t(atlas->EntryCount);
+    header.FrameCount    = uint32_t(frame_count);
+    header.TableCapacity = uint32_t(atlas->EntryTable.Capacity);
+    header.TableDeleted  = uint32_t(atlas->EntryTable.Deleted);
+    header.PageBytes     = uint64_t(page_bytes);
+    header.EntryOffset   = sizeof(r2d::atlas_file_header_t);
+    header.FrameOffset   = header.EntryOffset + uint64_t(atlas->EntryCount) * sizeof(r2d::atlas_file_entry_t);
+    header.NameOffset    = header.FrameOffset + uint64_t(frame_count) * sizeof(r2d::atlas_file_frame_t);
+    header.PageOffset    = atlas_file_align(header.NameOffset + table_bytes);
+
+    // read back the page data. a texture array is read back in one operation.
+    if (atlas->Staging.Scheduler != NULL)
+    {   // queued uploads must land before the pages are read.
+        gl::upload_scheduler_flush(atlas->Staging.Scheduler, uintptr_t(atlas));
+    }
+    read_pages = atlas->PageTarget == GL_TEXTURE_2D_ARRAY ? atlas->ArrayLayers : 1;
+    if ((pixels = (uint8_t*) malloc(page_bytes * (read_pages > 0 ? read_pages : 1))) == NULL)
+        goto error_cleanup;
+    if ((fp = fopen(path, "wb")) == NULL)
+        goto error_cleanup;
+    if (fwrite(&header, sizeof(header), 1, fp) != 1)
+        goto error_cleanup;
+
+    for (size_t i = 0, frame = 0; i < atlas->EntryCount; ++i)
+    {
+        r2d::atlas_entry_t const &e = atlas->EntryList[i];
+        r2d::atlas_file_entry_t   r = {
+            e.Name,
+            e.Flags,
+            uint32_t(e.FrameCount),
+            uint32_t(frame)
+        };
+        if (fwrite(&r, sizeof(r), 1, fp) != 1)
+            goto error_cleanup;
+        frame += e.FrameCount;
+    }
+    for (size_t i = 0; i < atlas->EntryCount; ++i)
+    {
+        r2d::atlas_entry_t const &e = atlas->EntryList[i];
+        for (size_t j = 0; j < e.FrameCount; ++j)
+        {
+            r2d::atlas_file_frame_t r = {
+                uint32_t(e.PageIds[j]),
+                uint32_t(e.Frames[j].X),
+                uint32_t(e.Frames[j].Y),
+                uint32_t(e.Frames[j].Width),
+                uint32_t(e.Frames[j].Height)
+            };
+            if (fwrite(&r, sizeof(r), 1, fp) != 1)
+                goto error_cleanup;
+        }
+    }
+    if (fwrite(atlas->EntryTable.Tags, 1, table_bytes, fp) != table_bytes)
+        goto error_cleanup;
+    {   // pad up to the start of the page data.
+        size_t const pad = size_t(header.PageOffset - (header.NameOffset + table_bytes));
+        if (pad > 0 && fwrite(zero, 1, pad, fp) != pad)
+            goto error_cleanup;
+    }
+
+    glGetIntegerv(GL_PACK_ALIGNMENT, &pack_align);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    gl::state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+    for (size_t p = 0; p < atlas->PageCount; ++p)
+    {
+        uint8_t const *src = pixels;
+        if (atlas->PageTarget == GL_TEXTURE_2D_ARRAY)
+        {   // the whole array is read back with the first page.
+            if (p == 0)
+            {
+                gl::state_bind_texture(0, GL_TEXTURE_2D_ARRAY, atlas->TextureArray);
+                if (compressed) glGetCompressedTexImage(GL_TEXTURE_2D_ARRAY, 0, pixels);
+                else glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, atlas->PageLayout, atlas->PageDataType, pixels);
+            }
+            src = pixels + (p * page_bytes);
+        }
+        else
+        {
+            gl::state_bind_texture(0, GL_TEXTURE_2D, atlas->TexturePages[p]);
+            if (compressed) glGetCompressedTexImage(GL_TEXTURE_2D, 0, pixels);
+            else glGetTexImage(GL_TEXTURE_2D, 0, atlas->PageLayout, atlas->PageDataType, pixels);
+        }
+        if (fwrite(src, 1, page_bytes, fp) != page_bytes)
+        {
+            glPixelStorei(GL_PACK_ALIGNMENT, pack_align);
+            goto error_cleanup;
+        }
+    }
+    gl::state_bind_texture(0, atlas->PageTarget, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, pack_align);
+
+    free(pixels);
+    fclose(fp);
+    return true;
+
+error_cleanup:
+    if (pixels != NULL) free(pixels);
+    if (fp     != NULL) fclose(fp);
+    return false;
+}
+
+bool r2d::atlas_load(r2d::atlas_t *atlas, void const *data, size_t data_size)
+{
+    r2d::atlas_file_header_t const *header = (r2d::atlas_file_header_t const*) data;
+    uint8_t                  const *base   = (uint8_t const*) data;
+    r2d::atlas_config_t             config;
+    GLint                           align  = 4;
+    size_t                          free_count = 0;
+
+    if (data == NULL || data_size < sizeof(r2d::atlas_file_header_t))
+        return false;
+    if (header->Magic != ATLAS_FILE_MAGIC || header->Version != ATLAS_FILE_VERSION)
+        return false;
+    if (header->PageBytes == 0 || header->PageBytes != uint64_t(gl::bytes_per_slice(header->PageFormat, header->PageDataType, header->PageWidth, header->PageHeight, 1)))
+    {   // each page is uploaded with a transfer sized from the page format.
+        return false;
+    }
+    if (header->TableCapacity < LLHASH_GROUP_SIZE || (header->TableCapacity & (header->TableCapacity - 1)) != 0)
+        return false;
+    if (header->EntryOffset > data_size || header->FrameOffset > data_size ||
+        header->NameOffset  > data_size || header->PageOffset  > data_size)
+    {   // the offsets are checked first so the sizes below cannot wrap.
+        return false;
+    }
+    if (header->EntryOffset + uint64_t(header->EntryCount) * sizeof(r2d::atlas_file_entry_t) > data_size ||
+        header->FrameOffset + uint64_t(header->FrameCount) * sizeof(r2d::atlas_file_frame_t) > data_size ||
+        header->NameOffset  + uint64_t(hash::table_storage_size(header->TableCapacity)) > data_size ||
+        header->PageCount   > (data_size - header->PageOffset) / header->PageBytes)
+    {   // the file is truncated.
         return false;
     }
 
-    // parse the remainder of the DDS file and describe the surfaces it contains.
-    levels = (data::dds_level_desc_t*) malloc(nexpect * sizeof(data::dds_level_desc_t));
-    count  =  data::dds_describe(dds_data, dds_size, &header, h_ex, levels, nexpect);
-    if (count != nexpect)
-    {   // unable to parse all of the level descriptions.
-        if (levels != NULL) free(levels);
-        if (gldesc != NULL) free(gldesc);
-        if (out_levels) *out_levels = NULL;
-        if (out_count ) *out_count  = 0;
-        if (out_texId ) *out_texId  = 0;
+    r2d::atlas_file_entry_t const *entries = (r2d::atlas_file_entry_t const*) (base + header->EntryOffset);
+    r2d::atlas_file_frame_t const *frames  = (r2d::atlas_file_frame_t const*) (base + header->FrameOffset);
+    uint8_t                 const *table   = base + header->NameOffset;
+    size_t                  const  nslots  = header->TableCapacity;
+
+    config.PageWidth     = header->PageWidth;
+    config.PageHeight    = header->PageHeight;
+    config.HorizontalPad = header->HorizontalPad;
+    config.VerticalPad   = header->VerticalPad;
+    config.ExpectedCount = header->EntryCount;
+    config.Layout        = header->PageLayout;
+    config.Format        = header->PageFormat;
+    config.DataType      = header->PageDataType;
+    config.PageTarget    = header->PageTarget;
+    config.PackerType    = header->PackerType;
+    config.MaxPages      = 0;
+    if (!r2d::create_atlas(atlas, config))
         return false;
+
+    // copy the entry table.
+    if (atlas->EntryCapacity < header->EntryCount)
+    {
+        void *newl = realloc(atlas->EntryList, header->EntryCount * sizeof(r2d::atlas_entry_t));
+        if (newl == NULL) goto error_cleanup;
+        atlas->EntryList     = (r2d::atlas_entry_t*) newl;
+        atlas->EntryCapacity = header->EntryCount;
+    }
+    for (size_t i = 0; i < header->EntryCount; ++i)
+    {
+        r2d::atlas_file_entry_t const &r = entries[i];
+        r2d::atlas_entry_t            *e = &atlas->EntryList[i];
+        if (r.Flags & r2d::ATLAS_ENTRY_FREE)
+        {   // the slot of a removed entry; rebuild the free list.
+            r2d::create_atlas_entry(e, 0, 1);
+            e->Flags         = r2d::ATLAS_ENTRY_FREE;
+            e->FrameCount    = 0;
+            e->Page0         = atlas->FreeEntry;
+            atlas->FreeEntry = uint32_t(i);
+            atlas->EntryCount++;
+            free_count++;
+            continue;
+        }
+        if (r.FrameCount == 0 || uint64_t(r.FirstFrame) + r.FrameCount > header->FrameCount)
+            goto error_cleanup;
+        if (!r2d::create_atlas_entry(e, r.Name, r.FrameCount))
+            goto error_cleanup;
+        atlas->EntryCount++;
+        for (size_t j = 0; j < r.FrameCount; ++j)
+        {
+            r2d::atlas_file_frame_t const &f = frames[r.FirstFrame + j];
+            r2d::atlas_frame_t        frame  = { f.X, f.Y, f.Width, f.Height };
+            if (f.PageId >= header->PageCount ||
+                uint64_t(f.X) + f.Width  > header->PageWidth ||
+                uint64_t(f.Y) + f.Height > header->PageHeight)
+            {   // the frame doesn't lie on one of the pages in the file.
+                goto error_cleanup;
+            }
+            r2d::set_atlas_entry_frame(e, j, f.PageId, frame);
+        }
+        e->Flags = r.Flags;
     }
 
-    // figure out the GL format from the DXGI format.
-    size_t width    = levels[0].Width;
-    size_t height   = levels[0].Height;
-    GLenum target   = GL_NONE;
-    GLenum format   = GL_NONE;
-    GLenum layout   = GL_NONE;
-    GLenum dataType = GL_NONE;
-    GLenum magFilter= GL_CLAMP_TO_EDGE;
-    GLenum minFilter= GL_CLAMP_TO_EDGE;
-    if (!r2d::dxgi_format_to_gl(levels[0].Format, format, layout, dataType))
-    {   // the DDS data is stored in an unsupported format.
-        if (levels != NULL) free(levels);
-        if (gldesc != NULL) free(gldesc);
-        if (out_levels) *out_levels = NULL;
-        if (out_count ) *out_count  = 0;
-        if (out_texId ) *out_texId  = 0;
+    // load the name lookup table storage directly; no names are re-hashed.
+    // it must hold exactly one slot per live entry, each referencing a valid entry.
+    if (!hash::load_table(&atlas->EntryTable, table, nslots))
+        goto error_cleanup;
+    if (atlas->EntryTable.Count != header->EntryCount - free_count)
+        goto error_cleanup;
+    for (size_t i = 0; i < nslots; ++i)
+    {
+        if ((atlas->EntryTable.Tags[i] & 0x80U) == 0 && atlas->EntryTable.Values[i] >= header->EntryCount)
+            goto error_cleanup;
+    }
+
+    // create and upload each page with a single transfer from the source data.
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &align);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t p = 0; p < header->PageCount; ++p)
+    {
+        size_t const page_id = atlas->PageCount;
+        GLuint const tex     = atlas_page_storage(atlas);
+        if (tex == 0)
+        {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, align);
+            goto error_cleanup;
+        }
+        gl::state_bind_texture(0, atlas->PageTarget, tex);
+
+        gl::pixel_transfer_h2d_t x;
+        x.Target          = atlas->PageTarget;
+        x.UnpackBuffer    = 0;
+        x.Format          = gl::bytes_per_block(atlas->PageFormat) > 0 ? atlas->PageFormat : atlas->PageLayout;
+        x.DataType        = atlas->PageDataType;
+        x.TargetIndex     = 0;
+        x.TargetX         = 0;
+        x.TargetY         = 0;
+        x.TargetZ         = atlas->PageTarget == GL_TEXTURE_2D_ARRAY ? page_id : 0;
+        x.SourceX         = 0;
+        x.SourceY         = 0;
+        x.SourceZ         = 0;
+        x.SourceWidth     = atlas->PageWidth;
+        x.SourceHeight    = atlas->PageHeight;
+        x.TransferWidth   = atlas->PageWidth;
+        x.TransferHeight  = atlas->PageHeight;
+        x.TransferSlices  = 1;
+        x.TransferSize    = size_t(header->PageBytes);
+        x.TransferBuffer  = (void*) (base + header->PageOffset + p * header->PageBytes);
+        gl::transfer_pixels_h2d(&x);
+
+        // loaded pages have no packer; the atlas is frozen below.
+        memset(&atlas->PagePackers[page_id], 0, sizeof(r2d::packer_t));
+        atlas->TexturePages[page_id] = tex;
+        atlas->PageCount++;
+    }
+    gl::state_bind_texture(0, atlas->PageTarget, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, align);
+    r2d::freeze_atlas(atlas);
+    return true;
+
+error_cleanup:
+    r2d::delete_atlas(atlas);
+    return false;
+}
+
+bool r2d::atlas_load(r2d::atlas_t *atlas, char const *path)
+{
+    data::file_mapping_t file;
+    if (!data::map_file(path, &file))
+        return false;
+
+    bool result = r2d::atlas_load(atlas, file.Data, file.Size);
+    data::unmap_file(&file);
+    return result;
+}
+
+bool r2d::create_atlas_pack_plan(r2d::atlas_pack_plan_t *plan, r2d::atlas_t const *atlas, size_t entry_count, uint32_t const *names, size_t const *frame_counts, size_t const *frame_widths, size_t const *frame_heights, uint32_t packers)
+{
+    if (plan == NULL || atlas == NULL)
+        return false;
+
+    size_t item_count  = 0;
+    size_t type_count  = 0;
+    for (size_t i = 0; i < entry_count; ++i)
+    {
+        item_count += frame_counts[i];
+    }
+    for (size_t i = 0; i < r2d::PACKER_TYPE_COUNT; ++i)
+    {
+        if (packers & (1U << i))
+            type_count++;
+    }
+    if (type_count == 0)
+    {   // no packer type was selected, so there is nothing to try.
         return false;
     }
 
-    // create the target texture object name and allocate GPU storage.
-    GLuint texId = 0;
-    glGenTextures (1, &texId);
-    if (texId  ==  0)
-    {   // unable to create the OpenGL texture object.
-        if (levels != NULL) free(levels);
-        if (gldesc != NULL) free(gldesc);
-        if (out_levels) *out_levels = NULL;
-        if (out_count ) *out_count  = 0;
-        if (out_texId ) *out_texId  = 0;
+    plan->PageWidth     = atlas->PageWidth;
+    plan->PageHeight    = atlas->PageHeight;
+    plan->HorizontalPad = atlas->HorizontalPad;
+    plan->VerticalPad   = atlas->VerticalPad;
+    plan->EntryCount    = entry_count;
+    plan->EntryNames    = NULL;
+    plan->FrameCounts   = NULL;
+    plan->ItemCount     = item_count;
+    plan->Items         = NULL;
+    plan->TrialCount    = 0;
+    plan->Trials        = NULL;
+
+    size_t const trial_count = r2d::ATLAS_SORT_COUNT * type_count;
+    plan->EntryNames  = (uint32_t*) malloc((entry_count + 1) * sizeof(uint32_t));
+    plan->FrameCounts = (size_t  *) malloc((entry_count + 1) * sizeof(size_t));
+    plan->Items       = (r2d::atlas_pack_item_t *) malloc((item_count + 1) * sizeof(r2d::atlas_pack_item_t));
+    plan->Trials      = (r2d::atlas_pack_trial_t*) malloc(trial_count * sizeof(r2d::atlas_pack_trial_t));
+    if (plan->EntryNames == NULL || plan->FrameCounts == NULL || plan->Items == NULL || plan->Trials == NULL)
+    {
+        r2d::delete_atlas_pack_plan(plan);
         return false;
     }
 
-    // figure out the 'default' texture target type. the target used by
-    // the application might be different, but we need something to upload.
-    bool isArray   = data::dds_array  (&header, h_ex);
-    bool isVolume  = data::dds_volume (&header, h_ex);
-    bool isCubemap = data::dds_cubemap(&header, h_ex);
-    if (isArray)
-    {   // note that volume arrays are not supported.
-        if (isCubemap) target = GL_TEXTURE_CUBE_MAP_ARRAY;
-        else if (width == 1 || height == 1) target = GL_TEXTURE_1D_ARRAY;
-        else target = GL_TEXTURE_2D_ARRAY;
+    for (size_t i = 0, item = 0; i < entry_count; ++i)
+    {
+        plan->EntryNames [i] = names[i];
+        plan->FrameCounts[i] = frame_counts[i];
+        for (size_t j = 0; j < frame_counts[i]; ++j, ++item)
+        {
+            plan->Items[item].Entry  = uint32_t(i);
+            plan->Items[item].Frame  = uint32_t(j);
+            plan->Items[item].Width  = uint32_t(frame_widths [item]);
+            plan->Items[item].Height = uint32_t(frame_heights[item]);
+        }
     }
-    else if (isVolume) target = GL_TEXTURE_3D;
-    else if (isCubemap) target = GL_TEXTURE_CUBE_MAP;
-    else if (width == 1 || height == 1) target = GL_TEXTURE_1D;
-    else target = GL_TEXTURE_2D;
+    for (size_t i = 0, k = 0; i < r2d::ATLAS_SORT_COUNT; ++i)
+    {
+        for (size_t j = 0; j < r2d::PACKER_TYPE_COUNT; ++j)
+        {
+            if ((packers & (1U << j)) == 0)
+                continue;
 
-    // allocate GPU storage for all elements/slices and levels of the texture.
-    GLenum error = glGetError(); // clear the current error value, if any.
-    gl::texture_storage(target, format, dataType, minFilter, magFilter, width , height, nitems, nlevels);
-    error = glGetError();
-    if (error != GL_NO_ERROR)
-    {   // unable to allocate the necessary GPU resources.
-        glDeleteTextures(1, &texId);
-        if (levels != NULL) free(levels);
-        if (gldesc != NULL) free(gldesc);
-        if (out_levels) *out_levels = NULL;
-        if (out_count ) *out_count  = 0;
-        if (out_texId ) *out_texId  = 0;
-        return false;
+            r2d::atlas_pack_trial_t &t = plan->Trials[k++];
+            t.SortKey      = uint32_t(i);
+            t.PackerType   = uint32_t(j);
+            t.Success      = false;
+            t.PageCount    = 0;
+            t.PageCapacity = 0;
+            t.Pages        = NULL;
+        }
     }
+    plan->TrialCount = trial_count;
+    return true;
+}
 
-    for (size_t dds_level  = 0;  dds_level < count; ++dds_level)
+void r2d::delete_atlas_pack_plan(r2d::atlas_pack_plan_t *plan)
+{
+    if (plan != NULL)
     {
-        data::dds_level_desc_t  &ddsd = levels[dds_level];
-        gl::level_desc_t        &glsd = gldesc[dds_level];
-        gl::pixel_transfer_h2d_t xfer;
+        if (plan->Trials != NULL)
+        {
+            for (size_t i = 0; i < plan->TrialCount; ++i)
+            {
+                pack_trial_clear(&plan->Trials[i]);
+            }
+            free(plan->Trials);
+        }
+        if (plan->Items       != NULL) free(plan->Items);
+        if (plan->FrameCounts != NULL) free(plan->FrameCounts);
+        if (plan->EntryNames  != NULL) free(plan->EntryNames);
+        plan->EntryCount  = 0;
+        plan->EntryNames  = NULL;
+        plan->FrameCounts = NULL;
+        plan->ItemCount   = 0;
+        plan->Items       = NULL;
+        plan->TrialCount  = 0;
+        plan->Trials      = NULL;
+    }
+}
 
-        // upload data to the GPU. since PBO's are not being used, this is
-        // synchronous on the CPU; the data is memcpy'd to driver memory and
-        // then transferred to the GPU.
-        xfer.Target            = target;
-        xfer.Format            = format;
-        xfer.DataType          = dataType;
-        xfer.UnpackBuffer      = 0;
-        xfer.TargetIndex       = ddsd.Index;          // target mipmap level.
-        xfer.TargetX           = 0;
-        xfer.TargetY           = 0;
-        xfer.TargetZ           = dds_level / nlevels; // target array slice.
-        xfer.SourceX           = 0;
-        xfer.SourceY           = 0;
-        xfer.SourceZ           = 0;
-        xfer.SourceWidth       = ddsd.Width;
-        xfer.SourceHeight      = ddsd.Height;
-        xfer.TransferWidth     = ddsd.Width;
-        xfer.TransferHeight    = ddsd.Height;
-        xfer.TransferSlices    = ddsd.Slices;
-        xfer.TransferSize      = ddsd.DataSize;
-        xfer.TransferBuffer    = ddsd.LevelData;
-        gl::transfer_pixels_h2d(&xfer);
+bool r2d::atlas_pack_trial(r2d::atlas_pack_plan_t *plan, size_t trial)
+{
+    r2d::atlas_pack_trial_t *t     = &plan->Trials[trial];
+    size_t            const  n     = plan->ItemCount;
+    size_t            const  hpad  = plan->HorizontalPad;
+    size_t            const  vpad  = plan->VerticalPad;
+    uint32_t                *order = (uint32_t*) malloc((n + 1) * sizeof(uint32_t));
 
-        // convert the level description to the GL format.
-        glsd.Index             = ddsd.Index;
-        glsd.Width             = ddsd.Width;
-        glsd.Height            = ddsd.Height;
-        glsd.Slices            = ddsd.Slices;
-        glsd.BytesPerElement   = ddsd.BytesPerElement;
-        glsd.BytesPerRow       = ddsd.BytesPerRow;
-        glsd.BytesPerSlice     = ddsd.BytesPerSlice;
-        glsd.Layout            = layout;
-        glsd.Format            = format;
-        glsd.DataType          = dataType;
+    pack_trial_clear(t);
+    if (order == NULL) return false;
+    for (size_t i = 0; i < n; ++i)
+    {
+        order[i] = uint32_t(i);
     }
+    std::sort(order, order + n, pack_item_order(plan->Items, t->SortKey));
 
-    // cleanup and set output parameters; we're done.
-    if (out_levels) *out_levels = gldesc;
-    if (out_count ) *out_count  = count;
-    if (out_texId ) *out_texId  = texId;
-    free(levels);
+    for (size_t i = 0; i < n; ++i)
+    {
+        r2d::atlas_pack_item_t const &item = plan->Items[order[i]];
+        bool placed = false;
+        for (size_t p = 0; p < t->PageCount && !placed; ++p)
+        {   // first-fit, trying the oldest (fullest) pages first.
+            placed = r2d::packer_insert(&t->Pages[p], item.Width, item.Height, hpad, vpad, order[i], NULL);
+        }
+        if (placed) continue;
+
+        if (t->PageCount == t->PageCapacity)
+        {
+            size_t         newc = t->PageCapacity + ATLAS_PAGE_CAPACITY;
+            r2d::packer_t *newp = (r2d::packer_t*) realloc(t->Pages, newc * sizeof(r2d::packer_t));
+            if (newp == NULL) goto error_cleanup;
+            t->Pages        = newp;
+            t->PageCapacity = newc;
+        }
+        if (!r2d::create_packer(&t->Pages[t->PageCount], t->PackerType, plan->PageWidth, plan->PageHeight, ATLAS_DEFAULT_CAPACITY))
+            goto error_cleanup;
+        t->PageCount++;
+        if (!r2d::packer_insert(&t->Pages[t->PageCount-1], item.Width, item.Height, hpad, vpad, order[i], NULL))
+            goto error_cleanup; // the frame is larger than a page.
+    }
+    free(order);
+    t->Success = true;
     return true;
-}
 
+error_cleanup:
+    free(order);
+    pack_trial_clear(t);
+    return false;
+}
 
-bool r2d::create_packer(r2d::packer_t *packer, size_t width, size_t height, size_t capacity)
+size_t r2d::atlas_pack_best(r2d::atlas_pack_plan_t const *plan)
 {
-    if (packer != NULL)
+    size_t best = plan->TrialCount;
+    for (size_t i = 0; i < plan->TrialCount; ++i)
     {
-        if (capacity == 0) capacity = 1; // need at least one node for the root.
-        packer->Width    = width;
-        packer->Height   = height;
-        packer->Free     = width * height;
-        packer->Used     = 0;
-        packer->Capacity = capacity;
-        packer->Count    = 0;
-        packer->Nodes    = NULL;
-        packer->Rects    = NULL;
-
-        r2d::pknode_t    root;
-        packer->Nodes    = (r2d::pknode_t*) malloc(capacity * sizeof(r2d::pknode_t) * 3);
-        packer->Rects    = (r2d::pkrect_t*) malloc(capacity * sizeof(r2d::pkrect_t));
-        root.Flags       = r2d::PACKER_FLAGS_NONE;
-        root.Index       = 0xFFFFFFFFU;
-        root.Child[0]    = 0;
-        root.Child[1]    = 0;
-        root.Bound[0]    = 0;
-        root.Bound[1]    = 0;
-        root.Bound[2]    = uint32_t(width);
-        root.Bound[3]    = uint32_t(height);
-        packer->Nodes[0] = root;
-        return true;
+        r2d::atlas_pack_trial_t const &t = plan->Trials[i];
+        if (!t.Success)
+            continue;
+        if (best == plan->TrialCount)
+        {
+            best = i;
+            continue;
+        }
+        r2d::atlas_pack_trial_t const &b = plan->Trials[best];
+        if (t.PageCount < b.PageCount)
+        {
+            best = i;
+            continue;
+        }
+        if (t.PageCount == b.PageCount && t.PageCount > 0 && t.Pages[t.PageCount-1].Used < b.Pages[b.PageCount-1].Used)
+        {
+            best = i;
+        }
     }
-    else return false;
+    return best;
 }
 
-void r2d::delete_packer(r2d::packer_t *packer)
+bool r2d::atlas_apply_pack_plan(r2d::atlas_t *atlas, r2d::atlas_pack_plan_t *plan, size_t trial, size_t *out_indices)
 {
-    if (packer != NULL)
+    if (trial >= plan->TrialCount || !plan->Trials[trial].Success)
+    {   // the trial did not produce a valid placement.
+        return false;
+    }
+    if (atlas->PagePackers == NULL)
+    {   // the atlas has been frozen, no data can be added.
+        return false;
+    }
+    if (atlas->MaxPages > 0 && atlas->PageCount + plan->Trials[trial].PageCount > atlas->MaxPages)
+    {   // the placement would exceed the page limit of a dynamic atlas.
+        return false;
+    }
+
+    r2d::atlas_pack_trial_t *t = &plan->Trials[trial];
+    size_t const base_page     = atlas->PageCount;
+    size_t       entry_count   = 0;
+    size_t      *entries       = (size_t*) malloc((plan->EntryCount + 1) * sizeof(size_t));
+    if (entries == NULL) return false;
+
+    // create all of the entries first, since creating an entry may move EntryList.
+    for (size_t i = 0; i < plan->EntryCount; ++i, ++entry_count)
+    {
+        if (r2d::atlas_create_entry(atlas, plan->EntryNames[i], plan->FrameCounts[i], &entries[i]) == NULL)
+            goto error_cleanup;
+    }
+
+    // allocate storage for every page before any packer is moved, so that a
+    // failure leaves the trial intact and the atlas can be rolled back.
+    for (size_t p = 0; p < t->PageCount; ++p)
+    {
+        GLuint const tex = atlas_page_storage(atlas);
+        if (tex == 0) goto error_cleanup;
+        memset(&atlas->PagePackers[atlas->PageCount], 0, sizeof(r2d::packer_t));
+        atlas->TexturePages[atlas->PageCount++] = tex;
+    }
+
+    // take ownership of each trial packer; nothing below can fail.
+    for (size_t p = 0; p < t->PageCount; ++p)
+    {
+        size_t const page_id = base_page + p;
+        r2d::packer_t *pack  = &atlas->PagePackers[page_id];
+        *pack = t->Pages[p];
+        memset(&t->Pages[p], 0, sizeof(r2d::packer_t));
+        for (size_t i = 0; i < pack->Count; ++i)
+        {   // the packer content is the item index; replace it with the entry name.
+            r2d::pkrect_t                &r    = pack->Rects[i];
+            r2d::atlas_pack_item_t const &item = plan->Items[r.Content];
+            r2d::atlas_entry_t           *ent  = &atlas->EntryList[entries[item.Entry]];
+            r2d::atlas_frame_t     eframe = { r.X, r.Y, r.Width, r.Height };
+            r2d::set_atlas_entry_frame(ent, item.Frame, page_id, eframe);
+            r.Content = ent->Name;
+        }
+    }
+    for (size_t i = 0; out_indices != NULL && i < plan->EntryCount; ++i)
     {
-        if (packer->Rects != NULL) free(packer->Rects);
-        if (packer->Nodes != NULL) free(packer->Nodes);
-        packer->Width      = 0;
-        packer->Height     = 0;
-        packer->Free       = 0;
-        packer->Used       = 0;
-        packer->Capacity   = 0;
-        packer->Count      = 0;
-        packer->Nodes      = NULL;
-        packer->Rects      = NULL;
+        out_indices[i] = entries[i];
+    }
+    pack_trial_clear(t);
+    free(entries);
+    return true;
+
+error_cleanup:
+    while (atlas->PageCount > base_page)
+    {   // array layers stay allocated and are reused by the next page.
+        atlas_free_page_storage(atlas, atlas->TexturePages[--atlas->PageCount]);
+    }
+    while (entry_count > 0)
+    {   // release in reverse order to restore the free entry list.
+        atlas_release_entry(atlas, entries[--entry_count]);
     }
+    free(entries);
+    return false;
 }
 
-void r2d::reset_packer(r2d::packer_t *packer)
+bool r2d::atlas_bulk_create_entries(r2d::atlas_t *atlas, size_t entry_count, uint32_t const *names, size_t const *frame_counts, size_t const *frame_widths, size_t const *frame_heights, size_t *out_indices, uint32_t packers)
 {
-    if (packer->Capacity > 0)
+    r2d::atlas_pack_plan_t plan;
+    if (!r2d::create_atlas_pack_plan(&plan, atlas, entry_count, names, frame_counts, frame_widths, frame_heights, packers))
+        return false;
+
+    for (size_t i = 0; i < plan.TrialCount; ++i)
     {
-        r2d::pknode_t root;
-        root.Flags    = r2d::PACKER_FLAGS_NONE;
-        root.Index    = 0xFFFFFFFFU;
-        root.Child[0] = 0;
-        root.Child[1] = 0;
-        root.Bound[0] = 0;
-        root.Bound[1] = 0;
-        root.Bound[2] = uint32_t(packer->Width);
-        root.Bound[3] = uint32_t(packer->Height);
-        packer->Count = 0;
-        packer->Nodes[0] = root;
+        r2d::atlas_pack_trial(&plan, i);
     }
-    packer->Free  = packer->Width * packer->Height;
-    packer->Used  = 0;
+    size_t const best = r2d::atlas_pack_best(&plan);
+    bool   const res  = r2d::atlas_apply_pack_plan(atlas, &plan, best, out_indices);
+    r2d::delete_atlas_pack_plan(&plan);
+    return res;
 }
 
-bool r2d::packer_insert(r2d::packer_t *packer, size_t width, size_t height, size_t hpad, size_t vpad, uint32_t id, r2d::pkrect_t *rect)
+bool r2d::create_tilemap(r2d::tilemap_t *map, size_t width, size_t height, size_t tile_width, size_t tile_height, size_t chunk_size, size_t source_count)
 {
-    size_t w = width  + (hpad * 2);
-    size_t h = height + (vpad * 2);
-    size_t a = w * h;
+    size_t  chunk_quads  = 0;
+    size_t  chunk_count  = 0;
+    GLuint  buffers[2]   = {0, 0};
+    GLuint  vao          = 0;
+    void   *indices      = NULL;
 
-    // if there isn't enough space available, don't
-    // bother searching for a place to put this rectangle.
-    if (a > packer->Free)
+    memset(map, 0, sizeof(r2d::tilemap_t));
+    if (width == 0 || height == 0 || tile_width == 0 || tile_height == 0)
         return false;
+    if (chunk_size   == 0) chunk_size   = TILEMAP_DEFAULT_CHUNK;
+    if (source_count == 0) source_count = 1;
 
-    r2d::pknode_t *n  = node_insert(packer, 0, w, h);
-    if (n != NULL)
-    {
-        r2d::pkrect_t r;
-        r.X        = n->Bound[0] + hpad;
-        r.Y        = n->Bound[1] + vpad;
-        r.Width    = width;
-        r.Height   = height;
-        r.Content  = id;
-        r.Flags    = n->Flags;
-        if (rect) *rect = r;
-
-        n->Flags  |= r2d::PACKER_FLAGS_USED;
-        n->Index   = uint32_t(packer->Count);
-        packer->Rects[packer->Count++] = r;
-        packer->Free -= a;
-        packer->Used += a;
-        return true;
-    }
-    else return false;
+    chunk_quads        = chunk_size * chunk_size;
+    map->Width         = width;
+    map->Height        = height;
+    map->TileWidth     = tile_width;
+    map->TileHeight    = tile_height;
+    map->ChunkSize     = chunk_size;
+    map->ChunksX       = (width  + chunk_size - 1) / chunk_size;
+    map->ChunksY       = (height + chunk_size - 1) / chunk_size;
+    map->SourceCount   = source_count;
+    map->TintColor     = 0xFFFFFFFFU;
+    map->LayerDepth    = 0;
+    map->IndexSize     = (chunk_quads * 4) <= 0x10000U ? sizeof(uint16_t) : sizeof(uint32_t);
+    map->DrawCapacity  = TILEMAP_DRAW_CAPACITY;
+    chunk_count        = map->ChunksX * map->ChunksY;
+
+    map->Tiles         = (uint32_t*) calloc(width * height, sizeof(uint32_t));
+    map->Chunks        = (r2d::tilemap_chunk_t*) calloc(chunk_count, sizeof(r2d::tilemap_chunk_t));
+    map->Sources       = (r2d::tilemap_source_t*) calloc(source_count, sizeof(r2d::tilemap_source_t));
+    map->Vertices      = (gl::sprite_vertex_ptc_t*) malloc(chunk_quads * 4 * sizeof(gl::sprite_vertex_ptc_t));
+    map->SortKeys      = (uint64_t*) malloc(chunk_quads * sizeof(uint64_t));
+    map->Draws         = (r2d::tilemap_draw_t*) malloc(map->DrawCapacity * sizeof(r2d::tilemap_draw_t));
+    map->DrawCounts    = (GLsizei*) malloc(map->DrawCapacity * sizeof(GLsizei));
+    map->DrawOffsets   = (GLvoid**) malloc(map->DrawCapacity * sizeof(GLvoid*));
+    map->DrawBases     = (GLint*) malloc(map->DrawCapacity * sizeof(GLint));
+    indices            = malloc(chunk_quads * 6 * map->IndexSize);
+    if (map->Tiles    == NULL || map->Chunks      == NULL || map->Sources    == NULL ||
+        map->Vertices == NULL || map->SortKeys    == NULL || map->Draws      == NULL ||
+        map->DrawCounts == NULL || map->DrawOffsets == NULL || map->DrawBases == NULL ||
+        indices       == NULL)
+        goto error_cleanup;
+
+    // every chunk uses the same index data, offset by its base vertex.
+    if (map->IndexSize == sizeof(uint16_t)) gl::generate_quad_indices_u16(indices, 0, 0, chunk_quads);
+    else gl::generate_quad_indices_u32(indices, 0, 0, chunk_quads);
+
+    glGenBuffers(2, buffers);
+    glGenVertexArrays(1, &vao);
+    gl::state_bind_vertex_array(vao);
+    gl::state_bind_buffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(chunk_count * chunk_quads * 4 * sizeof(gl::sprite_vertex_ptc_t)), NULL, GL_STATIC_DRAW);
+    gl::state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(chunk_quads * 6 * map->IndexSize), indices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(GL_SPRITE_PTC_LOCATION_PTX);
+    glEnableVertexAttribArray(GL_SPRITE_PTC_LOCATION_CLR);
+    glEnableVertexAttribArray(GL_SPRITE_PTC_LOCATION_DEP);
+    glEnableVertexAttribArray(GL_SPRITE_PTC_LOCATION_LAY);
+    glVertexAttribPointer(GL_SPRITE_PTC_LOCATION_PTX, 4, GL_FLOAT,         GL_FALSE, sizeof(gl::sprite_vertex_ptc_t), (GLvoid const*)  0);
+    glVertexAttribPointer(GL_SPRITE_PTC_LOCATION_CLR, 4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(gl::sprite_vertex_ptc_t), (GLvoid const*) 16);
+    glVertexAttribPointer(GL_SPRITE_PTC_LOCATION_DEP, 1, GL_FLOAT,         GL_FALSE, sizeof(gl::sprite_vertex_ptc_t), (GLvoid const*) 20);
+    glVertexAttribPointer(GL_SPRITE_PTC_LOCATION_LAY, 1, GL_FLOAT,         GL_FALSE, sizeof(gl::sprite_vertex_ptc_t), (GLvoid const*) 24);
+    gl::state_bind_vertex_array(0);
+    map->VertexArray   = vao;
+    map->VertexBuffer  = buffers[0];
+    map->IndexBuffer   = buffers[1];
+    free(indices);
+    return true;
+
+error_cleanup:
+    if (indices != NULL) free(indices);
+    r2d::delete_tilemap(map);
+    return false;
 }
 
-bool r2d::create_atlas_entry(r2d::atlas_entry_t *ent, uint32_t name, size_t frame_count)
+void r2d::delete_tilemap(r2d::tilemap_t *map)
 {
-    if (ent != NULL)
+    GLuint buffers[2] = {
+        map->VertexBuffer,
+        map->IndexBuffer
+    };
+    if (map->VertexArray  != 0) gl::state_delete_vertex_arrays(1, &map->VertexArray);
+    if (map->VertexBuffer != 0) gl::state_delete_buffers(2, buffers);
+    if (map->Chunks != NULL)
     {
-        if (frame_count == 0) frame_count = 1;
-        ent->Name        = name;
-        ent->Flags       = r2d::ATLAS_ENTRY_NORMAL;
-        ent->FrameCount  = frame_count;
-        ent->MaxWidth    = 0;
-        ent->MaxHeight   = 0;
-        ent->Page0       = 0;
-        ent->Frame0      = {
-            0, 0, 0, 0
-        };
-        if (frame_count == 1)
-        {   // this is the typical case - only one frame.
-            // don't allocate additional storage, use the pre-allocated stuff.
-            ent->PageIds = &ent->Page0;
-            ent->Frames  = &ent->Frame0;
-        }
-        else
-        {   // multi-frame entries allocate separate array storage.
-            ent->Flags  |= r2d::ATLAS_ENTRY_MULTIFRAME;
-            ent->PageIds = (size_t*)            malloc(frame_count * sizeof(size_t));
-            ent->Frames  = (r2d::atlas_frame_t*)malloc(frame_count * sizeof(r2d::atlas_frame_t));
+        size_t const count = map->ChunksX * map->ChunksY;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (map->Chunks[i].Runs != NULL) free(map->Chunks[i].Runs);
         }
-        return true;
+        free(map->Chunks);
     }
-    else return false;
+    if (map->Tiles       != NULL) free(map->Tiles);
+    if (map->Sources     != NULL) free(map->Sources);
+    if (map->Vertices    != NULL) free(map->Vertices);
+    if (map->SortKeys    != NULL) free(map->SortKeys);
+    if (map->Draws       != NULL) free(map->Draws);
+    if (map->DrawCounts  != NULL) free(map->DrawCounts);
+    if (map->DrawOffsets != NULL) free(map->DrawOffsets);
+    if (map->DrawBases   != NULL) free(map->DrawBases);
+    memset(map, 0, sizeof(r2d::tilemap_t));
 }
 
-void r2d::delete_atlas_entry(r2d::atlas_entry_t *ent)
+bool r2d::tilemap_set_source(r2d::tilemap_t *map, uint32_t index, r2d::atlas_t const *atlas, r2d::atlas_entry_t const *entry, size_t frame)
 {
-    if (ent != NULL)
+    if (index == 0 || index >= map->SourceCount || frame >= entry->FrameCount)
+        return false;
+
+    gl::sprite_t           sprite;
+    GLuint           const tex = r2d::atlas_sprite_source(atlas, entry, frame, &sprite);
+    float            const su  = 1.0f / float(sprite.TextureWidth);
+    float            const sv  = 1.0f / float(sprite.TextureHeight);
+    r2d::tilemap_source_t &src = map->Sources[index];
+    src.UV[0]   = float(sprite.ImageX) * su;
+    src.UV[1]   = 1.0f - (float(sprite.ImageY) * sv);
+    src.UV[2]   = float(sprite.ImageX + sprite.ImageWidth) * su;
+    src.UV[3]   = 1.0f - (float(sprite.ImageY + sprite.ImageHeight) * sv);
+    src.Layer   = float(sprite.ImageLayer);
+    src.Texture = tex;
+    tilemap_mark_all_dirty(map);
+    return true;
+}
+
+void r2d::tilemap_set_tile(r2d::tilemap_t *map, size_t x, size_t y, uint32_t index)
+{
+    if (x >= map->Width || y >= map->Height)
+        return;
+
+    uint32_t &cell = map->Tiles[y * map->Width + x];
+    if (cell != index)
     {
-        if (ent->Flags & r2d::ATLAS_ENTRY_MULTIFRAME)
+        r2d::tilemap_chunk_t &chunk = map->Chunks[(y / map->ChunkSize) * map->ChunksX + (x / map->ChunkSize)];
+        if (!chunk.Dirty)
         {
-            if (ent->Frames  != NULL) free(ent->Frames);
-            if (ent->PageIds != NULL) free(ent->PageIds);
+            chunk.Dirty = true;
+            map->DirtyCount++;
         }
-        ent->FrameCount = 0;
-        ent->PageIds    = NULL;
-        ent->Frames     = NULL;
+        cell = index;
     }
 }
 
-void r2d::set_atlas_entry_frame(r2d::atlas_entry_t *ent, size_t frame_index, size_t page_id, r2d::atlas_frame_t const &frame)
+void r2d::tilemap_set_tint(r2d::tilemap_t *map, uint32_t color)
 {
-    assert(frame_index < ent->FrameCount);
-
-    if (frame.Width  > ent->MaxWidth)
-        ent->MaxWidth  = frame.Width;
-
-    if (frame.Height > ent->MaxHeight)
-        ent->MaxHeight = frame.Height;
+    if (map->TintColor != color)
+    {
+        map->TintColor  = color;
+        tilemap_mark_all_dirty(map);
+    }
+}
 
-    if (frame_index > 0 && ent->PageIds[frame_index] != page_id)
-        ent->Flags    |= r2d::ATLAS_ENTRY_MULTIPAGE;
+void r2d::tilemap_set_layer_depth(r2d::tilemap_t *map, uint32_t layer_depth)
+{
+    if (map->LayerDepth != layer_depth)
+    {
+        map->LayerDepth = layer_depth;
+        tilemap_mark_all_dirty(map);
+    }
+}
 
-    ent->PageIds[frame_index] = page_id;
-    ent->Frames [frame_index] = frame;
+uint32_t r2d::tilemap_get_tile(r2d::tilemap_t const *map, size_t x, size_t y)
+{
+    if (x >= map->Width || y >= map->Height)
+        return 0;
+    return map->Tiles[y * map->Width + x];
 }
 
-bool r2d::create_atlas(r2d::atlas_t *atlas, r2d::atlas_config_t const &config)
+size_t r2d::tilemap_update(r2d::tilemap_t *map, size_t max_chunks)
 {
-    if (atlas != NULL)
+    size_t const count = map->ChunksX * map->ChunksY;
+    size_t       built = 0;
+    for (size_t i = 0; i < count && map->DirtyCount > 0; ++i)
     {
-        GLint   nalign         = 4;
-        GLsizei nbytes         = 0;
-        atlas->PageWidth       = config.PageWidth;
-        atlas->PageHeight      = config.PageHeight;
-        atlas->HorizontalPad   = config.HorizontalPad;
-        atlas->VerticalPad     = config.VerticalPad;
-        atlas->EntryCapacity   = 0;
-        atlas->EntryCount      = 0;
-        atlas->EntryList       = NULL;
-        atlas->PageCapacity    = 0;
-        atlas->PageCount       = 0;
-        atlas->TexturePages    = NULL;
-        atlas->BucketCount     = config.ExpectedCount / ATLAS_NAMES_PER_BUCKET;
-        atlas->BucketList      = NULL;
-        atlas->EntryNames      = NULL;
-        atlas->EntryIndices    = NULL;
-        atlas->PageLayout      = config.Layout;
-        atlas->PageFormat      = config.Format;
-        atlas->PageDataType    = config.DataType;
-        atlas->TransferBuffer  = 0;
-        atlas->TransferBytes   = 0;
-        atlas->BufferOffset    = 0;
-        if (atlas->BucketCount < ATLAS_MIN_BUCKET_COUNT)
-            atlas->BucketCount = ATLAS_MIN_BUCKET_COUNT;
-
-        // pre-allocate storage for the entry lookup-by-name table.
-        atlas->BucketList        = (r2d::bucket_t*) malloc(atlas->BucketCount * sizeof(r2d::bucket_t));
-        atlas->EntryNames        = (uint32_t    **) malloc(atlas->BucketCount * sizeof(uint32_t*));
-        atlas->EntryIndices      = (uint32_t    **) malloc(atlas->BucketCount * sizeof(uint32_t*));
-        if (atlas->BucketList   == NULL) goto error_cleanup;
-        if (atlas->EntryNames   == NULL) goto error_cleanup;
-        if (atlas->EntryIndices == NULL) goto error_cleanup;
-        for (size_t i = 0; i < atlas->BucketCount; ++i)
-        {
-            atlas->BucketList[i].Capacity = ATLAS_NAMES_PER_BUCKET;
-            atlas->BucketList[i].Count    = 0;
-            atlas->EntryNames[i]          = (uint32_t*) malloc(ATLAS_NAMES_PER_BUCKET * sizeof(uint32_t));
-            atlas->EntryIndices[i]        = (uint32_t*) malloc(ATLAS_NAMES_PER_BUCKET * sizeof(uint32_t));
-            if (atlas->EntryNames[i]   == NULL) goto error_cleanup;
-            if (atlas->EntryIndices[i] == NULL) goto error_cleanup;
-        }
+        if (max_chunks > 0 && built == max_chunks)
+            break;
+        if (map->Chunks[i].Dirty && tilemap_build_chunk(map, i))
+            built++;
+    }
+    return built;
+}
 
-        // pre-allocate storage for the entry list.
-        if (config.ExpectedCount > 0)
-        {
-            atlas->EntryCapacity = config.ExpectedCount;
-            atlas->EntryCount    = 0;
-            atlas->EntryList     = (r2d::atlas_entry_t*) malloc(config.ExpectedCount * sizeof(r2d::atlas_entry_t));
-            if (atlas->EntryList == NULL) goto error_cleanup;
-        }
+void r2d::tilemap_draw(r2d::tilemap_t *map, gl::sprite_effect_t *effect, float view_x, float view_y, float view_w, float view_h, gl::sprite_effect_apply_t const *fxfuncs, void *context)
+{
+    float  const cw       = float(map->ChunkSize * map->TileWidth);
+    float  const ch       = float(map->ChunkSize * map->TileHeight);
+    float  const right    = view_x + view_w;
+    float  const bottom   = view_y + view_h;
+    size_t const vertices = map->ChunkSize * map->ChunkSize * 4;
+    GLenum const type     = map->IndexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
-        // pre-allocate storage for texture page packers and page texture IDs.
-        atlas->PagePackers  = (r2d::packer_t*) malloc(ATLAS_PAGE_CAPACITY * sizeof(r2d::packer_t));
-        if (atlas->PagePackers == NULL)  goto error_cleanup;
-        atlas->TexturePages = (GLuint*)  malloc(ATLAS_PAGE_CAPACITY * sizeof(GLuint));
-        if (atlas->TexturePages == NULL) goto error_cleanup;
-        atlas->PageCapacity = ATLAS_PAGE_CAPACITY;
-        atlas->PageCount    = 0;
+    memset(&map->Stats, 0, sizeof(r2d::tilemap_stats_t));
+    map->DrawCount = 0;
+    if (view_w <= 0.0f || view_h <= 0.0f || right <= 0.0f || bottom <= 0.0f)
+        return;
 
-        // generate the PBO used to stream data to the GPU.
-        glGenBuffers(1, &atlas->TransferBuffer);
-        if (atlas->TransferBuffer == 0) goto error_cleanup;
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, atlas->TransferBuffer);
-        glGetIntegerv(GL_UNPACK_ALIGNMENT , &nalign);
-        nbytes = gl::bytes_per_slice(config.Format, config.DataType, config.PageWidth, config.PageHeight, size_t(nalign));
-        glBufferData(GL_PIXEL_UNPACK_BUFFER, nbytes, NULL, GL_STREAM_DRAW);
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-        atlas->TransferBytes = size_t(nbytes);
-        atlas->BufferOffset  = 0;
-        return true;
+    // determine the range of chunks intersecting the view rectangle.
+    size_t const cx0 = view_x > 0.0f ? size_t(view_x / cw) : 0;
+    size_t const cy0 = view_y > 0.0f ? size_t(view_y / ch) : 0;
+    size_t       cx1 = size_t(ceilf(right  / cw));
+    size_t       cy1 = size_t(ceilf(bottom / ch));
+    if (cx1 > map->ChunksX) cx1 = map->ChunksX;
+    if (cy1 > map->ChunksY) cy1 = map->ChunksY;
 
-error_cleanup:
-        if (atlas->TransferBuffer != 0)
-        {
-            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-            glDeleteBuffers(1, &atlas->TransferBuffer);
-        }
-        if (atlas->TexturePages != NULL)  free(atlas->TexturePages);
-        if (atlas->PagePackers != NULL)   free(atlas->PagePackers);
-        if (atlas->EntryList != NULL)     free(atlas->EntryList);
-        if (atlas->EntryIndices != NULL)
+    for (size_t cy = cy0; cy < cy1; ++cy)
+    {
+        for (size_t cx = cx0; cx < cx1; ++cx)
         {
-            for (size_t i = 0; i < atlas->BucketCount; ++i)
+            size_t const          index = cy * map->ChunksX + cx;
+            r2d::tilemap_chunk_t &chunk = map->Chunks[index];
+            map->Stats.ChunksVisible++;
+            if (chunk.Dirty)
             {
-                if (atlas->EntryIndices[i] != NULL)
-                {
-                    free(atlas->EntryIndices[i]);
-                    atlas->EntryIndices[i]  = NULL;
-                }
+                if (!tilemap_build_chunk(map, index))
+                    continue;
+                map->Stats.ChunksBuilt++;
             }
-            free(atlas->EntryIndices);
-        }
-        if (atlas->EntryNames != NULL)
-        {
-            for (size_t i = 0; i < atlas->BucketCount; ++i)
+            for (size_t i = 0; i < chunk.RunCount; ++i)
             {
-                if (atlas->EntryNames[i] != NULL)
-                {
-                    free(atlas->EntryNames[i]);
-                    atlas->EntryNames[i]  = NULL;
-                }
+                r2d::tilemap_run_t const &run = chunk.Runs[i];
+                r2d::tilemap_draw_t       draw;
+                draw.Texture    = run.Texture;
+                draw.Count      = GLsizei(run.Count * 6);
+                draw.BaseVertex = GLint(index * vertices);
+                draw.Offset     = size_t(run.First) * 6 * map->IndexSize;
+                if (!tilemap_push_draw(map, draw))
+                    break;
             }
-            free(atlas->EntryNames);
+            map->Stats.QuadsDrawn += chunk.QuadCount;
         }
-        if (atlas->BucketList != NULL)
+    }
+    if (map->DrawCount == 0)
+        return;
+
+    std::sort(map->Draws, map->Draws + map->DrawCount, tilemap_draw_order());
+    gl::gpu_scope_begin("tilemap_draw");
+
+    // offset the projection by the view position while the effect is set up.
+    float saved[16];
+    float *proj = effect->Projection;
+    size_t saved_offset = effect->ConstantOffset;
+    memcpy(saved, proj, sizeof(saved));
+    for (size_t r = 0; r < 4; ++r)
+    {
+        proj[12 + r] = saved[12 + r] - (saved[r] * view_x) - (saved[4 + r] * view_y);
+    }
+    gl::sprite_effect_update_constants(effect);
+    fxfuncs->SetupEffect(effect, context);
+    effect->CurrentState = 0xFFFFFFFFU;
+    gl::state_bind_vertex_array(map->VertexArray);
+
+    for (size_t i = 0; i < map->DrawCount; )
+    {
+        GLuint const tex = map->Draws[i].Texture;
+        GLsizei      n   = 0;
+        for ( ; i < map->DrawCount && map->Draws[i].Texture == tex; ++i, ++n)
         {
-            free(atlas->BucketList);
+            map->DrawCounts [n] = map->Draws[i].Count;
+            map->DrawOffsets[n] = GL_BUFFER_OFFSET(map->Draws[i].Offset);
+            map->DrawBases  [n] = map->Draws[i].BaseVertex;
         }
-        atlas->EntryCapacity  = 0;
-        atlas->EntryCount     = 0;
-        atlas->EntryList      = NULL;
-        atlas->PageCapacity   = 0;
-        atlas->PageCount      = 0;
-        atlas->PagePackers    = NULL;
-        atlas->TexturePages   = NULL;
-        atlas->BucketCount    = 0;
-        atlas->BucketList     = NULL;
-        atlas->EntryNames     = NULL;
-        atlas->EntryIndices   = NULL;
-        atlas->TransferBuffer = 0;
-        atlas->TransferBytes  = 0;
-        atlas->BufferOffset   = 0;
+        fxfuncs->ApplyState(effect, uint32_t(tex), context);
+        effect->CurrentState = uint32_t(tex);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, map->DrawCounts, type, map->DrawOffsets, n, map->DrawBases);
+        map->Stats.DrawCalls++;
+    }
+    memcpy(proj, saved, sizeof(saved));
+    effect->ConstantOffset = saved_offset;
+    gl::gpu_scope_end();
+}
+
+bool r2d::create_particle_system(r2d::particle_system_t *sys, size_t capacity)
+{
+    size_t const padded = (capacity + 3) & ~size_t(3);
+    size_t const stream = padded * sizeof(float);
+    uint8_t     *base   = NULL;
+
+    memset(sys, 0, sizeof(r2d::particle_system_t));
+    if (capacity == 0)
+        return false;
+
+    sys->Block = malloc(stream * PARTICLE_STREAM_COUNT + PARTICLE_ALIGNMENT);
+    if (sys->Block == NULL)
         return false;
+
+    // align the arrays for SSE loads and zero the padding lanes.
+    base = (uint8_t*) sys->Block;
+    base+= (PARTICLE_ALIGNMENT - (uintptr_t(base) & (PARTICLE_ALIGNMENT - 1))) & (PARTICLE_ALIGNMENT - 1);
+    memset(base, 0, stream * PARTICLE_STREAM_COUNT);
+    sys->Capacity      = capacity;
+    sys->Count         = 0;
+    sys->PositionX     = (float*) (base + stream * 0);
+    sys->PositionY     = (float*) (base + stream * 1);
+    sys->VelocityX     = (float*) (base + stream * 2);
+    sys->VelocityY     = (float*) (base + stream * 3);
+    sys->Age           = (float*) (base + stream * 4);
+    sys->InvLifetime   = (float*) (base + stream * 5);
+    sys->Gravity[0]    = 0.0f;
+    sys->Gravity[1]    = 0.0f;
+    sys->Drag          = 0.0f;
+    for (size_t c = 0; c < 4; ++c)
+    {
+        sys->ColorStart[c] = 1.0f;
+        sys->ColorEnd  [c] = 1.0f;
+    }
+    sys->SizeStart     = 1.0f;
+    sys->SizeEnd       = 1.0f;
+    sys->UV[0]         = 0.0f;
+    sys->UV[1]         = 1.0f;
+    sys->UV[2]         = 1.0f;
+    sys->UV[3]         = 0.0f;
+    sys->Layer         = 0.0f;
+    sys->Texture       = 0;
+    sys->RenderState   = 0;
+    sys->LayerDepth    = 0;
+    sys->Seed          = 0x9E3779B9U;
+    return true;
+}
+
+void r2d::delete_particle_system(r2d::particle_system_t *sys)
+{
+    if (sys->Block != NULL) free(sys->Block);
+    memset(sys, 0, sizeof(r2d::particle_system_t));
+}
+
+void r2d::particle_system_set_source(r2d::particle_system_t *sys, r2d::atlas_t const *atlas, r2d::atlas_entry_t const *entry, size_t frame, uint32_t render_state)
+{
+    gl::sprite_t       sprite;
+    GLuint       const tex = r2d::atlas_sprite_source(atlas, entry, frame, &sprite);
+    float        const su  = 1.0f / float(sprite.TextureWidth);
+    float        const sv  = 1.0f / float(sprite.TextureHeight);
+    sys->UV[0]       = float(sprite.ImageX) * su;
+    sys->UV[1]       = 1.0f - (float(sprite.ImageY) * sv);
+    sys->UV[2]       = float(sprite.ImageX + sprite.ImageWidth) * su;
+    sys->UV[3]       = 1.0f - (float(sprite.ImageY + sprite.ImageHeight) * sv);
+    sys->Layer       = float(sprite.ImageLayer);
+    sys->Texture     = tex;
+    sys->RenderState = render_state;
+}
+
+size_t r2d::particle_system_spawn(r2d::particle_system_t *sys, r2d::particle_spawn_t const &spawn, size_t count)
+{
+    size_t const avail = sys->Capacity - sys->Count;
+    if (count > avail)  count = avail;
+
+    uint32_t seed = sys->Seed;
+    for (size_t i = sys->Count, n = sys->Count + count; i < n; ++i)
+    {
+        float life = spawn.Lifetime + spawn.LifeJitter * particle_random(seed);
+        if   (life < 1.0e-4f) life = 1.0e-4f;
+        sys->PositionX  [i] = spawn.X;
+        sys->PositionY  [i] = spawn.Y;
+        sys->VelocityX  [i] = spawn.VelocityX + spawn.VelocityJitter * particle_random(seed);
+        sys->VelocityY  [i] = spawn.VelocityY + spawn.VelocityJitter * particle_random(seed);
+        sys->Age        [i] = 0.0f;
+        sys->InvLifetime[i] = 1.0f / life;
+    }
+    sys->Seed   = seed;
+    sys->Count += count;
+    return count;
+}
+
+size_t r2d::particle_system_update(r2d::particle_system_t *sys, float dt)
+{
+    float  damp = 1.0f - sys->Drag * dt;
+    float  gx   = sys->Gravity[0] * dt;
+    float  gy   = sys->Gravity[1] * dt;
+    size_t n    = sys->Count;
+    bool   dead = false;
+    if (damp < 0.0f) damp = 0.0f;
+
+#if GLDRAW2D_USE_SSE2
+    // the arrays are padded to a multiple of four, so the last group may
+    // safely read and write the unused lanes past sys->Count.
+    __m128 const dt4   = _mm_set1_ps(dt);
+    __m128 const damp4 = _mm_set1_ps(damp);
+    __m128 const gx4   = _mm_set1_ps(gx);
+    __m128 const gy4   = _mm_set1_ps(gy);
+    __m128 const one4  = _mm_set1_ps(1.0f);
+    int          mask  = 0;
+    for (size_t i = 0; i < n; i += 4)
+    {
+        __m128 vx  = _mm_mul_ps(_mm_add_ps(_mm_load_ps(&sys->VelocityX[i]), gx4), damp4);
+        __m128 vy  = _mm_mul_ps(_mm_add_ps(_mm_load_ps(&sys->VelocityY[i]), gy4), damp4);
+        __m128 px  = _mm_add_ps(_mm_load_ps(&sys->PositionX[i]), _mm_mul_ps(vx, dt4));
+        __m128 py  = _mm_add_ps(_mm_load_ps(&sys->PositionY[i]), _mm_mul_ps(vy, dt4));
+        __m128 age = _mm_add_ps(_mm_load_ps(&sys->Age[i]), dt4);
+        __m128 t   = _mm_mul_ps(age, _mm_load_ps(&sys->InvLifetime[i]));
+        _mm_store_ps(&sys->VelocityX[i], vx);
+        _mm_store_ps(&sys->VelocityY[i], vy);
+        _mm_store_ps(&sys->PositionX[i], px);
+        _mm_store_ps(&sys->PositionY[i], py);
+        _mm_store_ps(&sys->Age      [i], age);
+        mask |= _mm_movemask_ps(_mm_cmpge_ps(t, one4)) & (n - i >= 4 ? 0xF : int((1U << (n - i)) - 1));
+    }
+    dead = (mask != 0);
+#else
+    for (size_t i = 0; i < n; ++i)
+    {
+        sys->VelocityX[i] = (sys->VelocityX[i] + gx) * damp;
+        sys->VelocityY[i] = (sys->VelocityY[i] + gy) * damp;
+        sys->PositionX[i] =  sys->PositionX[i] + sys->VelocityX[i] * dt;
+        sys->PositionY[i] =  sys->PositionY[i] + sys->VelocityY[i] * dt;
+        sys->Age      [i] =  sys->Age[i] + dt;
+        dead = dead || (sys->Age[i] * sys->InvLifetime[i] >= 1.0f);
+    }
+#endif
+
+    if (!dead)
+        return 0;
+
+    // swap-remove dead particles; the moved particle is tested in turn.
+    for (size_t i = 0; i < n; )
+    {
+        if (sys->Age[i] * sys->InvLifetime[i] >= 1.0f)
+        {
+            size_t const last = --n;
+            sys->PositionX  [i] = sys->PositionX  [last];
+            sys->PositionY  [i] = sys->PositionY  [last];
+            sys->VelocityX  [i] = sys->VelocityX  [last];
+            sys->VelocityY  [i] = sys->VelocityY  [last];
+            sys->Age        [i] = sys->Age        [last];
+            sys->InvLifetime[i] = sys->InvLifetime[last];
+        }
+        else ++i;
     }
-    else return false;
+    size_t const removed = sys->Count - n;
+    sys->Count = n;
+    return removed;
 }
 
-void r2d::delete_atlas(r2d::atlas_t *atlas)
+void r2d::particle_system_write_vertices(r2d::particle_system_t const *sys, gl::sprite_vertex_ptc_t *buffer, size_t first, size_t count)
 {
-    if (atlas != NULL)
+    float    const depth = float(sys->LayerDepth < 0xFFFFFFU ? sys->LayerDepth : 0xFFFFFFU) * (1.0f / 16777216.0f);
+    size_t   const end   = first + count;
+    size_t         i     = first;
+    float          rect[4];
+    uint32_t       color;
+
+#if GLDRAW2D_USE_SSE2
+    // process single particles up to a group boundary, then four at a time.
+    for ( ; i < end && (i & 3) != 0; ++i, buffer += 4)
     {
-        if (atlas->TransferBuffer != 0)
-        {   // if the buffer is in use, it will be
-            // deleted when the GPU is finished with it.
-            glDeleteBuffers(1, &atlas->TransferBuffer);
-        }
-        if (atlas->TexturePages != NULL)
-        {
-            if (atlas->PageCount > 0)
-            {   // any textures in use will be deleted when the GPU is done with them.
-                glDeleteTextures(GLsizei(atlas->PageCount), atlas->TexturePages);
-            }
-            free(atlas->TexturePages);
-        }
-        if (atlas->PagePackers != NULL)
-        {
-            for (size_t i = 0; i < atlas->PageCount; ++i)
-            {
-                r2d::delete_packer(&atlas->PagePackers[i]);
-            }
-            free(atlas->PagePackers);
-        }
-        if (atlas->EntryList != NULL)
-        {
-            free(atlas->EntryList);
-        }
-        if (atlas->EntryIndices != NULL)
-        {
-            for (size_t i = 0; i < atlas->BucketCount; ++i)
-            {
-                if (atlas->EntryIndices[i] != NULL)
-                {
-                    free(atlas->EntryIndices[i]);
-                    atlas->EntryIndices[i]  = NULL;
-                }
-            }
-            free(atlas->EntryIndices);
-        }
-        if (atlas->EntryNames != NULL)
+        particle_quad(sys, i, rect, color);
+        particle_vertices(sys, buffer, rect, color, depth);
+    }
+    __m128  const one4  = _mm_set1_ps(1.0f);
+    __m128  const half4 = _mm_set1_ps(0.5f);
+    __m128  const s04   = _mm_set1_ps(sys->SizeStart);
+    __m128  const ds4   = _mm_set1_ps(sys->SizeEnd - sys->SizeStart);
+    __m128        c04[4];
+    __m128        dc4[4];
+    float   const u0    = sys->UV[0];
+    float   const v0    = sys->UV[1];
+    float   const u1    = sys->UV[2];
+    float   const v1    = sys->UV[3];
+    float   const ly    = sys->Layer;
+    float   const dp    = depth;
+    for (size_t c = 0; c < 4; ++c)
+    {   // pre-scale the colors to [0, 255], with rounding.
+        c04[c] = _mm_set1_ps(sys->ColorStart[c] * 255.0f + 0.5f);
+        dc4[c] = _mm_set1_ps((sys->ColorEnd[c] - sys->ColorStart[c]) * 255.0f);
+    }
+    for ( ; i < end; i += 4)
+    {
+        float    LTRB[4][4];
+        uint32_t ABGR[4];
+        __m128   t    = _mm_min_ps(_mm_mul_ps(_mm_load_ps(&sys->Age[i]), _mm_load_ps(&sys->InvLifetime[i])), one4);
+        __m128   half = _mm_mul_ps(_mm_add_ps(s04, _mm_mul_ps(ds4, t)), half4);
+        __m128   px   = _mm_load_ps(&sys->PositionX[i]);
+        __m128   py   = _mm_load_ps(&sys->PositionY[i]);
+        __m128i  clr  = _mm_setzero_si128();
+        for (int c = 0; c < 4; ++c)
         {
-            for (size_t i = 0; i < atlas->BucketCount; ++i)
-            {
-                if (atlas->EntryNames[i] != NULL)
-                {
-                    free(atlas->EntryNames[i]);
-                    atlas->EntryNames[i]  = NULL;
-                }
+            __m128i v = _mm_cvttps_epi32(_mm_add_ps(c04[c], _mm_mul_ps(dc4[c], t)));
+            switch (c)
+            {   // shift counts must be compile-time constants.
+                case 0: clr = _mm_or_si128(clr, v); break;
+                case 1: clr = _mm_or_si128(clr, _mm_slli_epi32(v,  8)); break;
+                case 2: clr = _mm_or_si128(clr, _mm_slli_epi32(v, 16)); break;
+                case 3: clr = _mm_or_si128(clr, _mm_slli_epi32(v, 24)); break;
             }
-            free(atlas->EntryNames);
         }
-        if (atlas->BucketList != NULL)
+        _mm_storeu_ps(LTRB[0], _mm_sub_ps(px, half));
+        _mm_storeu_ps(LTRB[1], _mm_sub_ps(py, half));
+        _mm_storeu_ps(LTRB[2], _mm_add_ps(px, half));
+        _mm_storeu_ps(LTRB[3], _mm_add_ps(py, half));
+        _mm_storeu_si128((__m128i*) ABGR, clr);
+
+        // each quad is 28 floats; write it with seven unaligned stores.
+        size_t const lanes = (end - i) < 4 ? (end - i) : 4;
+        for (size_t k = 0; k < lanes; ++k, buffer += 4)
         {
-            free(atlas->BucketList);
+            float const l = LTRB[0][k];
+            float const t = LTRB[1][k];
+            float const r = LTRB[2][k];
+            float const b = LTRB[3][k];
+            float       c;
+            memcpy(&c, &ABGR[k], sizeof(float));
+            float      *d = (float*) buffer;
+            _mm_storeu_ps(d +  0, _mm_setr_ps(l , t , u0, v0));
+            _mm_storeu_ps(d +  4, _mm_setr_ps(c , dp, ly, r ));
+            _mm_storeu_ps(d +  8, _mm_setr_ps(t , u1, v0, c ));
+            _mm_storeu_ps(d + 12, _mm_setr_ps(dp, ly, r , b ));
+            _mm_storeu_ps(d + 16, _mm_setr_ps(u1, v1, c , dp));
+            _mm_storeu_ps(d + 20, _mm_setr_ps(ly, l , b , u0));
+            _mm_storeu_ps(d + 24, _mm_setr_ps(v1, c , dp, ly));
         }
-        atlas->EntryCapacity     = 0;
-        atlas->EntryCount        = 0;
-        atlas->EntryList         = NULL;
-        atlas->PageCapacity      = 0;
-        atlas->PageCount         = 0;
-        atlas->PagePackers       = NULL;
-        atlas->TexturePages      = NULL;
-        atlas->BucketCount       = 0;
-        atlas->BucketList        = NULL;
-        atlas->EntryNames        = NULL;
-        atlas->EntryIndices      = NULL;
-        atlas->TransferBuffer    = 0;
-        atlas->TransferBytes     = 0;
-        atlas->BufferOffset      = 0;
     }
+#else
+    for ( ; i < end; ++i, buffer += 4)
+    {
+        particle_quad(sys, i, rect, color);
+        particle_vertices(sys, buffer, rect, color, depth);
+    }
+#endif
 }
 
-void r2d::freeze_atlas(r2d::atlas_t *atlas)
+size_t r2d::particle_system_draw(r2d::particle_system_t *sys, gl::sprite_effect_t *effect, gl::sprite_effect_apply_t const *fxfuncs, void *context)
 {
-    if (atlas->TransferBuffer != 0)
+    size_t const total = sys->Count;
+    size_t       first = 0;
+
+    if (total == 0)
+        return 0;
+
+    gl::gpu_scope_begin("particle_system_draw");
+    effect->Pass = gl::SPRITE_PASS_ALL;
+    fxfuncs->SetupEffect(effect, context);
+    fxfuncs->ApplyState(effect, sys->RenderState, context);
+    effect->CurrentState = sys->RenderState;
+    while (first < total)
     {
-        glDeleteBuffers(1, &atlas->TransferBuffer);
-        atlas->TransferBuffer  = 0;
-        atlas->TransferBytes   = 0;
-        atlas->BufferOffset    = 0;
+        size_t count = 0;
+        gl::sprite_vertex_ptc_t *v_data = sprite_effect_map_quads(effect, total - first, count);
+        if (v_data == NULL)
+            break;
+        r2d::particle_system_write_vertices(sys, v_data, first, count);
+        if (!sprite_effect_draw_quads(effect, count))
+            break;
+        first += count;
     }
-    if (atlas->PagePackers != NULL)
+    gl::gpu_scope_end();
+    return first;
+}
+
+bool r2d::create_text_cache(r2d::text_cache_t *cache, size_t capacity)
+{
+    if (capacity == 0)
+        capacity = TEXT_CACHE_CAPACITY;
+
+    cache->Capacity   = 0;
+    cache->Count      = 0;
+    cache->Layouts    = NULL;
+    cache->FrameStamp = 1;
+    cache->Hits       = 0;
+    cache->Misses     = 0;
+    cache->Evictions  = 0;
+    if (!hash::create_table(&cache->Table, capacity))
+        return false;
+
+    cache->Layouts = (r2d::text_layout_t*) malloc(capacity * sizeof(r2d::text_layout_t));
+    if (cache->Layouts == NULL)
     {
-        for (size_t i = 0; i < atlas->PageCount; ++i)
-        {
-            r2d::delete_packer(&atlas->PagePackers[i]);
-        }
-        free(atlas->PagePackers);
-        atlas->PagePackers = NULL;
+        hash::delete_table(&cache->Table);
+        return false;
     }
+    cache->Capacity = capacity;
+    return true;
 }
 
-r2d::atlas_entry_t* r2d::find_atlas_entry(r2d::atlas_t *atlas, uint32_t name)
+void r2d::delete_text_cache(r2d::text_cache_t *cache)
 {
-    size_t   const  bucket_index = hash_u32(name)  % atlas->BucketCount;
-    size_t   const  bucket_size  = atlas->BucketList[bucket_index].Count;
-    uint32_t const *bucket_names = atlas->EntryNames[bucket_index];
-    for (size_t  i = 0; i < bucket_size; ++i)
+    for (size_t i = 0; i < cache->Count; ++i)
     {
-        if (name == bucket_names[i])
-        {
-            uint32_t value_index = atlas->EntryIndices[bucket_index][i];
-            return &atlas->EntryList[value_index];
-        }
+        r2d::text_layout_t &L = cache->Layouts[i];
+        if (L.Text     != NULL) free(L.Text);
+        if (L.Vertices != NULL) free(L.Vertices);
+        if (L.Placed   != NULL) free(L.Placed);
+        if (L.Runs     != NULL) free(L.Runs);
     }
-    return NULL;
+    if (cache->Layouts != NULL) free(cache->Layouts);
+    hash::delete_table(&cache->Table);
+    cache->Capacity = 0;
+    cache->Count    = 0;
+    cache->Layouts  = NULL;
 }
 
-r2d::atlas_entry_t* r2d::get_atlas_entry(r2d::atlas_t *atlas, size_t index)
+void r2d::text_cache_begin_frame(r2d::text_cache_t *cache)
 {
-    return &atlas->EntryList[index];
+    cache->FrameStamp++;
 }
 
-r2d::atlas_entry_t* r2d::atlas_create_entry(r2d::atlas_t *atlas, uint32_t name, size_t frame_count, size_t *out_index)
+r2d::text_layout_t* r2d::text_cache_layout(r2d::text_cache_t *cache, gui::bitmap_font_t const *font, char const *str, float wrap_width)
 {
-    if (atlas->EntryCount == atlas->EntryCapacity)
-    {   // grow storage for the entry definitions.
-        size_t newc = atlas->EntryCapacity > 4096 ? atlas->EntryCapacity + 512 : atlas->EntryCapacity * 2;
-        void  *newl = realloc(atlas->EntryList, newc * sizeof(r2d::atlas_entry_t));
-        if (newl != NULL)
+    if (str == NULL) str = "";
+    if (wrap_width < 0.0f) wrap_width = 0.0f;
+
+    size_t   const length = strlen(str);
+    uint32_t const key    = text_layout_key(font, str, length, wrap_width);
+    uint32_t       index  = 0;
+    r2d::text_layout_t *L = NULL;
+
+    if (hash::table_get(&cache->Table, key, &index))
+    {
+        L = &cache->Layouts[index];
+        if (L->Font == font && L->WrapWidth == wrap_width && L->Length == length && memcmp(L->Text, str, length) == 0)
         {
-            atlas->EntryCapacity = newc;
-            atlas->EntryList     = (r2d::atlas_entry_t*) newl;
+            L->LastUsed = cache->FrameStamp;
+            cache->Hits++;
+            return L;
         }
-        else return NULL;
+        // else, a hash collision; replace the existing layout.
     }
-
-    size_t const entry_id  = atlas->EntryCount;
-    size_t const bucket_id = hash_u32(name) % atlas->BucketCount;
-    size_t const bucket_n  = atlas->BucketList[bucket_id].Count;
-    if (bucket_n == atlas->BucketList[bucket_id].Capacity)
-    {   // grow storage for the entry name lookup table.
-        size_t newc = bucket_n + 32;
-        void  *newn = realloc(atlas->EntryNames  [bucket_id], newc * sizeof(uint32_t));
-        void  *newi = realloc(atlas->EntryIndices[bucket_id], newc * sizeof(uint32_t));
-        if (newn != NULL) atlas->EntryNames  [bucket_id]   = (uint32_t*) newn;
-        if (newi != NULL) atlas->EntryIndices[bucket_id]   = (uint32_t*) newi;
-        if (newn != NULL && newi != NULL) atlas->BucketList[bucket_id].Capacity = newc;
-        else return NULL;
+    else
+    {
+        if (!text_cache_slot(cache, index))
+            return NULL;
+        if (!hash::table_put(&cache->Table, key, index))
+            goto error_cleanup;
+        L = &cache->Layouts[index];
     }
 
-    r2d::atlas_entry_t *e = &atlas->EntryList[entry_id];
-    if (!r2d::create_atlas_entry(e, name , frame_count))
-    {   // failed to allocate storage for frame data for the entry.
-        return NULL;
+    if (L->Length < length || L->Text == NULL)
+    {
+        char *text = (char*) realloc(L->Text, length + 1);
+        if (text == NULL) goto error_cleanup;
+        L->Text = text;
     }
-    if (out_index) *out_index = entry_id;
+    memcpy(L->Text, str, length + 1);
+    L->Key       = key;
+    L->LastUsed  = cache->FrameStamp;
+    L->Font      = font;
+    L->WrapWidth = wrap_width;
+    L->Length    = length;
+    if (!text_layout_build(L))
+        goto error_cleanup;
+    cache->Misses++;
+    return L;
 
-    size_t const  idx = atlas->BucketList[bucket_id].Count;
-    atlas->EntryNames  [bucket_id][idx] = name;
-    atlas->EntryIndices[bucket_id][idx] = uint32_t(entry_id);
-    atlas->BucketList  [bucket_id].Count++;
-    atlas->EntryCount++;
-    return e;
+error_cleanup:
+    // leave the slot empty; it is selected again by the next eviction.
+    hash::table_remove(&cache->Table, key);
+    cache->Layouts[index].Font     = NULL;
+    cache->Layouts[index].Length   = 0;
+    cache->Layouts[index].LastUsed = 0;
+    return NULL;
 }
 
-r2d::atlas_entry_t* r2d::atlas_create_entry(r2d::atlas_t *atlas, uint32_t name, size_t frame_count, size_t const *frame_widths, size_t const *frame_heights, size_t *out_index)
+void r2d::text_layout_write_vertices(r2d::text_layout_t *layout, gl::sprite_vertex_ptc_t *buffer, float x, float y, float scale, uint32_t color, uint32_t layer_depth)
 {
-    return r2d::atlas_create_entry(atlas, name, frame_count, frame_widths, frame_heights, atlas->HorizontalPad, atlas->VerticalPad, out_index);
+    text_layout_place(layout, x, y, scale, color, layer_depth);
+    memcpy(buffer, layout->Placed, layout->QuadCount * 4 * sizeof(gl::sprite_vertex_ptc_t));
 }
 
-r2d::atlas_entry_t* r2d::atlas_create_entry(r2d::atlas_t *atlas, uint32_t name, size_t frame_count, size_t const *frame_widths, size_t const *frame_heights, size_t hpad, size_t vpad, size_t *out_index)
+size_t r2d::text_draw(r2d::text_layout_t *layout, gl::sprite_effect_t *effect, float x, float y, float scale, uint32_t color, uint32_t layer_depth, GLuint const *page_textures, gl::sprite_effect_apply_t const *fxfuncs, void *context)
 {
-    // TODO: maybe want to use this opportunity to be smarter and reduce chances
-    // for failure by pre-allocating the necessary storage instead of possibly
-    // performing multiple allocations and ending up with partially-valid state.
-    r2d::atlas_entry_t *ae = r2d::atlas_create_entry(atlas, name, frame_count, out_index);
-    if (ae != NULL)
+    size_t drawn = 0;
+
+    if (layout == NULL || layout->QuadCount == 0)
+        return 0;
+
+    text_layout_place(layout, x, y, scale, color, layer_depth);
+    gl::gpu_scope_begin("text_draw");
+    effect->Pass = gl::SPRITE_PASS_ALL;
+    fxfuncs->SetupEffect(effect, context);
+    effect->CurrentState = 0xFFFFFFFFU;
+    for (size_t i = 0; i < layout->RunCount; ++i)
     {
-        for (size_t i = 0; i < frame_count; ++i)
+        r2d::text_run_t const &run = layout->Runs[i];
+        uint32_t const texture = page_textures[run.Page];
+        size_t         first   = run.First;
+        size_t const   last    = run.First + run.Count;
+
+        if (effect->CurrentState != texture)
+        {   // pages stored in a texture array share a single state change.
+            fxfuncs->ApplyState(effect, texture, context);
+            effect->CurrentState = texture;
+        }
+        while (first < last)
         {
-            r2d::atlas_place_frame(atlas, ae, i, frame_widths[i], frame_heights[i], hpad, vpad);
+            size_t count = 0;
+            gl::sprite_vertex_ptc_t *v_data = sprite_effect_map_quads(effect, last - first, count);
+            if (v_data == NULL)
+                goto draw_done;
+            memcpy(v_data, &layout->Placed[first * 4], count * 4 * sizeof(gl::sprite_vertex_ptc_t));
+            if (!sprite_effect_draw_quads(effect, count))
+                goto draw_done;
+            first += count;
+            drawn += count;
         }
     }
-    return ae;
-}
 
-bool r2d::atlas_place_frame(r2d::atlas_t *atlas, r2d::atlas_entry_t *entry, size_t frame, size_t w, size_t h)
-{
-    return r2d::atlas_place_frame(atlas, entry, frame, w, h, atlas->HorizontalPad, atlas->VerticalPad);
+draw_done:
+    gl::gpu_scope_end();
+    return drawn;
 }
 
-bool r2d::atlas_place_frame(r2d::atlas_t *atlas, r2d::atlas_entry_t *entry, size_t frame, size_t w, size_t h, size_t hpad, size_t vpad)
+bool r2d::create_sprite_grid(r2d::sprite_grid_t *grid, float origin_x, float origin_y, float width, float height, float cell_size, size_t expected_count)
 {
-    size_t frame_width  = w + (hpad * 2);
-    size_t frame_height = h + (vpad * 2);
-
-    if (frame_width > atlas->PageWidth || frame_height > atlas->PageHeight)
-    {   // no texture page can be large enough to hold this frame.
-        return false;
-    }
-    if (atlas->PagePackers == NULL)
-    {   // the atlas has been frozen, no data can be added.
+    memset(grid, 0, sizeof(r2d::sprite_grid_t));
+    if (cell_size <= 0.0f || width <= 0.0f || height <= 0.0f)
         return false;
+
+    grid->OriginX       = origin_x;
+    grid->OriginY       = origin_y;
+    grid->CellSize      = cell_size;
+    grid->InvCellSize   = 1.0f / cell_size;
+    grid->CellsX        = size_t(ceilf(width  / cell_size));
+    grid->CellsY        = size_t(ceilf(height / cell_size));
+    grid->OverflowLimit = SPRITE_GRID_OVERFLOW;
+    grid->FreeHandle    = SPRITE_GRID_NONE;
+    grid->Cells         = (r2d::sprite_cell_t*) calloc(grid->CellsX * grid->CellsY, sizeof(r2d::sprite_cell_t));
+    if (grid->Cells == NULL)
+        goto error_cleanup;
+
+    if (expected_count > 0)
+    {
+        grid->Sprites    = (gl::sprite_t*) malloc(expected_count * sizeof(gl::sprite_t));
+        grid->SlotHandle = (uint32_t*)     malloc(expected_count * sizeof(uint32_t));
+        grid->HandleSlot = (uint32_t*)     malloc(expected_count * sizeof(uint32_t));
+        grid->HandleCell = (uint32_t*)     malloc(expected_count * sizeof(uint32_t));
+        if (grid->Sprites == NULL || grid->SlotHandle == NULL || grid->HandleSlot == NULL || grid->HandleCell == NULL)
+            goto error_cleanup;
+        grid->SlotCapacity   = expected_count;
+        grid->HandleCapacity = expected_count;
     }
+    return true;
 
-    size_t const nump = atlas->PageCount;
-    size_t page_index = nump - 1;
-    while (page_index < nump)
+error_cleanup:
+    r2d::delete_sprite_grid(grid);
+    return false;
+}
+
+void r2d::delete_sprite_grid(r2d::sprite_grid_t *grid)
+{
+    if (grid->HandleCell != NULL) free(grid->HandleCell);
+    if (grid->HandleSlot != NULL) free(grid->HandleSlot);
+    if (grid->SlotHandle != NULL) free(grid->SlotHandle);
+    if (grid->Sprites    != NULL) free(grid->Sprites);
+    if (grid->Cells      != NULL) free(grid->Cells);
+    memset(grid, 0, sizeof(r2d::sprite_grid_t));
+}
+
+bool r2d::sprite_grid_insert(r2d::sprite_grid_t *grid, gl::sprite_t const *sprite, uint32_t *out_handle)
+{
+    uint32_t handle = grid->FreeHandle;
+    if (handle == SPRITE_GRID_NONE)
     {
-        r2d::pkrect_t   rect;
-        r2d::packer_t  *pack = &atlas->PagePackers[page_index];
-        if (r2d::packer_insert(pack, w, h, hpad, vpad, entry->Name, &rect))
-        {   // the frame was successfully placed on this page.
-            // note that rect is the unpadded content rectangle.
-            r2d::atlas_frame_t  eframe = {
-                rect.X,
-                rect.Y,
-                rect.Width,
-                rect.Height
-            };
-            r2d::set_atlas_entry_frame(entry, frame, page_index, eframe);
-            return true;
+        if (grid->HandleCount == grid->HandleCapacity)
+        {
+            size_t newc = grid->HandleCapacity ? grid->HandleCapacity * 2 : 64;
+            uint32_t *slots = (uint32_t*) realloc(grid->HandleSlot, newc * sizeof(uint32_t));
+            if (slots == NULL) return false;
+            grid->HandleSlot = slots;
+            uint32_t *cells = (uint32_t*) realloc(grid->HandleCell, newc * sizeof(uint32_t));
+            if (cells == NULL) return false;
+            grid->HandleCell = cells;
+            grid->HandleCapacity = newc;
         }
-        // decrement at page_index = 0 will cause wrap-around.
-        // page_index in this case will then be > npages.
-        page_index--;
+        handle = uint32_t(grid->HandleCount++);
     }
+    else grid->FreeHandle = grid->HandleSlot[handle];
 
-    // we were unable to find a page on which to place the frame, so allocate a new page.
-    if (atlas->PageCount == atlas->PageCapacity)
-    {   // allocate additional storage. we'll initialize as-needed.
-        size_t newc = atlas->PageCapacity + ATLAS_PAGE_CAPACITY;
-        void  *newp = realloc(atlas->PagePackers , newc * sizeof(r2d::packer_t));
-        void  *newt = realloc(atlas->TexturePages, newc * sizeof(GLuint));
-        if (newp != NULL) atlas->PagePackers  = (r2d::packer_t*) newp;
-        if (newt != NULL) atlas->TexturePages = (GLuint*) newt;
-        if (newp != NULL && newt != NULL) atlas->PageCapacity = newc;
+    if (!sprite_grid_link(grid, handle, sprite_grid_cell(grid, *sprite), sprite))
+    {   // return the handle to the free list.
+        grid->HandleCell[handle] = SPRITE_GRID_NONE;
+        grid->HandleSlot[handle] = grid->FreeHandle;
+        grid->FreeHandle = handle;
+        return false;
     }
+    grid->Count++;
+    *out_handle = handle;
+    return true;
+}
 
-    size_t const page_width  = atlas->PageWidth;
-    size_t const page_height = atlas->PageHeight;
-    size_t const page_id     = atlas->PageCount;
+bool r2d::sprite_grid_update(r2d::sprite_grid_t *grid, uint32_t handle, gl::sprite_t const *sprite)
+{
+    if (handle >= grid->HandleCount || grid->HandleCell[handle] == SPRITE_GRID_NONE)
+        return false;
 
-    // create texture storage for the new texture page.
-    GLuint tex  = 0;
-    glGenTextures(1, &tex);
-    if (tex == 0) return false;
-    glBindTexture(GL_TEXTURE_2D, tex);
-    gl::texture_storage(GL_TEXTURE_2D, atlas->PageFormat, atlas->PageDataType, GL_CLAMP_TO_EDGE , GL_CLAMP_TO_EDGE, page_width, page_height, 1, 1);
+    uint32_t const cell = sprite_grid_cell(grid, *sprite);
+    if (cell == grid->HandleCell[handle])
+    {   // the sprite remains in the same cell or overflow slot.
+        float const extent = sprite_extent(*sprite);
+        if (grid->MaxExtent < extent) grid->MaxExtent = extent;
+        grid->Sprites[grid->HandleSlot[handle]] = *sprite;
+        return true;
+    }
+    // sprite_grid_link() cannot fail here if the sprite leaves the overflow
+    // region, and otherwise it reserves space before the sprite is unlinked.
+    if (grid->HandleSlot[handle] < grid->PackedCount && !sprite_grid_reserve_overflow(grid))
+        return false;
+    sprite_grid_unlink(grid, handle);
+    sprite_grid_link(grid, handle, cell, sprite);
+    grid->Stats.CellMoves++;
+    return true;
+}
 
-    // initialize a new rectangle packer for placing sub-images.
-    if (!r2d::create_packer(&atlas->PagePackers[page_id], page_width, page_height, ATLAS_DEFAULT_CAPACITY))
-    {   // unable to initialize the packer, so delete the texture page.
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glDeleteTextures(1, &tex);
+bool r2d::sprite_grid_remove(r2d::sprite_grid_t *grid, uint32_t handle)
+{
+    if (handle >= grid->HandleCount || grid->HandleCell[handle] == SPRITE_GRID_NONE)
         return false;
-    }
 
-    r2d::pkrect_t  rect;
-    r2d::packer_t *pack = &atlas->PagePackers[page_id];
-    r2d::packer_insert(pack, w, h, hpad, vpad, entry->Name, &rect);
-    r2d::atlas_frame_t eframe = { rect.X, rect.Y, rect.Width, rect.Height };
-    r2d::set_atlas_entry_frame(entry, frame, page_id, eframe);
-    atlas->TexturePages[page_id] = tex;
-    atlas->PageCount++;
+    sprite_grid_unlink(grid, handle);
+    grid->HandleCell[handle] = SPRITE_GRID_NONE;
+    grid->HandleSlot[handle] = grid->FreeHandle;
+    grid->FreeHandle = handle;
+    grid->Count--;
     return true;
 }
 
-bool r2d::atlas_transfer_frame(r2d::atlas_t *atlas, r2d::atlas_entry_t *entry, size_t frame, void const *pixels)
+gl::sprite_t* r2d::sprite_grid_get(r2d::sprite_grid_t *grid, uint32_t handle)
 {
-    r2d::atlas_frame_t const &bounds = entry->Frames [frame];
-    size_t             const  pageid = entry->PageIds[frame];
-    size_t             const  w      = bounds.Width;
-    size_t             const  h      = bounds.Height;
-    size_t             const  align  = 4;
-    GLenum             const  type   = atlas->PageDataType;
-    GLenum             const  format = atlas->PageFormat;
-    GLsizei            const  size   = gl::bytes_per_slice(format, type, w, h, align);
-    GLintptr                  offset = atlas->BufferOffset;
-    GLbitfield                flags  = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
-
-    if (offset + size > atlas->TransferBytes)
-    {   // additionally discard (orphan) the buffer.
-        flags |= GL_MAP_INVALIDATE_BUFFER_BIT;
-        offset = 0;
+    if (handle >= grid->HandleCount || grid->HandleCell[handle] == SPRITE_GRID_NONE)
+        return NULL;
+    return &grid->Sprites[grid->HandleSlot[handle]];
+}
+
+bool r2d::sprite_grid_repack(r2d::sprite_grid_t *grid)
+{
+    size_t const  ncells = grid->CellsX * grid->CellsY;
+    size_t const  first  = grid->PackedCount;
+    size_t const  last   = grid->PackedCount + grid->OverflowCount;
+    size_t        total  = 0;
+    gl::sprite_t *sprites= NULL;
+    uint32_t     *owners = NULL;
+
+    // temporarily store the final sprite count of each cell in Capacity.
+    for (size_t i = 0; i < ncells; ++i)
+    {
+        grid->Cells[i].Capacity = grid->Cells[i].Count;
+    }
+    for (size_t i = first; i < last; ++i)
+    {
+        grid->Cells[grid->HandleCell[grid->SlotHandle[i]]].Capacity++;
+    }
+    for (size_t i = 0; i < ncells; ++i)
+    {   // occupied cells reserve a quarter of their size for sprites moving in.
+        uint32_t n = grid->Cells[i].Capacity;
+        total += n > 0 ? n + (n / 4) + 2 : 0;
     }
 
-    glBindTexture(GL_TEXTURE_2D, atlas->TexturePages[pageid]);
-    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, atlas->TransferBuffer);
-    GLvoid *buffer_ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, size, flags);
-    if (buffer_ptr != NULL)
-    {   // synchronously copy the data into the PBO; unmap the buffer.
-        memcpy(buffer_ptr, pixels, size);
-        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    size_t capacity = total + grid->OverflowLimit;
+    sprites = (gl::sprite_t*) malloc(capacity * sizeof(gl::sprite_t));
+    owners  = (uint32_t*)     malloc(capacity * sizeof(uint32_t));
+    if (sprites == NULL || owners == NULL)
+        goto error_cleanup;
 
-        // transfer the region from the PBO to the texture memory. the
-        // transfer should be performed asynchronously from the CPU.
-        gl::pixel_transfer_h2d_t x;
-        x.Target          = GL_TEXTURE_2D;
-        x.Format          = format;
-        x.DataType        = type;
-        x.TargetIndex     = 0;
-        x.TargetX         = bounds.X;
-        x.TargetY         = bounds.Y;
-        x.TargetZ         = 0;
-        x.SourceX         = 0;
-        x.SourceY         = 0;
-        x.SourceZ         = 0;
-        x.SourceWidth     = bounds.Width;
-        x.SourceHeight    = bounds.Height;
-        x.TransferWidth   = bounds.Width;
-        x.TransferHeight  = bounds.Height;
-        x.TransferSlices  = 1;
-        x.TransferSize    = size;
-        x.TransferBuffer  = (void*) offset;
-        gl::transfer_pixels_h2d(&x);
+    // copy the packed sprites of each cell to their new location, then
+    // append the sprites from the overflow region to their cells.
+    grid->MaxExtent = 0.0f;
+    for (size_t i = 0, offset = 0; i < ncells; ++i)
+    {
+        r2d::sprite_cell_t &cell = grid->Cells[i];
+        uint32_t const      n    = cell.Capacity;
+        for (size_t j = 0; j < cell.Count; ++j)
+        {
+            size_t const src = cell.First + j;
+            float const  ext = sprite_extent(grid->Sprites[src]);
+            if (grid->MaxExtent < ext) grid->MaxExtent = ext;
+            sprites[offset + j] = grid->Sprites[src];
+            owners [offset + j] = grid->SlotHandle[src];
+            grid->HandleSlot[owners[offset + j]] = uint32_t(offset + j);
+        }
+        cell.First    = uint32_t(offset);
+        cell.Capacity = n > 0 ? n + (n / 4) + 2 : 0;
+        offset       += cell.Capacity;
+    }
+    for (size_t i = first; i < last; ++i)
+    {
+        uint32_t const      handle = grid->SlotHandle[i];
+        r2d::sprite_cell_t &cell   = grid->Cells[grid->HandleCell[handle]];
+        size_t   const      dst    = cell.First + cell.Count++;
+        float    const      ext    = sprite_extent(grid->Sprites[i]);
+        if (grid->MaxExtent < ext) grid->MaxExtent = ext;
+        sprites[dst] = grid->Sprites[i];
+        owners [dst] = handle;
+        grid->HandleSlot[handle] = uint32_t(dst);
+    }
+    free(grid->SlotHandle);
+    free(grid->Sprites);
+    grid->Sprites       = sprites;
+    grid->SlotHandle    = owners;
+    grid->SlotCapacity  = capacity;
+    grid->PackedCount   = total;
+    grid->OverflowCount = 0;
+    grid->Stats.Repacks++;
+    return true;
 
-        // unbind the transfer buffer and texture page.
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-        glBindTexture(GL_TEXTURE_2D, 0);
+error_cleanup:
+    // restore the spare capacity of each cell from the existing layout.
+    for (size_t i = 0; i + 1 < ncells; ++i)
+    {
+        grid->Cells[i].Capacity = grid->Cells[i+1].First - grid->Cells[i].First;
+    }
+    if (ncells > 0) grid->Cells[ncells-1].Capacity = uint32_t(grid->PackedCount - grid->Cells[ncells-1].First);
+    if (owners  != NULL) free(owners);
+    if (sprites != NULL) free(sprites);
+    return false;
+}
 
-        // update the current offset within the PBO.
-        atlas->BufferOffset = size_t(offset + size);
-        return true;
+size_t r2d::sprite_grid_query(r2d::sprite_grid_t *grid, float x, float y, float width, float height, r2d::sprite_range_t *ranges, size_t max_ranges)
+{
+    if (grid->OverflowCount > grid->OverflowLimit)
+        r2d::sprite_grid_repack(grid); // on failure, the overflow region is culled below.
+
+    // expand the rectangle so sprites overlapping it from outside are found.
+    float const  e     = grid->MaxExtent;
+    float const  x0    = x - e, y0 = y - e;
+    float const  x1    = x + width + e, y1 = y + height + e;
+    size_t const cx0   = sprite_grid_axis(x0 - grid->OriginX, grid->InvCellSize, grid->CellsX);
+    size_t const cy0   = sprite_grid_axis(y0 - grid->OriginY, grid->InvCellSize, grid->CellsY);
+    size_t const cx1   = sprite_grid_axis(x1 - grid->OriginX, grid->InvCellSize, grid->CellsX);
+    size_t const cy1   = sprite_grid_axis(y1 - grid->OriginY, grid->InvCellSize, grid->CellsY);
+    size_t       count = 0;
+    size_t       found = 0;
+
+    for (size_t cy = cy0; cy <= cy1; ++cy)
+    {
+        r2d::sprite_cell_t const *row = &grid->Cells[cy * grid->CellsX];
+        for (size_t cx = cx0; cx <= cx1; ++cx)
+        {
+            if (row[cx].Count > 0)
+            {
+                sprite_grid_emit(ranges, max_ranges, count, row[cx].First, row[cx].Count);
+                found += row[cx].Count;
+            }
+        }
     }
-    else return false;
+    for (size_t i = grid->PackedCount, n = grid->PackedCount + grid->OverflowCount; i < n; ++i)
+    {   // sprites awaiting a repack are tested individually.
+        gl::sprite_t const &s = grid->Sprites[i];
+        if (s.ScreenX >= x0 && s.ScreenX <= x1 && s.ScreenY >= y0 && s.ScreenY <= y1)
+        {
+            sprite_grid_emit(ranges, max_ranges, count, uint32_t(i), 1);
+            found++;
+        }
+    }
+    grid->Stats.CellsVisited = (cx1 - cx0 + 1) * (cy1 - cy0 + 1);
+    grid->Stats.SpritesFound = found;
+    return count;
 }
 
+size_t r2d::sprite_grid_batch(r2d::sprite_grid_t const *grid, r2d::sprite_range_t const *ranges, size_t range_count, gl::sprite_batch_t *batch)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < range_count; ++i)
+    {
+        total += ranges[i].Count;
+    }
+    gl::ensure_sprite_batch(batch, batch->Count + total);
+    for (size_t i = 0; i < range_count; ++i)
+    {
+        gl::generate_quads(batch->Quads, batch->State, batch->Order, batch->Count, grid->Sprites, ranges[i].First, ranges[i].Count);
+        batch->Count += ranges[i].Count;
+    }
+    return total;
+}
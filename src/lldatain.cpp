@@ -15,6 +15,18 @@
 #include <stdlib.h>
 #include "lldatain.hpp"
 
+#if defined(_WIN32) || defined(_WIN64)
+    #ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
 /*/////////////////
 //   Constants   //
 /////////////////*/
@@ -800,6 +812,79 @@ void* data::load_binary(char const *path, size_t *out_buffer_size)
     }
 }
 
+bool data::map_file(char const *path, data::file_mapping_t *out_mapping)
+{
+    out_mapping->Data       = NULL;
+    out_mapping->Size       = 0;
+    out_mapping->FileHandle = NULL;
+    out_mapping->MapHandle  = NULL;
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE        fd = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    HANDLE        fm = NULL;
+    void         *pv = NULL;
+    LARGE_INTEGER sz;
+    if (fd == INVALID_HANDLE_VALUE)
+        return false;
+    if (!GetFileSizeEx(fd, &sz) || sz.QuadPart == 0)
+    {
+        CloseHandle(fd);
+        return false;
+    }
+    if ((fm = CreateFileMappingA(fd, NULL, PAGE_READONLY, 0, 0, NULL)) == NULL)
+    {
+        CloseHandle(fd);
+        return false;
+    }
+    if ((pv = MapViewOfFile(fm, FILE_MAP_READ, 0, 0, 0)) == NULL)
+    {
+        CloseHandle(fm);
+        CloseHandle(fd);
+        return false;
+    }
+    out_mapping->Data       = pv;
+    out_mapping->Size       = size_t(sz.QuadPart);
+    out_mapping->FileHandle = (void*) fd;
+    out_mapping->MapHandle  = (void*) fm;
+    return true;
+#else
+    struct stat st;
+    void       *pv = NULL;
+    int         fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+    pv = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps its own reference to the file.
+    if (pv == MAP_FAILED)
+        return false;
+    out_mapping->Data = pv;
+    out_mapping->Size = size_t(st.st_size);
+    return true;
+#endif
+}
+
+void data::unmap_file(data::file_mapping_t *mapping)
+{
+    if (mapping->Data != NULL)
+    {
+#if defined(_WIN32) || defined(_WIN64)
+        UnmapViewOfFile(mapping->Data);
+        if (mapping->MapHandle  != NULL) CloseHandle((HANDLE) mapping->MapHandle);
+        if (mapping->FileHandle != NULL) CloseHandle((HANDLE) mapping->FileHandle);
+#else
+        munmap(mapping->Data, mapping->Size);
+#endif
+    }
+    mapping->Data       = NULL;
+    mapping->Size       = 0;
+    mapping->FileHandle = NULL;
+    mapping->MapHandle  = NULL;
+}
+
 bool data::dds_header(void const *data, size_t data_size, data::dds_header_t *out_header)
 {
     size_t const offset   = sizeof(uint32_t);
@@ -14,126 +14,136 @@
 #include <assert.h>
 #include "llgui.hpp"
 
+/*////////////////////
+//   Preprocessor   //
+////////////////////*/
 #ifdef _MSC_VER
 #define STRDUP    _strdup
 #else
 #define STRDUP    strdup
 #endif
 
+/// @summary Use SSE2 for the column and quantization passes of the distance
+/// transform when the target supports it.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define LLGUI_USE_SSE2   1
+    #include <emmintrin.h>
+#else
+    #define LLGUI_USE_SSE2   0
+#endif
+
 /*/////////////////
 //   Constants   //
 /////////////////*/
-/// @summary Define the number of glyph indices we'd like to store per-bucket.
-/// Glyph indices are stored as 32-bit unsigned integers. The actual size of
-/// the bucket is two more than this, and stores the number of entries used.
-static size_t const FONT_BUCKET_SIZE      = 14;
-
-/// @summary Define the minimum number of buckets we want in the glyph table.
-static size_t const FONT_MIN_BUCKETS      = 16;
-
-/// @summary The zero-based index of the current size of a bucket in a glyph table.
-static size_t const FONT_SIZE_INDEX       = 0;
-
-/// @summary The zero-based index of the capacity of a bucket in a glyph table.
-static size_t const FONT_CAPACITY_INDEX   = 1;
-
-/// @summary The zero-based index of the first codepoint in a glyph table bucket.
-static size_t const FONT_CODEPOINT_OFFSET = 2;
+/// @summary A value larger than any parabola intersection in a distance transform row.
+static float const EDT_INFINITY = 1.0e30f;
 
 /*///////////////////////
 //   Local Functions   //
 ///////////////////////*/
-/// @summary Calculate a power-of-two value greater than or equal to a given value.
-/// @param The input value, which may or may not be a power of two.
-/// @param min The minimum power-of-two value, which must also be non-zero.
-/// @return A power-of-two that is greater than or equal to value.
-static inline size_t pow2_ge(size_t value, size_t min)
-{
-    assert((min > 0));
-    assert((min & (min - 1)) == 0);
-    size_t x = min;
-    while (x < value)
-        x  <<= 1;
-    return x;
-}
-
-/// @summary Mixes the bits in a 32-bit unsigned integer value.
-/// @param c The input value.
-/// @return A value based on the input.
-static inline uint32_t uint32_hash(uint32_t c)
-{
-    // Bob Jenkins' mix function.
-    uint32_t a = 0x9E3779B9;
-    uint32_t b = 0x9E3779B9;
-    a -= b; a -= c; a ^= (c >> 13);
-    b -= c; b -= a; b ^= (a <<  8);
-    c -= a; c -= b; c ^= (b >> 13);
-    a -= b; a -= c; a ^= (c >> 12);
-    b -= c; b -= a; b ^= (a << 16);
-    c -= a; c -= b; c ^= (b >>  5);
-    a -= b; a -= c; a ^= (c >>  3);
-    b -= c; b -= a; b ^= (a << 10);
-    c -= a; c -= b; c ^= (b >> 15);
-    return  c;
-}
-
-/// @summary Retrieves the next UTF-8 codepoint from a string.
-/// @param str Pointer to the start of the codepoint.
-/// @param cp On return, this value stores the current codepoint.
-/// @return A pointer to the start of the next codepoint.
-static inline char const* next_codepoint(char const *str, uint32_t &cp)
-{
-    if ((str[0] & 0x80) == 0)
-    {   // cp in [0x00000, 0x0007F]
-        cp = str[0];
-        return str + 1;
-    }
-    if ((str[0] & 0xFF) >= 0xC2 &&   (str[0] & 0xFF) <= 0xDF && (str[1] & 0xC0) == 0x80)
-    {   // cp in [0x00080, 0x007FF]
-        cp = (str[0] & 0x1F) <<  6 | (str[1] & 0x3F);
-        return str + 2;
-    }
-    if ((str[0] & 0xF0) == 0xE0 &&   (str[1] & 0xC0) == 0x80 && (str[2] & 0xC0) == 0x80)
-    {   // cp in [0x00800, 0x0FFFF]
-        cp = (str[0] & 0x0F) << 12 | (str[1] & 0x3F) << 6  |    (str[2] & 0x3F);
-        return str + 3;
-    }
-    if ((str[0] & 0xFF) == 0xF0 &&   (str[1] & 0xC0) == 0x80 && (str[2] & 0xC0) == 0x80 && (str[3] & 0xC0) == 0x80)
-    {   // cp in [0x10000, 0x3FFFF]
-        cp = (str[1] & 0x3F) << 12 | (str[2] & 0x3F) << 6  |    (str[3] & 0x3F);
-        return str + 4;
-    }
-    // else, invalid UTF-8 codepoint.
-    cp = 0xFFFFFFFFU;
-    return str + 1;
-}
-
-/// @summary Determine the amount to advance the cursor by on the horizontal axis,
-/// taking into account the kerning table of the font.
-/// @param f The font to query.
-/// @param a The codepoint of the first glyph.
-/// @param b The codepoint of the second glyph.
-/// @param default_x The advance amount to return if there is no special kerning
-/// between codepoints a and b.
-static int32_t advance_x(gui::bitmap_font_t const *f, uint32_t a, uint32_t b, int32_t default_x)
+/// @summary Propagates vertical distances through one row of a distance
+/// transform; each value becomes the minimum of itself and one more than the
+/// corresponding value of the neighbouring row.
+/// @param g The row to update.
+/// @param n The row that was previously updated.
+/// @param width The number of values in each row.
+static inline void edt_column_step(float *g, float const *n, size_t width)
+{
+    size_t x = 0;
+#if LLGUI_USE_SSE2
+    __m128 const one = _mm_set1_ps(1.0f);
+    for ( ; x + 4 <= width; x += 4)
+    {
+        __m128 a = _mm_loadu_ps(&g[x]);
+        __m128 b = _mm_add_ps(_mm_loadu_ps(&n[x]), one);
+        _mm_storeu_ps(&g[x], _mm_min_ps(a, b));
+    }
+#endif
+    for ( ; x < width; ++x)
+    {
+        float b = n[x] + 1.0f;
+        if (b < g[x]) g[x] = b;
+    }
+}
+
+/// @summary Computes the exact one-dimensional squared Euclidean distance
+/// transform of a sampled function as the lower envelope of parabolas rooted
+/// at each sample, as described by Felzenszwalb and Huttenlocher.
+/// @param f The sampled function; on return, the squared distances.
+/// @param n The number of samples.
+/// @param v Scratch storage for n parabola locations.
+/// @param z Scratch storage for n + 1 parabola boundaries.
+/// @param d Scratch storage for n output values.
+static void edt_row(float *f, size_t n, int32_t *v, float *z, float *d)
 {
-    size_t   const  n = f->KernCount;
-    uint32_t const *A = f->KerningA;
-    for (size_t i = 0;  i < n; ++i)
+    size_t k = 0;
+    v[0] = 0;
+    z[0] =-EDT_INFINITY;
+    z[1] = EDT_INFINITY;
+    for (size_t q = 1; q < n; ++q)
     {
-        if (A[i] == a)
+        float const fq = f[q] + float(q * q);
+        float       s;
+        for ( ; ; )
         {
-            uint32_t const *B = f->KerningB;
-            for (size_t j = i;  j < n; ++j)
-            {
-                if (A[j] != a)
-                    break;
-                if (B[j] == b)
-                    return f->KerningX[j];
-            }
+            int32_t const p = v[k];
+            s = (fq - (f[p] + float(p * p))) / float(2 * (int32_t(q) - p));
+            if (s > z[k]) break;
+            k--; // z[0] is -infinity, so k never passes zero.
         }
+        k++;
+        v[k]   = int32_t(q);
+        z[k]   = s;
+        z[k+1] = EDT_INFINITY;
+    }
+    k = 0;
+    for (size_t q = 0; q < n; ++q)
+    {
+        while (z[k+1] < float(q)) k++;
+        float const dx = float(int32_t(q) - v[k]);
+        d[q] = dx * dx + f[v[k]];
+    }
+    memcpy(f, d, n * sizeof(float));
+}
+
+/// @summary Converts the squared distances to the nearest inside and outside
+/// pixels for one row into quantized signed distance values.
+/// @param dst The destination row.
+/// @param di The squared distance from each pixel to the nearest outside pixel.
+/// @param doo The squared distance from each pixel to the nearest inside pixel.
+/// @param width The number of pixels in the row.
+/// @param scale The value -0.5 / spread, mapping a distance to the output range.
+static inline void edt_quantize(uint8_t *dst, float const *di, float const *doo, size_t width, float scale)
+{
+    size_t x = 0;
+#if LLGUI_USE_SSE2
+    __m128 const half  = _mm_set1_ps(0.5f);
+    __m128 const one   = _mm_set1_ps(1.0f);
+    __m128 const zero  = _mm_setzero_ps();
+    __m128 const top   = _mm_set1_ps(255.0f);
+    __m128 const sc    = _mm_set1_ps(scale);
+    for ( ; x + 4 <= width; x += 4)
+    {   // the glyph edge lies half a pixel from the centers on either side.
+        __m128  s = _mm_sub_ps(_mm_sqrt_ps(_mm_loadu_ps(&doo[x])), _mm_sqrt_ps(_mm_loadu_ps(&di[x])));
+        s = _mm_sub_ps(_mm_add_ps(s, half), _mm_and_ps(_mm_cmpgt_ps(s, zero), one));
+        __m128  o = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(s, sc), half), top);
+        o = _mm_add_ps(_mm_min_ps(_mm_max_ps(o, zero), top), half);
+        __m128i i = _mm_cvttps_epi32(o);
+        i = _mm_packs_epi32(i, i);
+        i = _mm_packus_epi16(i, i);
+        int32_t p = _mm_cvtsi128_si32(i);
+        memcpy(&dst[x], &p, 4);
+    }
+#endif
+    for ( ; x < width; ++x)
+    {
+        float s = sqrtf(doo[x]) - sqrtf(di[x]);
+        s += (s > 0.0f) ? -0.5f : 0.5f;
+        float o = (s * scale + 0.5f) * 255.0f;
+        if (o < 0.0f)   o = 0.0f;
+        if (o > 255.0f) o = 255.0f;
+        dst[x] = uint8_t(o + 0.5f);
     }
-    return default_x;
 }
 
 /// @summary Initializes a control list.
@@ -257,18 +267,9 @@ bool gui::create_bitmap_font(gui::bitmap_font_t *font, gui::bitmap_font_info_t c
 {
     if (font && info)
     {
-        size_t nbuckets    = pow2_ge(info->GlyphCount / FONT_BUCKET_SIZE, FONT_MIN_BUCKETS);
         font->GlyphCount   = info->GlyphCount;
-        font->BucketCount  = nbuckets;
-        font->GTable       = (uint32_t**) malloc(nbuckets * sizeof(uint32_t*));
-        font->Glyphs       = (gui::bitmap_glyph_t*)  malloc(info->GlyphCount);
-        for (size_t i = 0; i < nbuckets; ++i)
-        {
-            size_t nitems   = FONT_BUCKET_SIZE + 2;
-            font->GTable[i] = (uint32_t*) malloc(nitems * sizeof(uint32_t));
-            font->GTable[i][FONT_SIZE_INDEX]      = 0;
-            font->GTable[i][FONT_CAPACITY_INDEX]  = FONT_BUCKET_SIZE;
-        }
+        font->Glyphs       = (gui::bitmap_glyph_t*)  malloc(info->GlyphCount * sizeof(gui::bitmap_glyph_t));
+        bool const table   = hash::create_table(&font->GTable, info->GlyphCount);
 
         font->KernCount    = info->KernCount;
         font->KerningA     = (uint32_t*) malloc(info->KernCount * sizeof(uint32_t));
@@ -289,6 +290,11 @@ bool gui::create_bitmap_font(gui::bitmap_font_t *font, gui::bitmap_font_info_t c
         font->MinWidth     = 0;
         font->MaxWidth     = 0;
         font->AvgWidth     = 0.0f;
+        if (!table)
+        {   // unable to allocate the codepoint lookup table.
+            gui::delete_bitmap_font(font);
+            return false;
+        }
         return true;
     }
     else return false;
@@ -304,21 +310,8 @@ void gui::delete_bitmap_font(gui::bitmap_font_t *font)
         if (font->KerningB != NULL) free(font->KerningB);
         if (font->KerningA != NULL) free(font->KerningA);
         if (font->Glyphs   != NULL) free(font->Glyphs);
-        if (font->GTable   != NULL)
-        {
-            for (size_t i = 0; i < font->BucketCount; ++i)
-            {
-                if (font->GTable[i] != NULL)
-                {
-                    free(font->GTable[i]);
-                    font->GTable[i]  = NULL;
-                }
-            }
-            free(font->GTable);
-        }
+        hash::delete_table(&font->GTable);
         font->GlyphCount  = 0;
-        font->BucketCount = 0;
-        font->GTable      = NULL;
         font->Glyphs      = NULL;
         font->KernCount   = 0;
         font->KerningA    = NULL;
@@ -332,19 +325,8 @@ void gui::delete_bitmap_font(gui::bitmap_font_t *font)
 
 bool gui::define_glyph(gui::bitmap_font_t *font, gui::bitmap_glyph_t const *glyph, size_t i)
 {
-    uint32_t bucket = uint32_hash(glyph->Codepoint) & (font->BucketCount - 1);
-    uint32_t  count = font->GTable[bucket][FONT_SIZE_INDEX];
-    uint32_t  nmax  = font->GTable[bucket][FONT_CAPACITY_INDEX];
-    if (count == nmax)
-    {
-        size_t    n = (nmax < 256) ? nmax * 2 : nmax + 256;
-        uint32_t *b = (uint32_t *) realloc(font->GTable[bucket], n * sizeof(uint32_t));
-        if (b == NULL) return false;
-        font->GTable[bucket] = b;
-        font->GTable[bucket][FONT_CAPACITY_INDEX] = uint32_t(n);
-    }
-    font->GTable[bucket][FONT_SIZE_INDEX]++;
-    font->GTable[bucket][count] = uint32_t(i);
+    if (!hash::table_put(&font->GTable, glyph->Codepoint, uint32_t(i)))
+        return false;
     font->Glyphs[i] =*glyph;
     return true;
 }
@@ -357,6 +339,27 @@ bool gui::define_kerning(gui::bitmap_font_t *font, uint32_t A, uint32_t B, int32
     return true;
 }
 
+int32_t gui::advance_x(gui::bitmap_font_t const *f, uint32_t a, uint32_t b, int32_t default_x)
+{
+    size_t   const  n = f->KernCount;
+    uint32_t const *A = f->KerningA;
+    for (size_t i = 0;  i < n; ++i)
+    {
+        if (A[i] == a)
+        {
+            uint32_t const *B = f->KerningB;
+            for (size_t j = i;  j < n; ++j)
+            {
+                if (A[j] != a)
+                    break;
+                if (B[j] == b)
+                    return f->KerningX[j];
+            }
+        }
+    }
+    return default_x;
+}
+
 bool gui::define_page(gui::bitmap_font_t *font, void const *src, size_t src_size, size_t i, bool flip_y)
 {
     if (src == NULL || src_size <= font->PageBytes)
@@ -392,25 +395,17 @@ void gui::measure_string(gui::bitmap_font_t const *font, char const *str, size_t
         size_t   h = 0; // total height, in pixels
         uint32_t c = 0; // current  UTF-8 codepoint, 0xFFFFFFFFU = invalid
         uint32_t p = 0; // previous UTF-8 codepoint, 0xFFFFFFFFU = invalid
-        uint32_t const  m = uint32_t(font->BucketCount - 1);
-        char const     *n = next_codepoint(str, c);
+        char const     *n = gui::next_codepoint(str, c);
         while (c != 0)
         {
-            uint32_t bucket = uint32_hash(c) & m;
-            uint32_t const *table = font->GTable[bucket];
-            uint32_t const  count = font->GTable[bucket][FONT_SIZE_INDEX];
-            for (size_t  i  = FONT_CODEPOINT_OFFSET; i < FONT_CODEPOINT_OFFSET + count; ++i)
+            uint32_t gi = 0; // the index in into font->Glyphs.
+            if (hash::table_get(&font->GTable, c, &gi))
             {
-                if (table[i] == c)
-                {
-                    size_t gi = table[i];   // the index in into font->Glyphs.
-                    w += advance_x(font, p, c, font->Glyphs[gi].AdvanceX);
-                    break;
-                }
+                w += gui::advance_x(font, p, c, font->Glyphs[gi].AdvanceX);
             }
             if (c == '\n') h += font->LineHeight;
             p = c;
-            n = next_codepoint(n, c);
+            n = gui::next_codepoint(n, c);
             l++;
         }
         if (l > 0) h += font->LineHeight;
@@ -424,6 +419,115 @@ void gui::measure_string(gui::bitmap_font_t const *font, char const *str, size_t
     }
 }
 
+bool gui::distance_field(uint8_t *dst, size_t dst_stride, void const *src, size_t src_stride, size_t src_step, size_t width, size_t height, uint8_t threshold, float spread)
+{
+    if (dst == NULL || src == NULL || width == 0 || height == 0 || spread <= 0.0f)
+        return false;
+
+    // the inside and outside distance images are followed by row scratch.
+    size_t const count = width * height;
+    size_t const bytes =(count * 2 + width * 2 + 1) * sizeof(float) + width * sizeof(int32_t);
+    float       *gi    = (float*) malloc(bytes);
+    if (gi == NULL)
+        return false;
+    float       *go    = gi + count;
+    float       *z     = go + count;
+    float       *d     = z  + width + 1;
+    int32_t     *v     = (int32_t*) (d + width);
+    float const  inf   = float(width + height);
+
+    // seed the distance images from the coverage values. gi is zero outside
+    // the glyph and go is zero inside the glyph.
+    for (size_t y = 0; y < height; ++y)
+    {
+        uint8_t const *s = (uint8_t const*) src + y * src_stride;
+        float         *i = gi + y * width;
+        float         *o = go + y * width;
+        for (size_t x = 0; x < width; ++x, s += src_step)
+        {
+            bool inside = *s >= threshold;
+            i[x] = inside ? inf  : 0.0f;
+            o[x] = inside ? 0.0f : inf;
+        }
+    }
+
+    // vertical pass; rows are processed in order so all columns advance together.
+    for (size_t y = 1; y < height; ++y)
+    {
+        edt_column_step(gi + y * width, gi + (y - 1) * width, width);
+        edt_column_step(go + y * width, go + (y - 1) * width, width);
+    }
+    for (size_t y = height - 1; y > 0; --y)
+    {
+        edt_column_step(gi + (y - 1) * width, gi + y * width, width);
+        edt_column_step(go + (y - 1) * width, go + y * width, width);
+    }
+
+    // horizontal pass over the squared column distances, then quantize.
+    for (size_t y = 0; y < height; ++y)
+    {
+        float *i = gi + y * width;
+        float *o = go + y * width;
+        for (size_t x = 0; x < width; ++x)
+        {
+            i[x] *= i[x];
+            o[x] *= o[x];
+        }
+        edt_row(i, width, v, z, d);
+        edt_row(o, width, v, z, d);
+        edt_quantize(dst + y * dst_stride, i, o, width, -0.5f / spread);
+    }
+    free(gi);
+    return true;
+}
+
+bool gui::create_distance_field_font(gui::bitmap_font_t *dst, gui::bitmap_font_t const *src)
+{
+    gui::bitmap_font_info_t info;
+    gui::init_bitmap_font_info(&info);
+    info.GlyphCount = src->GlyphCount;
+    info.KernCount  = src->KernCount;
+    info.BitDepth   = 8;
+    info.PageWidth  = src->PageWidth;
+    info.PageHeight = src->PageHeight;
+    info.PageCount  = src->PageCount;
+    info.FontName   = src->FontName;
+    info.PointSize  = src->PointSize;
+    info.LineHeight = src->LineHeight;
+    info.Baseline   = src->Baseline;
+    if (!gui::create_bitmap_font(dst, &info))
+        return false;
+
+    for (size_t i = 0; i < src->GlyphCount; ++i)
+    {
+        if (!gui::define_glyph(dst, &src->Glyphs[i], i))
+        {
+            gui::delete_bitmap_font(dst);
+            return false;
+        }
+    }
+    for (size_t i = 0; i < src->KernCount; ++i)
+    {
+        gui::define_kerning(dst, src->KerningA[i], src->KerningB[i], src->KerningX[i], i);
+    }
+    dst->MinWidth = src->MinWidth;
+    dst->MaxWidth = src->MaxWidth;
+    dst->AvgWidth = src->AvgWidth;
+    return true;
+}
+
+bool gui::distance_field_page(gui::bitmap_font_t *dst, gui::bitmap_font_t const *src, size_t i, float spread)
+{
+    if (i >= src->PageCount || i >= dst->PageCount || dst->BitDepth != 8 ||
+        dst->PageWidth != src->PageWidth || dst->PageHeight != src->PageHeight)
+        return false;
+
+    size_t   const step  = src->BitDepth / 8;
+    uint8_t const *pixel = (uint8_t const*) gui::glyph_page(src, i);
+    if (step == 4) pixel += 3; // coverage is stored in the alpha channel of ABGR pages.
+    return gui::distance_field((uint8_t*) gui::glyph_page(dst, i), dst->PageWidth, pixel, src->PageWidth * step, step, src->PageWidth, src->PageHeight, 128, spread);
+}
+
 void gui::init_key_buffer(gui::key_buffer_t *buffer)
 {
     if (buffer)
@@ -0,0 +1,374 @@
+/*/////////////////////////////////////////////////////////////////////////////
+/// @summary Implements a flat open-addressing hash table mapping 32-bit keys
+/// to 32-bit values, probed sixteen slots at a time.
+/// @author Russell Klenk (contact@russellklenk.com)
+///////////////////////////////////////////////////////////////////////////80*/
+
+/*////////////////
+//   Includes   //
+////////////////*/
+#ifdef  _MSC_VER
+#include <intrin.h>
+#endif
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "llhash.hpp"
+
+/*////////////////////
+//   Preprocessor   //
+////////////////////*/
+/// @summary Use SSE2 to probe a group of tags when the target supports it.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define LLHASH_USE_SSE2   1
+    #include <emmintrin.h>
+#else
+    #define LLHASH_USE_SSE2   0
+#endif
+
+/*/////////////////
+//   Constants   //
+/////////////////*/
+/// @summary The size of a single slot, in bytes: one tag, one key and one value.
+static size_t const TABLE_SLOT_SIZE = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint32_t);
+
+/*///////////////////////
+//   Local Functions   //
+///////////////////////*/
+/// @summary Mixes the bits of a 32-bit key using the MurmurHash3 finalizer.
+/// The low bits select the first group probed, the high seven bits form the
+/// tag stored for the slot.
+/// @param key The key to hash.
+/// @return The 32-bit hash value.
+static inline uint32_t mix_u32(uint32_t key)
+{
+    key ^= key >> 16;
+    key *= 0x85EBCA6BU;
+    key ^= key >> 13;
+    key *= 0xC2B2AE35U;
+    key ^= key >> 16;
+    return key;
+}
+
+/// @summary Extracts the tag value stored for an occupied slot from a hash.
+/// @param h The hash value returned by mix_u32().
+/// @return A tag value in [0, 127].
+static inline uint8_t hash_tag(uint32_t h)
+{
+    return uint8_t(h >> 25);
+}
+
+/// @summary Returns the index of the lowest set bit in a non-zero mask.
+/// @param mask The bitmask to search. Must be non-zero.
+/// @return The zero-based index of the lowest set bit.
+static inline uint32_t lowest_bit(uint32_t mask)
+{
+    assert(mask != 0);
+#if   defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward(&index, mask);
+    return uint32_t(index);
+#elif defined(__GNUC__)
+    return uint32_t(__builtin_ctz(mask));
+#else
+    uint32_t index = 0;
+    while ((mask & 1) == 0)
+    {
+        mask >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+/// @summary Builds a bitmask of the slots in a group whose tag equals a value.
+/// @param tags The first tag in the group; LLHASH_GROUP_SIZE bytes.
+/// @param tag The tag value to match.
+/// @return A bitmask with bit i set if tags[i] == tag.
+static inline uint32_t group_match(uint8_t const *tags, uint8_t tag)
+{
+#if LLHASH_USE_SSE2
+    __m128i g = _mm_loadu_si128((__m128i const*) tags);
+    __m128i t = _mm_set1_epi8((char) tag);
+    return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(g, t)));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < LLHASH_GROUP_SIZE; ++i)
+    {
+        if (tags[i] == tag) mask |= (1U << i);
+    }
+    return mask;
+#endif
+}
+
+/// @summary Builds a bitmask of the slots in a group that are empty or deleted.
+/// Both special tags have the high bit set, while occupied slots do not.
+/// @param tags The first tag in the group; LLHASH_GROUP_SIZE bytes.
+/// @return A bitmask with bit i set if slot i is available for insertion.
+static inline uint32_t group_available(uint8_t const *tags)
+{
+#if LLHASH_USE_SSE2
+    return uint32_t(_mm_movemask_epi8(_mm_loadu_si128((__m128i const*) tags)));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < LLHASH_GROUP_SIZE; ++i)
+    {
+        if (tags[i] & 0x80U) mask |= (1U << i);
+    }
+    return mask;
+#endif
+}
+
+/// @summary Calculates the maximum number of occupied or deleted slots allowed
+/// in a table before it must be rehashed; the maximum load factor is 7/8.
+/// @param capacity The number of slots in the table.
+/// @return The maximum number of occupied and deleted slots.
+static inline size_t max_load(size_t capacity)
+{
+    return capacity - (capacity / 8);
+}
+
+/// @summary Calculates the table capacity required to store a given number
+/// of items without exceeding the maximum load factor.
+/// @param count The number of items to store.
+/// @return The required number of slots, a power of two.
+static size_t capacity_for(size_t count)
+{
+    size_t c = LLHASH_GROUP_SIZE;
+    while (max_load(c) < count)
+        c <<= 1;
+    return c;
+}
+
+/// @summary Locates an available slot for a key known not to be present.
+/// @param table The hash table to search. Must have at least one available slot.
+/// @param h The hash of the key returned by mix_u32().
+/// @return The index of an empty or deleted slot.
+static size_t find_available(hash::table_t const *table, uint32_t h)
+{
+    size_t const mask = (table->Capacity / LLHASH_GROUP_SIZE) - 1;
+    size_t       grp  =  h & mask;
+    for (size_t  step = 1; ; ++step)
+    {
+        size_t   base = grp * LLHASH_GROUP_SIZE;
+        uint32_t bits = group_available(&table->Tags[base]);
+        if (bits != 0) return base + lowest_bit(bits);
+        grp = (grp + step) & mask; // triangular probing visits every group.
+    }
+}
+
+/// @summary Locates the slot containing a given key.
+/// @param table The hash table to search.
+/// @param key The key to locate.
+/// @param h The hash of the key returned by mix_u32().
+/// @return The index of the slot containing the key, or table->Capacity.
+static size_t find_key(hash::table_t const *table, uint32_t key, uint32_t h)
+{
+    if (table->Capacity == 0)
+        return 0;
+
+    size_t  const mask = (table->Capacity / LLHASH_GROUP_SIZE) - 1;
+    uint8_t const tag  =  hash_tag(h);
+    size_t        grp  =  h & mask;
+    for (size_t   n    =  0; n <= mask; ++n)
+    {
+        size_t   base  = grp * LLHASH_GROUP_SIZE;
+        uint32_t bits  = group_match(&table->Tags[base], tag);
+        while (bits != 0)
+        {
+            size_t slot = base + lowest_bit(bits);
+            if (table->Keys[slot] == key)
+                return slot;
+            bits &= bits - 1;
+        }
+        if (group_match(&table->Tags[base], LLHASH_TAG_EMPTY) != 0)
+            break; // the key was never inserted past this group.
+        grp = (grp + n + 1) & mask;
+    }
+    return table->Capacity;
+}
+
+/// @summary Allocates new storage for a table and re-inserts all occupied
+/// slots, discarding any deleted slots.
+/// @param table The hash table to rehash.
+/// @param capacity The new number of slots; a power of two, at least
+/// LLHASH_GROUP_SIZE, and large enough to hold table->Count items.
+/// @return true if the table was rehashed.
+static bool rehash(hash::table_t *table, size_t capacity)
+{
+    uint8_t *block = (uint8_t*) malloc(capacity * TABLE_SLOT_SIZE);
+    if (block == NULL)
+        return false;
+
+    hash::table_t t;
+    t.Capacity = capacity;
+    t.Count    = table->Count;
+    t.Deleted  = 0;
+    t.Tags     = block;
+    t.Keys     = (uint32_t*) (block  + capacity);
+    t.Values   = t.Keys + capacity;
+    memset(t.Tags, LLHASH_TAG_EMPTY, capacity);
+
+    for (size_t i = 0; i < table->Capacity; ++i)
+    {
+        if ((table->Tags[i] & 0x80U) == 0)
+        {
+            uint32_t const h = mix_u32(table->Keys[i]);
+            size_t   const s = find_available(&t, h);
+            t.Tags  [s] = hash_tag(h);
+            t.Keys  [s] = table->Keys[i];
+            t.Values[s] = table->Values[i];
+        }
+    }
+    if (table->Tags != NULL) free(table->Tags);
+    *table = t;
+    return true;
+}
+
+/*///////////////////////
+//  Public Functions   //
+///////////////////////*/
+size_t hash::table_storage_size(size_t capacity)
+{
+    return capacity * TABLE_SLOT_SIZE;
+}
+
+bool hash::create_table(hash::table_t *table, size_t expected_count)
+{
+    table->Capacity = 0;
+    table->Count    = 0;
+    table->Deleted  = 0;
+    table->Tags     = NULL;
+    table->Keys     = NULL;
+    table->Values   = NULL;
+    return rehash(table, capacity_for(expected_count));
+}
+
+bool hash::load_table(hash::table_t *table, void const *storage, size_t capacity)
+{
+    if (capacity < LLHASH_GROUP_SIZE || (capacity & (capacity - 1)) != 0)
+        return false;
+
+    size_t   const nbytes = hash::table_storage_size(capacity);
+    uint8_t       *block  = (uint8_t*) malloc(nbytes);
+    if (block == NULL)
+        return false;
+    memcpy(block, storage, nbytes);
+
+    hash::table_t t;
+    t.Capacity = capacity;
+    t.Count    = 0;
+    t.Deleted  = 0;
+    t.Tags     = block;
+    t.Keys     = (uint32_t*) (block  + capacity);
+    t.Values   = t.Keys + capacity;
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        uint8_t const tag = t.Tags[i];
+        if ((tag & 0x80U) == 0)
+        {   // an occupied slot must be found by a lookup of its key.
+            if (tag != hash_tag(mix_u32(t.Keys[i])))
+                goto error_cleanup;
+            t.Count++;
+        }
+        else if (tag == LLHASH_TAG_DELETED)
+        {
+            t.Deleted++;
+        }
+        else if (tag != LLHASH_TAG_EMPTY)
+        {   // not a valid tag value.
+            goto error_cleanup;
+        }
+    }
+    if (t.Count + t.Deleted > max_load(capacity))
+    {   // a table within its load factor always has an empty slot.
+        goto error_cleanup;
+    }
+    if (table->Tags != NULL) free(table->Tags);
+    *table = t;
+    return true;
+
+error_cleanup:
+    free(block);
+    return false;
+}
+
+void hash::delete_table(hash::table_t *table)
+{
+    if (table->Tags != NULL) free(table->Tags);
+    table->Capacity = 0;
+    table->Count    = 0;
+    table->Deleted  = 0;
+    table->Tags     = NULL;
+    table->Keys     = NULL;
+    table->Values   = NULL;
+}
+
+void hash::clear_table(hash::table_t *table)
+{
+    if (table->Tags != NULL) memset(table->Tags, LLHASH_TAG_EMPTY, table->Capacity);
+    table->Count    = 0;
+    table->Deleted  = 0;
+}
+
+bool hash::table_reserve(hash::table_t *table, size_t count)
+{
+    if (count + table->Deleted <= max_load(table->Capacity))
+        return true;
+    return rehash(table, capacity_for(count));
+}
+
+bool hash::table_put(hash::table_t *table, uint32_t key, uint32_t value)
+{
+    uint32_t const h = mix_u32(key);
+    size_t         s = find_key(table, key, h);
+    if (s < table->Capacity)
+    {   // the key already exists; replace its value.
+        table->Values[s] = value;
+        return true;
+    }
+    if (!hash::table_reserve(table, table->Count + 1))
+        return false;
+
+    s = find_available(table, h);
+    if (table->Tags[s] == LLHASH_TAG_DELETED)
+        table->Deleted--;
+    table->Tags  [s] = hash_tag(h);
+    table->Keys  [s] = key;
+    table->Values[s] = value;
+    table->Count++;
+    return true;
+}
+
+bool hash::table_get(hash::table_t const *table, uint32_t key, uint32_t *out_value)
+{
+    size_t const s = find_key(table, key, mix_u32(key));
+    if (s < table->Capacity)
+    {
+        *out_value = table->Values[s];
+        return true;
+    }
+    return false;
+}
+
+bool hash::table_remove(hash::table_t *table, uint32_t key)
+{
+    size_t const s = find_key(table, key, mix_u32(key));
+    if (s < table->Capacity)
+    {   // a group that still has an empty slot has never been full, so no
+        // probe sequence passes through it and the slot can become empty.
+        size_t const base = s & ~size_t(LLHASH_GROUP_SIZE - 1);
+        if (group_match(&table->Tags[base], LLHASH_TAG_EMPTY) != 0)
+        {
+            table->Tags[s] = LLHASH_TAG_EMPTY;
+        }
+        else
+        {
+            table->Tags[s] = LLHASH_TAG_DELETED;
+            table->Deleted++;
+        }
+        table->Count--;
+        return true;
+    }
+    return false;
+}
@@ -12,25 +12,45 @@
 #include <intrin.h>
 #endif
 #include <math.h>
+#include <stdio.h>
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 #include "llopengl.hpp"
 
+#if   defined(__APPLE__)
+#include <mach/mach_time.h>
+#elif !defined(_WIN32) && !defined(_WIN64)
+#include <time.h>
+#endif
+
 /*/////////////////
 //   Constants   //
 /////////////////*/
+/// @summary The vertex shader prologue declaring the screenspace -> clipspace
+/// matrix in a std140 uniform block, supplied from a gl::constant_ring_t.
+static char const *SpriteShaderMSS_UBO_VSS =
+    "#version 330\n"
+    "layout (std140) uniform SpriteConstants {\n"
+    "    mat4 uMSS;\n"
+    "};\n";
+
+/// @summary The vertex shader prologue declaring the screenspace -> clipspace
+/// matrix as a plain uniform, set with glUniformMatrix4fv.
+static char const *SpriteShaderMSS_UNI_VSS =
+    "#version 330\n"
+    "uniform mat4 uMSS;\n";
+
 /// @summary The vertex shader source code for rendering solid-colored quads
-/// specified in screen-space.
+/// specified in screen-space. Follows one of the uMSS prologues.
 static char const *SpriteShaderPTC_CLR_VSS =
-    "#version 330\n"
-    "uniform mat4 uMSS;\n"
-    "layout (location = 0) in vec4 aPTX;\n"
-    "layout (location = 1) in vec4 aCLR;\n"
+    "layout (location = 0) in vec4  aPTX;\n"
+    "layout (location = 1) in vec4  aCLR;\n"
+    "layout (location = 2) in float aDEP;\n"
     "out vec4 vCLR;\n"
     "void main() {\n"
     "    vCLR = aCLR;\n"
-    "    gl_Position = uMSS * vec4(aPTX.x, aPTX.y, 0, 1);\n"
+    "    gl_Position = uMSS * vec4(aPTX.x, aPTX.y, aDEP, 1);\n"
     "}\n";
 
 /// @summary The fragment shader source code for rendering solid-colored quads
@@ -44,32 +64,248 @@ static char const *SpriteShaderPTC_CLR_FSS =
     "}\n";
 
 /// @summary The vertex shader source code for rendering textured and tinted
-/// quads specified in screen-space.
+/// quads specified in screen-space. Follows one of the uMSS prologues.
 static char const *SpriteShaderPTC_TEX_VSS =
-    "#version 330\n"
-    "uniform mat4 uMSS;\n"
-    "layout (location = 0) in vec4 aPTX;\n"
-    "layout (location = 1) in vec4 aCLR;\n"
+    "layout (location = 0) in vec4  aPTX;\n"
+    "layout (location = 1) in vec4  aCLR;\n"
+    "layout (location = 2) in float aDEP;\n"
     "out vec4 vCLR;\n"
     "out vec2 vTEX;\n"
     "void main() {\n"
     "    vCLR = aCLR;\n"
     "    vTEX = vec2(aPTX.z, aPTX.w);\n"
-    "    gl_Position = uMSS * vec4(aPTX.x, aPTX.y, 0, 1);\n"
+    "    gl_Position = uMSS * vec4(aPTX.x, aPTX.y, aDEP, 1);\n"
     "}\n";
 
 /// @summary The fragment shader source code for rendering textured and tinted
-/// quads specified in screen-space.
+/// quads specified in screen-space. Fragments with alpha below uATH are
+/// discarded; uATH defaults to zero, which disables the alpha test.
 static char const *SpriteShaderPTC_TEX_FSS =
     "#version 330\n"
     "uniform sampler2D sTEX;\n"
+    "uniform float uATH;\n"
+    "in  vec2 vTEX;\n"
+    "in  vec4 vCLR;\n"
+    "out vec4 oCLR;\n"
+    "void main() {\n"
+    "    vec4 c = texture(sTEX, vTEX) * vCLR;\n"
+    "    if (c.a < uATH) discard;\n"
+    "    oCLR = c;\n"
+    "}\n";
+
+/// @summary The vertex shader source code for rendering textured and tinted
+/// quads specified in screen-space, sampling from a 2D texture array.
+/// Follows one of the uMSS prologues.
+static char const *SpriteShaderPTC_ARR_VSS =
+    "layout (location = 0) in vec4  aPTX;\n"
+    "layout (location = 1) in vec4  aCLR;\n"
+    "layout (location = 2) in float aDEP;\n"
+    "layout (location = 3) in float aLAY;\n"
+    "out vec4 vCLR;\n"
+    "out vec3 vTEX;\n"
+    "void main() {\n"
+    "    vCLR = aCLR;\n"
+    "    vTEX = vec3(aPTX.z, aPTX.w, aLAY);\n"
+    "    gl_Position = uMSS * vec4(aPTX.x, aPTX.y, aDEP, 1);\n"
+    "}\n";
+
+/// @summary The fragment shader source code for rendering textured and tinted
+/// quads specified in screen-space, sampling from a 2D texture array.
+static char const *SpriteShaderPTC_ARR_FSS =
+    "#version 330\n"
+    "uniform sampler2DArray sTEX;\n"
+    "uniform float uATH;\n"
+    "in  vec3 vTEX;\n"
+    "in  vec4 vCLR;\n"
+    "out vec4 oCLR;\n"
+    "void main() {\n"
+    "    vec4 c = texture(sTEX, vTEX) * vCLR;\n"
+    "    if (c.a < uATH) discard;\n"
+    "    oCLR = c;\n"
+    "}\n";
+
+/// @summary The fragment shader source code for rendering text from signed
+/// distance field pages. The edge is antialiased over one screen pixel by
+/// scaling the smoothing width with the derivative of the distance value.
+static char const *SpriteShaderPTC_SDF_FSS =
+    "#version 330\n"
+    "uniform sampler2D sTEX;\n"
+    "uniform float uEDG;\n"
     "in  vec2 vTEX;\n"
     "in  vec4 vCLR;\n"
     "out vec4 oCLR;\n"
     "void main() {\n"
-    "    oCLR = texture(sTEX, vTEX) * vCLR;\n"
+    "    float d = texture(sTEX, vTEX).r;\n"
+    "    float e = 0.5 + uEDG;\n"
+    "    float w = max(fwidth(d) * 0.5, 1.0 / 255.0);\n"
+    "    float a = smoothstep(e - w, e + w, d) * vCLR.a;\n"
+    "    if (a <= 0.0) discard;\n"
+    "    oCLR = vec4(vCLR.rgb, a);\n"
+    "}\n";
+
+/// @summary The fragment shader source code for rendering text from signed
+/// distance field pages stored in a 2D texture array.
+static char const *SpriteShaderPTC_SDF_ARR_FSS =
+    "#version 330\n"
+    "uniform sampler2DArray sTEX;\n"
+    "uniform float uEDG;\n"
+    "in  vec3 vTEX;\n"
+    "in  vec4 vCLR;\n"
+    "out vec4 oCLR;\n"
+    "void main() {\n"
+    "    float d = texture(sTEX, vTEX).r;\n"
+    "    float e = 0.5 + uEDG;\n"
+    "    float w = max(fwidth(d) * 0.5, 1.0 / 255.0);\n"
+    "    float a = smoothstep(e - w, e + w, d) * vCLR.a;\n"
+    "    if (a <= 0.0) discard;\n"
+    "    oCLR = vec4(vCLR.rgb, a);\n"
     "}\n";
 
+/// @summary The size of the SpriteConstants uniform block, a single mat4.
+static size_t   const SPRITE_CONSTANTS_SIZE = 16 * sizeof(float);
+
+/// @summary The offset basis and prime for the 64-bit FNV-1a hash.
+static uint64_t const FNV1A64_SEED         = 0xCBF29CE484222325ULL;
+static uint64_t const FNV1A64_PRIME        = 0x00000100000001B3ULL;
+
+/// @summary The magic value 'GLPB' identifying a shader cache entry.
+static uint32_t const SHADER_CACHE_MAGIC   = 0x42504C47U;
+
+/// @summary The shader cache file format version. The size of size_t is
+/// encoded in the version, since the cached metadata contains size_t fields.
+static uint32_t const SHADER_CACHE_VERSION = 0x00030000U | uint32_t(sizeof(size_t));
+
+/*//////////////////
+//   Data Types   //
+//////////////////*/
+/// @summary Defines the header of a shader program binary cache entry. The
+/// header is followed by the shader_desc_t metadata block, and then by the
+/// program binary returned by glGetProgramBinary.
+struct shader_cache_header_t
+{
+    uint32_t Magic;          /// SHADER_CACHE_MAGIC.
+    uint32_t Version;        /// SHADER_CACHE_VERSION.
+    uint32_t DriverHash;     /// Hash of the driver that produced the binary.
+    uint32_t BinaryFormat;   /// The binary format returned by glGetProgramBinary.
+    uint64_t SourceHash;     /// Hash of the shader program source code.
+    uint32_t AttributeCount; /// The number of active vertex attributes.
+    uint32_t SamplerCount;   /// The number of active texture samplers.
+    uint32_t UniformCount;   /// The number of active uniforms.
+    uint32_t MetadataSize;   /// The size of the shader_desc_t metadata block.
+    uint32_t BinarySize;     /// The size of the program binary, in bytes.
+    uint32_t BlockCount;     /// The number of active uniform blocks.
+};
+
+/// @summary Prefixes every command recorded into a command buffer. The size
+/// includes the header and is always a multiple of eight bytes.
+struct command_header_t
+{
+    uint32_t Type;           /// One of gl::command_type_e.
+    uint32_t Size;           /// The total size of the command, in bytes.
+};
+
+/// @summary The payload of commands that bind or select a single object.
+struct command_bind_t
+{
+    GLenum   Target;         /// The binding target, if any.
+    GLuint   Unit;           /// The texture unit, if any.
+    GLuint   Object;         /// The OpenGL object name.
+};
+
+/// @summary The payload of COMMAND_TYPE_BIND_BUFFER_RANGE.
+struct command_bind_range_t
+{
+    GLenum     Target;       /// The indexed buffer target.
+    GLuint     Index;        /// The binding point index.
+    GLuint     Buffer;       /// The OpenGL buffer object.
+    GLintptr   Offset;       /// The byte offset of the range.
+    GLsizeiptr Size;         /// The size of the range, in bytes.
+};
+
+/// @summary The payload of COMMAND_TYPE_SET_SAMPLER.
+struct command_sampler_t
+{
+    gl::sampler_desc_t *Sampler; /// The sampler to set.
+    GLuint   Texture;        /// The OpenGL texture object.
+};
+
+/// @summary The payload of COMMAND_TYPE_SET_UNIFORM. The uniform value
+/// immediately follows the payload.
+struct command_uniform_t
+{
+    gl::uniform_desc_t *Uniform; /// The uniform to set.
+    uint64_t Transpose;      /// Non-zero to transpose matrix values.
+};
+
+/// @summary The payload of the fixed-function state commands.
+struct command_state_t
+{
+    GLenum   Values[4];      /// Enumerated or boolean state values.
+    float    Color [4];      /// The constant blend color.
+};
+
+/// @summary The payload of COMMAND_TYPE_DRAW_SPRITE_BATCH.
+struct command_draw_sprites_t
+{
+    gl::sprite_effect_t             *Effect;  /// The sprite effect.
+    gl::sprite_batch_t              *Batch;   /// The sprite batch to draw.
+    gl::sprite_effect_apply_t const *FxFuncs; /// The effect functions.
+    void                            *Context; /// Opaque data passed to FxFuncs.
+};
+
+/// @summary The payload of COMMAND_TYPE_CALLBACK.
+struct command_callback_t
+{
+    gl::command_callback_fn Func;    /// The function to invoke.
+    void                   *Context; /// Opaque data passed to Func.
+};
+
+/// @summary Identifies a command group within the set of command buffers
+/// being replayed by execute_command_buffers().
+struct command_group_ref_t
+{
+    uint64_t SortKey;        /// The sort key of the group.
+    size_t   Buffer;         /// The index of the command buffer.
+    size_t   Group;          /// The index of the group within the buffer.
+};
+
+/// @summary Orders command groups by ascending sort key, then by buffer and
+/// group index so that the replay order is deterministic.
+struct command_group_order
+{
+    inline bool operator()(command_group_ref_t const &a, command_group_ref_t const &b) const
+    {
+        if (a.SortKey != b.SortKey) return (a.SortKey < b.SortKey);
+        if (a.Buffer  != b.Buffer)  return (a.Buffer  < b.Buffer);
+        return (a.Group < b.Group);
+    }
+};
+
+/// @summary Partition predicate selecting quads flagged as opaque.
+struct is_opaque_sprite
+{
+    gl::sprite_batch_t *batch;
+
+    inline is_opaque_sprite(gl::sprite_batch_t *sprite_batch)
+        :
+        batch(sprite_batch)
+    { /* empty */ }
+
+    inline bool operator()(uint32_t i) const
+    {
+        return (batch->State[i].Flags & gl::SPRITE_FLAG_OPAQUE) != 0;
+    }
+};
+
+/*///////////////
+//   Globals   //
+///////////////*/
+/// @summary The shadow state cache used by the state_* functions, or NULL.
+static gl::state_cache_t *CurrentStateCache = NULL;
+
+/// @summary The GPU profiler used by the gpu_scope_* functions, or NULL.
+static gl::gpu_profiler_t *CurrentGpuProfiler = NULL;
+
 /*///////////////////////
 //   Local Functions   //
 ///////////////////////*/
@@ -91,192 +327,1300 @@ static inline size_t align_up(size_t size, size_t pow2)
     return (size != 0) ? ((size + (pow2 - 1)) & ~(pow2 - 1)) : pow2;
 }
 
-/*////////////////////////
-//   Public Functions   //
-////////////////////////*/
-size_t gl::data_size(GLenum data_type)
+/// @summary Retrieves a region of a pixel stream, relative to the oldest region.
+/// @param stream The pixel stream to query.
+/// @param i The zero-based index of the region, where zero is the oldest.
+/// @return A pointer to the region record.
+static inline gl::pixel_stream_region_t* pixel_stream_region(gl::pixel_stream_h2d_t *stream, size_t i)
 {
-    switch (data_type)
+    return &stream->Regions[(stream->RegionHead + i) % GL_MAX_PIXEL_STREAM_REGIONS];
+}
+
+/// @summary Retrieves the most recent reservation of a pixel stream, if it
+/// has not yet been committed or cancelled.
+/// @param stream The pixel stream to query.
+/// @return A pointer to the region record, or NULL.
+static gl::pixel_stream_region_t* pixel_stream_newest(gl::pixel_stream_h2d_t *stream)
+{
+    if (stream->RegionCount > 0)
     {
-    case GL_UNSIGNED_BYTE:               return sizeof(GLubyte);
-    case GL_FLOAT:                       return sizeof(GLfloat);
-    case GL_FLOAT_VEC2:                  return sizeof(GLfloat) *  2;
-    case GL_FLOAT_VEC3:                  return sizeof(GLfloat) *  3;
-    case GL_FLOAT_VEC4:                  return sizeof(GLfloat) *  4;
-    case GL_INT:                         return sizeof(GLint);
-    case GL_INT_VEC2:                    return sizeof(GLint)   *  2;
-    case GL_INT_VEC3:                    return sizeof(GLint)   *  3;
-    case GL_INT_VEC4:                    return sizeof(GLint)   *  4;
-    case GL_BOOL:                        return sizeof(GLint);
-    case GL_BOOL_VEC2:                   return sizeof(GLint)   *  2;
-    case GL_BOOL_VEC3:                   return sizeof(GLint)   *  3;
-    case GL_BOOL_VEC4:                   return sizeof(GLint)   *  4;
-    case GL_FLOAT_MAT2:                  return sizeof(GLfloat) *  4;
-    case GL_FLOAT_MAT3:                  return sizeof(GLfloat) *  9;
-    case GL_FLOAT_MAT4:                  return sizeof(GLfloat) * 16;
-    case GL_FLOAT_MAT2x3:                return sizeof(GLfloat) *  6;
-    case GL_FLOAT_MAT2x4:                return sizeof(GLfloat) *  8;
-    case GL_FLOAT_MAT3x2:                return sizeof(GLfloat) *  6;
-    case GL_FLOAT_MAT3x4:                return sizeof(GLfloat) * 12;
-    case GL_FLOAT_MAT4x2:                return sizeof(GLfloat) *  8;
-    case GL_FLOAT_MAT4x3:                return sizeof(GLfloat) * 12;
-    case GL_BYTE:                        return sizeof(GLbyte);
-    case GL_UNSIGNED_SHORT:              return sizeof(GLushort);
-    case GL_SHORT:                       return sizeof(GLshort);
-    case GL_UNSIGNED_INT:                return sizeof(GLuint);
-    case GL_UNSIGNED_SHORT_5_6_5:        return sizeof(GLushort);
-    case GL_UNSIGNED_SHORT_5_6_5_REV:    return sizeof(GLushort);
-    case GL_UNSIGNED_SHORT_4_4_4_4:      return sizeof(GLushort);
-    case GL_UNSIGNED_SHORT_4_4_4_4_REV:  return sizeof(GLushort);
-    case GL_UNSIGNED_SHORT_5_5_5_1:      return sizeof(GLushort);
-    case GL_UNSIGNED_SHORT_1_5_5_5_REV:  return sizeof(GLushort);
-    case GL_UNSIGNED_INT_8_8_8_8:        return sizeof(GLubyte);
-    case GL_UNSIGNED_INT_8_8_8_8_REV:    return sizeof(GLubyte);
-    case GL_UNSIGNED_INT_10_10_10_2:     return sizeof(GLuint);
-    case GL_UNSIGNED_INT_2_10_10_10_REV: return sizeof(GLuint);
-    case GL_UNSIGNED_BYTE_3_3_2:         return sizeof(GLubyte);
-    case GL_UNSIGNED_BYTE_2_3_3_REV:     return sizeof(GLubyte);
-    default:                             break;
+        gl::pixel_stream_region_t *r = pixel_stream_region(stream, stream->RegionCount - 1);
+        if (r->State == gl::PIXEL_STREAM_REGION_RESERVED) return r;
     }
-    return 0;
+    return NULL;
 }
 
-uint32_t gl::shader_name(char const *name)
+/// @summary Locates the active reservation beginning at a given address.
+/// @param stream The pixel stream to search.
+/// @param address The address returned by pixel_stream_h2d_reserve().
+/// @return A pointer to the region record, or NULL.
+static gl::pixel_stream_region_t* pixel_stream_find(gl::pixel_stream_h2d_t *stream, void const *address)
 {
-    #define HAS_NULL_BYTE(x) (((x) - 0x01010101) & (~(x) & 0x80808080))
-    #ifdef  _MSC_VER
-        #define ROTL32(x, y) _rotl((x), (y))
-    #else
-        #define ROTL32(x, y) rotl32((x), (y))
-    #endif
-
-    uint32_t hash = 0;
-    if (name != NULL)
+    if (address == NULL) return NULL;
+    for (size_t i = 0;  i < stream->RegionCount; ++i)
     {
-        // hash the majority of the data in 4-byte chunks.
-        while (!HAS_NULL_BYTE(*((uint32_t*)name)))
-        {
-            hash  = ROTL32(hash, 7) + name[0];
-            hash  = ROTL32(hash, 7) + name[1];
-            hash  = ROTL32(hash, 7) + name[2];
-            hash  = ROTL32(hash, 7) + name[3];
-            name += 4;
-        }
-        // hash the remaining 0-3 bytes.
-        while (*name) hash = ROTL32(hash, 7) + *name++;
+        gl::pixel_stream_region_t *r = pixel_stream_region(stream, i);
+        if (r->Address == address && r->State == gl::PIXEL_STREAM_REGION_RESERVED)
+            return r;
     }
-    #undef HAS_NULL_BYTE
-    #ifdef _MSC_VER
-        #undef ROTL32
-    #endif
-    return hash;
+    return NULL;
 }
 
-bool gl::builtin(char const *name)
+/// @summary Determines whether a pixel stream has a reservation outstanding.
+/// @param stream The pixel stream to query.
+/// @return true if at least one region is in the reserved state.
+static bool pixel_stream_mapped(gl::pixel_stream_h2d_t *stream)
 {
-    char prefix[4] = {'g','l','_','\0'};
-    return (strncmp(name, prefix, 3) == 0);
+    for (size_t i = 0;  i < stream->RegionCount; ++i)
+    {
+        if (pixel_stream_region(stream, i)->State == gl::PIXEL_STREAM_REGION_RESERVED)
+            return true;
+    }
+    return false;
 }
 
-bool gl::compile_shader(
-    GLenum   shader_type,
-    char   **shader_source,
-    size_t   string_count,
-    GLuint  *out_shader,
-    size_t  *out_log_size)
+/// @summary Releases the oldest region of a pixel stream, deleting its fence.
+/// @param stream The pixel stream to update.
+static void pixel_stream_pop(gl::pixel_stream_h2d_t *stream)
 {
-    GLuint  shader   = 0;
-    GLsizei log_size = 0;
-    GLint   result   = GL_FALSE;
+    gl::pixel_stream_region_t *r = pixel_stream_region(stream, 0);
+    if (r->Fence != NULL) glDeleteSync(r->Fence);
+    stream->Stats.BytesInFlight -= r->Size;
+    stream->RegionHead = (stream->RegionHead + 1) % GL_MAX_PIXEL_STREAM_REGIONS;
+    stream->RegionCount--;
+    r->Fence = NULL;
+    r->State = gl::PIXEL_STREAM_REGION_CANCELLED;
+    if (stream->RegionCount == 0)
+    {   // the ring is empty; restart at the beginning to limit wrapping.
+        stream->HeadOffset = 0;
+    }
+}
 
-    shader = glCreateShader(shader_type);
-    if (0 == shader)
-    {
-        if (out_shader)   *out_shader   = 0;
-        if (out_log_size) *out_log_size = 1;
+/// @summary Attempts to find space for a new region within the ring without
+/// overlapping any region that is reserved or in-flight.
+/// @param stream The pixel stream to allocate from.
+/// @param size The aligned size of the region, in bytes.
+/// @param out_offset On return, stores the byte offset of the new region.
+/// @return true if the region fits, or false if the ring is full.
+static bool pixel_stream_place(gl::pixel_stream_h2d_t *stream, size_t size, size_t *out_offset)
+{
+    if (stream->RegionCount == GL_MAX_PIXEL_STREAM_REGIONS)
         return false;
+    if (stream->RegionCount == 0)
+    {   // the entire buffer is available.
+        *out_offset = 0;
+        return true;
     }
-    glShaderSource (shader, GLsizei(string_count), (GLchar const**) shader_source, NULL);
-    glCompileShader(shader);
-    glGetShaderiv  (shader, GL_COMPILE_STATUS,  &result);
-    glGetShaderiv  (shader, GL_INFO_LOG_LENGTH, &log_size);
-    glGetError();
+    size_t head = stream->HeadOffset;
+    size_t tail = pixel_stream_region(stream, 0)->Offset;
+    if (head > tail)
+    {   // the free space is [head, BufferSize) and [0, tail).
+        if (head + size <= stream->BufferSize)
+        {
+            *out_offset = head;
+            return true;
+        }
+        if (size < tail)
+        {   // wrap around to the start of the buffer.
+            *out_offset = 0;
+            return true;
+        }
+        return false;
+    }
+    // the ring has wrapped; the free space is [head, tail).
+    if (head + size < tail)
+    {
+        *out_offset = head;
+        return true;
+    }
+    return false;
+}
 
-    if (out_shader)   *out_shader   = shader;
-    if (out_log_size) *out_log_size = log_size + 1;
-    return (result == GL_TRUE);
+/// @summary Blocks the calling thread until a fence is signaled.
+/// @param fence The fence to wait on.
+/// @return true if the fence was signaled, or false if the wait failed.
+static bool pixel_stream_wait(GLsync fence)
+{
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    GLuint64   nsec  = 1000000; // 1ms
+    for ( ; ; )
+    {
+        GLenum res = glClientWaitSync(fence, flags, nsec);
+        if (res == GL_ALREADY_SIGNALED || res == GL_CONDITION_SATISFIED)
+            return true;
+        if (res == GL_WAIT_FAILED)
+            return false;
+        flags = 0;
+    }
 }
 
-void gl::copy_compile_log(GLuint shader, char *buffer, size_t buffer_size)
+/// @summary Calculates the number of elements in a perfect hash table; one
+/// for the bucket mask, followed by one displacement per bucket.
+/// @param count The number of items to be indexed.
+/// @return The number of 16-bit elements in the table.
+static inline size_t phf_table_size(size_t count)
 {
-    GLsizei len = 0;
-    glGetShaderInfoLog(shader, (GLsizei) buffer_size, &len, buffer);
-    buffer[len] = '\0';
+    size_t nb = 1;
+    while (nb < count) nb <<= 1;
+    return nb + 1;
 }
 
-bool gl::attach_shaders(GLuint *shader_list, size_t shader_count, GLuint *out_program)
+/// @summary Builds a minimal perfect hash table using the hash-and-displace
+/// method. Names are distributed into buckets, and the buckets are processed
+/// from largest to smallest, searching for a displacement value that maps
+/// every name in the bucket to an unoccupied slot. The name and value lists
+/// are then reordered so that each item is stored in its slot.
+/// @param names The list of 32-bit name hashes.
+/// @param values The list of values, where values[i] corresponds to names[i].
+/// @param table The table to populate, with phf_table_size(count) elements.
+/// @param count The number of items in the name and value lists.
+/// @return true if the table was built, or false if the names could not be
+/// indexed, in which case the table is marked with GL_SHADER_INDEX_NONE.
+template <typename T>
+static bool phf_build(uint32_t *names, T *values, uint16_t *table, size_t count)
 {
-    GLuint  program = 0;
-    program = glCreateProgram();
-    if (0  == program)
-    {
-        if (out_program) *out_program = 0;
+    size_t    nb       = phf_table_size(count) - 1;
+    uint32_t  mask     = uint32_t(nb - 1);
+    size_t   *bucket   = NULL; // bucket of each name
+    size_t   *slot     = NULL; // slot assigned to each name
+    size_t   *order    = NULL; // bucket indices, largest first
+    size_t   *bsize    = NULL; // number of names in each bucket
+    uint8_t  *used     = NULL; // slot occupancy flags
+    uint32_t *tnames   = NULL; // reordered names
+    T        *tvalues  = NULL; // reordered values
+
+    table[0] = GL_SHADER_INDEX_NONE;
+    if (count == 0)
+    {   // nothing to index; lookups return immediately.
+        table[0] = 0;
+        table[1] = 0;
+        return true;
+    }
+    if (count >= GL_SHADER_INDEX_NONE)
         return false;
+
+    bucket  = (size_t  *) malloc(count * sizeof(size_t));
+    slot    = (size_t  *) malloc(count * sizeof(size_t));
+    order   = (size_t  *) malloc(nb    * sizeof(size_t));
+    bsize   = (size_t  *) malloc(nb    * sizeof(size_t));
+    used    = (uint8_t *) malloc(count * sizeof(uint8_t));
+    tnames  = (uint32_t*) malloc(count * sizeof(uint32_t));
+    tvalues = (T       *) malloc(count * sizeof(T));
+    if (!bucket || !slot || !order || !bsize || !used || !tnames || !tvalues)
+        goto cleanup;
+
+    memset(bsize, 0, nb    * sizeof(size_t));
+    memset(used,  0, count * sizeof(uint8_t));
+    for (size_t i = 0; i < count; ++i)
+    {
+        bucket[i] = gl::phf_bucket(names[i], mask);
+        bsize[bucket[i]]++;
+    }
+    for (size_t i = 0; i < nb; ++i)
+    {   // insertion sort; the number of buckets is small.
+        size_t j = i;
+        while (j > 0 && bsize[order[j-1]] < bsize[i])
+        {
+            order[j] = order[j-1];
+            --j;
+        }
+        order[j] = i;
     }
 
-    for (size_t i = 0; i < shader_count;  ++i)
+    for (size_t i = 0; i < nb; ++i)
     {
-        glAttachShader(program, shader_list[i]);
-        if (glGetError() != GL_NO_ERROR)
+        size_t b = order[i];
+        if (bsize[b] == 0)
+        {   // all remaining buckets are empty.
+            for ( ; i < nb; ++i) table[1 + order[i]] = 0;
+            break;
+        }
+        uint32_t d = 0;
+        for ( ; d < GL_SHADER_INDEX_NONE; ++d)
         {
-            glDeleteProgram(program);
-            if (out_program) *out_program = 0;
-            return false;
+            bool ok = true;
+            for (size_t k = 0; k < count && ok; ++k)
+            {
+                if (bucket[k] != b) continue;
+                slot[k] = gl::phf_slot(names[k], d, count);
+                if (used[slot[k]]) ok = false;
+                for (size_t m = 0; m < k && ok; ++m)
+                {   // check for collisions within the bucket.
+                    if (bucket[m] == b && slot[m] == slot[k]) ok = false;
+                }
+            }
+            if (ok) break;
+        }
+        if (d == GL_SHADER_INDEX_NONE)
+        {   // no displacement works; likely duplicate name hashes.
+            goto cleanup;
         }
+        for (size_t k = 0; k < count; ++k)
+        {
+            if (bucket[k] == b) used[slot[k]] = 1;
+        }
+        table[1 + b] = uint16_t(d);
     }
-    if (out_program) *out_program = program;
-    return true;
-}
 
-bool gl::assign_vertex_attributes(GLuint program, char const **attrib_names, GLuint *attrib_locations, size_t attrib_count)
-{
-    bool result   = true;
-    for (size_t i = 0; i < attrib_count; ++i)
+    // reorder the names and values so that item i is stored in slot[i].
+    for (size_t i = 0; i < count; ++i)
     {
-        glBindAttribLocation(program, attrib_locations[i], attrib_names[i]);
-        if (glGetError() != GL_NO_ERROR)
-            result = false;
+        tnames [slot[i]] = names [i];
+        tvalues[slot[i]] = values[i];
     }
-    return result;
+    memcpy(names,  tnames,  count * sizeof(uint32_t));
+    memcpy(values, tvalues, count * sizeof(T));
+    table[0] = uint16_t(mask);
+
+cleanup:
+    if (tvalues != NULL) free(tvalues);
+    if (tnames  != NULL) free(tnames);
+    if (used    != NULL) free(used);
+    if (bsize   != NULL) free(bsize);
+    if (order   != NULL) free(order);
+    if (slot    != NULL) free(slot);
+    if (bucket  != NULL) free(bucket);
+    return (table[0] != GL_SHADER_INDEX_NONE);
 }
 
-bool gl::assign_fragment_outputs(GLuint program, char const **output_names, GLuint *output_locations, size_t output_count)
+/// @summary Updates a 64-bit FNV-1a hash with a block of data.
+/// @param hash The current hash value. Specify FNV1A64_SEED for the first block.
+/// @param data The data to hash.
+/// @param size The number of bytes of data to hash.
+/// @return The updated hash value.
+static uint64_t fnv1a64(uint64_t hash, void const *data, size_t size)
 {
-    bool result   = true;
-    for (size_t i = 0; i < output_count; ++i)
+    uint8_t const *p = (uint8_t const*) data;
+    for (size_t i = 0; i < size; ++i)
     {
-        glBindFragDataLocation(program, output_locations[i], output_names[i]);
-        if (glGetError() != GL_NO_ERROR)
-            result = false;
+        hash ^= p[i];
+        hash *= FNV1A64_PRIME;
     }
-    return result;
+    return hash;
 }
 
-bool gl::link_program(GLuint program, size_t *out_max_name, size_t *out_log_size)
+/// @summary Calculates the size of the memory block allocated by shader_desc_alloc().
+/// @param desc The shader program description to query.
+/// @return The size of the block pointed to by desc->Metadata, in bytes.
+static size_t shader_desc_size(gl::shader_desc_t const *desc)
 {
-    GLsizei log_size = 0;
-    GLint   result   = GL_FALSE;
+    uint8_t const *beg = (uint8_t const*)  desc->Metadata;
+    uint8_t const *end = (uint8_t const*) (desc->UniformIndex + phf_table_size(desc->UniformCount));
+    return size_t(end - beg);
+}
 
-    glLinkProgram (program);
-    glGetProgramiv(program, GL_LINK_STATUS, &result);
-    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_size);
-    if (out_log_size) *out_log_size = log_size;
+/// @summary Builds the path of the file storing a shader cache entry.
+/// @param cache The shader cache.
+/// @param key The hash of the shader program source code.
+/// @param buffer The buffer to receive the NULL-terminated path.
+/// @param buffer_size The maximum number of bytes to write to buffer.
+/// @return true if the path fit in the buffer.
+static bool shader_cache_path(gl::shader_cache_t const *cache, uint64_t key, char *buffer, size_t buffer_size)
+{
+    int n = snprintf(buffer, buffer_size, "%s/%08x%08x.glpb", cache->Directory,
+        uint32_t(key >> 32), uint32_t(key & 0xFFFFFFFFU));
+    return (n > 0 && size_t(n) < buffer_size);
+}
 
-    if (result == GL_TRUE)
-    {
-        GLint a_max = 0;
-        GLint u_max = 0;
-        GLint n_max = 0;
+/// @summary Reflects a linked shader program, allocating and populating the
+/// shader program description.
+/// @param program The OpenGL program object, which must be linked successfully.
+/// @param shader The shader program object to initialize.
+/// @return true if the program was reflected successfully.
+static bool reflect_shader_program(GLuint program, gl::shader_desc_t *shader)
+{
+    GLint  a_max        = 0;
+    GLint  u_max        = 0;
+    GLint  b_max        = 0;
+    size_t max_name     = 0;
+    size_t num_attribs  = 0;
+    size_t num_samplers = 0;
+    size_t num_uniforms = 0;
+    size_t num_blocks   = 0;
+    char  *name_buffer  = NULL;
+
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH,   &u_max);
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &a_max);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &b_max);
+    if (u_max < a_max) u_max = a_max;
+    if (u_max < b_max) u_max = b_max;
+    max_name    = size_t(u_max) + 1;
+    name_buffer = (char*) malloc(max_name);
+    if (name_buffer == NULL)
+        return false;
+
+    gl::reflect_program_counts(program, name_buffer, max_name,
+        false, &num_attribs, &num_samplers, &num_uniforms);
+    num_blocks = gl::reflect_uniform_block_count(program);
+
+    if (!gl::shader_desc_alloc(shader, num_attribs, num_samplers, num_uniforms, num_blocks))
+    {
+        free(name_buffer);
+        return false;
+    }
+
+    // retrieve detailed information about all vertex attributes, texture
+    // samplers, uniform variables and uniform blocks.
+    gl::reflect_program_details(program, name_buffer, max_name, false,
+        shader->AttributeNames, shader->Attributes,
+        shader->SamplerNames,   shader->Samplers,
+        shader->UniformNames,   shader->Uniforms);
+    gl::reflect_uniform_blocks(program, name_buffer, max_name,
+        shader->UniformBlockNames, shader->UniformBlocks);
+    gl::shader_desc_index(shader);
+
+    free(name_buffer);
+    return true;
+}
+
+/// @summary Compiles, links and reflects a shader program.
+/// @param source The shader source code buffer.
+/// @param shader The shader program object to initialize.
+/// @param out_program On return, set to the OpenGL program object, or 0.
+/// @param retrievable Specify true to request that the driver retain the
+/// program binary so it can be retrieved with glGetProgramBinary.
+/// @return true if the build process was successful.
+static bool build_shader_program(gl::shader_source_t *source, gl::shader_desc_t *shader, GLuint *out_program, bool retrievable)
+{
+    GLuint shader_list[GL_MAX_SHADER_STAGES] = {0};
+    GLuint program       = 0;
+
+    for (size_t  i = 0; i < source->StageCount;  ++i)
+    {
+        size_t  ls = 0;
+        GLenum  sn = source->StageNames [i];
+        GLsizei fc = source->StringCount[i];
+        char  **sc = source->SourceCode [i];
+        if (!gl::compile_shader(sn, sc, fc, &shader_list[i], &ls))
+            goto error_cleanup;
+    }
+
+    if (!gl::attach_shaders(shader_list, source->StageCount, &program))
+        goto error_cleanup;
+
+    if (retrievable)
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    if (!gl::link_program(program, NULL, NULL))
+        goto error_cleanup;
+
+    // flag each attached shader for deletion when the program is deleted.
+    // the shaders are automatically detached when the program is deleted.
+    for (size_t i = 0; i < source->StageCount; ++i)
+        glDeleteShader(shader_list[i]);
+
+    // the shaders are owned by the program now; don't delete them twice.
+    for (size_t i = 0; i < source->StageCount; ++i)
+        shader_list[i] = 0;
+
+    // reflect the shader program to retrieve detailed information about
+    // all vertex attributes, texture samplers and uniform variables.
+    if (!reflect_shader_program(program, shader))
+        goto error_cleanup;
+
+    *out_program = program;
+    return true;
+
+error_cleanup:
+    for (size_t i = 0; i < source->StageCount; ++i)
+    {
+        if (shader_list[i] != 0)
+        {
+            glDeleteShader(shader_list[i]);
+        }
+    }
+    if (shader->Metadata != NULL) gl::shader_desc_free(shader);
+    if (program != 0)             gl::state_delete_program(program);
+    *out_program = 0;
+    return false;
+}
+
+/// @summary Attempts to restore a shader program from the program binary cache.
+/// @param cache The shader cache.
+/// @param key The hash of the shader program source code.
+/// @param shader The shader program object to initialize.
+/// @param out_program On return, set to the OpenGL program object, or 0.
+/// @return true if the program was restored from the cache.
+static bool shader_cache_load(gl::shader_cache_t *cache, uint64_t key, gl::shader_desc_t *shader, GLuint *out_program)
+{
+    shader_cache_header_t header;
+    char     path[1024];
+    uint8_t *metadata = NULL;
+    uint8_t *binary   = NULL;
+    GLuint   program  = 0;
+    GLint    linked   = GL_FALSE;
+    FILE    *fp       = NULL;
+
+    *out_program = 0;
+    if (!shader_cache_path(cache, key, path, sizeof(path)))
+        return false;
+    if ((fp = fopen(path, "rb")) == NULL)
+        return false;
+
+    if (fread(&header, sizeof(header), 1, fp) != 1)
+        goto error_cleanup;
+    if (header.Magic      != SHADER_CACHE_MAGIC   ||
+        header.Version    != SHADER_CACHE_VERSION ||
+        header.DriverHash != cache->DriverHash    ||
+        header.SourceHash != key)
+        goto error_cleanup;
+
+    if (!gl::shader_desc_alloc(shader, header.AttributeCount, header.SamplerCount, header.UniformCount, header.BlockCount))
+        goto error_cleanup;
+    if (shader_desc_size(shader) != header.MetadataSize)
+        goto error_cleanup;
+    if ((binary = (uint8_t*) malloc(header.BinarySize)) == NULL)
+        goto error_cleanup;
+
+    metadata = (uint8_t*) shader->Metadata;
+    if (fread(metadata, 1, header.MetadataSize, fp) != header.MetadataSize)
+        goto error_cleanup;
+    if (fread(binary, 1, header.BinarySize, fp) != header.BinarySize)
+        goto error_cleanup;
+    fclose(fp); fp = NULL;
+
+    // the driver may reject the binary, for example after a driver update
+    // that doesn't change the version string; the caller will rebuild.
+    program = glCreateProgram();
+    glProgramBinary(program, GLenum(header.BinaryFormat), binary, GLsizei(header.BinarySize));
+    glGetProgramiv (program, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE)
+    {
+        cache->Rejects++;
+        goto error_cleanup;
+    }
+    // uniform block bindings are not part of the program binary.
+    gl::apply_uniform_block_bindings(program, shader);
+
+    free(binary);
+    *out_program = program;
+    return true;
+
+error_cleanup:
+    if (shader->Metadata != NULL) gl::shader_desc_free(shader);
+    if (binary  != NULL)          free(binary);
+    if (program != 0)             gl::state_delete_program(program);
+    if (fp      != NULL)          fclose(fp);
+    return false;
+}
+
+/// @summary Writes a linked shader program to the program binary cache.
+/// @param cache The shader cache.
+/// @param key The hash of the shader program source code.
+/// @param shader The reflected shader program metadata.
+/// @param program The OpenGL program object, linked with the retrievable hint.
+/// @return true if the cache entry was written successfully.
+static bool shader_cache_store(gl::shader_cache_t *cache, uint64_t key, gl::shader_desc_t const *shader, GLuint program)
+{
+    shader_cache_header_t header;
+    char     path[1024];
+    uint8_t *binary   = NULL;
+    GLint    length   = 0;
+    GLsizei  written  = 0;
+    GLenum   format   = GL_NONE;
+    FILE    *fp       = NULL;
+    bool     result   = false;
+
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+    if (!shader_cache_path(cache, key, path, sizeof(path)))
+        return false;
+    if ((binary = (uint8_t*) malloc(size_t(length))) == NULL)
+        return false;
+
+    glGetProgramBinary(program, length, &written, &format, binary);
+    if (written > 0 && (fp = fopen(path, "wb")) != NULL)
+    {
+        header.Magic          = SHADER_CACHE_MAGIC;
+        header.Version        = SHADER_CACHE_VERSION;
+        header.DriverHash     = cache->DriverHash;
+        header.BinaryFormat   = uint32_t(format);
+        header.SourceHash     = key;
+        header.AttributeCount = uint32_t(shader->AttributeCount);
+        header.SamplerCount   = uint32_t(shader->SamplerCount);
+        header.UniformCount   = uint32_t(shader->UniformCount);
+        header.MetadataSize   = uint32_t(shader_desc_size(shader));
+        header.BinarySize     = uint32_t(written);
+        header.BlockCount     = uint32_t(shader->UniformBlockCount);
+        result = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                 fwrite(shader->Metadata, 1, header.MetadataSize, fp) == header.MetadataSize &&
+                 fwrite(binary, 1, header.BinarySize, fp) == header.BinarySize;
+        fclose(fp);
+        // a truncated entry fails validation when loaded, but remove it anyway.
+        if (!result) remove(path);
+    }
+    free(binary);
+    return result;
+}
+
+/// @summary Releases the OpenGL objects for a shader program that failed to
+/// build, and updates the batch counters.
+/// @param batch The shader batch.
+/// @param item The shader program that failed.
+static void shader_build_fail(gl::shader_batch_t *batch, gl::shader_build_t *item)
+{
+    for (size_t i = 0; i < item->Source->StageCount; ++i)
+    {
+        if (item->Stages[i] != 0)
+        {
+            glDeleteShader(item->Stages[i]);
+            item->Stages[i] = 0;
+        }
+    }
+    if (item->Program != 0)
+    {
+        gl::state_delete_program(item->Program);
+        item->Program = 0;
+    }
+    item->State = gl::SHADER_BUILD_STATE_FAILED;
+    batch->Pending--;
+    batch->Failed++;
+}
+
+/// @summary Determines whether the driver has finished compiling a shader or
+/// linking a program. Without parallel compilation, this always returns true,
+/// and the subsequent status query blocks instead.
+/// @param parallel true if KHR_parallel_shader_compile is in use.
+/// @param object The shader or program object.
+/// @param is_program true if @a object is a program object.
+/// @return true if the result of the operation is available.
+static bool shader_build_ready(bool parallel, GLuint object, bool is_program)
+{
+#ifdef GL_KHR_parallel_shader_compile
+    if (parallel)
+    {
+        GLint done = GL_FALSE;
+        if (is_program) glGetProgramiv(object, GL_COMPLETION_STATUS_KHR, &done);
+        else            glGetShaderiv (object, GL_COMPLETION_STATUS_KHR, &done);
+        return (done == GL_TRUE);
+    }
+#else
+    (void) parallel;
+    (void) object;
+    (void) is_program;
+#endif
+    return true;
+}
+
+/// @summary Locates or registers a named GPU profiler scope.
+/// @param profiler The GPU profiler.
+/// @param name The NULL-terminated scope name.
+/// @return The zero-based scope index, or GL_MAX_GPU_PROFILER_SCOPES if the
+/// scope table is full.
+static size_t gpu_profiler_scope(gl::gpu_profiler_t *profiler, char const *name)
+{
+    uint32_t hash = gl::shader_name(name);
+    for (size_t i = 0; i < profiler->ScopeCount; ++i)
+    {
+        if (profiler->Scopes[i].NameHash == hash)
+            return i;
+    }
+    if (profiler->ScopeCount < GL_MAX_GPU_PROFILER_SCOPES)
+    {
+        size_t index = profiler->ScopeCount++;
+        gl::gpu_scope_stats_t *scope = &profiler->Scopes[index];
+        memset(scope, 0, sizeof(gl::gpu_scope_stats_t));
+        scope->Name     = name;
+        scope->NameHash = hash;
+        return index;
+    }
+    return GL_MAX_GPU_PROFILER_SCOPES;
+}
+
+/// @summary Reads back the timestamp queries for a recorded frame, if they
+/// are available, and updates the per-scope statistics.
+/// @param profiler The GPU profiler.
+/// @param frame The frame to resolve.
+/// @return true if the results were available.
+static bool gpu_profiler_resolve(gl::gpu_profiler_t *profiler, gl::gpu_profiler_frame_t *frame)
+{
+    uint64_t ns   [GL_MAX_GPU_PROFILER_SCOPES];
+    size_t   calls[GL_MAX_GPU_PROFILER_SCOPES];
+    GLuint   ready = GL_FALSE;
+
+    // queries complete in the order they were issued.
+    glGetQueryObjectuiv(frame->Queries[frame->LastQuery], GL_QUERY_RESULT_AVAILABLE, &ready);
+    if (ready != GL_TRUE)
+        return false;
+
+    memset(ns,    0, sizeof(ns));
+    memset(calls, 0, sizeof(calls));
+    for (size_t i = 0; i < frame->SampleCount; ++i)
+    {
+        GLuint64 t0 = 0;
+        GLuint64 t1 = 0;
+        size_t   si = frame->Scopes[i];
+        glGetQueryObjectui64v(frame->Queries[i * 2 + 0], GL_QUERY_RESULT, &t0);
+        glGetQueryObjectui64v(frame->Queries[i * 2 + 1], GL_QUERY_RESULT, &t1);
+        if (t1 > t0) ns[si] += t1 - t0;
+        calls[si]++;
+    }
+    for (size_t i = 0; i < profiler->ScopeCount; ++i)
+    {
+        gl::gpu_scope_stats_t *scope = &profiler->Scopes[i];
+        scope->Calls  = calls[i];
+        scope->LastNs = ns[i];
+        if (calls[i] == 0)
+            continue;
+        if (scope->Frames == 0 || ns[i] < scope->MinNs) scope->MinNs = ns[i];
+        if (scope->Frames == 0 || ns[i] > scope->MaxNs) scope->MaxNs = ns[i];
+        scope->TotalNs += ns[i];
+        scope->Frames  += 1;
+        scope->AvgNs    = double(scope->TotalNs) / double(scope->Frames);
+    }
+    return true;
+}
+
+/// @summary Appends a new, empty command group to a command buffer.
+/// @param cmdbuf The command buffer.
+/// @param sort_key The sort key of the new group.
+/// @return true if the group was appended.
+static bool command_buffer_group(gl::command_buffer_t *cmdbuf, uint64_t sort_key)
+{
+    if (cmdbuf->GroupCount == cmdbuf->GroupCapacity)
+    {
+        size_t newc = cmdbuf->GroupCapacity < 16 ? 16 : cmdbuf->GroupCapacity * 2;
+        void  *newg = realloc(cmdbuf->Groups, newc * sizeof(gl::command_group_t));
+        if (newg == NULL) return false;
+        cmdbuf->Groups        = (gl::command_group_t*) newg;
+        cmdbuf->GroupCapacity = newc;
+    }
+    gl::command_group_t &g = cmdbuf->Groups[cmdbuf->GroupCount++];
+    g.SortKey = sort_key;
+    g.Begin   = cmdbuf->Used;
+    g.End     = cmdbuf->Used;
+    return true;
+}
+
+/// @summary Reserves space for a command at the end of a command buffer.
+/// @param cmdbuf The command buffer.
+/// @param type One of gl::command_type_e.
+/// @param payload_size The size of the command payload, in bytes.
+/// @return A pointer to the zero-initialized command payload, or NULL.
+static void* command_buffer_alloc(gl::command_buffer_t *cmdbuf, uint32_t type, size_t payload_size)
+{
+    size_t size = (sizeof(command_header_t) + payload_size + 7) & ~size_t(7);
+    if (cmdbuf->GroupCount == 0 && !command_buffer_group(cmdbuf, 0))
+        return NULL;
+    if (cmdbuf->Used + size > cmdbuf->Capacity)
+    {
+        size_t newc = cmdbuf->Capacity < 4096 ? 4096 : cmdbuf->Capacity;
+        while (newc < cmdbuf->Used + size) newc *= 2;
+        void  *newb = realloc(cmdbuf->Commands, newc);
+        if (newb == NULL) return NULL;
+        cmdbuf->Commands = (uint8_t*) newb;
+        cmdbuf->Capacity = newc;
+    }
+    command_header_t *cmd = (command_header_t*) (cmdbuf->Commands + cmdbuf->Used);
+    memset(cmd, 0, size);
+    cmd->Type    = type;
+    cmd->Size    = uint32_t(size);
+    cmdbuf->Used+= size;
+    cmdbuf->CommandCount++;
+    cmdbuf->Groups[cmdbuf->GroupCount - 1].End = cmdbuf->Used;
+    return (cmd + 1);
+}
+
+/// @summary Records a command whose payload is a single object binding.
+/// @param cmdbuf The command buffer.
+/// @param type One of gl::command_type_e.
+/// @param target The binding target, if any.
+/// @param unit The texture unit, if any.
+/// @param object The OpenGL object name.
+/// @return true if the command was recorded.
+static bool command_buffer_bind(gl::command_buffer_t *cmdbuf, uint32_t type, GLenum target, GLuint unit, GLuint object)
+{
+    command_bind_t *cmd = (command_bind_t*) command_buffer_alloc(cmdbuf, type, sizeof(command_bind_t));
+    if (cmd == NULL) return false;
+    cmd->Target = target;
+    cmd->Unit   = unit;
+    cmd->Object = object;
+    return true;
+}
+
+/// @summary Records a fixed-function state command.
+/// @param cmdbuf The command buffer.
+/// @param type One of gl::command_type_e.
+/// @param v0 The first state value.
+/// @param v1 The second state value.
+/// @param v2 The third state value.
+/// @param v3 The fourth state value.
+/// @return A pointer to the command payload, or NULL.
+static command_state_t* command_buffer_state(gl::command_buffer_t *cmdbuf, uint32_t type, GLenum v0, GLenum v1, GLenum v2, GLenum v3)
+{
+    command_state_t *cmd = (command_state_t*) command_buffer_alloc(cmdbuf, type, sizeof(command_state_t));
+    if (cmd != NULL)
+    {
+        cmd->Values[0] = v0;
+        cmd->Values[1] = v1;
+        cmd->Values[2] = v2;
+        cmd->Values[3] = v3;
+    }
+    return cmd;
+}
+
+/// @summary Executes a single recorded command on the GL thread.
+/// @param cmd The command header, followed by the command payload.
+static void execute_command(command_header_t const *cmd)
+{
+    void const *data = (void const*) (cmd + 1);
+    switch (cmd->Type)
+    {
+        case gl::COMMAND_TYPE_USE_PROGRAM:
+            {
+                command_bind_t const *c = (command_bind_t const*) data;
+                gl::state_use_program(c->Object);
+            }
+            break;
+        case gl::COMMAND_TYPE_BIND_VERTEX_ARRAY:
+            {
+                command_bind_t const *c = (command_bind_t const*) data;
+                gl::state_bind_vertex_array(c->Object);
+            }
+            break;
+        case gl::COMMAND_TYPE_BIND_BUFFER:
+            {
+                command_bind_t const *c = (command_bind_t const*) data;
+                gl::state_bind_buffer(c->Target, c->Object);
+            }
+            break;
+        case gl::COMMAND_TYPE_BIND_BUFFER_RANGE:
+            {
+                command_bind_range_t const *c = (command_bind_range_t const*) data;
+                gl::state_bind_buffer_range(c->Target, c->Index, c->Buffer, c->Offset, c->Size);
+            }
+            break;
+        case gl::COMMAND_TYPE_BIND_TEXTURE:
+            {
+                command_bind_t const *c = (command_bind_t const*) data;
+                gl::state_bind_texture(c->Unit, c->Target, c->Object);
+            }
+            break;
+        case gl::COMMAND_TYPE_SET_SAMPLER:
+            {
+                command_sampler_t const *c = (command_sampler_t const*) data;
+                gl::set_sampler(c->Sampler, c->Texture);
+            }
+            break;
+        case gl::COMMAND_TYPE_SET_UNIFORM:
+            {
+                command_uniform_t const *c = (command_uniform_t const*) data;
+                gl::set_uniform(c->Uniform, (void const*) (c + 1), c->Transpose != 0);
+            }
+            break;
+        case gl::COMMAND_TYPE_ENABLE:
+            {
+                command_state_t const *c = (command_state_t const*) data;
+                gl::state_enable(c->Values[0], c->Values[1] != GL_FALSE);
+            }
+            break;
+        case gl::COMMAND_TYPE_BLEND_FUNC:
+            {
+                command_state_t const *c = (command_state_t const*) data;
+                gl::state_blend_func(c->Values[0], c->Values[1], c->Values[2], c->Values[3]);
+            }
+            break;
+        case gl::COMMAND_TYPE_BLEND_EQUATION:
+            {
+                command_state_t const *c = (command_state_t const*) data;
+                gl::state_blend_equation(c->Values[0], c->Values[1]);
+            }
+            break;
+        case gl::COMMAND_TYPE_BLEND_COLOR:
+            {
+                command_state_t const *c = (command_state_t const*) data;
+                gl::state_blend_color(c->Color[0], c->Color[1], c->Color[2], c->Color[3]);
+            }
+            break;
+        case gl::COMMAND_TYPE_DEPTH_FUNC:
+            {
+                command_state_t const *c = (command_state_t const*) data;
+                gl::state_depth_func(c->Values[0]);
+            }
+            break;
+        case gl::COMMAND_TYPE_DEPTH_MASK:
+            {
+                command_state_t const *c = (command_state_t const*) data;
+                gl::state_depth_mask(c->Values[0] != GL_FALSE);
+            }
+            break;
+        case gl::COMMAND_TYPE_TRANSFER_PIXELS_H2D:
+            {
+                gl::pixel_transfer_h2d_t x = *(gl::pixel_transfer_h2d_t const*) data;
+                gl::transfer_pixels_h2d(&x);
+            }
+            break;
+        case gl::COMMAND_TYPE_TRANSFER_PIXELS_D2H:
+            {
+                gl::pixel_transfer_d2h_t x = *(gl::pixel_transfer_d2h_t const*) data;
+                gl::transfer_pixels_d2h(&x);
+            }
+            break;
+        case gl::COMMAND_TYPE_DRAW_SPRITE_BATCH:
+            {
+                command_draw_sprites_t const *c = (command_draw_sprites_t const*) data;
+                gl::sprite_effect_draw_batch_ptc(c->Effect, c->Batch, c->FxFuncs, c->Context);
+            }
+            break;
+        case gl::COMMAND_TYPE_CALLBACK:
+            {
+                command_callback_t const *c = (command_callback_t const*) data;
+                c->Func(c->Context);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/// @summary Buffers and draws a contiguous range of a sorted sprite batch,
+/// invoking the effect setup callback first.
+/// @param effect The effect being applied.
+/// @param batch The sprite batch being rendered.
+/// @param quad_index The index of the first quad in the batch order array.
+/// @param quad_count The number of quads to draw.
+/// @param fxfuncs The effect-specific functions for applying render state.
+/// @param context Opaque data defined by the application.
+static void sprite_effect_draw_range_ptc(
+    gl::sprite_effect_t             *effect,
+    gl::sprite_batch_t              *batch,
+    size_t                           quad_index,
+    size_t                           quad_count,
+    gl::sprite_effect_apply_t const *fxfuncs,
+    void                            *context)
+{
+    size_t base_index = 0;
+    size_t n          = 0;
+
+    fxfuncs->SetupEffect(effect, context);
+    effect->CurrentState = 0xFFFFFFFFU;
+    if (effect->Pass == gl::SPRITE_PASS_OPAQUE)
+    {   // opaque sprites write depth and never need blending.
+        gl::state_enable(GL_BLEND, false);
+        gl::state_enable(GL_DEPTH_TEST, true);
+        gl::state_depth_func(GL_LESS);
+        gl::state_depth_mask(true);
+    }
+    else if (effect->Pass == gl::SPRITE_PASS_TRANSLUCENT)
+    {   // translucent sprites are hidden by nearer opaque sprites.
+        gl::state_enable(GL_DEPTH_TEST, true);
+        gl::state_depth_func(GL_LEQUAL);
+        gl::state_depth_mask(false);
+    }
+
+    while (quad_count > 0)
+    {
+        n = gl::sprite_effect_buffer_data_ptc(effect, batch->Quads, batch->Order, quad_index, quad_count, &base_index);
+        gl::sprite_effect_draw_batch_region_ptc(effect, batch, quad_index, n, base_index, fxfuncs, context);
+        base_index  = effect->IndexOffset;
+        quad_index += n;
+        quad_count -= n;
+    }
+}
+
+/// @summary Describes the shape of a uniform data type for the std140 layout
+/// rules. Vectors have a single column; matrices are stored column-major.
+/// @param data_type The uniform data type, ex. GL_FLOAT_MAT2x3.
+/// @param out_cols On return, set to the number of columns.
+/// @param out_rows On return, set to the number of 32-bit components per column.
+/// @return true if the data type is supported in a uniform block.
+static bool std140_shape(GLenum data_type, size_t *out_cols, size_t *out_rows)
+{
+    size_t c = 1;
+    size_t r = 0;
+    switch (data_type)
+    {
+        case GL_FLOAT:
+        case GL_INT:
+        case GL_UNSIGNED_INT:
+        case GL_BOOL:              r = 1;        break;
+        case GL_FLOAT_VEC2:
+        case GL_INT_VEC2:
+        case GL_UNSIGNED_INT_VEC2:
+        case GL_BOOL_VEC2:         r = 2;        break;
+        case GL_FLOAT_VEC3:
+        case GL_INT_VEC3:
+        case GL_UNSIGNED_INT_VEC3:
+        case GL_BOOL_VEC3:         r = 3;        break;
+        case GL_FLOAT_VEC4:
+        case GL_INT_VEC4:
+        case GL_UNSIGNED_INT_VEC4:
+        case GL_BOOL_VEC4:         r = 4;        break;
+        case GL_FLOAT_MAT2:        c = 2; r = 2; break;
+        case GL_FLOAT_MAT3:        c = 3; r = 3; break;
+        case GL_FLOAT_MAT4:        c = 4; r = 4; break;
+        case GL_FLOAT_MAT2x3:      c = 2; r = 3; break;
+        case GL_FLOAT_MAT2x4:      c = 2; r = 4; break;
+        case GL_FLOAT_MAT3x2:      c = 3; r = 2; break;
+        case GL_FLOAT_MAT3x4:      c = 3; r = 4; break;
+        case GL_FLOAT_MAT4x2:      c = 4; r = 2; break;
+        case GL_FLOAT_MAT4x3:      c = 4; r = 3; break;
+        default: return false;
+    }
+    *out_cols = c;
+    *out_rows = r;
+    return true;
+}
+
+/// @summary Maps an OpenGL buffer target to an index in state_cache_t::Buffers.
+/// @param target The buffer target, ex. GL_ARRAY_BUFFER.
+/// @return One of state_buffer_target_e, or STATE_BUFFER_TARGET_COUNT if the
+/// target is not tracked by the shadow state cache.
+static size_t state_buffer_index(GLenum target)
+{
+    switch (target)
+    {
+        case GL_ARRAY_BUFFER:         return gl::STATE_BUFFER_ARRAY;
+        case GL_ELEMENT_ARRAY_BUFFER: return gl::STATE_BUFFER_ELEMENT_ARRAY;
+        case GL_PIXEL_PACK_BUFFER:    return gl::STATE_BUFFER_PIXEL_PACK;
+        case GL_PIXEL_UNPACK_BUFFER:  return gl::STATE_BUFFER_PIXEL_UNPACK;
+        case GL_UNIFORM_BUFFER:       return gl::STATE_BUFFER_UNIFORM;
+        case GL_COPY_READ_BUFFER:     return gl::STATE_BUFFER_COPY_READ;
+        case GL_COPY_WRITE_BUFFER:    return gl::STATE_BUFFER_COPY_WRITE;
+        case GL_TEXTURE_BUFFER:       return gl::STATE_BUFFER_TEXTURE;
+        default: break;
+    }
+    return gl::STATE_BUFFER_TARGET_COUNT;
+}
+
+/// @summary Maps an OpenGL texture target to an index in state_cache_t::Textures.
+/// @param target The texture target, ex. GL_TEXTURE_2D.
+/// @return One of state_texture_target_e, or STATE_TEXTURE_TARGET_COUNT if the
+/// target is not tracked by the shadow state cache.
+static size_t state_texture_index(GLenum target)
+{
+    switch (target)
+    {
+        case GL_TEXTURE_1D:             return gl::STATE_TEXTURE_1D;
+        case GL_TEXTURE_2D:             return gl::STATE_TEXTURE_2D;
+        case GL_TEXTURE_3D:             return gl::STATE_TEXTURE_3D;
+        case GL_TEXTURE_1D_ARRAY:       return gl::STATE_TEXTURE_1D_ARRAY;
+        case GL_TEXTURE_2D_ARRAY:       return gl::STATE_TEXTURE_2D_ARRAY;
+        case GL_TEXTURE_RECTANGLE:      return gl::STATE_TEXTURE_RECTANGLE;
+        case GL_TEXTURE_CUBE_MAP:       return gl::STATE_TEXTURE_CUBE_MAP;
+        case GL_TEXTURE_CUBE_MAP_ARRAY: return gl::STATE_TEXTURE_CUBE_MAP_ARRAY;
+        case GL_TEXTURE_BUFFER:         return gl::STATE_TEXTURE_BUFFER;
+        default: break;
+    }
+    return gl::STATE_TEXTURE_TARGET_COUNT;
+}
+
+/// @summary Compares a cached state value against a new value, updating the
+/// cache and the call counters.
+/// @param cache The current shadow state cache, or NULL.
+/// @param cached The cached state value.
+/// @param value The new state value.
+/// @return true if the GL call must be issued.
+static inline bool state_changed(gl::state_cache_t *cache, GLuint &cached, GLuint value)
+{
+    if (cache == NULL) return true;
+    if (cached != value)
+    {
+        cached  = value;
+        cache->Counters.Issued++;
+        return true;
+    }
+    cache->Counters.Elided++;
+    return false;
+}
+
+/// @summary Reads a monotonic clock used to enforce upload scheduler time budgets.
+/// @return The current time, in microseconds, from an arbitrary epoch.
+static uint64_t upload_clock_usec(void)
+{
+#if   defined(_WIN32) || defined(_WIN64)
+    LARGE_INTEGER f, t;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&t);
+    return uint64_t((t.QuadPart / f.QuadPart) * 1000000 + ((t.QuadPart % f.QuadPart) * 1000000) / f.QuadPart);
+#elif defined(__APPLE__)
+    static mach_timebase_info_data_t tb = {0, 0};
+    if (tb.denom == 0) mach_timebase_info(&tb);
+    return (mach_absolute_time() * tb.numer / tb.denom) / 1000;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000 + uint64_t(ts.tv_nsec / 1000);
+#endif
+}
+
+/// @summary Determines whether one upload job should execute before another.
+/// @param a The first job.
+/// @param b The second job.
+/// @return true if job @a a has a lower priority value, or was submitted first.
+static inline bool upload_job_before(gl::upload_job_t const &a, gl::upload_job_t const &b)
+{
+    if (a.Priority != b.Priority) return (a.Priority < b.Priority);
+    return (a.Sequence < b.Sequence);
+}
+
+/// @summary Moves the job at a given position of the upload heap toward the
+/// root until the heap property is restored.
+/// @param jobs The upload job heap.
+/// @param pos The zero-based index of the job to move.
+static void upload_heap_up(gl::upload_job_t *jobs, size_t pos)
+{
+    gl::upload_job_t item = jobs[pos];
+    while (pos > 0)
+    {
+        size_t parent = (pos - 1) / 2;
+        if (!upload_job_before(item, jobs[parent]))
+            break;
+        jobs[pos] = jobs[parent];
+        pos       = parent;
+    }
+    jobs[pos] = item;
+}
+
+/// @summary Moves the job at a given position of the upload heap toward the
+/// leaves until the heap property is restored.
+/// @param jobs The upload job heap.
+/// @param count The number of jobs in the heap.
+/// @param pos The zero-based index of the job to move.
+static void upload_heap_down(gl::upload_job_t *jobs, size_t count, size_t pos)
+{
+    gl::upload_job_t item = jobs[pos];
+    for ( ; ; )
+    {
+        size_t child = pos * 2 + 1;
+        if (child >= count)
+            break;
+        if (child + 1 < count && upload_job_before(jobs[child + 1], jobs[child]))
+            child++;
+        if (!upload_job_before(jobs[child], item))
+            break;
+        jobs[pos] = jobs[child];
+        pos       = child;
+    }
+    jobs[pos] = item;
+}
+
+/// @summary Determines the texture target to bind for a transfer target.
+/// Transfers to cube map faces require the cube map to be bound.
+/// @param target The transfer target.
+/// @return The texture binding target.
+static inline GLenum upload_bind_target(GLenum target)
+{
+    if (target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z)
+        return GL_TEXTURE_CUBE_MAP;
+    return target;
+}
+
+/// @summary Executes a single upload job that has been removed from the queue
+/// and updates the latency counters of the scheduler.
+/// @param sched The upload scheduler.
+/// @param job The job to execute.
+/// @param align The GL_UNPACK_ALIGNMENT value currently set, updated if the job changes it.
+/// @return The time at which the job completed, in microseconds.
+static uint64_t upload_job_execute(gl::upload_scheduler_t *sched, gl::upload_job_t &job, GLint *align)
+{
+    GLenum const bind = upload_bind_target(job.Transfer.Target);
+    if (job.Alignment != *align)
+    {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, job.Alignment);
+        *align = job.Alignment;
+    }
+    gl::state_bind_texture(0, bind, job.Texture);
+    gl::transfer_pixels_h2d(&job.Transfer);
+    gl::state_bind_texture(0, bind, 0);
+
+    uint64_t const now     = upload_clock_usec();
+    uint64_t const latency = now - job.SubmitTime;
+    size_t   const frames  = sched->FrameIndex - job.SubmitFrame;
+    sched->Stats.TotalLatencyMicros += latency;
+    if (sched->Stats.MaxLatencyMicros < latency) sched->Stats.MaxLatencyMicros = latency;
+    if (sched->Stats.MaxLatencyFrames < frames ) sched->Stats.MaxLatencyFrames = frames;
+    if (sched->Complete != NULL) sched->Complete(job.Tag, sched->Context);
+    return now;
+}
+
+/*////////////////////////
+//   Public Functions   //
+////////////////////////*/
+size_t gl::data_size(GLenum data_type)
+{
+    switch (data_type)
+    {
+    case GL_UNSIGNED_BYTE:               return sizeof(GLubyte);
+    case GL_FLOAT:                       return sizeof(GLfloat);
+    case GL_FLOAT_VEC2:                  return sizeof(GLfloat) *  2;
+    case GL_FLOAT_VEC3:                  return sizeof(GLfloat) *  3;
+    case GL_FLOAT_VEC4:                  return sizeof(GLfloat) *  4;
+    case GL_INT:                         return sizeof(GLint);
+    case GL_INT_VEC2:                    return sizeof(GLint)   *  2;
+    case GL_INT_VEC3:                    return sizeof(GLint)   *  3;
+    case GL_INT_VEC4:                    return sizeof(GLint)   *  4;
+    case GL_BOOL:                        return sizeof(GLint);
+    case GL_BOOL_VEC2:                   return sizeof(GLint)   *  2;
+    case GL_BOOL_VEC3:                   return sizeof(GLint)   *  3;
+    case GL_BOOL_VEC4:                   return sizeof(GLint)   *  4;
+    case GL_FLOAT_MAT2:                  return sizeof(GLfloat) *  4;
+    case GL_FLOAT_MAT3:                  return sizeof(GLfloat) *  9;
+    case GL_FLOAT_MAT4:                  return sizeof(GLfloat) * 16;
+    case GL_FLOAT_MAT2x3:                return sizeof(GLfloat) *  6;
+    case GL_FLOAT_MAT2x4:                return sizeof(GLfloat) *  8;
+    case GL_FLOAT_MAT3x2:                return sizeof(GLfloat) *  6;
+    case GL_FLOAT_MAT3x4:                return sizeof(GLfloat) * 12;
+    case GL_FLOAT_MAT4x2:                return sizeof(GLfloat) *  8;
+    case GL_FLOAT_MAT4x3:                return sizeof(GLfloat) * 12;
+    case GL_BYTE:                        return sizeof(GLbyte);
+    case GL_UNSIGNED_SHORT:              return sizeof(GLushort);
+    case GL_SHORT:                       return sizeof(GLshort);
+    case GL_UNSIGNED_INT:                return sizeof(GLuint);
+    case GL_UNSIGNED_SHORT_5_6_5:        return sizeof(GLushort);
+    case GL_UNSIGNED_SHORT_5_6_5_REV:    return sizeof(GLushort);
+    case GL_UNSIGNED_SHORT_4_4_4_4:      return sizeof(GLushort);
+    case GL_UNSIGNED_SHORT_4_4_4_4_REV:  return sizeof(GLushort);
+    case GL_UNSIGNED_SHORT_5_5_5_1:      return sizeof(GLushort);
+    case GL_UNSIGNED_SHORT_1_5_5_5_REV:  return sizeof(GLushort);
+    case GL_UNSIGNED_INT_8_8_8_8:        return sizeof(GLubyte);
+    case GL_UNSIGNED_INT_8_8_8_8_REV:    return sizeof(GLubyte);
+    case GL_UNSIGNED_INT_10_10_10_2:     return sizeof(GLuint);
+    case GL_UNSIGNED_INT_2_10_10_10_REV: return sizeof(GLuint);
+    case GL_UNSIGNED_BYTE_3_3_2:         return sizeof(GLubyte);
+    case GL_UNSIGNED_BYTE_2_3_3_REV:     return sizeof(GLubyte);
+    default:                             break;
+    }
+    return 0;
+}
+
+uint32_t gl::shader_name(char const *name)
+{
+    #define HAS_NULL_BYTE(x) (((x) - 0x01010101) & (~(x) & 0x80808080))
+    #ifdef  _MSC_VER
+        #define ROTL32(x, y) _rotl((x), (y))
+    #else
+        #define ROTL32(x, y) rotl32((x), (y))
+    #endif
+
+    uint32_t hash = 0;
+    if (name != NULL)
+    {
+        // hash the majority of the data in 4-byte chunks.
+        while (!HAS_NULL_BYTE(*((uint32_t*)name)))
+        {
+            hash  = ROTL32(hash, 7) + name[0];
+            hash  = ROTL32(hash, 7) + name[1];
+            hash  = ROTL32(hash, 7) + name[2];
+            hash  = ROTL32(hash, 7) + name[3];
+            name += 4;
+        }
+        // hash the remaining 0-3 bytes.
+        while (*name) hash = ROTL32(hash, 7) + *name++;
+    }
+    #undef HAS_NULL_BYTE
+    #ifdef _MSC_VER
+        #undef ROTL32
+    #endif
+    return hash;
+}
+
+bool gl::builtin(char const *name)
+{
+    char prefix[4] = {'g','l','_','\0'};
+    return (strncmp(name, prefix, 3) == 0);
+}
+
+bool gl::compile_shader(
+    GLenum   shader_type,
+    char   **shader_source,
+    size_t   string_count,
+    GLuint  *out_shader,
+    size_t  *out_log_size)
+{
+    GLuint  shader   = 0;
+    GLsizei log_size = 0;
+    GLint   result   = GL_FALSE;
+
+    shader = glCreateShader(shader_type);
+    if (0 == shader)
+    {
+        if (out_shader)   *out_shader   = 0;
+        if (out_log_size) *out_log_size = 1;
+        return false;
+    }
+    glShaderSource (shader, GLsizei(string_count), (GLchar const**) shader_source, NULL);
+    glCompileShader(shader);
+    glGetShaderiv  (shader, GL_COMPILE_STATUS,  &result);
+    glGetShaderiv  (shader, GL_INFO_LOG_LENGTH, &log_size);
+    glGetError();
+
+    if (out_shader)   *out_shader   = shader;
+    if (out_log_size) *out_log_size = log_size + 1;
+    return (result == GL_TRUE);
+}
+
+void gl::copy_compile_log(GLuint shader, char *buffer, size_t buffer_size)
+{
+    GLsizei len = 0;
+    glGetShaderInfoLog(shader, (GLsizei) buffer_size, &len, buffer);
+    buffer[len] = '\0';
+}
+
+bool gl::attach_shaders(GLuint *shader_list, size_t shader_count, GLuint *out_program)
+{
+    GLuint  program = 0;
+    program = glCreateProgram();
+    if (0  == program)
+    {
+        if (out_program) *out_program = 0;
+        return false;
+    }
+
+    for (size_t i = 0; i < shader_count;  ++i)
+    {
+        glAttachShader(program, shader_list[i]);
+        if (glGetError() != GL_NO_ERROR)
+        {
+            gl::state_delete_program(program);
+            if (out_program) *out_program = 0;
+            return false;
+        }
+    }
+    if (out_program) *out_program = program;
+    return true;
+}
+
+bool gl::assign_vertex_attributes(GLuint program, char const **attrib_names, GLuint *attrib_locations, size_t attrib_count)
+{
+    bool result   = true;
+    for (size_t i = 0; i < attrib_count; ++i)
+    {
+        glBindAttribLocation(program, attrib_locations[i], attrib_names[i]);
+        if (glGetError() != GL_NO_ERROR)
+            result = false;
+    }
+    return result;
+}
+
+bool gl::assign_fragment_outputs(GLuint program, char const **output_names, GLuint *output_locations, size_t output_count)
+{
+    bool result   = true;
+    for (size_t i = 0; i < output_count; ++i)
+    {
+        glBindFragDataLocation(program, output_locations[i], output_names[i]);
+        if (glGetError() != GL_NO_ERROR)
+            result = false;
+    }
+    return result;
+}
+
+bool gl::link_program(GLuint program, size_t *out_max_name, size_t *out_log_size)
+{
+    GLsizei log_size = 0;
+    GLint   result   = GL_FALSE;
+
+    glLinkProgram (program);
+    glGetProgramiv(program, GL_LINK_STATUS, &result);
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_size);
+    if (out_log_size) *out_log_size = log_size;
+
+    if (result == GL_TRUE)
+    {
+        GLint a_max = 0;
+        GLint u_max = 0;
+        GLint n_max = 0;
         glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &u_max);
         glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &a_max);
         n_max = u_max > a_max ? u_max : a_max;
@@ -294,13 +1638,23 @@ void gl::copy_linker_log(GLuint program, char *buffer, size_t buffer_size)
 }
 
 bool gl::shader_desc_alloc(gl::shader_desc_t *desc, size_t num_attribs, size_t num_samplers, size_t num_uniforms)
+{
+    return gl::shader_desc_alloc(desc, num_attribs, num_samplers, num_uniforms, 0);
+}
+
+bool gl::shader_desc_alloc(gl::shader_desc_t *desc, size_t num_attribs, size_t num_samplers, size_t num_uniforms, size_t num_blocks)
 {
     gl::attribute_desc_t *attribs       = NULL;
     gl::sampler_desc_t   *samplers      = NULL;
     gl::uniform_desc_t   *uniforms      = NULL;
+    gl::uniform_block_desc_t *blocks    = NULL;
     uint32_t             *attrib_names  = NULL;
     uint32_t             *sampler_names = NULL;
     uint32_t             *uniform_names = NULL;
+    uint32_t             *block_names   = NULL;
+    uint16_t             *attrib_index  = NULL;
+    uint16_t             *sampler_index = NULL;
+    uint16_t             *uniform_index = NULL;
     uint8_t              *memory_block  = NULL;
     uint8_t              *memory_ptr    = NULL;
     size_t                aname_size    = 0;
@@ -309,6 +1663,11 @@ bool gl::shader_desc_alloc(gl::shader_desc_t *desc, size_t num_attribs, size_t n
     size_t                attrib_size   = 0;
     size_t                sampler_size  = 0;
     size_t                uniform_size  = 0;
+    size_t                bname_size    = 0;
+    size_t                block_size    = 0;
+    size_t                aindex_size   = 0;
+    size_t                sindex_size   = 0;
+    size_t                uindex_size   = 0;
     size_t                total_size    = 0;
 
     // calculate the total size of all shader program metadata.
@@ -318,8 +1677,15 @@ bool gl::shader_desc_alloc(gl::shader_desc_t *desc, size_t num_attribs, size_t n
     attrib_size   = sizeof(attribute_desc_t)   * num_attribs;
     sampler_size  = sizeof(sampler_desc_t)     * num_samplers;
     uniform_size  = sizeof(uniform_desc_t)     * num_uniforms;
-    total_size    = aname_size  + sname_size   + uname_size +
-                    attrib_size + sampler_size + uniform_size;
+    bname_size    = sizeof(uint32_t)           * num_blocks;
+    block_size    = sizeof(uniform_block_desc_t) * num_blocks;
+    aindex_size   = sizeof(uint16_t)           * phf_table_size(num_attribs);
+    sindex_size   = sizeof(uint16_t)           * phf_table_size(num_samplers);
+    uindex_size   = sizeof(uint16_t)           * phf_table_size(num_uniforms);
+    total_size    = aname_size  + sname_size   + uname_size   +
+                    attrib_size + sampler_size + uniform_size +
+                    bname_size  + block_size   +
+                    aindex_size + sindex_size  + uindex_size;
 
     // perform a single large memory allocation for the metadata.
     memory_block  = (uint8_t*) malloc(total_size);
@@ -343,16 +1709,38 @@ bool gl::shader_desc_alloc(gl::shader_desc_t *desc, size_t num_attribs, size_t n
     uniforms      = (gl::uniform_desc_t*) memory_ptr;
     memory_ptr   +=  uniform_size;
 
+    block_names   = (uint32_t*) memory_ptr;
+    memory_ptr   +=  bname_size;
+    blocks        = (gl::uniform_block_desc_t*) memory_ptr;
+    memory_ptr   +=  block_size;
+
+    // the perfect hash tables are built later by shader_desc_index().
+    attrib_index  = (uint16_t*) memory_ptr;
+    memory_ptr   +=  aindex_size;
+    sampler_index = (uint16_t*) memory_ptr;
+    memory_ptr   +=  sindex_size;
+    uniform_index = (uint16_t*) memory_ptr;
+    memory_ptr   +=  uindex_size;
+    attrib_index [0] = GL_SHADER_INDEX_NONE;
+    sampler_index[0] = GL_SHADER_INDEX_NONE;
+    uniform_index[0] = GL_SHADER_INDEX_NONE;
+
     // set all of the fields on the shader_desc_t structure.
     desc->UniformCount   = num_uniforms;
     desc->UniformNames   = uniform_names;
     desc->Uniforms       = uniforms;
+    desc->UniformIndex   = uniform_index;
     desc->AttributeCount = num_attribs;
     desc->AttributeNames = attrib_names;
     desc->Attributes     = attribs;
+    desc->AttributeIndex = attrib_index;
     desc->SamplerCount   = num_samplers;
     desc->SamplerNames   = sampler_names;
     desc->Samplers       = samplers;
+    desc->SamplerIndex   = sampler_index;
+    desc->UniformBlockCount = num_blocks;
+    desc->UniformBlockNames = block_names;
+    desc->UniformBlocks     = blocks;
     desc->Metadata       = memory_block;
     return true;
 }
@@ -366,23 +1754,133 @@ void gl::shader_desc_free(gl::shader_desc_t *desc)
         desc->UniformCount   = 0;
         desc->UniformNames   = NULL;
         desc->Uniforms       = NULL;
+        desc->UniformIndex   = NULL;
         desc->AttributeCount = 0;
         desc->AttributeNames = NULL;
         desc->Attributes     = NULL;
+        desc->AttributeIndex = NULL;
         desc->SamplerCount   = 0;
         desc->SamplerNames   = NULL;
         desc->Samplers       = NULL;
+        desc->SamplerIndex   = NULL;
+        desc->UniformBlockCount = 0;
+        desc->UniformBlockNames = NULL;
+        desc->UniformBlocks     = NULL;
+    }
+}
+
+bool gl::shader_desc_index(gl::shader_desc_t *desc)
+{
+    bool a = phf_build(desc->AttributeNames, desc->Attributes, desc->AttributeIndex, desc->AttributeCount);
+    bool s = phf_build(desc->SamplerNames,   desc->Samplers,   desc->SamplerIndex,   desc->SamplerCount);
+    bool u = phf_build(desc->UniformNames,   desc->Uniforms,   desc->UniformIndex,   desc->UniformCount);
+    return (a && s && u);
+}
+
+void gl::reflect_program_counts(
+    GLuint  program,
+    char   *buffer,
+    size_t  buffer_size,
+    bool    include_builtins,
+    size_t *out_num_attribs,
+    size_t *out_num_samplers,
+    size_t *out_num_uniforms)
+{
+    size_t  num_attribs  = 0;
+    GLint   attrib_count = 0;
+    GLsizei buf_size     = (GLsizei) buffer_size;
+
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attrib_count);
+    for (GLint i = 0; i < attrib_count; ++i)
+    {
+        GLenum type = GL_FLOAT;
+        GLuint idx  = (GLuint) i;
+        GLint  len  = 0;
+        GLint  sz   = 0;
+        glGetActiveAttrib(program, idx, buf_size, &len, &sz, &type, buffer);
+        if (gl::builtin(buffer) && !include_builtins)
+            continue;
+        num_attribs++;
+    }
+
+    size_t num_samplers  = 0;
+    size_t num_uniforms  = 0;
+    GLint  uniform_count = 0;
+
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniform_count);
+    for (GLint i = 0; i < uniform_count; ++i)
+    {
+        GLenum type = GL_FLOAT;
+        GLuint idx  = (GLuint) i;
+        GLint  len  = 0;
+        GLint  sz   = 0;
+        glGetActiveUniform(program, idx, buf_size, &len, &sz, &type, buffer);
+        if (gl::builtin(buffer) && !include_builtins)
+            continue;
+
+        switch (type)
+        {
+            case GL_SAMPLER_1D:
+            case GL_INT_SAMPLER_1D:
+            case GL_UNSIGNED_INT_SAMPLER_1D:
+            case GL_SAMPLER_1D_SHADOW:
+            case GL_SAMPLER_2D:
+            case GL_INT_SAMPLER_2D:
+            case GL_UNSIGNED_INT_SAMPLER_2D:
+            case GL_SAMPLER_2D_SHADOW:
+            case GL_SAMPLER_3D:
+            case GL_INT_SAMPLER_3D:
+            case GL_UNSIGNED_INT_SAMPLER_3D:
+            case GL_SAMPLER_CUBE:
+            case GL_INT_SAMPLER_CUBE:
+            case GL_UNSIGNED_INT_SAMPLER_CUBE:
+            case GL_SAMPLER_CUBE_SHADOW:
+            case GL_SAMPLER_1D_ARRAY:
+            case GL_SAMPLER_1D_ARRAY_SHADOW:
+            case GL_INT_SAMPLER_1D_ARRAY:
+            case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY:
+            case GL_SAMPLER_2D_ARRAY:
+            case GL_SAMPLER_2D_ARRAY_SHADOW:
+            case GL_INT_SAMPLER_2D_ARRAY:
+            case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+            case GL_SAMPLER_BUFFER:
+            case GL_INT_SAMPLER_BUFFER:
+            case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+            case GL_SAMPLER_2D_RECT:
+            case GL_SAMPLER_2D_RECT_SHADOW:
+            case GL_INT_SAMPLER_2D_RECT:
+            case GL_UNSIGNED_INT_SAMPLER_2D_RECT:
+            case GL_SAMPLER_2D_MULTISAMPLE:
+            case GL_INT_SAMPLER_2D_MULTISAMPLE:
+            case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:
+            case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+            case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+            case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+                num_samplers++;
+                break;
+
+            default:
+                num_uniforms++;
+                break;
+        }
     }
+
+    if (out_num_attribs)  *out_num_attribs  = num_attribs;
+    if (out_num_samplers) *out_num_samplers = num_samplers;
+    if (out_num_uniforms) *out_num_uniforms = num_uniforms;
 }
 
-void gl::reflect_program_counts(
-    GLuint  program,
-    char   *buffer,
-    size_t  buffer_size,
-    bool    include_builtins,
-    size_t *out_num_attribs,
-    size_t *out_num_samplers,
-    size_t *out_num_uniforms)
+void gl::reflect_program_details(
+    GLuint                program,
+    char                 *buffer,
+    size_t                buffer_size,
+    bool                  include_builtins,
+    uint32_t             *attrib_names,
+    gl::attribute_desc_t *attrib_info,
+    uint32_t             *sampler_names,
+    gl::sampler_desc_t   *sampler_info,
+    uint32_t             *uniform_names,
+    gl::uniform_desc_t   *uniform_info)
 {
     size_t  num_attribs  = 0;
     GLint   attrib_count = 0;
@@ -394,16 +1892,28 @@ void gl::reflect_program_counts(
         GLenum type = GL_FLOAT;
         GLuint idx  = (GLuint) i;
         GLint  len  = 0;
+        GLint  loc  = 0;
         GLint  sz   = 0;
         glGetActiveAttrib(program, idx, buf_size, &len, &sz, &type, buffer);
         if (gl::builtin(buffer) && !include_builtins)
             continue;
+
+        attribute_desc_t va;
+        loc           = glGetAttribLocation(program, buffer);
+        va.DataType   = (GLenum) type;
+        va.Location   = (GLint)  loc;
+        va.DataSize   = (size_t) gl::data_size(type) * sz;
+        va.DataOffset = (size_t) 0; // for application use only
+        va.Dimension  = (size_t) sz;
+        attrib_names[num_attribs] = gl::shader_name(buffer);
+        attrib_info [num_attribs] = va;
         num_attribs++;
     }
 
     size_t num_samplers  = 0;
     size_t num_uniforms  = 0;
     GLint  uniform_count = 0;
+    GLint  texture_unit  = 0;
 
     glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniform_count);
     for (GLint i = 0; i < uniform_count; ++i)
@@ -411,6 +1921,7 @@ void gl::reflect_program_counts(
         GLenum type = GL_FLOAT;
         GLuint idx  = (GLuint) i;
         GLint  len  = 0;
+        GLint  loc  = 0;
         GLint  sz   = 0;
         glGetActiveUniform(program, idx, buf_size, &len, &sz, &type, buffer);
         if (gl::builtin(buffer) && !include_builtins)
@@ -454,271 +1965,857 @@ void gl::reflect_program_counts(
             case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
             case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
             case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
-                num_samplers++;
+                {
+                    sampler_desc_t ts;
+                    loc            = glGetUniformLocation(program, buffer);
+                    ts.SamplerType = (GLenum) type;
+                    ts.BindTarget  = (GLenum) gl::texture_target(type);
+                    ts.Location    = (GLint)  loc;
+                    ts.ImageUnit   = (GLint)  texture_unit++;
+                    sampler_names[num_samplers] = gl::shader_name(buffer);
+                    sampler_info [num_samplers] = ts;
+                    num_samplers++;
+                }
+                break;
+
+            default:
+                {
+                    uniform_desc_t uv;
+                    GLint  block   = -1;
+                    GLint  offset  =  0;
+                    glGetActiveUniformsiv(program, 1, &idx, GL_UNIFORM_BLOCK_INDEX, &block);
+                    if (block >= 0)
+                    {   // members of a uniform block are located by byte offset.
+                        glGetActiveUniformsiv(program, 1, &idx, GL_UNIFORM_OFFSET, &offset);
+                        loc = -1;
+                    }
+                    else loc = glGetUniformLocation(program, buffer);
+                    uv.DataType    = (GLenum) type;
+                    uv.Location    = (GLint)  loc;
+                    uv.DataSize    = (size_t) gl::data_size(type) * sz;
+                    uv.DataOffset  = (size_t) offset; // application use, if not in a block
+                    uv.Dimension   = (size_t) sz;
+                    uv.BlockIndex  = (GLint)  block;
+                    uniform_names[num_uniforms] = gl::shader_name(buffer);
+                    uniform_info [num_uniforms] = uv;
+                    num_uniforms++;
+                }
                 break;
+        }
+    }
+}
+
+void gl::set_sampler(gl::sampler_desc_t *sampler, GLuint texture)
+{
+    gl::state_bind_texture(GLuint(sampler->ImageUnit), sampler->BindTarget, texture);
+    glUniform1i(sampler->Location, sampler->ImageUnit);
+}
+
+void gl::set_uniform(gl::uniform_desc_t *uniform, void const *value, bool transpose)
+{
+    GLint          loc = uniform->Location;
+    GLsizei        dim = uniform->Dimension;
+    GLboolean      tm  = transpose ? GL_TRUE : GL_FALSE;
+    GLint const   *id  = (GLint const*)   value;
+    GLfloat const *fd  = (GLfloat const*) value;
+    switch (uniform->DataType)
+    {
+        case GL_FLOAT:        glUniform1fv(loc, dim, fd);             break;
+        case GL_FLOAT_VEC2:   glUniform2fv(loc, dim, fd);             break;
+        case GL_FLOAT_VEC3:   glUniform3fv(loc, dim, fd);             break;
+        case GL_FLOAT_VEC4:   glUniform4fv(loc, dim, fd);             break;
+        case GL_INT:          glUniform1iv(loc, dim, id);             break;
+        case GL_INT_VEC2:     glUniform2iv(loc, dim, id);             break;
+        case GL_INT_VEC3:     glUniform3iv(loc, dim, id);             break;
+        case GL_INT_VEC4:     glUniform4iv(loc, dim, id);             break;
+        case GL_BOOL:         glUniform1iv(loc, dim, id);             break;
+        case GL_BOOL_VEC2:    glUniform2iv(loc, dim, id);             break;
+        case GL_BOOL_VEC3:    glUniform3iv(loc, dim, id);             break;
+        case GL_BOOL_VEC4:    glUniform4iv(loc, dim, id);             break;
+        case GL_FLOAT_MAT2:   glUniformMatrix2fv  (loc, dim, tm, fd); break;
+        case GL_FLOAT_MAT3:   glUniformMatrix3fv  (loc, dim, tm, fd); break;
+        case GL_FLOAT_MAT4:   glUniformMatrix4fv  (loc, dim, tm, fd); break;
+        case GL_FLOAT_MAT2x3: glUniformMatrix2x3fv(loc, dim, tm, fd); break;
+        case GL_FLOAT_MAT2x4: glUniformMatrix2x4fv(loc, dim, tm, fd); break;
+        case GL_FLOAT_MAT3x2: glUniformMatrix3x2fv(loc, dim, tm, fd); break;
+        case GL_FLOAT_MAT3x4: glUniformMatrix3x4fv(loc, dim, tm, fd); break;
+        case GL_FLOAT_MAT4x2: glUniformMatrix4x2fv(loc, dim, tm, fd); break;
+        case GL_FLOAT_MAT4x3: glUniformMatrix4x3fv(loc, dim, tm, fd); break;
+        default: break;
+    }
+}
+
+size_t gl::reflect_uniform_block_count(GLuint program)
+{
+    GLint block_count = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &block_count);
+    return size_t(block_count);
+}
+
+void gl::reflect_uniform_blocks(GLuint program, char *buffer, size_t buffer_size, uint32_t *block_names, gl::uniform_block_desc_t *block_info)
+{
+    GLint   block_count = 0;
+    GLsizei buf_size    = (GLsizei) buffer_size;
+
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &block_count);
+    for (GLint i = 0; i < block_count; ++i)
+    {
+        GLuint  idx = (GLuint) i;
+        GLsizei len = 0;
+        GLint   sz  = 0;
+        glGetActiveUniformBlockName(program, idx, buf_size, &len, buffer);
+        glGetActiveUniformBlockiv  (program, idx, GL_UNIFORM_BLOCK_DATA_SIZE, &sz);
+        // assign each block a unique binding point within the program.
+        glUniformBlockBinding(program, idx, idx);
+
+        uniform_block_desc_t ub;
+        ub.Index       = idx;
+        ub.Binding     = idx;
+        ub.DataSize    = (size_t) sz;
+        block_names[i] = gl::shader_name(buffer);
+        block_info [i] = ub;
+    }
+}
+
+void gl::apply_uniform_block_bindings(GLuint program, gl::shader_desc_t const *shader)
+{
+    for (size_t i = 0; i < shader->UniformBlockCount; ++i)
+    {
+        gl::uniform_block_desc_t const *ub = &shader->UniformBlocks[i];
+        glUniformBlockBinding(program, ub->Index, ub->Binding);
+    }
+}
+
+void gl::set_uniform_block(gl::uniform_block_desc_t const *block, GLuint buffer, size_t offset, size_t size)
+{
+    gl::state_bind_buffer_range(GL_UNIFORM_BUFFER, block->Binding, buffer, GLintptr(offset), GLsizeiptr(size));
+}
+
+size_t gl::std140_alignment(GLenum data_type, size_t dimension)
+{
+    size_t cols = 0;
+    size_t rows = 0;
+    if (!std140_shape(data_type, &cols, &rows))
+        return 0;
+    if (cols > 1 || dimension > 1)
+        return 16; // arrays and matrices use a vec4 stride.
+    if (rows ==  1) return 4;
+    if (rows ==  2) return 8;
+    return 16;
+}
+
+size_t gl::std140_size(GLenum data_type, size_t dimension)
+{
+    size_t cols = 0;
+    size_t rows = 0;
+    if (!std140_shape(data_type, &cols, &rows))
+        return 0;
+    if (cols > 1 || dimension > 1)
+        return dimension * cols * 16;
+    return rows * sizeof(GLfloat);
+}
+
+size_t gl::std140_layout(GLenum const *data_types, size_t const *dimensions, size_t count, size_t *out_offsets)
+{
+    size_t offset = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t align   = gl::std140_alignment(data_types[i], dimensions[i]);
+        if (align == 0)  align = 1;
+        offset         = (offset + (align - 1)) & ~(align - 1);
+        out_offsets[i] = offset;
+        offset        += gl::std140_size(data_types[i], dimensions[i]);
+    }
+    return (offset + 15) & ~size_t(15);
+}
+
+void gl::std140_store(void *block, size_t offset, GLenum data_type, size_t dimension, void const *value)
+{
+    uint8_t       *dst  = (uint8_t*) block + offset;
+    uint8_t const *src  = (uint8_t const*) value;
+    size_t         cols = 0;
+    size_t         rows = 0;
+    if (!std140_shape(data_type, &cols, &rows))
+        return;
+
+    size_t column_size  = rows * sizeof(GLfloat);
+    if (cols == 1 && dimension <= 1)
+    {   // scalars and vectors are stored without padding.
+        memcpy(dst, src, column_size);
+        return;
+    }
+    // each array element and matrix column begins on a 16-byte boundary.
+    for (size_t i = 0, n = dimension * cols; i < n; ++i)
+    {
+        memcpy(dst, src, column_size);
+        dst += 16;
+        src += column_size;
+    }
+}
+
+void gl::std140_store(void *block, gl::uniform_desc_t const *uniform, void const *value)
+{
+    gl::std140_store(block, uniform->DataOffset, uniform->DataType, size_t(uniform->Dimension), value);
+}
+
+bool gl::create_constant_ring(gl::constant_ring_t *ring, size_t frame_size, size_t frame_count)
+{
+    if (ring == NULL || frame_count == 0 || frame_count > GL_MAX_CONSTANT_RING_FRAMES)
+        return false;
+
+    memset(ring, 0, sizeof(gl::constant_ring_t));
+
+    // each frame segment must begin at a valid uniform buffer offset.
+    GLint align = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+    if (align <= 0) align = 256;
+
+    GLuint ubo = 0;
+    glGenBuffers(1, &ubo);
+    if (ubo == 0)
+    {   // failed to allocate the buffer object.
+        return false;
+    }
+
+    // allocate immutable storage and map the entire buffer once.
+    // the mapping is coherent, so no explicit flush is required.
+    size_t     seg    = (frame_size + size_t(align - 1)) / size_t(align) * size_t(align);
+    GLsizeiptr size   = GLsizeiptr(seg * frame_count);
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    gl::state_bind_buffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferStorage(GL_UNIFORM_BUFFER, size, NULL, access);
+    ring->MappedBase = (uint8_t*) glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, access);
+    gl::state_bind_buffer(GL_UNIFORM_BUFFER, 0);
+    if (ring->MappedBase == NULL)
+    {   // persistent mapping is not supported by the driver.
+        gl::state_delete_buffers(1, &ubo);
+        return false;
+    }
+
+    ring->Buffer     = ubo;
+    ring->Alignment  = size_t(align);
+    ring->FrameSize  = seg;
+    ring->FrameCount = frame_count;
+    ring->FrameIndex = frame_count - 1;
+    return true;
+}
+
+void gl::delete_constant_ring(gl::constant_ring_t *ring)
+{
+    if (ring != NULL)
+    {
+        for (size_t i = 0; i < GL_MAX_CONSTANT_RING_FRAMES; ++i)
+        {
+            if (ring->Fences[i] != NULL) glDeleteSync(ring->Fences[i]);
+        }
+        if (ring->Buffer != 0)
+        {
+            gl::state_bind_buffer(GL_UNIFORM_BUFFER, ring->Buffer);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+            gl::state_bind_buffer(GL_UNIFORM_BUFFER, 0);
+            gl::state_delete_buffers(1, &ring->Buffer);
+        }
+        memset(ring, 0, sizeof(gl::constant_ring_t));
+    }
+}
+
+void gl::constant_ring_begin_frame(gl::constant_ring_t *ring)
+{
+    ring->FrameIndex = (ring->FrameIndex + 1) % ring->FrameCount;
+    ring->FrameUsed  = 0;
+
+    GLsync fence = ring->Fences[ring->FrameIndex];
+    if (fence != NULL)
+    {   // the GPU may still be reading constants written FrameCount frames ago.
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            ring->Stalls++;
+            pixel_stream_wait(fence);
+        }
+        glDeleteSync(fence);
+        ring->Fences[ring->FrameIndex] = NULL;
+    }
+}
+
+void gl::constant_ring_end_frame(gl::constant_ring_t *ring)
+{
+    GLsync &fence = ring->Fences[ring->FrameIndex];
+    if (fence != NULL) glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void* gl::constant_ring_alloc(gl::constant_ring_t *ring, size_t size, size_t *out_offset)
+{
+    size_t used = (ring->FrameUsed + (ring->Alignment - 1)) / ring->Alignment * ring->Alignment;
+    if (used + size > ring->FrameSize)
+    {   // the frame segment is exhausted.
+        *out_offset = 0;
+        return NULL;
+    }
+    size_t offset   = ring->FrameIndex * ring->FrameSize + used;
+    ring->FrameUsed = used + size;
+    *out_offset     = offset;
+    return ring->MappedBase + offset;
+}
+
+void gl::constant_ring_bind(gl::constant_ring_t *ring, gl::uniform_block_desc_t const *block, size_t offset, size_t size)
+{
+    gl::set_uniform_block(block, ring->Buffer, offset, size);
+}
+
+void gl::shader_source_init(gl::shader_source_t *source)
+{
+    source->StageCount = 0;
+    for (size_t i = 0; i < GL_MAX_SHADER_STAGES; ++i)
+    {
+        source->StageNames [i] = 0;
+        source->StringCount[i] = 0;
+        source->SourceCode [i] = NULL;
+    }
+}
+
+void gl::shader_source_add(gl::shader_source_t *source, GLenum shader_stage, char **source_code, size_t string_count)
+{
+    if (source->StageCount < GL_MAX_SHADER_STAGES)
+    {
+        source->StageNames [source->StageCount] = shader_stage;
+        source->StringCount[source->StageCount] = GLsizei(string_count);
+        source->SourceCode [source->StageCount] = source_code;
+        source->StageCount++;
+    }
+}
+
+bool gl::build_shader(gl::shader_source_t *source, gl::shader_desc_t *shader, GLuint *out_program)
+{
+    return build_shader_program(source, shader, out_program, false);
+}
+
+bool gl::extension_supported(char const *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i)
+    {
+        char const *ext = (char const*) glGetStringi(GL_EXTENSIONS, GLuint(i));
+        if (ext != NULL && strcmp(ext, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+void gl::state_cache_init(gl::state_cache_t *cache)
+{
+    memset(cache, 0, sizeof(gl::state_cache_t));
+    gl::state_cache_invalidate(cache);
+}
+
+void gl::state_cache_invalidate(gl::state_cache_t *cache)
+{
+    cache->Program       = GL_STATE_UNKNOWN;
+    cache->VertexArray   = GL_STATE_UNKNOWN;
+    cache->ActiveTexture = GL_STATE_UNKNOWN;
+    cache->Blend         = GL_STATE_UNKNOWN;
+    cache->DepthTest     = GL_STATE_UNKNOWN;
+    cache->DepthMask     = GL_STATE_UNKNOWN;
+    cache->DepthFunc     = GL_STATE_UNKNOWN;
+    for (size_t i = 0; i < gl::STATE_BUFFER_TARGET_COUNT; ++i)
+        cache->Buffers[i] = GL_STATE_UNKNOWN;
+    for (size_t i = 0; i < GL_STATE_MAX_UNIFORM_BINDINGS; ++i)
+        cache->UniformRanges[i].Buffer = GL_STATE_UNKNOWN;
+    for (size_t i = 0; i < GL_STATE_MAX_TEXTURE_UNITS; ++i)
+    {
+        for (size_t j = 0; j < gl::STATE_TEXTURE_TARGET_COUNT; ++j)
+            cache->Textures[i][j] = GL_STATE_UNKNOWN;
+    }
+    for (size_t i = 0; i < 4; ++i)
+        cache->BlendFunc[i] = GL_STATE_UNKNOWN;
+    cache->BlendEquation[0] = GL_STATE_UNKNOWN;
+    cache->BlendEquation[1] = GL_STATE_UNKNOWN;
+    cache->BlendColorValid  = false;
+}
+
+void gl::state_cache_reset_counters(gl::state_cache_t *cache)
+{
+    cache->Counters.Issued = 0;
+    cache->Counters.Elided = 0;
+}
+
+void gl::make_state_cache_current(gl::state_cache_t *cache)
+{
+    CurrentStateCache = cache;
+}
+
+gl::state_cache_t* gl::current_state_cache(void)
+{
+    return CurrentStateCache;
+}
+
+void gl::state_use_program(GLuint program)
+{
+    gl::state_cache_t *cache = CurrentStateCache;
+    if (cache == NULL || state_changed(cache, cache->Program, program))
+        glUseProgram(program);
+}
+
+void gl::state_bind_vertex_array(GLuint vao)
+{
+    gl::state_cache_t *cache = CurrentStateCache;
+    if (cache == NULL || state_changed(cache, cache->VertexArray, vao))
+    {
+        glBindVertexArray(vao);
+        if (cache != NULL)
+        {   // the element array buffer binding is part of the VAO state.
+            cache->Buffers[gl::STATE_BUFFER_ELEMENT_ARRAY] = GL_STATE_UNKNOWN;
+        }
+    }
+}
+
+void gl::state_bind_buffer(GLenum target, GLuint buffer)
+{
+    gl::state_cache_t *cache = CurrentStateCache;
+    size_t             index = state_buffer_index(target);
+    if (cache == NULL || index == gl::STATE_BUFFER_TARGET_COUNT)
+    {   // the target isn't tracked; always issue the call.
+        glBindBuffer(target, buffer);
+        if (cache != NULL) cache->Counters.Issued++;
+        return;
+    }
+    if (state_changed(cache, cache->Buffers[index], buffer))
+        glBindBuffer(target, buffer);
+}
+
+void gl::state_bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    gl::state_cache_t *cache = CurrentStateCache;
+    if (cache == NULL || target != GL_UNIFORM_BUFFER || index >= GL_STATE_MAX_UNIFORM_BINDINGS)
+    {   // the target or index isn't tracked; always issue the call.
+        glBindBufferRange(target, index, buffer, offset, size);
+        if (cache != NULL)
+        {   // the generic binding point is also modified.
+            size_t generic = state_buffer_index(target);
+            if (generic != gl::STATE_BUFFER_TARGET_COUNT)
+                cache->Buffers[generic] = buffer;
+            cache->Counters.Issued++;
+        }
+        return;
+    }
+    gl::state_buffer_range_t &r = cache->UniformRanges[index];
+    if (r.Buffer == buffer && r.Offset == offset && r.Size == size)
+    {
+        cache->Counters.Elided++;
+        return;
+    }
+    glBindBufferRange(target, index, buffer, offset, size);
+    cache->Buffers[gl::STATE_BUFFER_UNIFORM] = buffer;
+    cache->Counters.Issued++;
+    r.Buffer = buffer;
+    r.Offset = offset;
+    r.Size   = size;
+}
+
+void gl::state_active_texture(GLuint unit)
+{
+    gl::state_cache_t *cache = CurrentStateCache;
+    if (cache == NULL || state_changed(cache, cache->ActiveTexture, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void gl::state_bind_texture(GLuint unit, GLenum target, GLuint texture)
+{
+    gl::state_cache_t *cache = CurrentStateCache;
+    size_t             index = state_texture_index(target);
+    if (cache == NULL || index == gl::STATE_TEXTURE_TARGET_COUNT || unit >= GL_STATE_MAX_TEXTURE_UNITS)
+    {   // the unit or target isn't tracked; always issue the call.
+        gl::state_active_texture(unit);
+        glBindTexture(target, texture);
+        if (cache != NULL) cache->Counters.Issued++;
+        return;
+    }
+    if (state_changed(cache, cache->Textures[unit][index], texture))
+    {
+        gl::state_active_texture(unit);
+        glBindTexture(target, texture);
+    }
+}
 
+void gl::state_enable(GLenum cap, bool enable)
+{
+    gl::state_cache_t *cache = CurrentStateCache;
+    GLuint             value = enable ? GL_TRUE : GL_FALSE;
+    bool               issue = true;
+    if (cache != NULL)
+    {
+        switch (cap)
+        {
+            case GL_BLEND:
+                issue = state_changed(cache, cache->Blend, value);
+                break;
+            case GL_DEPTH_TEST:
+                issue = state_changed(cache, cache->DepthTest, value);
+                break;
             default:
-                num_uniforms++;
+                cache->Counters.Issued++;
                 break;
         }
     }
-
-    if (out_num_attribs)  *out_num_attribs  = num_attribs;
-    if (out_num_samplers) *out_num_samplers = num_samplers;
-    if (out_num_uniforms) *out_num_uniforms = num_uniforms;
+    if (issue)
+    {
+        if (enable) glEnable(cap);
+        else glDisable(cap);
+    }
 }
 
-void gl::reflect_program_details(
-    GLuint                program,
-    char                 *buffer,
-    size_t                buffer_size,
-    bool                  include_builtins,
-    uint32_t             *attrib_names,
-    gl::attribute_desc_t *attrib_info,
-    uint32_t             *sampler_names,
-    gl::sampler_desc_t   *sampler_info,
-    uint32_t             *uniform_names,
-    gl::uniform_desc_t   *uniform_info)
+void gl::state_blend_func(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha)
 {
-    size_t  num_attribs  = 0;
-    GLint   attrib_count = 0;
-    GLsizei buf_size     = (GLsizei) buffer_size;
+    gl::state_cache_t *cache = CurrentStateCache;
+    if (cache != NULL)
+    {
+        if (cache->BlendFunc[0] == src_rgb   && cache->BlendFunc[1] == dst_rgb &&
+            cache->BlendFunc[2] == src_alpha && cache->BlendFunc[3] == dst_alpha)
+        {
+            cache->Counters.Elided++;
+            return;
+        }
+        cache->BlendFunc[0] = src_rgb;
+        cache->BlendFunc[1] = dst_rgb;
+        cache->BlendFunc[2] = src_alpha;
+        cache->BlendFunc[3] = dst_alpha;
+        cache->Counters.Issued++;
+    }
+    glBlendFuncSeparate(src_rgb, dst_rgb, src_alpha, dst_alpha);
+}
 
-    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attrib_count);
-    for (GLint i = 0; i < attrib_count; ++i)
+void gl::state_blend_equation(GLenum mode_rgb, GLenum mode_alpha)
+{
+    gl::state_cache_t *cache = CurrentStateCache;
+    if (cache != NULL)
     {
-        GLenum type = GL_FLOAT;
-        GLuint idx  = (GLuint) i;
-        GLint  len  = 0;
-        GLint  loc  = 0;
-        GLint  sz   = 0;
-        glGetActiveAttrib(program, idx, buf_size, &len, &sz, &type, buffer);
-        if (gl::builtin(buffer) && !include_builtins)
-            continue;
+        if (cache->BlendEquation[0] == mode_rgb && cache->BlendEquation[1] == mode_alpha)
+        {
+            cache->Counters.Elided++;
+            return;
+        }
+        cache->BlendEquation[0] = mode_rgb;
+        cache->BlendEquation[1] = mode_alpha;
+        cache->Counters.Issued++;
+    }
+    glBlendEquationSeparate(mode_rgb, mode_alpha);
+}
 
-        attribute_desc_t va;
-        loc           = glGetAttribLocation(program, buffer);
-        va.DataType   = (GLenum) type;
-        va.Location   = (GLint)  loc;
-        va.DataSize   = (size_t) gl::data_size(type) * sz;
-        va.DataOffset = (size_t) 0; // for application use only
-        va.Dimension  = (size_t) sz;
-        attrib_names[num_attribs] = gl::shader_name(buffer);
-        attrib_info [num_attribs] = va;
-        num_attribs++;
+void gl::state_blend_color(float r, float g, float b, float a)
+{
+    gl::state_cache_t *cache = CurrentStateCache;
+    if (cache != NULL)
+    {
+        if (cache->BlendColorValid     &&
+            cache->BlendColor[0] == r  && cache->BlendColor[1] == g &&
+            cache->BlendColor[2] == b  && cache->BlendColor[3] == a)
+        {
+            cache->Counters.Elided++;
+            return;
+        }
+        cache->BlendColor[0]   = r;
+        cache->BlendColor[1]   = g;
+        cache->BlendColor[2]   = b;
+        cache->BlendColor[3]   = a;
+        cache->BlendColorValid = true;
+        cache->Counters.Issued++;
     }
+    glBlendColor(r, g, b, a);
+}
 
-    size_t num_samplers  = 0;
-    size_t num_uniforms  = 0;
-    GLint  uniform_count = 0;
-    GLint  texture_unit  = 0;
+void gl::state_depth_func(GLenum func)
+{
+    gl::state_cache_t *cache = CurrentStateCache;
+    if (cache == NULL || state_changed(cache, cache->DepthFunc, func))
+        glDepthFunc(func);
+}
 
-    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniform_count);
-    for (GLint i = 0; i < uniform_count; ++i)
-    {
-        GLenum type = GL_FLOAT;
-        GLuint idx  = (GLuint) i;
-        GLint  len  = 0;
-        GLint  loc  = 0;
-        GLint  sz   = 0;
-        glGetActiveUniform(program, idx, buf_size, &len, &sz, &type, buffer);
-        if (gl::builtin(buffer) && !include_builtins)
-            continue;
+void gl::state_depth_mask(bool write)
+{
+    gl::state_cache_t *cache = CurrentStateCache;
+    if (cache == NULL || state_changed(cache, cache->DepthMask, write ? GL_TRUE : GL_FALSE))
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
 
-        switch (type)
+void gl::state_delete_buffers(GLsizei n, GLuint const *buffers)
+{
+    gl::state_cache_t *cache = CurrentStateCache;
+    if (cache != NULL)
+    {   // deleting a bound buffer reverts the binding to zero.
+        for (GLsizei i = 0; i < n; ++i)
         {
-            case GL_SAMPLER_1D:
-            case GL_INT_SAMPLER_1D:
-            case GL_UNSIGNED_INT_SAMPLER_1D:
-            case GL_SAMPLER_1D_SHADOW:
-            case GL_SAMPLER_2D:
-            case GL_INT_SAMPLER_2D:
-            case GL_UNSIGNED_INT_SAMPLER_2D:
-            case GL_SAMPLER_2D_SHADOW:
-            case GL_SAMPLER_3D:
-            case GL_INT_SAMPLER_3D:
-            case GL_UNSIGNED_INT_SAMPLER_3D:
-            case GL_SAMPLER_CUBE:
-            case GL_INT_SAMPLER_CUBE:
-            case GL_UNSIGNED_INT_SAMPLER_CUBE:
-            case GL_SAMPLER_CUBE_SHADOW:
-            case GL_SAMPLER_1D_ARRAY:
-            case GL_SAMPLER_1D_ARRAY_SHADOW:
-            case GL_INT_SAMPLER_1D_ARRAY:
-            case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY:
-            case GL_SAMPLER_2D_ARRAY:
-            case GL_SAMPLER_2D_ARRAY_SHADOW:
-            case GL_INT_SAMPLER_2D_ARRAY:
-            case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
-            case GL_SAMPLER_BUFFER:
-            case GL_INT_SAMPLER_BUFFER:
-            case GL_UNSIGNED_INT_SAMPLER_BUFFER:
-            case GL_SAMPLER_2D_RECT:
-            case GL_SAMPLER_2D_RECT_SHADOW:
-            case GL_INT_SAMPLER_2D_RECT:
-            case GL_UNSIGNED_INT_SAMPLER_2D_RECT:
-            case GL_SAMPLER_2D_MULTISAMPLE:
-            case GL_INT_SAMPLER_2D_MULTISAMPLE:
-            case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:
-            case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
-            case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
-            case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
-                {
-                    sampler_desc_t ts;
-                    loc            = glGetUniformLocation(program, buffer);
-                    ts.SamplerType = (GLenum) type;
-                    ts.BindTarget  = (GLenum) gl::texture_target(type);
-                    ts.Location    = (GLint)  loc;
-                    ts.ImageUnit   = (GLint)  texture_unit++;
-                    sampler_names[num_samplers] = gl::shader_name(buffer);
-                    sampler_info [num_samplers] = ts;
-                    num_samplers++;
-                }
-                break;
+            for (size_t j = 0; j < gl::STATE_BUFFER_TARGET_COUNT; ++j)
+            {
+                if (cache->Buffers[j] == buffers[i] && buffers[i] != 0)
+                    cache->Buffers[j] = 0;
+            }
+            for (size_t j = 0; j < GL_STATE_MAX_UNIFORM_BINDINGS; ++j)
+            {
+                if (cache->UniformRanges[j].Buffer == buffers[i] && buffers[i] != 0)
+                    cache->UniformRanges[j].Buffer = 0;
+            }
+        }
+    }
+    glDeleteBuffers(n, buffers);
+}
 
-            default:
+void gl::state_delete_textures(GLsizei n, GLuint const *textures)
+{
+    gl::state_cache_t *cache = CurrentStateCache;
+    if (cache != NULL)
+    {   // deleting a bound texture reverts the binding to zero.
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            for (size_t u = 0; u < GL_STATE_MAX_TEXTURE_UNITS; ++u)
+            {
+                for (size_t j = 0; j < gl::STATE_TEXTURE_TARGET_COUNT; ++j)
                 {
-                    uniform_desc_t uv;
-                    loc            = glGetUniformLocation(program, buffer);
-                    uv.DataType    = (GLenum) type;
-                    uv.Location    = (GLint)  loc;
-                    uv.DataSize    = (size_t) gl::data_size(type) * sz;
-                    uv.DataOffset  = (size_t) 0; // for application use only
-                    uv.Dimension   = (size_t) sz;
-                    uniform_names[num_uniforms] = gl::shader_name(buffer);
-                    uniform_info [num_uniforms] = uv;
-                    num_uniforms++;
+                    if (cache->Textures[u][j] == textures[i] && textures[i] != 0)
+                        cache->Textures[u][j] = 0;
                 }
-                break;
+            }
         }
     }
+    glDeleteTextures(n, textures);
 }
 
-void gl::set_sampler(gl::sampler_desc_t *sampler, GLuint texture)
+void gl::state_delete_vertex_arrays(GLsizei n, GLuint const *arrays)
 {
-    glActiveTexture(GL_TEXTURE0 + sampler->ImageUnit);
-    glBindTexture(sampler->BindTarget, texture);
-    glUniform1i(sampler->Location, sampler->ImageUnit);
+    gl::state_cache_t *cache = CurrentStateCache;
+    if (cache != NULL)
+    {   // deleting the bound VAO reverts the binding to zero.
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            if (cache->VertexArray == arrays[i] && arrays[i] != 0)
+            {
+                cache->VertexArray = 0;
+                cache->Buffers[gl::STATE_BUFFER_ELEMENT_ARRAY] = GL_STATE_UNKNOWN;
+            }
+        }
+    }
+    glDeleteVertexArrays(n, arrays);
 }
 
-void gl::set_uniform(gl::uniform_desc_t *uniform, void const *value, bool transpose)
+void gl::state_delete_program(GLuint program)
 {
-    GLint          loc = uniform->Location;
-    GLsizei        dim = uniform->Dimension;
-    GLboolean      tm  = transpose ? GL_TRUE : GL_FALSE;
-    GLint const   *id  = (GLint const*)   value;
-    GLfloat const *fd  = (GLfloat const*) value;
-    switch (uniform->DataType)
+    glDeleteProgram(program);
+}
+
+bool gl::create_shader_batch(gl::shader_batch_t *batch, size_t capacity, GLuint thread_count)
+{
+    if (batch != NULL)
     {
-        case GL_FLOAT:        glUniform1fv(loc, dim, fd);             break;
-        case GL_FLOAT_VEC2:   glUniform2fv(loc, dim, fd);             break;
-        case GL_FLOAT_VEC3:   glUniform3fv(loc, dim, fd);             break;
-        case GL_FLOAT_VEC4:   glUniform4fv(loc, dim, fd);             break;
-        case GL_INT:          glUniform1iv(loc, dim, id);             break;
-        case GL_INT_VEC2:     glUniform2iv(loc, dim, id);             break;
-        case GL_INT_VEC3:     glUniform3iv(loc, dim, id);             break;
-        case GL_INT_VEC4:     glUniform4iv(loc, dim, id);             break;
-        case GL_BOOL:         glUniform1iv(loc, dim, id);             break;
-        case GL_BOOL_VEC2:    glUniform2iv(loc, dim, id);             break;
-        case GL_BOOL_VEC3:    glUniform3iv(loc, dim, id);             break;
-        case GL_BOOL_VEC4:    glUniform4iv(loc, dim, id);             break;
-        case GL_FLOAT_MAT2:   glUniformMatrix2fv  (loc, dim, tm, fd); break;
-        case GL_FLOAT_MAT3:   glUniformMatrix3fv  (loc, dim, tm, fd); break;
-        case GL_FLOAT_MAT4:   glUniformMatrix4fv  (loc, dim, tm, fd); break;
-        case GL_FLOAT_MAT2x3: glUniformMatrix2x3fv(loc, dim, tm, fd); break;
-        case GL_FLOAT_MAT2x4: glUniformMatrix2x4fv(loc, dim, tm, fd); break;
-        case GL_FLOAT_MAT3x2: glUniformMatrix3x2fv(loc, dim, tm, fd); break;
-        case GL_FLOAT_MAT3x4: glUniformMatrix3x4fv(loc, dim, tm, fd); break;
-        case GL_FLOAT_MAT4x2: glUniformMatrix4x2fv(loc, dim, tm, fd); break;
-        case GL_FLOAT_MAT4x3: glUniformMatrix4x3fv(loc, dim, tm, fd); break;
-        default: break;
+        memset(batch, 0, sizeof(gl::shader_batch_t));
+        if (capacity > 0)
+        {
+            batch->Items = (gl::shader_build_t*) malloc(capacity * sizeof(gl::shader_build_t));
+            if (batch->Items == NULL) return false;
+        }
+        batch->Capacity = capacity;
+#ifdef GL_KHR_parallel_shader_compile
+        if (gl::extension_supported("GL_KHR_parallel_shader_compile"))
+        {
+            glMaxShaderCompilerThreadsKHR(thread_count);
+            batch->Parallel = true;
+        }
+#else
+        (void) thread_count;
+#endif
+        return true;
     }
+    else return false;
 }
 
-void gl::shader_source_init(gl::shader_source_t *source)
+void gl::delete_shader_batch(gl::shader_batch_t *batch)
 {
-    source->StageCount = 0;
-    for (size_t i = 0; i < GL_MAX_SHADER_STAGES; ++i)
+    if (batch != NULL)
     {
-        source->StageNames [i] = 0;
-        source->StringCount[i] = 0;
-        source->SourceCode [i] = NULL;
+        for (size_t i = 0; i < batch->Count; ++i)
+        {
+            gl::shader_build_t *item = &batch->Items[i];
+            if (item->State == gl::SHADER_BUILD_STATE_COMPILING ||
+                item->State == gl::SHADER_BUILD_STATE_LINKING)
+            {   // abandon any program that hasn't finished building.
+                shader_build_fail(batch, item);
+            }
+        }
+        if (batch->Items != NULL) free(batch->Items);
+        memset(batch, 0, sizeof(gl::shader_batch_t));
+    }
+}
+
+size_t gl::shader_batch_add(gl::shader_batch_t *batch, gl::shader_source_t *source, gl::shader_desc_t *shader)
+{
+    if (batch->Count == batch->Capacity)
+        return batch->Capacity;
+
+    gl::shader_build_t *item = &batch->Items[batch->Count];
+    memset(item, 0, sizeof(gl::shader_build_t));
+    item->Source  = source;
+    item->Shader  = shader;
+    item->State   = gl::SHADER_BUILD_STATE_COMPILING;
+    batch->Pending++;
+
+    // submit each stage for compilation, but don't query the status.
+    // querying GL_COMPILE_STATUS would force the driver to finish.
+    for (size_t i = 0; i < source->StageCount; ++i)
+    {
+        GLuint shader_obj = glCreateShader(source->StageNames[i]);
+        if (shader_obj == 0)
+        {
+            shader_build_fail(batch, item);
+            return batch->Count++;
+        }
+        glShaderSource (shader_obj, source->StringCount[i], (GLchar const**) source->SourceCode[i], NULL);
+        glCompileShader(shader_obj);
+        item->Stages[i] = shader_obj;
+    }
+    return batch->Count++;
+}
+
+size_t gl::shader_batch_poll(gl::shader_batch_t *batch)
+{
+    bool parallel = batch->Parallel;
+    for (size_t i = 0; i < batch->Count; ++i)
+    {
+        gl::shader_build_t *item = &batch->Items[i];
+        if (item->State == gl::SHADER_BUILD_STATE_COMPILING)
+        {
+            size_t nstages = item->Source->StageCount;
+            size_t nready  = 0;
+            for (size_t j  = 0; j < nstages; ++j)
+            {
+                if (shader_build_ready(parallel, item->Stages[j], false))
+                    nready++;
+            }
+            if (nready != nstages)
+                continue;
+
+            bool compiled = true;
+            for (size_t j = 0; j < nstages; ++j)
+            {
+                GLint result = GL_FALSE;
+                glGetShaderiv(item->Stages[j], GL_COMPILE_STATUS, &result);
+                if (result != GL_TRUE) compiled = false;
+            }
+            if (!compiled || !gl::attach_shaders(item->Stages, nstages, &item->Program))
+            {
+                shader_build_fail(batch, item);
+                continue;
+            }
+            // the shaders are detached and deleted with the program.
+            for (size_t j = 0; j < nstages; ++j)
+            {
+                glDeleteShader(item->Stages[j]);
+                item->Stages[j] = 0;
+            }
+            glLinkProgram(item->Program);
+            item->State = gl::SHADER_BUILD_STATE_LINKING;
+        }
+        if (item->State == gl::SHADER_BUILD_STATE_LINKING)
+        {
+            if (!shader_build_ready(parallel, item->Program, true))
+                continue;
+
+            GLint result = GL_FALSE;
+            glGetProgramiv(item->Program, GL_LINK_STATUS, &result);
+            if (result != GL_TRUE || !reflect_shader_program(item->Program, item->Shader))
+            {
+                shader_build_fail(batch, item);
+                continue;
+            }
+            item->State = gl::SHADER_BUILD_STATE_COMPLETE;
+            batch->Pending--;
+        }
+    }
+    return batch->Pending;
+}
+
+bool gl::shader_batch_finish(gl::shader_batch_t *batch)
+{
+    while (gl::shader_batch_poll(batch) > 0)
+    {
+        /* empty */
+    }
+    return (batch->Failed == 0);
+}
+
+bool gl::create_shader_cache(gl::shader_cache_t *cache, char const *directory)
+{
+    if (cache != NULL && directory != NULL)
+    {
+        GLenum const strings[4] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+        uint64_t     hash       = FNV1A64_SEED;
+        GLint        nformats   = 0;
+        size_t       len        = strlen(directory);
+
+        memset(cache, 0, sizeof(gl::shader_cache_t));
+        if ((cache->Directory = (char*) malloc(len + 1)) == NULL)
+            return false;
+        memcpy(cache->Directory, directory, len + 1);
+
+        // any change to the driver invalidates all cache entries.
+        for (size_t i = 0; i < 4; ++i)
+        {
+            char const *s = (char const*) glGetString(strings[i]);
+            if (s != NULL) hash = fnv1a64(hash, s, strlen(s) + 1);
+        }
+        cache->DriverHash = uint32_t(hash ^ (hash >> 32));
+
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nformats);
+        cache->Enabled = nformats > 0;
+        return true;
     }
+    else return false;
 }
 
-void gl::shader_source_add(gl::shader_source_t *source, GLenum shader_stage, char **source_code, size_t string_count)
+void gl::delete_shader_cache(gl::shader_cache_t *cache)
 {
-    if (source->StageCount < GL_MAX_SHADER_STAGES)
+    if (cache != NULL)
     {
-        source->StageNames [source->StageCount] = shader_stage;
-        source->StringCount[source->StageCount] = GLsizei(string_count);
-        source->SourceCode [source->StageCount] = source_code;
-        source->StageCount++;
+        if (cache->Directory != NULL) free(cache->Directory);
+        memset(cache, 0, sizeof(gl::shader_cache_t));
     }
 }
 
-bool gl::build_shader(gl::shader_source_t *source, gl::shader_desc_t *shader, GLuint *out_program)
+uint64_t gl::shader_source_hash(gl::shader_source_t const *source)
 {
-    GLuint shader_list[GL_MAX_SHADER_STAGES];
-    GLuint program       = 0;
-    char  *name_buffer   = NULL;
-    size_t num_attribs   = 0;
-    size_t num_samplers  = 0;
-    size_t num_uniforms  = 0;
-    size_t max_name      = 0;
-
-    for (size_t  i = 0; i < source->StageCount;  ++i)
+    uint64_t hash = FNV1A64_SEED;
+    for (size_t i = 0; i < source->StageCount; ++i)
     {
-        size_t  ls = 0;
-        GLenum  sn = source->StageNames [i];
-        GLsizei fc = source->StringCount[i];
-        char  **sc = source->SourceCode [i];
-        if (!gl::compile_shader(sn, sc, fc, &shader_list[i], &ls))
-            goto error_cleanup;
+        uint32_t stage = uint32_t(source->StageNames[i]);
+        hash = fnv1a64(hash, &stage, sizeof(stage));
+        for (GLsizei j = 0; j < source->StringCount[i]; ++j)
+        {
+            char const *s = source->SourceCode[i][j];
+            hash = fnv1a64(hash, s, strlen(s) + 1);
+        }
     }
+    return hash;
+}
 
-    if (!gl::attach_shaders(shader_list, source->StageCount, &program))
-        goto error_cleanup;
-
-    if (!gl::link_program(program, &max_name, NULL))
-        goto error_cleanup;
-
-    // flag each attached shader for deletion when the program is deleted.
-    // the shaders are automatically detached when the program is deleted.
-    for (size_t i = 0; i < source->StageCount; ++i)
-        glDeleteShader(shader_list[i]);
-
-    // figure out how many attributes, samplers and uniforms we have.
-    name_buffer = (char*) malloc(max_name);
-    gl::reflect_program_counts(program, name_buffer, max_name,
-        false, &num_attribs, &num_samplers, &num_uniforms);
+bool gl::build_shader(gl::shader_cache_t *cache, gl::shader_source_t *source, gl::shader_desc_t *shader, GLuint *out_program)
+{
+    if (cache == NULL || cache->Enabled == false)
+    {   // there's no usable cache; always build from source.
+        return build_shader_program(source, shader, out_program, false);
+    }
 
-    if (!gl::shader_desc_alloc(shader, num_attribs, num_samplers, num_uniforms))
-        goto error_cleanup;
+    uint64_t key = gl::shader_source_hash(source);
+    if (shader_cache_load(cache, key, shader, out_program))
+    {   // restored the binary and metadata; no compile or reflection needed.
+        cache->Hits++;
+        return true;
+    }
+    cache->Misses++;
 
-    // now reflect the shader program to retrieve detailed information
-    // about all vertex attributes, texture samplers and uniform variables.
-    gl::reflect_program_details(program, name_buffer, max_name, false,
-        shader->AttributeNames, shader->Attributes,
-        shader->SamplerNames,   shader->Samplers,
-        shader->UniformNames,   shader->Uniforms);
+    if (!build_shader_program(source, shader, out_program, true))
+        return false;
 
-    *out_program = program;
+    if (shader_cache_store(cache, key, shader, *out_program))
+        cache->Writes++;
     return true;
-
-error_cleanup:
-    for (size_t i = 0; i < source->StageCount; ++i)
-    {
-        if (shader_list[i] != 0)
-        {
-            glDeleteShader(shader_list[i]);
-        }
-    }
-    if (shader->Metadata != NULL) gl::shader_desc_free(shader);
-    if (name_buffer  != NULL)     free(name_buffer);
-    if (program != 0)             glDeleteProgram(program);
-    *out_program = 0;
-    return false;
 }
 
 size_t gl::block_dimension(GLenum internal_format)
@@ -1326,7 +3423,7 @@ void gl::texture_storage(
 
     // make sure that no PBO is bound as the unpack target.
     // we don't want to copy data to the texture now.
-    glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+    gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
     // specify the maximum number of mipmap levels.
     if (target != GL_TEXTURE_RECTANGLE)
@@ -1396,6 +3493,21 @@ void gl::texture_storage(
                 }
                 break;
 
+            case GL_TEXTURE_CUBE_MAP:
+                {
+                    // allocate all six faces; slice_count is ignored.
+                    for (size_t face = 0; face < 6; ++face)
+                    {
+                        for (size_t lod = 0; lod < max_levels; ++lod)
+                        {
+                            size_t lw = gl::level_dimension(width,  lod);
+                            size_t lh = gl::level_dimension(height, lod);
+                            glTexImage2D(GLenum(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face), GLint(lod), internal_format, GLsizei(lw), GLsizei(lh), 0, layout, data_type, NULL);
+                        }
+                    }
+                }
+                break;
+
             case GL_TEXTURE_2D_ARRAY:
             case GL_TEXTURE_CUBE_MAP_ARRAY:
                 {
@@ -1426,15 +3538,16 @@ void gl::texture_storage(
 
 void gl::transfer_pixels_d2h(gl::pixel_transfer_d2h_t *transfer)
 {
+    gl::gpu_scope_begin("transfer_pixels_d2h");
     if (transfer->PackBuffer != 0)
     {
         // select the PBO as the target of the pack operation.
-        glBindBuffer(GL_PIXEL_PACK_BUFFER, transfer->PackBuffer);
+        gl::state_bind_buffer(GL_PIXEL_PACK_BUFFER, transfer->PackBuffer);
     }
     else
     {
         // select the client memory as the target of the pack operation.
-        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        gl::state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
     }
     if (transfer->TargetWidth != transfer->TransferWidth)
     {
@@ -1520,7 +3633,7 @@ void gl::transfer_pixels_d2h(gl::pixel_transfer_d2h_t *transfer)
 
     // restore the pack state values to their defaults.
     if (transfer->PackBuffer  != 0)
-        glBindBuffer(GL_PIXEL_PACK_BUFFER,  0);
+        gl::state_bind_buffer(GL_PIXEL_PACK_BUFFER,  0);
     if (transfer->TargetWidth != transfer->TransferWidth)
     {
         glPixelStorei(GL_PACK_ROW_LENGTH,   0);
@@ -1529,28 +3642,215 @@ void gl::transfer_pixels_d2h(gl::pixel_transfer_d2h_t *transfer)
     if (transfer->TargetX != 0) glPixelStorei(GL_PACK_SKIP_PIXELS,  0);
     if (transfer->TargetY != 0) glPixelStorei(GL_PACK_SKIP_ROWS,    0);
     if (transfer->TargetZ != 0) glPixelStorei(GL_PACK_SKIP_IMAGES,  0);
+    gl::gpu_scope_end();
+}
+
+bool gl::create_pixel_stream_d2h(gl::pixel_stream_d2h_t *stream, size_t slot_count)
+{
+    if (stream != NULL)
+    {
+        memset(stream, 0, sizeof(gl::pixel_stream_d2h_t));
+        if (slot_count == 0 || slot_count > GL_MAX_PIXEL_READBACK_SLOTS)
+        {   // the slot count is invalid.
+            return false;
+        }
+        stream->SlotCount = slot_count;
+        return true;
+    }
+    else return false;
+}
+
+void gl::delete_pixel_stream_d2h(gl::pixel_stream_d2h_t *stream)
+{
+    if (stream != NULL)
+    {
+        for (size_t i = 0; i < stream->SlotCount; ++i)
+        {
+            gl::pixel_readback_slot_t *slot = &stream->Slots[i];
+            if (slot->Fence != NULL)
+            {
+                glDeleteSync(slot->Fence);
+            }
+            if (slot->State == gl::PIXEL_READBACK_STATE_MAPPED)
+            {
+                gl::state_bind_buffer(GL_PIXEL_PACK_BUFFER, slot->Pbo);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            if (slot->Pbo != 0)
+            {
+                gl::state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+                gl::state_delete_buffers(1, &slot->Pbo);
+            }
+        }
+        memset(stream, 0, sizeof(gl::pixel_stream_d2h_t));
+    }
+}
+
+bool gl::pixel_stream_d2h_request(gl::pixel_stream_d2h_t *stream, gl::pixel_transfer_d2h_t const *transfer, uintptr_t tag)
+{
+    if (stream->ActiveCount == stream->SlotCount)
+    {   // every slot is in use; drop the request rather than stall.
+        stream->Stats.Dropped++;
+        return false;
+    }
+
+    size_t index  = (stream->SlotHead + stream->ActiveCount) % stream->SlotCount;
+    gl::pixel_readback_slot_t *slot = &stream->Slots[index];
+    GLint  align  = 4;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &align);
+    size_t width  = transfer->TransferWidth;
+    size_t height = transfer->TransferHeight;
+    size_t depth  = 1;
+    if (transfer->Target != GL_READ_FRAMEBUFFER)
+    {   // glGetTexImage always writes the entire level, so a sub-rectangle
+        // cannot be read back from a texture; the level must be requested.
+        GLint level_w = 0, level_h = 0, level_d = 0;
+        GLint level   = GLint(transfer->SourceIndex);
+        glGetTexLevelParameteriv(transfer->Target, level, GL_TEXTURE_WIDTH , &level_w);
+        glGetTexLevelParameteriv(transfer->Target, level, GL_TEXTURE_HEIGHT, &level_h);
+        glGetTexLevelParameteriv(transfer->Target, level, GL_TEXTURE_DEPTH , &level_d);
+        if (transfer->TransferX != 0 || transfer->TransferY != 0 ||
+            width != size_t(level_w) || height != size_t(level_h) || level_d < 1)
+            return false;
+        depth = size_t(level_d);
+    }
+    size_t pitch  = gl::bytes_per_row  (transfer->Format, transfer->DataType, width, size_t(align));
+    size_t size   = gl::bytes_per_slice(transfer->Format, transfer->DataType, width, height, size_t(align)) * depth;
+
+    if (slot->Pbo == 0)
+    {   // lazily create the pack buffer for this slot.
+        glGenBuffers(1, &slot->Pbo);
+        if (slot->Pbo == 0) return false;
+    }
+    if (slot->Capacity < size)
+    {   // grow the pack buffer to fit the request.
+        gl::state_bind_buffer(GL_PIXEL_PACK_BUFFER, slot->Pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(size), NULL, GL_STREAM_READ);
+        slot->Capacity = size;
+    }
+
+    // pack the region tightly at the start of the slot's buffer.
+    gl::pixel_transfer_d2h_t xfer = *transfer;
+    xfer.PackBuffer     = slot->Pbo;
+    xfer.TargetX        = 0;
+    xfer.TargetY        = 0;
+    xfer.TargetZ        = 0;
+    xfer.TargetWidth    = width;
+    xfer.TargetHeight   = height;
+    xfer.TransferBuffer = GL_BUFFER_OFFSET(0);
+    gl::transfer_pixels_d2h(&xfer);
+
+    slot->Fence         = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot->State         = gl::PIXEL_READBACK_STATE_PENDING;
+    slot->Info.Memory   = NULL;
+    slot->Info.Size     = size;
+    slot->Info.Width    = width;
+    slot->Info.Height   = height;
+    slot->Info.RowPitch = pitch;
+    slot->Info.Layout   = transfer->Layout;
+    slot->Info.DataType = transfer->DataType;
+    slot->Info.Sequence = stream->Sequence++;
+    slot->Info.Tag      = tag;
+    stream->ActiveCount++;
+    stream->Stats.Requests++;
+    return true;
+}
+
+size_t gl::pixel_stream_d2h_poll(gl::pixel_stream_d2h_t *stream)
+{
+    size_t     ready  = 0;
+    GLbitfield flags  = GL_SYNC_FLUSH_COMMANDS_BIT;
+    for (size_t i = 0; i < stream->ActiveCount; ++i)
+    {
+        gl::pixel_readback_slot_t *slot = &stream->Slots[(stream->SlotHead + i) % stream->SlotCount];
+        if (slot->State == gl::PIXEL_READBACK_STATE_PENDING)
+        {   // results are returned in order, so stop at the first incomplete request.
+            GLenum res = glClientWaitSync(slot->Fence, flags, 0);
+            if (res != GL_ALREADY_SIGNALED && res != GL_CONDITION_SATISFIED)
+                break;
+            flags  = 0;
+            ready++;
+        }
+    }
+    return ready;
+}
+
+bool gl::pixel_stream_d2h_try_map(gl::pixel_stream_d2h_t *stream, gl::pixel_readback_t *out_readback)
+{
+    if (stream->ActiveCount == 0)
+        return false;
+
+    gl::pixel_readback_slot_t *slot = &stream->Slots[stream->SlotHead];
+    if (slot->State != gl::PIXEL_READBACK_STATE_PENDING)
+    {   // the oldest request is already mapped; release it first.
+        return false;
+    }
+    GLenum res = glClientWaitSync(slot->Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (res != GL_ALREADY_SIGNALED && res != GL_CONDITION_SATISFIED)
+    {   // the GPU hasn't finished the copy yet.
+        return false;
+    }
+    glDeleteSync(slot->Fence);
+    slot->Fence = NULL;
+
+    // the copy has completed, so mapping the buffer will not stall.
+    gl::state_bind_buffer(GL_PIXEL_PACK_BUFFER, slot->Pbo);
+    slot->Info.Memory = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(slot->Info.Size), GL_MAP_READ_BIT);
+    gl::state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (slot->Info.Memory == NULL)
+    {   // the map failed; discard the request.
+        slot->State = gl::PIXEL_READBACK_STATE_IDLE;
+        stream->SlotHead = (stream->SlotHead + 1) % stream->SlotCount;
+        stream->ActiveCount--;
+        return false;
+    }
+    slot->State = gl::PIXEL_READBACK_STATE_MAPPED;
+    stream->Stats.Completed++;
+    if (out_readback != NULL) *out_readback = slot->Info;
+    return true;
+}
+
+void gl::pixel_stream_d2h_release(gl::pixel_stream_d2h_t *stream)
+{
+    if (stream->ActiveCount > 0)
+    {
+        gl::pixel_readback_slot_t *slot = &stream->Slots[stream->SlotHead];
+        if (slot->State == gl::PIXEL_READBACK_STATE_MAPPED)
+        {
+            gl::state_bind_buffer(GL_PIXEL_PACK_BUFFER, slot->Pbo);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            gl::state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+            slot->Info.Memory = NULL;
+            slot->State       = gl::PIXEL_READBACK_STATE_IDLE;
+            stream->SlotHead  = (stream->SlotHead + 1) % stream->SlotCount;
+            stream->ActiveCount--;
+        }
+    }
 }
 
 bool gl::create_pixel_stream_h2d(gl::pixel_stream_h2d_t *stream, size_t alignment, size_t buffer_size)
+{
+    return gl::create_pixel_stream_h2d(stream, alignment, buffer_size, gl::PIXEL_STREAM_FLAGS_NONE);
+}
+
+bool gl::create_pixel_stream_h2d(gl::pixel_stream_h2d_t *stream, size_t alignment, size_t buffer_size, uint32_t flags)
 {
     if (stream != NULL)
     {
         // ensure the alignment is a power-of-two.
         assert((alignment & (alignment-1)) == 0);
 
+        // start with an empty ring and zeroed counters.
+        memset(stream, 0, sizeof(gl::pixel_stream_h2d_t));
+
         // create the pixel buffer object.
         GLuint pbo = 0;
         glGenBuffers(1, &pbo);
         if (pbo == 0)
         {   // failed to allocate the buffer object.
-            stream->Pbo           = 0;
-            stream->Alignment     = 0;
-            stream->BufferSize    = 0;
-            stream->ReserveOffset = 0;
-            stream->ReserveSize   = 0;
             return false;
         }
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, pbo);
 
         // determine the reservation alignment.
         GLint   align  = GLint(alignment);
@@ -1562,14 +3862,27 @@ bool gl::create_pixel_stream_h2d(gl::pixel_stream_h2d_t *stream, size_t alignmen
         // round the buffer size up to a multiple of the alignment.
         // then allocate storage for the buffer within the driver.
         GLsizei size   = (buffer_size + (align - 1)) & ~(align - 1);
-        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        if (flags & gl::PIXEL_STREAM_FLAGS_PERSISTENT)
+        {   // allocate immutable storage and map the entire buffer once.
+            // the mapping is coherent, so no explicit flush is required.
+            GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, access);
+            stream->MappedBase = (uint8_t*) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, access);
+            if (stream->MappedBase == NULL)
+            {   // persistent mapping is not supported by the driver.
+                gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                gl::state_delete_buffers(1, &pbo);
+                return false;
+            }
+        }
+        else glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
         // fill out the buffer descriptor; we're done:
         stream->Pbo           = pbo;
+        stream->Flags         = flags;
         stream->Alignment     = size_t(align);
         stream->BufferSize    = size_t(size);
-        stream->ReserveOffset = 0;
-        stream->ReserveSize   = 0;
         return true;
     }
     else return false;
@@ -1579,59 +3892,123 @@ void gl::delete_pixel_stream_h2d(gl::pixel_stream_h2d_t *stream)
 {
     if (stream != NULL)
     {
+        for (size_t i = 0; i < stream->RegionCount; ++i)
+        {
+            gl::pixel_stream_region_t *r = pixel_stream_region(stream, i);
+            if (r->Fence != NULL) glDeleteSync(r->Fence);
+        }
         if (stream->Pbo != 0)
         {
-            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-            glDeleteBuffers(1, &stream->Pbo);
+            gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, stream->Pbo);
+            if (stream->MappedBase != NULL || stream->RegionCount > 0)
+            {   // the buffer is persistently mapped, or has an active reservation.
+                GLint mapped = GL_FALSE;
+                glGetBufferParameteriv(GL_PIXEL_UNPACK_BUFFER, GL_BUFFER_MAPPED, &mapped);
+                if (mapped) glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            }
+            gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            gl::state_delete_buffers(1, &stream->Pbo);
         }
-        stream->Pbo           = 0;
-        stream->Alignment     = 0;
-        stream->BufferSize    = 0;
-        stream->ReserveOffset = 0;
-        stream->ReserveSize   = 0;
+        memset(stream, 0, sizeof(gl::pixel_stream_h2d_t));
     }
 }
 
 void* gl::pixel_stream_h2d_reserve(gl::pixel_stream_h2d_t *stream, size_t amount)
 {
-    assert(stream->ReserveSize == 0);       // no existing reservation
     assert(amount <= stream->BufferSize);   // requested amount is less than the buffer size
 
-    GLsizei    align  = stream->Alignment;
-    GLsizei    size   = (amount + (align - 1)) & ~(align - 1);
-    GLintptr   offset = GLintptr(stream->ReserveOffset);
-    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    size_t  align  = stream->Alignment;
+    size_t  size   = align_up(amount, align);
+    size_t  offset = 0;
+
+    if (stream->MappedBase == NULL && pixel_stream_mapped(stream))
+    {   // only a persistently-mapped buffer supports multiple reservations.
+        assert(0 && "Only one active reservation allowed when not persistently mapped.");
+        return NULL;
+    }
+
+    // release any regions the GPU has finished with, then find space.
+    // if the ring has wrapped onto an in-flight region, wait on its fence.
+    gl::pixel_stream_h2d_retire(stream);
+    while (pixel_stream_place(stream, size, &offset) == false)
+    {
+        gl::pixel_stream_region_t *r = pixel_stream_region(stream, 0);
+        if (stream->RegionCount > 0 && r->State == gl::PIXEL_STREAM_REGION_COMMITTED)
+        {   // the application hasn't fenced its committed regions. any transfers
+            // sourcing them were issued before this call, so fence them all now.
+            gl::pixel_stream_h2d_fence(stream);
+        }
+        if ((stream->Flags & gl::PIXEL_STREAM_FLAGS_NO_WAIT) ||
+            (stream->RegionCount == 0) || (r->State != gl::PIXEL_STREAM_REGION_FENCED))
+        {   // either the caller doesn't want to stall, or the oldest
+            // region is still reserved and so can never be released here.
+            stream->Stats.Skips++;
+            return NULL;
+        }
+        stream->Stats.Stalls++;
+        if (pixel_stream_wait(r->Fence) == false)
+        {   // the wait failed; the context may have been lost.
+            return NULL;
+        }
+        pixel_stream_pop(stream);
+        gl::pixel_stream_h2d_retire(stream);
+    }
 
-    if (offset + size > stream->BufferSize)
-    {   // orphan the existing buffer and reserve a new buffer.
-        access |= GL_MAP_INVALIDATE_BUFFER_BIT;
-        offset  = 0;
+    uint8_t *b = NULL;
+    if (stream->MappedBase == NULL)
+    {   // the fence guarantees the GPU is done with this range, so the
+        // map can be unsynchronized and no orphaning is necessary.
+        GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, stream->Pbo);
+        b = (uint8_t*) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, GLintptr(offset), GLsizeiptr(size), access);
+        gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
     }
+    else b = stream->MappedBase + offset;
 
-    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream->Pbo);
-    GLvoid  *b = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, size, access);
     if (b != NULL)
     {   // store a description of the reserved range.
-        stream->ReserveOffset = offset;
-        stream->ReserveSize   = size;
+        size_t index   = (stream->RegionHead + stream->RegionCount) % GL_MAX_PIXEL_STREAM_REGIONS;
+        gl::pixel_stream_region_t *r = &stream->Regions[index];
+        r->Fence       = NULL;
+        r->Address     = b;
+        r->Offset      = offset;
+        r->Size        = size;
+        r->State       = gl::PIXEL_STREAM_REGION_RESERVED;
+        stream->RegionCount++;
+        stream->HeadOffset = offset + size;
+        stream->Stats.Reservations++;
+        stream->Stats.BytesReserved += size;
+        stream->Stats.BytesInFlight += size;
+        if (stream->Stats.BytesInFlight > stream->Stats.MaxInFlight)
+            stream->Stats.MaxInFlight = stream->Stats.BytesInFlight;
     }
     return b;
 }
 
 bool gl::pixel_stream_h2d_commit(gl::pixel_stream_h2d_t *stream, gl::pixel_transfer_h2d_t *transfer)
 {
-    if (stream->ReserveSize > 0)
+    gl::pixel_stream_region_t *r = pixel_stream_newest(stream);
+    return gl::pixel_stream_h2d_commit(stream, (r != NULL) ? r->Address : NULL, transfer);
+}
+
+bool gl::pixel_stream_h2d_commit(gl::pixel_stream_h2d_t *stream, void const *reservation, gl::pixel_transfer_h2d_t *transfer)
+{
+    gl::pixel_stream_region_t *r = pixel_stream_find(stream, reservation);
+    if (r != NULL)
     {
         if (transfer != NULL)
         {
             transfer->UnpackBuffer   = stream->Pbo;
-            transfer->TransferSize   = stream->ReserveSize;
-            transfer->TransferBuffer = GL_BUFFER_OFFSET(stream->ReserveOffset);
+            transfer->TransferSize   = r->Size;
+            transfer->TransferBuffer = GL_BUFFER_OFFSET(r->Offset);
+        }
+        if (stream->MappedBase == NULL)
+        {
+            gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, stream->Pbo);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
         }
-        glBindBuffer (GL_PIXEL_UNPACK_BUFFER, stream->Pbo);
-        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
-        stream->ReserveOffset += stream->ReserveSize;
-        stream->ReserveSize    = 0;
+        r->State = gl::PIXEL_STREAM_REGION_COMMITTED;
         return true;
     }
     else if (transfer != NULL)
@@ -1646,25 +4023,90 @@ bool gl::pixel_stream_h2d_commit(gl::pixel_stream_h2d_t *stream, gl::pixel_trans
 
 void gl::pixel_stream_h2d_cancel(gl::pixel_stream_h2d_t *stream)
 {
-    if (stream->ReserveSize > 0)
+    gl::pixel_stream_region_t *r = pixel_stream_newest(stream);
+    if (r != NULL) gl::pixel_stream_h2d_cancel(stream, r->Address);
+}
+
+void gl::pixel_stream_h2d_cancel(gl::pixel_stream_h2d_t *stream, void const *reservation)
+{
+    gl::pixel_stream_region_t *r = pixel_stream_find(stream, reservation);
+    if (r != NULL)
+    {
+        if (stream->MappedBase == NULL)
+        {
+            gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, stream->Pbo);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        if (r == pixel_stream_region(stream, stream->RegionCount - 1))
+        {   // the newest region can be rolled back immediately.
+            stream->HeadOffset  = r->Offset;
+            stream->Stats.BytesInFlight -= r->Size;
+            stream->RegionCount--;
+        }
+        else r->State = gl::PIXEL_STREAM_REGION_CANCELLED;
+        gl::pixel_stream_h2d_retire(stream);
+    }
+}
+
+size_t gl::pixel_stream_h2d_fence(gl::pixel_stream_h2d_t *stream)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < stream->RegionCount; ++i)
+    {
+        gl::pixel_stream_region_t *r = pixel_stream_region(stream, i);
+        if (r->State == gl::PIXEL_STREAM_REGION_COMMITTED)
+        {
+            r->Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            r->State = gl::PIXEL_STREAM_REGION_FENCED;
+            n++;
+        }
+    }
+    return n;
+}
+
+size_t gl::pixel_stream_h2d_retire(gl::pixel_stream_h2d_t *stream)
+{
+    size_t bytes = 0;
+    while (stream->RegionCount > 0)
     {
-        glBindBuffer (GL_PIXEL_UNPACK_BUFFER, stream->Pbo);
-        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
-        stream->ReserveSize = 0;
+        gl::pixel_stream_region_t *r = pixel_stream_region(stream, 0);
+        if (r->State == gl::PIXEL_STREAM_REGION_FENCED)
+        {   // poll the fence without flushing or blocking.
+            GLenum res = glClientWaitSync(r->Fence, 0, 0);
+            if (res != GL_ALREADY_SIGNALED && res != GL_CONDITION_SATISFIED)
+                break;
+        }
+        else if (r->State != gl::PIXEL_STREAM_REGION_CANCELLED)
+        {   // the region is still reserved or awaiting a fence.
+            break;
+        }
+        bytes += r->Size;
+        pixel_stream_pop(stream);
     }
+    return bytes;
+}
+
+void gl::pixel_stream_h2d_reset_stats(gl::pixel_stream_h2d_t *stream)
+{
+    size_t in_flight = stream->Stats.BytesInFlight;
+    memset(&stream->Stats, 0, sizeof(gl::pixel_stream_stats_t));
+    stream->Stats.BytesInFlight = in_flight;
+    stream->Stats.MaxInFlight   = in_flight;
 }
 
 void gl::transfer_pixels_h2d(gl::pixel_transfer_h2d_t *transfer)
 {
+    gl::gpu_scope_begin("transfer_pixels_h2d");
     if (transfer->UnpackBuffer != 0)
     {
         // select the PBO as the source of the unpack operation.
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, transfer->UnpackBuffer);
+        gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, transfer->UnpackBuffer);
     }
     else
     {
         // select the client memory as the source of the unpack operation.
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
     }
     if (transfer->SourceWidth != transfer->TransferWidth)
     {
@@ -1809,7 +4251,7 @@ void gl::transfer_pixels_h2d(gl::pixel_transfer_h2d_t *transfer)
 
     // restore the unpack state values to their defaults.
     if (transfer->UnpackBuffer  != 0)
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER,  0);
+        gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER,  0);
     if (transfer->SourceWidth   != transfer->TransferWidth)
         glPixelStorei(GL_UNPACK_ROW_LENGTH,   0);
     if (transfer->TransferSlices > 1)
@@ -1820,14 +4262,221 @@ void gl::transfer_pixels_h2d(gl::pixel_transfer_h2d_t *transfer)
         glPixelStorei(GL_UNPACK_SKIP_ROWS,    0);
     if (transfer->SourceZ != 0)
         glPixelStorei(GL_UNPACK_SKIP_IMAGES,  0);
+    gl::gpu_scope_end();
+}
+
+bool gl::create_upload_scheduler(gl::upload_scheduler_t *sched, size_t capacity, size_t byte_budget, uint64_t time_budget)
+{
+    if (capacity == 0) capacity = 1;
+    sched->ByteBudget   = byte_budget;
+    sched->TimeBudget   = time_budget;
+    sched->Capacity     = 0;
+    sched->Count        = 0;
+    sched->Jobs         = NULL;
+    sched->NextSequence = 0;
+    sched->FrameIndex   = 0;
+    sched->Complete     = NULL;
+    sched->Context      = NULL;
+    memset(&sched->Stats, 0, sizeof(gl::upload_stats_t));
+    sched->Jobs = (gl::upload_job_t*) malloc(capacity * sizeof(gl::upload_job_t));
+    if (sched->Jobs == NULL)
+        return false;
+    sched->Capacity = capacity;
+    return true;
+}
+
+void gl::delete_upload_scheduler(gl::upload_scheduler_t *sched)
+{
+    if (sched->Jobs != NULL) free(sched->Jobs);
+    sched->Capacity = 0;
+    sched->Count    = 0;
+    sched->Jobs     = NULL;
+    sched->Stats.QueueDepth = 0;
+    sched->Stats.QueueBytes = 0;
+}
+
+bool gl::upload_scheduler_submit(gl::upload_scheduler_t *sched, GLuint texture, gl::pixel_transfer_h2d_t const *transfer, uint32_t priority, uintptr_t tag)
+{
+    if (sched->Count == sched->Capacity)
+    {
+        size_t            newc = sched->Capacity > 0 ? sched->Capacity * 2 : 16;
+        gl::upload_job_t *newj = (gl::upload_job_t*) realloc(sched->Jobs, newc * sizeof(gl::upload_job_t));
+        if (newj == NULL) return false;
+        sched->Capacity = newc;
+        sched->Jobs     = newj;
+    }
+
+    gl::upload_job_t &job = sched->Jobs[sched->Count];
+    job.Transfer    = *transfer;
+    job.Texture     = texture;
+    job.Alignment   = 4;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &job.Alignment);
+    job.Priority    = priority;
+    job.Sequence    = sched->NextSequence++;
+    job.SubmitTime  = upload_clock_usec();
+    job.SubmitFrame = sched->FrameIndex;
+    job.Tag         = tag;
+    upload_heap_up(sched->Jobs, sched->Count++);
+
+    sched->Stats.JobsSubmitted++;
+    sched->Stats.QueueDepth = sched->Count;
+    sched->Stats.QueueBytes+= transfer->TransferSize;
+    if (sched->Stats.MaxQueueDepth < sched->Count)
+        sched->Stats.MaxQueueDepth = sched->Count;
+    return true;
+}
+
+size_t gl::upload_scheduler_cancel(gl::upload_scheduler_t *sched, uintptr_t tag)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < sched->Count; ++i)
+    {
+        if (sched->Jobs[i].Tag != tag)
+        {
+            sched->Jobs[kept++] = sched->Jobs[i];
+        }
+        else sched->Stats.QueueBytes -= sched->Jobs[i].Transfer.TransferSize;
+    }
+
+    size_t const removed = sched->Count - kept;
+    if (removed > 0)
+    {   // rebuild the heap from the remaining jobs.
+        sched->Count = kept;
+        for (size_t i = kept / 2; i > 0; --i)
+        {
+            upload_heap_down(sched->Jobs, kept, i - 1);
+        }
+        sched->Stats.QueueDepth = kept;
+    }
+    return removed;
+}
+
+size_t gl::upload_scheduler_drain(gl::upload_scheduler_t *sched)
+{
+    uint64_t const start = upload_clock_usec();
+    uint64_t       now   = start;
+    size_t         bytes = 0;
+    size_t         jobs  = 0;
+    GLint          prev  = 4;
+    GLint          align = 4;
+
+    gl::gpu_scope_begin("upload_scheduler_drain");
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &prev);
+    align = prev;
+    while (sched->Count > 0)
+    {
+        gl::upload_job_t job = sched->Jobs[0];
+        if (jobs > 0)
+        {   // always make progress, then stop at either budget.
+            if (sched->ByteBudget > 0 && bytes + job.Transfer.TransferSize > sched->ByteBudget)
+                break;
+            if (sched->TimeBudget > 0 && now - start >= sched->TimeBudget)
+                break;
+        }
+        if (--sched->Count > 0)
+        {
+            sched->Jobs[0] = sched->Jobs[sched->Count];
+            upload_heap_down(sched->Jobs, sched->Count, 0);
+        }
+
+        now    = upload_job_execute(sched, job, &align);
+        bytes += job.Transfer.TransferSize;
+        jobs  += 1;
+    }
+    if (align != prev)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, prev);
+    gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    gl::gpu_scope_end();
+
+    uint64_t const elapsed = now - start;
+    sched->FrameIndex++;
+    sched->Stats.Drains++;
+    sched->Stats.JobsExecuted  += jobs;
+    sched->Stats.BytesExecuted += bytes;
+    sched->Stats.DrainMicros   += elapsed;
+    sched->Stats.QueueDepth     = sched->Count;
+    sched->Stats.QueueBytes    -= bytes;
+    if (sched->Stats.MaxDrainMicros < elapsed)
+        sched->Stats.MaxDrainMicros = elapsed;
+    return bytes;
+}
+
+size_t gl::upload_scheduler_flush(gl::upload_scheduler_t *sched, uintptr_t tag)
+{
+    uint64_t const start = upload_clock_usec();
+    uint64_t       now   = start;
+    size_t         bytes = 0;
+    size_t         jobs  = 0;
+    GLint          prev  = 4;
+    GLint          align = 4;
+
+    gl::gpu_scope_begin("upload_scheduler_flush");
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &prev);
+    align = prev;
+    for ( ; ; )
+    {   // find the next job with the tag. the queue is searched each time,
+        // since the completion function may submit additional jobs.
+        size_t next = sched->Count;
+        for (size_t i = 0; i < sched->Count; ++i)
+        {
+            if (sched->Jobs[i].Tag == tag && (next == sched->Count || upload_job_before(sched->Jobs[i], sched->Jobs[next])))
+                next = i;
+        }
+        if (next == sched->Count)
+            break;
+
+        gl::upload_job_t job = sched->Jobs[next];
+        if (next != --sched->Count)
+        {   // move the last job into the hole and restore the heap property.
+            sched->Jobs[next] = sched->Jobs[sched->Count];
+            upload_heap_down(sched->Jobs, sched->Count, next);
+            upload_heap_up  (sched->Jobs, next);
+        }
+        now    = upload_job_execute(sched, job, &align);
+        bytes += job.Transfer.TransferSize;
+        jobs  += 1;
+    }
+    if (align != prev)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, prev);
+    gl::state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    gl::gpu_scope_end();
+
+    sched->Stats.JobsExecuted  += jobs;
+    sched->Stats.BytesExecuted += bytes;
+    sched->Stats.DrainMicros   += now - start;
+    sched->Stats.QueueDepth     = sched->Count;
+    sched->Stats.QueueBytes    -= bytes;
+    return bytes;
+}
+
+size_t gl::upload_scheduler_pending(gl::upload_scheduler_t const *sched, uintptr_t tag)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < sched->Count; ++i)
+    {
+        if (sched->Jobs[i].Tag == tag)
+            count++;
+    }
+    return count;
+}
+
+void gl::upload_scheduler_reset_stats(gl::upload_scheduler_t *sched)
+{
+    size_t const depth = sched->Stats.QueueDepth;
+    size_t const bytes = sched->Stats.QueueBytes;
+    memset(&sched->Stats, 0, sizeof(gl::upload_stats_t));
+    sched->Stats.QueueDepth    = depth;
+    sched->Stats.QueueBytes    = bytes;
+    sched->Stats.MaxQueueDepth = depth;
 }
 
 void gl::create_sprite_batch(gl::sprite_batch_t *batch, size_t capacity)
 {
     if (batch)
     {
-        batch->Count    = 0;
-        batch->Capacity = capacity;
+        batch->Count       = 0;
+        batch->Capacity    = capacity;
+        batch->OpaqueCount = 0;
         if (capacity)
         {
             batch->Quads = (gl::sprite_quad_t*)      malloc(capacity * sizeof(gl::sprite_quad_t));
@@ -1855,6 +4504,7 @@ void gl::delete_sprite_batch(gl::sprite_batch_t *batch)
         }
         batch->Count    = 0;
         batch->Capacity = 0;
+        batch->OpaqueCount = 0;
         batch->Quads    = NULL;
         batch->State    = NULL;
         batch->Order    = NULL;
@@ -1875,7 +4525,8 @@ void gl::ensure_sprite_batch(gl::sprite_batch_t *batch, size_t capacity)
 
 void gl::flush_sprite_batch(gl::sprite_batch_t *batch)
 {
-    batch->Count = 0;
+    batch->Count       = 0;
+    batch->OpaqueCount = 0;
 }
 
 void gl::generate_quads(
@@ -1909,9 +4560,13 @@ void gl::generate_quads(
         q.Scale [1]   = 1.0f / s.TextureHeight;
         q.Orientation = s.Orientation;
         q.TintColor   = s.TintColor;
+        // map the layer depth into [0, 1) with 24 bits of precision.
+        q.Depth       = float(s.LayerDepth < 0xFFFFFFU ? s.LayerDepth : 0xFFFFFFU) * (1.0f / 16777216.0f);
+        q.Layer       = float(s.ImageLayer);
 
         r.LayerDepth  = s.LayerDepth;
         r.RenderState = s.RenderState;
+        r.Flags       = s.Flags;
 
         indices[qindex] = uint32_t(qindex);
     }
@@ -1955,6 +4610,8 @@ void gl::generate_quad_vertices_ptc(
         float    const scl_v = quad.Scale[Y];
         float    const angle = quad.Orientation;
         uint32_t const color = quad.TintColor;
+        float    const depth = quad.Depth;
+        float    const layer = quad.Layer;
         float    const sin_o = sinf(angle);
         float    const cos_o = cosf(angle);
 
@@ -1971,6 +4628,8 @@ void gl::generate_quad_vertices_ptc(
             vert.XYUV[2]   = (src_x + (ofs_x * src_w)) *  scl_u;
             vert.XYUV[3]   = 1.0f - ((src_y + (ofs_y * src_h)) *  scl_v);
             vert.TintColor = color;
+            vert.Depth     = depth;
+            vert.Layer     = layer;
         }
     }
 }
@@ -2017,9 +4676,9 @@ bool gl::create_sprite_effect(gl::sprite_effect_t *effect, size_t quad_count, si
     GLsizei eao_size   = GLsizei(index_size  * icount);
 
     glGenBuffers(2, buffers);
-    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    gl::state_bind_buffer(GL_ARRAY_BUFFER, buffers[0]);
     glBufferData(GL_ARRAY_BUFFER, abo_size, NULL, GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    gl::state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, eao_size, NULL, GL_DYNAMIC_DRAW);
     glGenVertexArrays(1, &vao);
 
@@ -2030,6 +4689,7 @@ bool gl::create_sprite_effect(gl::sprite_effect_t *effect, size_t quad_count, si
     effect->IndexOffset      = 0;
     effect->IndexSize        = index_size;
     effect->CurrentState     = 0xFFFFFFFFU;
+    effect->Pass             = gl::SPRITE_PASS_ALL;
     effect->VertexArray      = vao;
     effect->VertexBuffer     = buffers[0];
     effect->IndexBuffer      = buffers[1];
@@ -2044,6 +4704,8 @@ bool gl::create_sprite_effect(gl::sprite_effect_t *effect, size_t quad_count, si
     effect->BlendColor[1]    = 0.0f;
     effect->BlendColor[2]    = 0.0f;
     effect->BlendColor[3]    = 0.0f;
+    effect->ConstantRing     = NULL;
+    effect->ConstantOffset   = 0;
     return true;
 }
 
@@ -2053,8 +4715,8 @@ void gl::delete_sprite_effect(gl::sprite_effect_t *effect)
         effect->VertexBuffer,
         effect->IndexBuffer
     };
-    glDeleteBuffers(2, buffers);
-    glDeleteVertexArrays(1, &effect->VertexArray);
+    gl::state_delete_buffers(2, buffers);
+    gl::state_delete_vertex_arrays(1, &effect->VertexArray);
     effect->VertexCapacity = 0;
     effect->VertexOffset   = 0;
     effect->VertexSize     = 0;
@@ -2064,6 +4726,8 @@ void gl::delete_sprite_effect(gl::sprite_effect_t *effect)
     effect->VertexArray    = 0;
     effect->VertexBuffer   = 0;
     effect->IndexBuffer    = 0;
+    effect->ConstantRing   = NULL;
+    effect->ConstantOffset = 0;
 }
 
 void gl::sprite_effect_blend_none(gl::sprite_effect_t *effect)
@@ -2126,7 +4790,7 @@ void gl::sprite_effect_blend_premultiplied(gl::sprite_effect_t *effect)
     effect->BlendColor[3]    = 0.0f;
 }
 
-void gl::sprite_effect_set_viewport(gl::sprite_effect_t *effect, int width, int height)
+bool gl::sprite_effect_set_viewport(gl::sprite_effect_t *effect, int width, int height, gl::constant_ring_t *ring)
 {
     float *dst16 = effect->Projection;
     float  s_x = 1.0f / (width   * 0.5f);
@@ -2135,34 +4799,69 @@ void gl::sprite_effect_set_viewport(gl::sprite_effect_t *effect, int width, int
     dst16[ 4]  = 0.0f; dst16[ 5] = -s_y; dst16[ 6] = 0.0f; dst16[ 7] = 0.0f;
     dst16[ 8]  = 0.0f; dst16[ 9] = 0.0f; dst16[10] = 1.0f; dst16[11] = 0.0f;
     dst16[12]  =-1.0f; dst16[13] = 1.0f; dst16[14] = 0.0f; dst16[15] = 1.0f;
+    effect->ConstantRing   = ring;
+    effect->ConstantOffset = 0;
+    return gl::sprite_effect_update_constants(effect);
+}
+
+bool gl::sprite_effect_update_constants(gl::sprite_effect_t *effect)
+{
+    if (effect->ConstantRing == NULL)
+        return true;
+
+    size_t offset = 0;
+    void  *block  = gl::constant_ring_alloc(effect->ConstantRing, SPRITE_CONSTANTS_SIZE, &offset);
+    if (block == NULL)
+    {   // the ring segment for this frame is full.
+        return false;
+    }
+    gl::std140_store(block, 0, GL_FLOAT_MAT4, 1, effect->Projection);
+    effect->ConstantOffset = offset;
+    return true;
+}
+
+void gl::sprite_effect_apply_constants(gl::sprite_effect_t *effect, gl::uniform_block_desc_t const *block, gl::uniform_desc_t *uniform)
+{
+    if (effect->ConstantRing != NULL && block != NULL)
+    {   // the range binding is filtered by the state cache.
+        gl::constant_ring_bind(effect->ConstantRing, block, effect->ConstantOffset, SPRITE_CONSTANTS_SIZE);
+    }
+    else if (uniform != NULL)
+    {   // fallback for shaders declaring a plain uMSS uniform.
+        gl::set_uniform(uniform, effect->Projection, false);
+    }
 }
 
 void gl::sprite_effect_bind_buffers(gl::sprite_effect_t *effect)
 {
-    glBindVertexArray(effect->VertexArray);
-    glBindBuffer(GL_ARRAY_BUFFER, effect->VertexBuffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, effect->IndexBuffer);
+    gl::state_bind_vertex_array(effect->VertexArray);
+    gl::state_bind_buffer(GL_ARRAY_BUFFER, effect->VertexBuffer);
+    gl::state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, effect->IndexBuffer);
 }
 
 void gl::sprite_effect_apply_blendstate(gl::sprite_effect_t *effect)
 {
     if (effect->BlendEnabled)
     {
-        glEnable(GL_BLEND);
-        glBlendColor(effect->BlendColor[0], effect->BlendColor[1], effect->BlendColor[2], effect->BlendColor[3]);
-        glBlendFuncSeparate(effect->BlendSourceColor, effect->BlendTargetColor, effect->BlendSourceAlpha, effect->BlendTargetAlpha);
-        glBlendEquationSeparate(effect->BlendFuncColor, effect->BlendFuncAlpha);
+        gl::state_enable(GL_BLEND, true);
+        gl::state_blend_color(effect->BlendColor[0], effect->BlendColor[1], effect->BlendColor[2], effect->BlendColor[3]);
+        gl::state_blend_func(effect->BlendSourceColor, effect->BlendTargetColor, effect->BlendSourceAlpha, effect->BlendTargetAlpha);
+        gl::state_blend_equation(effect->BlendFuncColor, effect->BlendFuncAlpha);
     }
-    else glDisable(GL_BLEND);
+    else gl::state_enable(GL_BLEND, false);
 }
 
 void gl::sprite_effect_setup_vao_ptc(gl::sprite_effect_t *effect)
 {
-    glBindVertexArray(effect->VertexArray);
+    gl::state_bind_vertex_array(effect->VertexArray);
     glEnableVertexAttribArray(GL_SPRITE_PTC_LOCATION_PTX);
     glEnableVertexAttribArray(GL_SPRITE_PTC_LOCATION_CLR);
+    glEnableVertexAttribArray(GL_SPRITE_PTC_LOCATION_DEP);
+    glEnableVertexAttribArray(GL_SPRITE_PTC_LOCATION_LAY);
     glVertexAttribPointer(GL_SPRITE_PTC_LOCATION_PTX, 4, GL_FLOAT,         GL_FALSE, sizeof(gl::sprite_vertex_ptc_t), (GLvoid const*)  0);
     glVertexAttribPointer(GL_SPRITE_PTC_LOCATION_CLR, 4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(gl::sprite_vertex_ptc_t), (GLvoid const*) 16);
+    glVertexAttribPointer(GL_SPRITE_PTC_LOCATION_DEP, 1, GL_FLOAT,         GL_FALSE, sizeof(gl::sprite_vertex_ptc_t), (GLvoid const*) 20);
+    glVertexAttribPointer(GL_SPRITE_PTC_LOCATION_LAY, 1, GL_FLOAT,         GL_FALSE, sizeof(gl::sprite_vertex_ptc_t), (GLvoid const*) 24);
 }
 
 size_t gl::sprite_effect_buffer_data_ptc(
@@ -2237,22 +4936,46 @@ void gl::sprite_effect_draw_batch_ptc(
     gl::sprite_effect_apply_t const *fxfuncs,
     void                            *context)
 {
-    size_t quad_count = batch->Count;
-    size_t quad_index = 0;
-    size_t base_index = 0;
-    size_t n          = 0;
+    gl::gpu_scope_begin("sprite_effect_draw_batch_ptc");
+    effect->Pass = gl::SPRITE_PASS_ALL;
+    sprite_effect_draw_range_ptc(effect, batch, 0, batch->Count, fxfuncs, context);
+    gl::gpu_scope_end();
+}
 
-    fxfuncs->SetupEffect(effect, context);
-    effect->CurrentState = 0xFFFFFFFFU;
+void gl::sort_sprite_batch_layered(gl::sprite_batch_t *batch)
+{
+    uint32_t *beg = batch->Order;
+    uint32_t *end = batch->Order + batch->Count;
+    uint32_t *mid = std::partition(beg, end, is_opaque_sprite(batch));
+    std::sort(beg, mid, gl::front_to_back(batch));
+    std::sort(mid, end, gl::back_to_front(batch));
+    batch->OpaqueCount = size_t(mid - beg);
+}
+
+void gl::sprite_effect_draw_batch_layered_ptc(
+    gl::sprite_effect_t             *effect,
+    gl::sprite_batch_t              *batch,
+    gl::sprite_effect_apply_t const *fxfuncs,
+    void                            *context)
+{
+    size_t opaque = batch->OpaqueCount < batch->Count ? batch->OpaqueCount : batch->Count;
 
-    while (quad_count > 0)
+    gl::gpu_scope_begin("sprite_effect_draw_batch_layered_ptc");
+    if (opaque > 0)
     {
-        n = gl::sprite_effect_buffer_data_ptc(effect, batch->Quads, batch->Order, quad_index, quad_count, &base_index);
-        gl::sprite_effect_draw_batch_region_ptc(effect, batch, quad_index, n, base_index, fxfuncs, context);
-        base_index  = effect->IndexOffset;
-        quad_index += n;
-        quad_count -= n;
+        effect->Pass = gl::SPRITE_PASS_OPAQUE;
+        sprite_effect_draw_range_ptc(effect, batch, 0, opaque, fxfuncs, context);
+    }
+    if (opaque < batch->Count)
+    {
+        effect->Pass = gl::SPRITE_PASS_TRANSLUCENT;
+        sprite_effect_draw_range_ptc(effect, batch, opaque, batch->Count - opaque, fxfuncs, context);
     }
+    // restore the default depth state used by sprite_effect_draw_batch_ptc().
+    gl::state_enable(GL_DEPTH_TEST, false);
+    gl::state_depth_mask(true);
+    effect->Pass = gl::SPRITE_PASS_ALL;
+    gl::gpu_scope_end();
 }
 
 void gl::sprite_effect_draw_batch_region_ptc(
@@ -2301,19 +5024,24 @@ void gl::sprite_effect_draw_batch_region_ptc(
     effect->CurrentState = state_1;
 }
 
-bool gl::create_sprite_shader_ptc_clr(gl::sprite_shader_ptc_clr_t *shader)
+bool gl::create_sprite_shader_ptc_clr(gl::sprite_shader_ptc_clr_t *shader, bool constant_block)
 {
     if (shader)
     {
+        char const *vss[2] = {
+            constant_block ? SpriteShaderMSS_UBO_VSS : SpriteShaderMSS_UNI_VSS,
+            SpriteShaderPTC_CLR_VSS
+        };
         gl::shader_source_t     sources;
         gl::shader_source_init(&sources);
-        gl::shader_source_add (&sources, GL_VERTEX_SHADER,   (char**) &SpriteShaderPTC_CLR_VSS, 1);
+        gl::shader_source_add (&sources, GL_VERTEX_SHADER,   (char**) vss, 2);
         gl::shader_source_add (&sources, GL_FRAGMENT_SHADER, (char**) &SpriteShaderPTC_CLR_FSS, 1);
         if (gl::build_shader  (&sources, &shader->ShaderDesc, &shader->Program))
         {
             shader->AttribPTX  = gl::find_attribute(&shader->ShaderDesc, "aPTX");
             shader->AttribCLR  = gl::find_attribute(&shader->ShaderDesc, "aCLR");
             shader->UniformMSS = gl::find_uniform  (&shader->ShaderDesc, "uMSS");
+            shader->BlockSPC   = gl::find_uniform_block(&shader->ShaderDesc, "SpriteConstants");
             return true;
         }
         else return false;
@@ -2326,21 +5054,26 @@ void gl::delete_sprite_shader_ptc_clr(gl::sprite_shader_ptc_clr_t *shader)
     if (shader && shader->Program)
     {
         gl::shader_desc_free(&shader->ShaderDesc);
-        glDeleteProgram(shader->Program);
+        gl::state_delete_program(shader->Program);
         shader->AttribPTX  = NULL;
         shader->AttribCLR  = NULL;
         shader->UniformMSS = NULL;
+        shader->BlockSPC   = NULL;
         shader->Program    = 0;
     }
 }
 
-bool gl::create_sprite_shader_ptc_tex(gl::sprite_shader_ptc_tex_t *shader)
+bool gl::create_sprite_shader_ptc_tex(gl::sprite_shader_ptc_tex_t *shader, bool constant_block)
 {
     if (shader)
     {
+        char const *vss[2] = {
+            constant_block ? SpriteShaderMSS_UBO_VSS : SpriteShaderMSS_UNI_VSS,
+            SpriteShaderPTC_TEX_VSS
+        };
         gl::shader_source_t     sources;
         gl::shader_source_init(&sources);
-        gl::shader_source_add (&sources, GL_VERTEX_SHADER,   (char**) &SpriteShaderPTC_TEX_VSS, 1);
+        gl::shader_source_add (&sources, GL_VERTEX_SHADER,   (char**) vss, 2);
         gl::shader_source_add (&sources, GL_FRAGMENT_SHADER, (char**) &SpriteShaderPTC_TEX_FSS, 1);
         if (gl::build_shader  (&sources, &shader->ShaderDesc, &shader->Program))
         {
@@ -2348,6 +5081,8 @@ bool gl::create_sprite_shader_ptc_tex(gl::sprite_shader_ptc_tex_t *shader)
             shader->AttribCLR  = gl::find_attribute(&shader->ShaderDesc, "aCLR");
             shader->SamplerTEX = gl::find_sampler  (&shader->ShaderDesc, "sTEX");
             shader->UniformMSS = gl::find_uniform  (&shader->ShaderDesc, "uMSS");
+            shader->BlockSPC   = gl::find_uniform_block(&shader->ShaderDesc, "SpriteConstants");
+            shader->UniformATH = gl::find_uniform  (&shader->ShaderDesc, "uATH");
             return true;
         }
         else return false;
@@ -2360,12 +5095,520 @@ void gl::delete_sprite_shader_ptc_tex(gl::sprite_shader_ptc_tex_t *shader)
     if (shader && shader->Program)
     {
         gl::shader_desc_free(&shader->ShaderDesc);
-        glDeleteProgram(shader->Program);
+        gl::state_delete_program(shader->Program);
+        shader->AttribPTX  = NULL;
+        shader->AttribCLR  = NULL;
+        shader->SamplerTEX = NULL;
+        shader->UniformMSS = NULL;
+        shader->BlockSPC   = NULL;
+        shader->UniformATH = NULL;
+        shader->Program    = 0;
+    }
+}
+
+bool gl::create_sprite_shader_ptc_arr(gl::sprite_shader_ptc_arr_t *shader, bool constant_block)
+{
+    if (shader)
+    {
+        char const *vss[2] = {
+            constant_block ? SpriteShaderMSS_UBO_VSS : SpriteShaderMSS_UNI_VSS,
+            SpriteShaderPTC_ARR_VSS
+        };
+        gl::shader_source_t     sources;
+        gl::shader_source_init(&sources);
+        gl::shader_source_add (&sources, GL_VERTEX_SHADER,   (char**) vss, 2);
+        gl::shader_source_add (&sources, GL_FRAGMENT_SHADER, (char**) &SpriteShaderPTC_ARR_FSS, 1);
+        if (gl::build_shader  (&sources, &shader->ShaderDesc, &shader->Program))
+        {
+            shader->AttribPTX  = gl::find_attribute(&shader->ShaderDesc, "aPTX");
+            shader->AttribCLR  = gl::find_attribute(&shader->ShaderDesc, "aCLR");
+            shader->AttribLAY  = gl::find_attribute(&shader->ShaderDesc, "aLAY");
+            shader->SamplerTEX = gl::find_sampler  (&shader->ShaderDesc, "sTEX");
+            shader->UniformMSS = gl::find_uniform  (&shader->ShaderDesc, "uMSS");
+            shader->BlockSPC   = gl::find_uniform_block(&shader->ShaderDesc, "SpriteConstants");
+            shader->UniformATH = gl::find_uniform  (&shader->ShaderDesc, "uATH");
+            return true;
+        }
+        else return false;
+    }
+    else return false;
+}
+
+void gl::delete_sprite_shader_ptc_arr(gl::sprite_shader_ptc_arr_t *shader)
+{
+    if (shader && shader->Program)
+    {
+        gl::shader_desc_free(&shader->ShaderDesc);
+        gl::state_delete_program(shader->Program);
+        shader->AttribPTX  = NULL;
+        shader->AttribCLR  = NULL;
+        shader->AttribLAY  = NULL;
+        shader->SamplerTEX = NULL;
+        shader->UniformMSS = NULL;
+        shader->BlockSPC   = NULL;
+        shader->UniformATH = NULL;
+        shader->Program    = 0;
+    }
+}
+
+bool gl::create_sprite_shader_ptc_sdf(gl::sprite_shader_ptc_sdf_t *shader, bool constant_block)
+{
+    if (shader)
+    {
+        char const *vss[2] = {
+            constant_block ? SpriteShaderMSS_UBO_VSS : SpriteShaderMSS_UNI_VSS,
+            SpriteShaderPTC_TEX_VSS
+        };
+        gl::shader_source_t     sources;
+        gl::shader_source_init(&sources);
+        gl::shader_source_add (&sources, GL_VERTEX_SHADER,   (char**) vss, 2);
+        gl::shader_source_add (&sources, GL_FRAGMENT_SHADER, (char**) &SpriteShaderPTC_SDF_FSS, 1);
+        if (gl::build_shader  (&sources, &shader->ShaderDesc, &shader->Program))
+        {
+            shader->AttribPTX  = gl::find_attribute(&shader->ShaderDesc, "aPTX");
+            shader->AttribCLR  = gl::find_attribute(&shader->ShaderDesc, "aCLR");
+            shader->SamplerTEX = gl::find_sampler  (&shader->ShaderDesc, "sTEX");
+            shader->UniformMSS = gl::find_uniform  (&shader->ShaderDesc, "uMSS");
+            shader->BlockSPC   = gl::find_uniform_block(&shader->ShaderDesc, "SpriteConstants");
+            shader->UniformEDG = gl::find_uniform  (&shader->ShaderDesc, "uEDG");
+            return true;
+        }
+        else return false;
+    }
+    else return false;
+}
+
+void gl::delete_sprite_shader_ptc_sdf(gl::sprite_shader_ptc_sdf_t *shader)
+{
+    if (shader && shader->Program)
+    {
+        gl::shader_desc_free(&shader->ShaderDesc);
+        gl::state_delete_program(shader->Program);
+        shader->AttribPTX  = NULL;
+        shader->AttribCLR  = NULL;
+        shader->SamplerTEX = NULL;
+        shader->UniformMSS = NULL;
+        shader->BlockSPC   = NULL;
+        shader->UniformEDG = NULL;
+        shader->Program    = 0;
+    }
+}
+
+bool gl::create_sprite_shader_ptc_sdf_arr(gl::sprite_shader_ptc_sdf_arr_t *shader, bool constant_block)
+{
+    if (shader)
+    {
+        char const *vss[2] = {
+            constant_block ? SpriteShaderMSS_UBO_VSS : SpriteShaderMSS_UNI_VSS,
+            SpriteShaderPTC_ARR_VSS
+        };
+        gl::shader_source_t     sources;
+        gl::shader_source_init(&sources);
+        gl::shader_source_add (&sources, GL_VERTEX_SHADER,   (char**) vss, 2);
+        gl::shader_source_add (&sources, GL_FRAGMENT_SHADER, (char**) &SpriteShaderPTC_SDF_ARR_FSS, 1);
+        if (gl::build_shader  (&sources, &shader->ShaderDesc, &shader->Program))
+        {
+            shader->AttribPTX  = gl::find_attribute(&shader->ShaderDesc, "aPTX");
+            shader->AttribCLR  = gl::find_attribute(&shader->ShaderDesc, "aCLR");
+            shader->AttribLAY  = gl::find_attribute(&shader->ShaderDesc, "aLAY");
+            shader->SamplerTEX = gl::find_sampler  (&shader->ShaderDesc, "sTEX");
+            shader->UniformMSS = gl::find_uniform  (&shader->ShaderDesc, "uMSS");
+            shader->BlockSPC   = gl::find_uniform_block(&shader->ShaderDesc, "SpriteConstants");
+            shader->UniformEDG = gl::find_uniform  (&shader->ShaderDesc, "uEDG");
+            return true;
+        }
+        else return false;
+    }
+    else return false;
+}
+
+void gl::delete_sprite_shader_ptc_sdf_arr(gl::sprite_shader_ptc_sdf_arr_t *shader)
+{
+    if (shader && shader->Program)
+    {
+        gl::shader_desc_free(&shader->ShaderDesc);
+        gl::state_delete_program(shader->Program);
         shader->AttribPTX  = NULL;
         shader->AttribCLR  = NULL;
+        shader->AttribLAY  = NULL;
         shader->SamplerTEX = NULL;
         shader->UniformMSS = NULL;
+        shader->BlockSPC   = NULL;
+        shader->UniformEDG = NULL;
         shader->Program    = 0;
     }
 }
 
+bool gl::create_gpu_profiler(gl::gpu_profiler_t *profiler, size_t frame_count)
+{
+    if (profiler == NULL || frame_count == 0 || frame_count > GL_MAX_GPU_PROFILER_FRAMES)
+        return false;
+
+    memset(profiler, 0, sizeof(gl::gpu_profiler_t));
+    profiler->FrameCount = frame_count;
+    profiler->FrameIndex = frame_count - 1;
+
+    // the timestamp counter may have zero bits, in which case
+    // the implementation doesn't support timestamp queries.
+    GLint bits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+    if (bits > 0)
+    {
+        for (size_t i = 0; i < frame_count; ++i)
+        {
+            gl::gpu_profiler_frame_t *frame = &profiler->Frames[i];
+            glGenQueries(GLsizei(GL_MAX_GPU_PROFILER_SAMPLES * 2), frame->Queries);
+        }
+        profiler->Enabled = true;
+    }
+    return true;
+}
+
+void gl::delete_gpu_profiler(gl::gpu_profiler_t *profiler)
+{
+    if (profiler != NULL)
+    {
+        if (profiler->Enabled)
+        {
+            for (size_t i = 0; i < profiler->FrameCount; ++i)
+            {
+                gl::gpu_profiler_frame_t *frame = &profiler->Frames[i];
+                glDeleteQueries(GLsizei(GL_MAX_GPU_PROFILER_SAMPLES * 2), frame->Queries);
+            }
+        }
+        if (CurrentGpuProfiler == profiler)
+            CurrentGpuProfiler  = NULL;
+        memset(profiler, 0, sizeof(gl::gpu_profiler_t));
+    }
+}
+
+void gl::make_gpu_profiler_current(gl::gpu_profiler_t *profiler)
+{
+    CurrentGpuProfiler = profiler;
+}
+
+gl::gpu_profiler_t* gl::current_gpu_profiler(void)
+{
+    return CurrentGpuProfiler;
+}
+
+void gl::gpu_profiler_begin_frame(gl::gpu_profiler_t *profiler)
+{
+    profiler->FrameIndex = (profiler->FrameIndex + 1) % profiler->FrameCount;
+    profiler->Depth      = 0;
+
+    gl::gpu_profiler_frame_t *frame = &profiler->Frames[profiler->FrameIndex];
+    if (frame->Pending && !gpu_profiler_resolve(profiler, frame))
+    {   // don't stall; the query objects are about to be re-used.
+        profiler->Dropped++;
+    }
+    frame->SampleCount = 0;
+    frame->LastQuery   = 0;
+    frame->Pending     = false;
+}
+
+void gl::gpu_profiler_end_frame(gl::gpu_profiler_t *profiler)
+{
+    gl::gpu_profiler_t *current = CurrentGpuProfiler;
+    CurrentGpuProfiler = profiler;
+    while (profiler->Depth > 0)
+        gl::gpu_scope_end();
+    CurrentGpuProfiler = current;
+
+    gl::gpu_profiler_frame_t *frame = &profiler->Frames[profiler->FrameIndex];
+    frame->Pending = frame->SampleCount > 0;
+}
+
+void gl::gpu_profiler_reset_stats(gl::gpu_profiler_t *profiler)
+{
+    for (size_t i = 0; i < profiler->ScopeCount; ++i)
+    {
+        gl::gpu_scope_stats_t *scope = &profiler->Scopes[i];
+        scope->MinNs   = 0;
+        scope->MaxNs   = 0;
+        scope->TotalNs = 0;
+        scope->Frames  = 0;
+        scope->AvgNs   = 0.0;
+    }
+    profiler->Dropped   = 0;
+    profiler->Overflows = 0;
+}
+
+gl::gpu_scope_stats_t const* gl::gpu_profiler_find(gl::gpu_profiler_t const *profiler, char const *name)
+{
+    uint32_t hash = gl::shader_name(name);
+    for (size_t i = 0; i < profiler->ScopeCount; ++i)
+    {
+        if (profiler->Scopes[i].NameHash == hash)
+            return &profiler->Scopes[i];
+    }
+    return NULL;
+}
+
+size_t gl::gpu_profiler_export(gl::gpu_profiler_t const *profiler, gl::gpu_scope_stats_t *stats, size_t max_stats)
+{
+    size_t n = profiler->ScopeCount < max_stats ? profiler->ScopeCount : max_stats;
+    memcpy(stats, profiler->Scopes, n * sizeof(gl::gpu_scope_stats_t));
+    return n;
+}
+
+void gl::gpu_scope_begin(char const *name)
+{
+    gl::gpu_profiler_t *profiler = CurrentGpuProfiler;
+    if (profiler == NULL || !profiler->Enabled)
+        return;
+
+    size_t depth = profiler->Depth++;
+    if (depth >= GL_MAX_GPU_PROFILER_DEPTH)
+    {   // nested too deeply; gpu_scope_end() ignores this level.
+        profiler->Overflows++;
+        return;
+    }
+
+    gl::gpu_profiler_frame_t *frame = &profiler->Frames[profiler->FrameIndex];
+    size_t scope = gpu_profiler_scope(profiler, name);
+    if (scope == GL_MAX_GPU_PROFILER_SCOPES || frame->SampleCount == GL_MAX_GPU_PROFILER_SAMPLES)
+    {   // out of scope names or query objects; don't record this instance.
+        profiler->Stack[depth] = GL_MAX_GPU_PROFILER_SAMPLES;
+        profiler->Overflows++;
+        return;
+    }
+
+    size_t sample = frame->SampleCount++;
+    frame->Scopes[sample] = uint8_t(scope);
+    frame->LastQuery      = sample * 2;
+    profiler->Stack[depth]= sample;
+    glQueryCounter(frame->Queries[sample * 2], GL_TIMESTAMP);
+}
+
+void gl::gpu_scope_end(void)
+{
+    gl::gpu_profiler_t *profiler = CurrentGpuProfiler;
+    if (profiler == NULL || !profiler->Enabled || profiler->Depth == 0)
+        return;
+
+    size_t depth = --profiler->Depth;
+    if (depth >= GL_MAX_GPU_PROFILER_DEPTH)
+        return;
+
+    size_t sample = profiler->Stack[depth];
+    if (sample < GL_MAX_GPU_PROFILER_SAMPLES)
+    {
+        gl::gpu_profiler_frame_t *frame = &profiler->Frames[profiler->FrameIndex];
+        frame->LastQuery = sample * 2 + 1;
+        glQueryCounter(frame->Queries[sample * 2 + 1], GL_TIMESTAMP);
+    }
+}
+
+bool gl::create_command_buffer(gl::command_buffer_t *cmdbuf, size_t capacity)
+{
+    if (cmdbuf == NULL)
+        return false;
+
+    memset(cmdbuf, 0, sizeof(gl::command_buffer_t));
+    if (capacity > 0)
+    {
+        capacity = (capacity + 7) & ~size_t(7);
+        if ((cmdbuf->Commands = (uint8_t*) malloc(capacity)) == NULL)
+            return false;
+        cmdbuf->Capacity = capacity;
+    }
+    return true;
+}
+
+void gl::delete_command_buffer(gl::command_buffer_t *cmdbuf)
+{
+    if (cmdbuf != NULL)
+    {
+        if (cmdbuf->Commands != NULL) free(cmdbuf->Commands);
+        if (cmdbuf->Groups   != NULL) free(cmdbuf->Groups);
+        memset(cmdbuf, 0, sizeof(gl::command_buffer_t));
+    }
+}
+
+void gl::command_buffer_reset(gl::command_buffer_t *cmdbuf)
+{
+    cmdbuf->Used         = 0;
+    cmdbuf->CommandCount = 0;
+    cmdbuf->GroupCount   = 0;
+}
+
+bool gl::command_buffer_sort_key(gl::command_buffer_t *cmdbuf, uint64_t sort_key)
+{
+    if (cmdbuf->GroupCount > 0)
+    {
+        gl::command_group_t &g = cmdbuf->Groups[cmdbuf->GroupCount - 1];
+        if (g.Begin == g.End)
+        {   // the current group is empty; re-use it.
+            g.SortKey = sort_key;
+            return true;
+        }
+    }
+    return command_buffer_group(cmdbuf, sort_key);
+}
+
+bool gl::command_buffer_use_program(gl::command_buffer_t *cmdbuf, GLuint program)
+{
+    return command_buffer_bind(cmdbuf, gl::COMMAND_TYPE_USE_PROGRAM, GL_NONE, 0, program);
+}
+
+bool gl::command_buffer_bind_vertex_array(gl::command_buffer_t *cmdbuf, GLuint vao)
+{
+    return command_buffer_bind(cmdbuf, gl::COMMAND_TYPE_BIND_VERTEX_ARRAY, GL_NONE, 0, vao);
+}
+
+bool gl::command_buffer_bind_buffer(gl::command_buffer_t *cmdbuf, GLenum target, GLuint buffer)
+{
+    return command_buffer_bind(cmdbuf, gl::COMMAND_TYPE_BIND_BUFFER, target, 0, buffer);
+}
+
+bool gl::command_buffer_bind_buffer_range(gl::command_buffer_t *cmdbuf, GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    command_bind_range_t *cmd = (command_bind_range_t*) command_buffer_alloc(cmdbuf, gl::COMMAND_TYPE_BIND_BUFFER_RANGE, sizeof(command_bind_range_t));
+    if (cmd == NULL) return false;
+    cmd->Target = target;
+    cmd->Index  = index;
+    cmd->Buffer = buffer;
+    cmd->Offset = offset;
+    cmd->Size   = size;
+    return true;
+}
+
+bool gl::command_buffer_bind_texture(gl::command_buffer_t *cmdbuf, GLuint unit, GLenum target, GLuint texture)
+{
+    return command_buffer_bind(cmdbuf, gl::COMMAND_TYPE_BIND_TEXTURE, target, unit, texture);
+}
+
+bool gl::command_buffer_set_sampler(gl::command_buffer_t *cmdbuf, gl::sampler_desc_t *sampler, GLuint texture)
+{
+    command_sampler_t *cmd = (command_sampler_t*) command_buffer_alloc(cmdbuf, gl::COMMAND_TYPE_SET_SAMPLER, sizeof(command_sampler_t));
+    if (cmd == NULL) return false;
+    cmd->Sampler = sampler;
+    cmd->Texture = texture;
+    return true;
+}
+
+bool gl::command_buffer_set_uniform(gl::command_buffer_t *cmdbuf, gl::uniform_desc_t *uniform, void const *value, bool transpose)
+{
+    size_t             size = sizeof(command_uniform_t) + uniform->DataSize;
+    command_uniform_t *cmd  = (command_uniform_t*) command_buffer_alloc(cmdbuf, gl::COMMAND_TYPE_SET_UNIFORM, size);
+    if (cmd == NULL) return false;
+    cmd->Uniform   = uniform;
+    cmd->Transpose = transpose ? 1 : 0;
+    memcpy(cmd + 1, value, uniform->DataSize);
+    return true;
+}
+
+bool gl::command_buffer_enable(gl::command_buffer_t *cmdbuf, GLenum cap, bool enable)
+{
+    return command_buffer_state(cmdbuf, gl::COMMAND_TYPE_ENABLE, cap, enable ? GL_TRUE : GL_FALSE, GL_NONE, GL_NONE) != NULL;
+}
+
+bool gl::command_buffer_blend_func(gl::command_buffer_t *cmdbuf, GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha)
+{
+    return command_buffer_state(cmdbuf, gl::COMMAND_TYPE_BLEND_FUNC, src_rgb, dst_rgb, src_alpha, dst_alpha) != NULL;
+}
+
+bool gl::command_buffer_blend_equation(gl::command_buffer_t *cmdbuf, GLenum mode_rgb, GLenum mode_alpha)
+{
+    return command_buffer_state(cmdbuf, gl::COMMAND_TYPE_BLEND_EQUATION, mode_rgb, mode_alpha, GL_NONE, GL_NONE) != NULL;
+}
+
+bool gl::command_buffer_blend_color(gl::command_buffer_t *cmdbuf, float r, float g, float b, float a)
+{
+    command_state_t *cmd = command_buffer_state(cmdbuf, gl::COMMAND_TYPE_BLEND_COLOR, GL_NONE, GL_NONE, GL_NONE, GL_NONE);
+    if (cmd == NULL) return false;
+    cmd->Color[0] = r;
+    cmd->Color[1] = g;
+    cmd->Color[2] = b;
+    cmd->Color[3] = a;
+    return true;
+}
+
+bool gl::command_buffer_depth_func(gl::command_buffer_t *cmdbuf, GLenum func)
+{
+    return command_buffer_state(cmdbuf, gl::COMMAND_TYPE_DEPTH_FUNC, func, GL_NONE, GL_NONE, GL_NONE) != NULL;
+}
+
+bool gl::command_buffer_depth_mask(gl::command_buffer_t *cmdbuf, bool write)
+{
+    return command_buffer_state(cmdbuf, gl::COMMAND_TYPE_DEPTH_MASK, write ? GL_TRUE : GL_FALSE, GL_NONE, GL_NONE, GL_NONE) != NULL;
+}
+
+bool gl::command_buffer_transfer_pixels_h2d(gl::command_buffer_t *cmdbuf, gl::pixel_transfer_h2d_t const *transfer)
+{
+    void *cmd = command_buffer_alloc(cmdbuf, gl::COMMAND_TYPE_TRANSFER_PIXELS_H2D, sizeof(gl::pixel_transfer_h2d_t));
+    if (cmd == NULL) return false;
+    memcpy(cmd, transfer, sizeof(gl::pixel_transfer_h2d_t));
+    return true;
+}
+
+bool gl::command_buffer_transfer_pixels_d2h(gl::command_buffer_t *cmdbuf, gl::pixel_transfer_d2h_t const *transfer)
+{
+    void *cmd = command_buffer_alloc(cmdbuf, gl::COMMAND_TYPE_TRANSFER_PIXELS_D2H, sizeof(gl::pixel_transfer_d2h_t));
+    if (cmd == NULL) return false;
+    memcpy(cmd, transfer, sizeof(gl::pixel_transfer_d2h_t));
+    return true;
+}
+
+bool gl::command_buffer_draw_sprite_batch(gl::command_buffer_t *cmdbuf, gl::sprite_effect_t *effect, gl::sprite_batch_t *batch, gl::sprite_effect_apply_t const *fxfuncs, void *context)
+{
+    command_draw_sprites_t *cmd = (command_draw_sprites_t*) command_buffer_alloc(cmdbuf, gl::COMMAND_TYPE_DRAW_SPRITE_BATCH, sizeof(command_draw_sprites_t));
+    if (cmd == NULL) return false;
+    cmd->Effect  = effect;
+    cmd->Batch   = batch;
+    cmd->FxFuncs = fxfuncs;
+    cmd->Context = context;
+    return true;
+}
+
+bool gl::command_buffer_callback(gl::command_buffer_t *cmdbuf, gl::command_callback_fn func, void *context)
+{
+    command_callback_t *cmd = (command_callback_t*) command_buffer_alloc(cmdbuf, gl::COMMAND_TYPE_CALLBACK, sizeof(command_callback_t));
+    if (cmd == NULL) return false;
+    cmd->Func    = func;
+    cmd->Context = context;
+    return true;
+}
+
+size_t gl::execute_command_buffers(gl::command_buffer_t * const *buffers, size_t buffer_count)
+{
+    command_group_ref_t *refs      = NULL;
+    size_t               ref_count = 0;
+    size_t               executed  = 0;
+
+    for (size_t i = 0; i < buffer_count; ++i)
+        ref_count += buffers[i]->GroupCount;
+    if (ref_count == 0)
+        return 0;
+    if ((refs = (command_group_ref_t*) malloc(ref_count * sizeof(command_group_ref_t))) == NULL)
+        return 0;
+
+    // gather the groups from all buffers and merge them by sort key.
+    for (size_t i = 0, n = 0; i < buffer_count; ++i)
+    {
+        for (size_t j = 0; j < buffers[i]->GroupCount; ++j, ++n)
+        {
+            refs[n].SortKey = buffers[i]->Groups[j].SortKey;
+            refs[n].Buffer  = i;
+            refs[n].Group   = j;
+        }
+    }
+    std::sort(refs, refs + ref_count, command_group_order());
+
+    for (size_t i = 0; i < ref_count; ++i)
+    {
+        gl::command_buffer_t const *cmdbuf = buffers[refs[i].Buffer];
+        gl::command_group_t  const &group  = cmdbuf->Groups[refs[i].Group];
+        size_t                      offset = group.Begin;
+        while (offset < group.End)
+        {
+            command_header_t const *cmd = (command_header_t const*) (cmdbuf->Commands + offset);
+            execute_command(cmd);
+            offset += cmd->Size;
+            executed++;
+        }
+    }
+    free(refs);
+    return executed;
+}
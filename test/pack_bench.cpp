@@ -0,0 +1,366 @@
+/*/////////////////////////////////////////////////////////////////////////////
+/// @summary Measures page occupancy, insert time and removal time of the
+/// rectangle packers, and the result of each bulk pack trial, over a set of
+/// sprite sizes loaded from a file or generated.
+/// @author Russell Klenk (contact@russellklenk.com)
+///////////////////////////////////////////////////////////////////////////80*/
+
+/*////////////////
+//   Includes   //
+////////////////*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "gldraw2d.hpp"
+
+/*/////////////////
+//   Constants   //
+/////////////////*/
+/// @summary The width and height of each simulated atlas page, in pixels.
+static const size_t PAGE_SIZE      = 1024;
+
+/// @summary The padding applied around each sub-image, in pixels.
+static const size_t PAGE_PADDING   = 1;
+
+/// @summary The number of sprite sizes generated when no corpus is specified.
+static const size_t GENERATE_COUNT = 4096;
+
+/// @summary The number of times the corpus is packed for each packer type.
+static const size_t REPEAT_COUNT   = 8;
+
+/// @summary The packer types to benchmark, and their display names.
+static const size_t PACKER_COUNT   = r2d::PACKER_TYPE_COUNT;
+static const char  *PACKER_NAMES[PACKER_COUNT] =
+{
+    "GUILLOTINE",
+    "MAXRECTS_BSSF",
+    "MAXRECTS_BAF",
+    "SKYLINE_BL"
+};
+
+/// @summary The display names of the bulk pack sort keys.
+static const size_t SORT_COUNT     = r2d::ATLAS_SORT_COUNT;
+static const char  *SORT_NAMES[SORT_COUNT] =
+{
+    "HEIGHT",
+    "AREA",
+    "PERIMETER",
+    "MAXSIDE"
+};
+
+/*///////////////////////
+//   Local Functions   //
+///////////////////////*/
+/// @summary Loads a sprite corpus from a text file containing one 'width height'
+/// pair per line.
+/// @param path The path of the corpus file.
+/// @param out_w On return, points to a malloc'd array of widths.
+/// @param out_h On return, points to a malloc'd array of heights.
+/// @return The number of sizes loaded.
+static size_t load_corpus(char const *path, size_t **out_w, size_t **out_h)
+{
+    FILE   *fp    = fopen(path, "rt");
+    size_t  count = 0;
+    size_t  cap   = 1024;
+    size_t *w     = (size_t*) malloc(cap * sizeof(size_t));
+    size_t *h     = (size_t*) malloc(cap * sizeof(size_t));
+    unsigned iw   = 0;
+    unsigned ih   = 0;
+    if (fp == NULL)
+    {
+        free(w); free(h);
+        return 0;
+    }
+    while (fscanf(fp, "%u %u", &iw, &ih) == 2)
+    {
+        if (iw == 0 || ih == 0)
+            continue;
+        if (count == cap)
+        {
+            cap *= 2;
+            w = (size_t*) realloc(w, cap * sizeof(size_t));
+            h = (size_t*) realloc(h, cap * sizeof(size_t));
+        }
+        w[count] = iw;
+        h[count] = ih;
+        count++;
+    }
+    fclose(fp);
+    *out_w = w;
+    *out_h = h;
+    return count;
+}
+
+/// @summary Generates a deterministic set of sprite sizes mixing small icons,
+/// glyph-like strips and larger character frames.
+/// @param count The number of sizes to generate.
+/// @param out_w On return, points to a malloc'd array of widths.
+/// @param out_h On return, points to a malloc'd array of heights.
+/// @return The number of sizes generated.
+static size_t generate_corpus(size_t count, size_t **out_w, size_t **out_h)
+{
+    size_t  *w    = (size_t*) malloc(count * sizeof(size_t));
+    size_t  *h    = (size_t*) malloc(count * sizeof(size_t));
+    uint32_t seed = 0x2545F491U;
+    for (size_t i = 0; i < count; ++i)
+    {
+        seed = seed * 1664525U + 1013904223U;
+        uint32_t r = seed >> 8;
+        switch (r % 4)
+        {
+            case 0: w[i] = 8  + (r >> 2) % 24;  h[i] = 8  + (r >> 7) % 24;  break;
+            case 1: w[i] = 4  + (r >> 2) % 16;  h[i] = 16 + (r >> 7) % 32;  break;
+            case 2: w[i] = 32 + (r >> 2) % 64;  h[i] = 32 + (r >> 7) % 64;  break;
+            case 3: w[i] = 64 + (r >> 2) % 128; h[i] = 48 + (r >> 7) % 96;  break;
+        }
+    }
+    *out_w = w;
+    *out_h = h;
+    return count;
+}
+
+/// @summary Checks that no two rectangles placed by a packer overlap and that
+/// all rectangles lie within the master rectangle.
+/// @param p The packer to validate.
+/// @return true if the placement is valid.
+static bool validate_packer(r2d::packer_t const *p)
+{
+    for (size_t i = 0; i < p->Count; ++i)
+    {
+        r2d::pkrect_t const &a = p->Rects[i];
+        if (a.X + a.Width + PAGE_PADDING > p->Width || a.Y + a.Height + PAGE_PADDING > p->Height)
+            return false;
+        for (size_t j = i + 1; j < p->Count; ++j)
+        {
+            r2d::pkrect_t const &b = p->Rects[j];
+            if (a.X < b.X + b.Width && b.X < a.X + a.Width &&
+                a.Y < b.Y + b.Height && b.Y < a.Y + a.Height)
+                return false;
+        }
+    }
+    return true;
+}
+
+/// @summary Removes every second sub-rectangle from a page and then inserts
+/// them again, measuring removal time and how much of the released space the
+/// packer is able to reuse.
+/// @param packer The page to churn.
+/// @param out_removed On return, stores the number of sub-rectangles removed.
+/// @param out_reinserted On return, stores the number of sub-rectangles re-inserted.
+/// @return The number of clock ticks spent in packer_remove.
+static clock_t churn_page(r2d::packer_t *packer, size_t *out_removed, size_t *out_reinserted)
+{
+    size_t         n       = packer->Count / 2;
+    r2d::pkrect_t *removed = (r2d::pkrect_t*) malloc((n + 1) * sizeof(r2d::pkrect_t));
+    clock_t        elapsed = 0;
+    size_t         count   = 0;
+    size_t         placed  = 0;
+    for (size_t i = 0; i < n; ++i)
+    {   // Rects is reordered by removal, so copy the item first.
+        r2d::pkrect_t r = packer->Rects[i];
+        clock_t   start = clock();
+        if (r2d::packer_remove(packer, r.Content))
+            removed[count++] = r;
+        elapsed += clock() - start;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        r2d::pkrect_t const &r = removed[i];
+        if (r2d::packer_insert(packer, r.Width, r.Height, r.PadX, r.PadY, r.Content, NULL))
+            placed++;
+    }
+    free(removed);
+    *out_removed    = count;
+    *out_reinserted = placed;
+    return elapsed;
+}
+
+/// @summary Packs the corpus onto as many pages as necessary, inserting into
+/// the most recently created page first, as r2d::atlas_place_frame() does.
+/// @param type One of r2d::packer_type_e.
+/// @param n The number of sizes in the corpus.
+/// @param w The array of corpus widths.
+/// @param h The array of corpus heights.
+/// @param out_pages On return, stores the number of pages used.
+/// @param out_area On return, stores the total padded area placed.
+/// @param out_valid On return, set to false if any page failed validation.
+/// @param out_remove On return, stores the number of seconds spent in packer_remove.
+/// @param out_removed On return, stores the number of sub-rectangles removed while churning.
+/// @param out_reinserted On return, stores the number of sub-rectangles re-inserted while churning.
+/// @return The number of seconds spent in packer_insert.
+static double pack_corpus(uint32_t type, size_t n, size_t const *w, size_t const *h, size_t *out_pages, size_t *out_area, bool *out_valid, double *out_remove, size_t *out_removed, size_t *out_reinserted)
+{
+    size_t         capacity = 16;
+    size_t         pages    = 0;
+    clock_t        elapsed  = 0;
+    r2d::packer_t *packers  = (r2d::packer_t*) malloc(capacity * sizeof(r2d::packer_t));
+    *out_area = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        r2d::pkrect_t rect;
+        bool    placed = false;
+        clock_t start  = clock();
+        for (size_t p  = pages; p > 0 && !placed; --p)
+        {
+            placed = r2d::packer_insert(&packers[p-1], w[i], h[i], PAGE_PADDING, PAGE_PADDING, uint32_t(i), &rect);
+        }
+        if (!placed)
+        {
+            if (pages == capacity)
+            {
+                capacity *= 2;
+                packers   = (r2d::packer_t*) realloc(packers, capacity * sizeof(r2d::packer_t));
+            }
+            r2d::create_packer(&packers[pages], type, PAGE_SIZE, PAGE_SIZE, 256);
+            placed = r2d::packer_insert(&packers[pages++], w[i], h[i], PAGE_PADDING, PAGE_PADDING, uint32_t(i), &rect);
+        }
+        elapsed += clock() - start;
+        if (placed) *out_area += (w[i] + PAGE_PADDING * 2) * (h[i] + PAGE_PADDING * 2);
+    }
+    *out_valid = true;
+    *out_removed    = 0;
+    *out_reinserted = 0;
+    clock_t removing = 0;
+    for (size_t p = 0; p < pages; ++p)
+    {
+        size_t  nr = 0;
+        size_t  ni = 0;
+        if (!validate_packer(&packers[p]))
+            *out_valid = false;
+        removing += churn_page(&packers[p], &nr, &ni);
+        if (!validate_packer(&packers[p]))
+            *out_valid = false;
+        *out_removed    += nr;
+        *out_reinserted += ni;
+        r2d::delete_packer(&packers[p]);
+    }
+    free(packers);
+    *out_remove = double(removing) / double(CLOCKS_PER_SEC);
+    *out_pages  = pages;
+    return double(elapsed) / double(CLOCKS_PER_SEC);
+}
+
+/// @summary Runs every trial of a bulk pack over the corpus, treating each size
+/// as a single-frame entry, and prints the result of each trial and the best.
+/// @param n The number of sizes in the corpus.
+/// @param w The array of corpus widths.
+/// @param h The array of corpus heights.
+static void bulk_pack_corpus(size_t n, size_t const *w, size_t const *h)
+{
+    r2d::atlas_t      atlas;
+    r2d::atlas_pack_plan_t plan;
+    uint32_t         *names  = (uint32_t*) malloc(n * sizeof(uint32_t));
+    size_t           *frames = (size_t  *) malloc(n * sizeof(size_t));
+    for (size_t i = 0; i < n; ++i)
+    {
+        names [i] = uint32_t(i);
+        frames[i] = 1;
+    }
+    // only the page dimensions and padding are used by the pack plan.
+    atlas.PageWidth     = PAGE_SIZE;
+    atlas.PageHeight    = PAGE_SIZE;
+    atlas.HorizontalPad = PAGE_PADDING;
+    atlas.VerticalPad   = PAGE_PADDING;
+    if (!r2d::create_atlas_pack_plan(&plan, &atlas, n, names, frames, w, h, r2d::ATLAS_PACK_ALL))
+    {
+        printf("ERROR: Unable to create the bulk pack plan.\n");
+        free(frames); free(names);
+        return;
+    }
+
+    printf("\n%-10s %-14s %6s %10s %12s %6s\n", "SORT", "PACKER", "PAGES", "OCCUPANCY", "MS/TRIAL", "VALID");
+    clock_t total = 0;
+    for (size_t i = 0; i < plan.TrialCount; ++i)
+    {
+        r2d::atlas_pack_trial_t const &t = plan.Trials[i];
+        clock_t start = clock();
+        r2d::atlas_pack_trial(&plan, i);
+        clock_t ticks = clock() - start;
+        total += ticks;
+        size_t  area  = 0;
+        bool    valid = t.Success;
+        for (size_t p = 0; p < t.PageCount; ++p)
+        {
+            area += t.Pages[p].Used;
+            valid = valid && validate_packer(&t.Pages[p]);
+        }
+        double occupancy = t.PageCount > 0 ? double(area) / double(t.PageCount * PAGE_SIZE * PAGE_SIZE) : 0.0;
+        printf("%-10s %-14s %6u %9.2f%% %12.3f %6s\n", SORT_NAMES[t.SortKey], PACKER_NAMES[t.PackerType], unsigned(t.PageCount), occupancy * 100.0, double(ticks) * 1000.0 / double(CLOCKS_PER_SEC), valid ? "yes" : "NO");
+    }
+    size_t best = r2d::atlas_pack_best(&plan);
+    if (best < plan.TrialCount)
+    {
+        r2d::atlas_pack_trial_t const &t = plan.Trials[best];
+        printf("BEST:      %s/%s, %u pages, %.3f ms for all trials.\n", SORT_NAMES[t.SortKey], PACKER_NAMES[t.PackerType], unsigned(t.PageCount), double(total) * 1000.0 / double(CLOCKS_PER_SEC));
+    }
+    else printf("BEST:      No trial placed every item.\n");
+    r2d::delete_atlas_pack_plan(&plan);
+    free(frames);
+    free(names);
+}
+
+/*////////////////////////
+//   Public Functions   //
+////////////////////////*/
+/// @summary Implements the entry point of the application.
+/// @param argc The number of arguments passed on the command line.
+/// @param argv An array of strings specifying command line arguments.
+/// @return EXIT_SUCCESS or EXIT_FAILURE.
+int main(int argc, char **argv)
+{
+    size_t *w = NULL;
+    size_t *h = NULL;
+    size_t  n = 0;
+
+    if (argc > 1)
+    {
+        if ((n = load_corpus(argv[1], &w, &h)) == 0)
+        {
+            printf("ERROR: Unable to load any sizes from \'%s\'.\n", argv[1]);
+            printf("USAGE: packbench [path/to/sizes.txt]\n");
+            exit(EXIT_FAILURE);
+        }
+        printf("INFO:  Loaded %u sizes from \'%s\'.\n", unsigned(n), argv[1]);
+    }
+    else
+    {
+        n = generate_corpus(GENERATE_COUNT, &w, &h);
+        printf("INFO:  Generated %u sizes.\n", unsigned(n));
+    }
+
+    printf("%-14s %6s %10s %12s %12s %9s %6s\n", "PACKER", "PAGES", "OCCUPANCY", "US/INSERT", "US/REMOVE", "REINSERT", "VALID");
+    for (size_t t = 0; t < PACKER_COUNT; ++t)
+    {
+        size_t pages   = 0;
+        size_t area    = 0;
+        size_t nremove = 0;
+        size_t nreused = 0;
+        bool   valid   = true;
+        double seconds = 0.0;
+        double removal = 0.0;
+        for (size_t r  = 0; r < REPEAT_COUNT; ++r)
+        {
+            bool   ok  = true;
+            double rs  = 0.0;
+            size_t nr  = 0;
+            size_t ni  = 0;
+            seconds   += pack_corpus(uint32_t(t), n, w, h, &pages, &area, &ok, &rs, &nr, &ni);
+            removal   += rs;
+            nremove   += nr;
+            nreused   += ni;
+            valid      = valid && ok;
+        }
+        double occupancy = double(area) / double(pages * PAGE_SIZE * PAGE_SIZE);
+        double us_insert = (seconds * 1000000.0) / double(n * REPEAT_COUNT);
+        double us_remove = nremove > 0 ? (removal * 1000000.0) / double(nremove) : 0.0;
+        double reinsert  = nremove > 0 ? double(nreused) / double(nremove) : 0.0;
+        if (nremove > 0) printf("%-14s %6u %9.2f%% %12.3f %12.3f %8.2f%% %6s\n", PACKER_NAMES[t], unsigned(pages), occupancy * 100.0, us_insert, us_remove, reinsert * 100.0, valid ? "yes" : "NO");
+        else printf("%-14s %6u %9.2f%% %12.3f %12s %9s %6s\n", PACKER_NAMES[t], unsigned(pages), occupancy * 100.0, us_insert, "-", "-", valid ? "yes" : "NO");
+    }
+
+    bulk_pack_corpus(n, w, h);
+
+    free(h);
+    free(w);
+    exit(EXIT_SUCCESS);
+}